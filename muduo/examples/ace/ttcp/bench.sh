@@ -0,0 +1,31 @@
+#!/bin/sh
+# Sweep buffer lengths and connection counts over every ttcp receiver,
+# eg. ./bench.sh ../../../build/release-cpp11/bin > ttcp.csv
+# ttcp_muduo is the transmitter for all runs, so only the receiver varies.
+# Each run prints one CSV record with throughput, CPU time, syscalls and
+# context switches of the receiving process.
+
+BIN=${1:-.}
+LENGTHS=${LENGTHS:-"1024 16384 65536 1048576"}
+CONNECTIONS=${CONNECTIONS:-"1 4 16"}
+TOTAL_MB=${TOTAL_MB:-1024}  # per connection
+PORT=5001
+
+IMPLS="muduo blocking"
+[ -x $BIN/ttcp_asio_sync ] && IMPLS="$IMPLS asio_sync"
+[ -x $BIN/ttcp_asio_async ] && IMPLS="$IMPLS asio_async"
+
+echo "csv,label,role,length,number,connections,seconds,MiB,MiB/s,user,sys,cpu_per_GiB,rw_syscalls,rw_syscalls_per_MiB,vcsw,ivcsw"
+for impl in $IMPLS; do
+  for length in $LENGTHS; do
+    number=$((TOTAL_MB * 1048576 / length))
+    for conn in $CONNECTIONS; do
+      $BIN/ttcp_$impl -r -p $PORT -c $conn --csv $impl > recv.$$.log 2>&1 & pid=$!
+      sleep 1
+      $BIN/ttcp_muduo -t 127.0.0.1 -p $PORT -l $length -n $number -c $conn --csv $impl > /dev/null 2>&1
+      wait $pid
+      grep ^csv, recv.$$.log
+    done
+  done
+done
+rm -f recv.$$.log
@@ -1,4 +1,6 @@
 #include "examples/ace/ttcp/common.h"
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/Timestamp.h"
 #include "muduo/base/Types.h"
 
 #include <boost/program_options.hpp>
@@ -7,6 +9,8 @@
 
 #include <netdb.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
 
 namespace po = boost::program_options;
 
@@ -21,6 +25,10 @@ bool parseCommandLine(int argc, char* argv[], Options* opt)
       ("trans,t",  po::value<std::string>(&opt->host), "Transmit")
       ("recv,r", "Receive")
       ("nodelay,D", "set TCP_NODELAY")
+      ("connections,c", po::value<int>(&opt->connections)->default_value(1),
+       "Number of concurrent connections")
+      ("csv", po::value<std::string>(&opt->csv),
+       "Print a CSV record with this label when done")
       ;
 
   po::variables_map vm;
@@ -43,6 +51,7 @@ bool parseCommandLine(int argc, char* argv[], Options* opt)
   }
 
   printf("port = %d\n", opt->port);
+  printf("connections = %d\n", opt->connections);
   if (opt->transmit)
   {
     printf("buffer length = %d\n", opt->length);
@@ -74,3 +83,53 @@ struct sockaddr_in resolveOrDie(const char* host, uint16_t port)
   return addr;
 }
 
+namespace
+{
+
+int64_t findField(const std::string& content, const char* name)
+{
+  size_t pos = content.find(name);
+  if (pos == std::string::npos)
+    return 0;
+  return ::atoll(content.c_str() + pos + ::strlen(name));
+}
+
+}  // namespace
+
+ResourceUsage ResourceUsage::now()
+{
+  ResourceUsage u;
+  u.seconds = static_cast<double>(muduo::Timestamp::now().microSecondsSinceEpoch()) / 1e6;
+
+  struct rusage ru;
+  ::getrusage(RUSAGE_SELF, &ru);
+  u.userSeconds = static_cast<double>(ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec) / 1e6;
+  u.systemSeconds = static_cast<double>(ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec) / 1e6;
+  u.voluntarySwitches = ru.ru_nvcsw;
+  u.involuntarySwitches = ru.ru_nivcsw;
+
+  std::string io;
+  muduo::FileUtil::readFile("/proc/self/io", 65536, &io);
+  u.readCalls = findField(io, "syscr:");
+  u.writeCalls = findField(io, "syscw:");
+  return u;
+}
+
+void printCsv(const Options& opt, const char* role, int length, int number,
+              const ResourceUsage& start, const ResourceUsage& end)
+{
+  if (opt.csv.empty())
+    return;
+  double seconds = end.seconds - start.seconds;
+  double mib = 1.0 * length * number * opt.connections / 1024 / 1024;
+  double user = end.userSeconds - start.userSeconds;
+  double sys = end.systemSeconds - start.systemSeconds;
+  int64_t syscalls = (end.readCalls - start.readCalls) + (end.writeCalls - start.writeCalls);
+  printf("csv,%s,%s,%d,%d,%d,%.3f,%.1f,%.1f,%.3f,%.3f,%.3f,%ld,%.1f,%ld,%ld\n",
+         opt.csv.c_str(), role, length, number, opt.connections,
+         seconds, mib, mib / seconds, user, sys, (user + sys) * 1024 / mib,
+         static_cast<long>(syscalls), static_cast<double>(syscalls) / mib,
+         static_cast<long>(end.voluntarySwitches - start.voluntarySwitches),
+         static_cast<long>(end.involuntarySwitches - start.involuntarySwitches));
+  fflush(stdout);
+}
@@ -8,10 +8,12 @@ struct Options
   uint16_t port;
   int length;
   int number;
+  int connections;
   bool transmit, receive, nodelay;
   std::string host;
+  std::string csv;
   Options()
-    : port(0), length(0), number(0),
+    : port(0), length(0), number(0), connections(1),
       transmit(false), receive(false), nodelay(false)
   {
   }
@@ -20,6 +22,26 @@ struct Options
 bool parseCommandLine(int argc, char* argv[], Options* opt);
 struct sockaddr_in resolveOrDie(const char* host, uint16_t port);
 
+// CPU time and context switches of all threads from getrusage(2),
+// read/write syscalls from /proc/self/io.  The latter doesn't count
+// recvmsg/sendmsg, which asio uses.
+struct ResourceUsage
+{
+  double seconds;  // wall clock
+  double userSeconds;
+  double systemSeconds;
+  int64_t readCalls;
+  int64_t writeCalls;
+  int64_t voluntarySwitches;
+  int64_t involuntarySwitches;
+
+  static ResourceUsage now();
+};
+
+// if --csv is given, prints one record of 'end - start' prefixed by "csv,"
+void printCsv(const Options& opt, const char* role, int length, int number,
+              const ResourceUsage& start, const ResourceUsage& end);
+
 struct SessionMessage
 {
   int32_t number;
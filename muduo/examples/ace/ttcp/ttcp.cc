@@ -5,12 +5,19 @@
 #include "muduo/net/TcpClient.h"
 #include "muduo/net/TcpServer.h"
 
+#include <memory>
+#include <vector>
+
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
 EventLoop* g_loop;
+int g_sessions = 0;  // finished connections
+int g_length = 0;
+int g_number = 0;
+ResourceUsage g_start = ResourceUsage();
 
 struct Context
 {
@@ -65,7 +72,10 @@ void onConnection(const Options& opt, const TcpConnectionPtr& conn)
   {
     const Context& context = boost::any_cast<Context>(conn->getContext());
     LOG_INFO << "payload bytes " << context.bytes;
-    conn->getLoop()->quit();
+    if (++g_sessions >= opt.connections)
+    {
+      conn->getLoop()->quit();
+    }
   }
 }
 
@@ -107,18 +117,24 @@ void transmit(const Options& opt)
     LOG_FATAL << "Unable to resolve " << opt.host;
   }
   muduo::Timestamp start(muduo::Timestamp::now());
+  g_start = ResourceUsage::now();
   EventLoop loop;
   g_loop = &loop;
-  TcpClient client(&loop, addr, "TtcpClient");
-  client.setConnectionCallback(
-      std::bind(&trans::onConnection, opt, _1));
-  client.setMessageCallback(
-      std::bind(&trans::onMessage, _1, _2, _3));
-  client.connect();
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  for (int i = 0; i < opt.connections; ++i)
+  {
+    clients.emplace_back(new TcpClient(&loop, addr, "TtcpClient"));
+    clients.back()->setConnectionCallback(
+        std::bind(&trans::onConnection, opt, _1));
+    clients.back()->setMessageCallback(
+        std::bind(&trans::onMessage, _1, _2, _3));
+    clients.back()->connect();
+  }
   loop.loop();
   double elapsed = timeDifference(muduo::Timestamp::now(), start);
-  double total_mb = 1.0 * opt.length * opt.number / 1024 / 1024;
+  double total_mb = 1.0 * opt.length * opt.number * opt.connections / 1024 / 1024;
   printf("%.3f MiB transferred\n%.3f MiB/s\n", total_mb, total_mb / elapsed);
+  printCsv(opt, "transmit", opt.length, opt.number, g_start, ResourceUsage::now());
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -128,10 +144,14 @@ void transmit(const Options& opt)
 namespace receiving
 {
 
-void onConnection(const TcpConnectionPtr& conn)
+void onConnection(const Options& opt, const TcpConnectionPtr& conn)
 {
   if (conn->connected())
   {
+    if (g_start.seconds == 0)
+    {
+      g_start = ResourceUsage::now();  // measures from the first connection
+    }
     Context context;
     conn->setContext(context);
   }
@@ -139,7 +159,10 @@ void onConnection(const TcpConnectionPtr& conn)
   {
     const Context& context = boost::any_cast<Context>(conn->getContext());
     LOG_INFO << "payload bytes " << context.bytes;
-    conn->getLoop()->quit();
+    if (++g_sessions >= opt.connections)
+    {
+      conn->getLoop()->quit();
+    }
   }
 }
 
@@ -155,6 +178,8 @@ void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time)
       {
         session.number = buf->readInt32();
         session.length = buf->readInt32();
+        g_length = session.length;
+        g_number = session.number;
         context->output.appendInt32(session.length);
         printf("receive number = %d\nreceive length = %d\n",
                session.number, session.length);
@@ -206,9 +231,10 @@ void receive(const Options& opt)
   InetAddress listenAddr(opt.port);
   TcpServer server(&loop, listenAddr, "TtcpReceive");
   server.setConnectionCallback(
-      std::bind(&receiving::onConnection, _1));
+      std::bind(&receiving::onConnection, opt, _1));
   server.setMessageCallback(
       std::bind(&receiving::onMessage, _1, _2, _3));
   server.start();
   loop.loop();
+  printCsv(opt, "receive", g_length, g_number, g_start, ResourceUsage::now());
 }
@@ -6,6 +6,13 @@
 
 using boost::asio::ip::tcp;
 
+boost::asio::io_service* g_io_service = NULL;
+int g_sessions = 0;  // finished connections
+int g_connections = 1;
+int g_length = 0;
+int g_number = 0;
+ResourceUsage g_start = ResourceUsage();
+
 void transmit(const Options& opt)
 {
   try
@@ -62,6 +69,8 @@ class TtcpServerConnection : public std::enable_shared_from_this<TtcpServerConne
             sessionMessage_.length = ntohl(sessionMessage_.length);
             printf("receive number = %d\nreceive length = %d\n",
                    sessionMessage_.number, sessionMessage_.length);
+            g_length = sessionMessage_.length;
+            g_number = sessionMessage_.number;
             const int total_len = static_cast<int>(sizeof(int32_t) + sessionMessage_.length);
             payload_ = static_cast<PayloadMessage*>(::malloc(total_len));
             doReadLength();
@@ -129,6 +138,10 @@ class TtcpServerConnection : public std::enable_shared_from_this<TtcpServerConne
             else
             {
               LOG_INFO << "Done";
+              if (++g_sessions >= g_connections)
+              {
+                g_io_service->stop();
+              }
             }
           }
           else
@@ -160,6 +173,10 @@ void doAccept(tcp::acceptor& acceptor)
       {
         if (!error)
         {
+          if (g_start.seconds == 0)
+          {
+            g_start = ResourceUsage::now();  // measures from the first connection
+          }
           new_connection->start();
         }
         doAccept(acceptor);
@@ -172,8 +189,11 @@ void receive(const Options& opt)
   {
     boost::asio::io_service io_service;
     tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), opt.port));
+    g_io_service = &io_service;
+    g_connections = opt.connections;
     doAccept(acceptor);
     io_service.run();
+    printCsv(opt, "receive", g_length, g_number, g_start, ResourceUsage::now());
   }
   catch (std::exception& e)
   {
@@ -1,7 +1,11 @@
 #include "examples/ace/ttcp/common.h"
 
+#include "muduo/base/Atomic.h"
 #include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
 #include <boost/asio.hpp>
+#include <memory>
+#include <vector>
 #include <stdio.h>
 
 using boost::asio::ip::tcp;
@@ -17,15 +21,14 @@ void transmit(const Options& opt)
   }
 }
 
-void receive(const Options& opt)
+// each connection thread stores the length of its session here
+muduo::AtomicInt64 g_length;
+muduo::AtomicInt64 g_number;
+
+void receiveOne(tcp::socket& socket)
 {
   try
   {
-    boost::asio::io_service io_service;
-    tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), opt.port));
-    tcp::socket socket(io_service);
-    acceptor.accept(socket);
-
     struct SessionMessage sessionMessage = { 0, 0 };
     boost::system::error_code error;
     size_t nr = boost::asio::read(socket, boost::asio::buffer(&sessionMessage, sizeof sessionMessage),
@@ -43,6 +46,8 @@ void receive(const Options& opt)
     sessionMessage.length = ntohl(sessionMessage.length);
     printf("receive number = %d\nreceive length = %d\n",
            sessionMessage.number, sessionMessage.length);
+    g_length.getAndSet(sessionMessage.length);
+    g_number.getAndSet(sessionMessage.number);
     const int total_len = static_cast<int>(sizeof(int32_t) + sessionMessage.length);
     PayloadMessage* payload = static_cast<PayloadMessage*>(::malloc(total_len));
     std::unique_ptr<PayloadMessage, void (*)(void*)> freeIt(payload, ::free);
@@ -84,3 +89,38 @@ void receive(const Options& opt)
     LOG_ERROR << e.what();
   }
 }
+
+void receive(const Options& opt)
+{
+  try
+  {
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), opt.port));
+    std::vector<std::unique_ptr<tcp::socket>> sockets;
+    std::vector<std::unique_ptr<muduo::Thread>> threads;
+    ResourceUsage usage;
+    for (int i = 0; i < opt.connections; ++i)
+    {
+      sockets.emplace_back(new tcp::socket(io_service));
+      acceptor.accept(*sockets.back());
+      if (i == 0)
+      {
+        usage = ResourceUsage::now();
+      }
+      // one thread per connection
+      threads.emplace_back(new muduo::Thread(std::bind(receiveOne, std::ref(*sockets.back())), "ttcp"));
+      threads.back()->start();
+    }
+    for (auto& thr : threads)
+    {
+      thr->join();
+    }
+    printCsv(opt, "receive",
+           static_cast<int>(g_length.get()), static_cast<int>(g_number.get()),
+           usage, ResourceUsage::now());
+  }
+  catch (std::exception& e)
+  {
+    LOG_ERROR << e.what();
+  }
+}
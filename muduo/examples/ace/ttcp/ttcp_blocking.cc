@@ -1,7 +1,12 @@
 #include "examples/ace/ttcp/common.h"
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Thread.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/base/Types.h"
 
+#include <memory>
+#include <vector>
+
 #undef NDEBUG
 
 #include <assert.h>
@@ -12,7 +17,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-static int acceptOrDie(uint16_t port)
+static int listenOrDie(uint16_t port)
 {
   int listenfd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
   assert(listenfd >= 0);
@@ -35,12 +40,16 @@ static int acceptOrDie(uint16_t port)
     exit(1);
   }
 
-  if (listen(listenfd, 5))
+  if (listen(listenfd, 128))
   {
     perror("listen");
     exit(1);
   }
+  return listenfd;
+}
 
+static int acceptOrDie(int listenfd)
+{
   struct sockaddr_in peer_addr;
   muduo::memZero(&peer_addr, sizeof(peer_addr));
   socklen_t addrlen = 0;
@@ -50,7 +59,6 @@ static int acceptOrDie(uint16_t port)
     perror("accept");
     exit(1);
   }
-  ::close(listenfd);
   return sockfd;
 }
 
@@ -100,11 +108,8 @@ static int read_n(int sockfd, void* buf, int length)
   return nread;
 }
 
-void transmit(const Options& opt)
+static void transmitOne(const Options& opt, struct sockaddr_in addr)
 {
-  struct sockaddr_in addr = resolveOrDie(opt.host.c_str(), opt.port);
-  printf("connecting to %s:%d\n", inet_ntoa(addr.sin_addr), opt.port);
-
   int sockfd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
   assert(sockfd >= 0);
   int ret = ::connect(sockfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
@@ -117,7 +122,6 @@ void transmit(const Options& opt)
   }
 
   printf("connected\n");
-  muduo::Timestamp start(muduo::Timestamp::now());
   struct SessionMessage sessionMessage = { 0, 0 };
   sessionMessage.number = htonl(opt.number);
   sessionMessage.length = htonl(opt.length);
@@ -136,9 +140,6 @@ void transmit(const Options& opt)
     payload->data[i] = "0123456789ABCDEF"[i % 16];
   }
 
-  double total_mb = 1.0 * opt.length * opt.number / 1024 / 1024;
-  printf("%.3f MiB in total\n", total_mb);
-
   for (int i = 0; i < opt.number; ++i)
   {
     int nw = write_n(sockfd, payload, total_len);
@@ -153,14 +154,48 @@ void transmit(const Options& opt)
 
   ::free(payload);
   ::close(sockfd);
+}
+
+void transmit(const Options& opt)
+{
+  struct sockaddr_in addr = resolveOrDie(opt.host.c_str(), opt.port);
+  printf("connecting to %s:%d\n", inet_ntoa(addr.sin_addr), opt.port);
+
+  muduo::Timestamp start(muduo::Timestamp::now());
+  ResourceUsage usage = ResourceUsage::now();
+  double total_mb = 1.0 * opt.length * opt.number * opt.connections / 1024 / 1024;
+  printf("%.3f MiB in total\n", total_mb);
+
+  if (opt.connections == 1)
+  {
+    transmitOne(opt, addr);
+  }
+  else
+  {
+    // one thread per connection, as a blocking server would do
+    std::vector<std::unique_ptr<muduo::Thread>> threads;
+    for (int i = 0; i < opt.connections; ++i)
+    {
+      threads.emplace_back(new muduo::Thread(std::bind(transmitOne, opt, addr), "ttcp"));
+      threads.back()->start();
+    }
+    for (auto& thr : threads)
+    {
+      thr->join();
+    }
+  }
+
   double elapsed = timeDifference(muduo::Timestamp::now(), start);
   printf("%.3f seconds\n%.3f MiB/s\n", elapsed, total_mb / elapsed);
+  printCsv(opt, "transmit", opt.length, opt.number, usage, ResourceUsage::now());
 }
 
-void receive(const Options& opt)
-{
-  int sockfd = acceptOrDie(opt.port);
+// stored concurrently by the receiveOne() thread of every connection
+static muduo::AtomicInt64 g_length;
+static muduo::AtomicInt64 g_number;
 
+static void receiveOne(int sockfd)
+{
   struct SessionMessage sessionMessage = { 0, 0 };
   if (read_n(sockfd, &sessionMessage, sizeof(sessionMessage)) != sizeof(sessionMessage))
   {
@@ -172,6 +207,8 @@ void receive(const Options& opt)
   sessionMessage.length = ntohl(sessionMessage.length);
   printf("receive number = %d\nreceive length = %d\n",
          sessionMessage.number, sessionMessage.length);
+  g_length.getAndSet(sessionMessage.length);
+  g_number.getAndSet(sessionMessage.number);
   const int total_len = static_cast<int>(sizeof(int32_t) + sessionMessage.length);
   PayloadMessage* payload = static_cast<PayloadMessage*>(::malloc(total_len));
   assert(payload);
@@ -202,3 +239,35 @@ void receive(const Options& opt)
   ::close(sockfd);
 }
 
+void receive(const Options& opt)
+{
+  int listenfd = listenOrDie(opt.port);
+  int sockfd = acceptOrDie(listenfd);
+  ResourceUsage usage = ResourceUsage::now();
+  if (opt.connections == 1)
+  {
+    ::close(listenfd);
+    receiveOne(sockfd);
+  }
+  else
+  {
+    std::vector<std::unique_ptr<muduo::Thread>> threads;
+    for (int i = 0; i < opt.connections; ++i)
+    {
+      if (i > 0)
+      {
+        sockfd = acceptOrDie(listenfd);
+      }
+      threads.emplace_back(new muduo::Thread(std::bind(receiveOne, sockfd), "ttcp"));
+      threads.back()->start();
+    }
+    ::close(listenfd);
+    for (auto& thr : threads)
+    {
+      thr->join();
+    }
+  }
+  printCsv(opt, "receive",
+           static_cast<int>(g_length.get()), static_cast<int>(g_number.get()),
+           usage, ResourceUsage::now());
+}
@@ -2,54 +2,22 @@
 #include "muduo/base/Logging.h"
 #include "muduo/net/Endian.h"
 
-struct FastCgiCodec::RecordHeader
-{
-  uint8_t version;
-  uint8_t type;
-  uint16_t id;
-  uint16_t length;
-  uint8_t padding;
-  uint8_t unused;
-};
-
 const unsigned FastCgiCodec::kRecordHeader = static_cast<unsigned>(sizeof(FastCgiCodec::RecordHeader));
 
-enum FcgiType
-{
-  kFcgiInvalid = 0,
-  kFcgiBeginRequest = 1,
-  kFcgiAbortRequest = 2,
-  kFcgiEndRequest = 3,
-  kFcgiParams = 4,
-  kFcgiStdin = 5,
-  kFcgiStdout = 6,
-  kFcgiStderr = 7,
-  kFcgiData = 8,
-  kFcgiGetValues = 9,
-  kFcgiGetValuesResult = 10,
-};
-
-enum FcgiRole
-{
-  // kFcgiInvalid = 0,
-  kFcgiResponder = 1,
-  kFcgiAuthorizer = 2,
-};
-
-enum FcgiConstant
-{
-  kFcgiKeepConn = 1,
-};
-
 using namespace muduo::net;
 
-bool FastCgiCodec::onParams(const char* content, uint16_t length)
+bool FastCgiCodec::onParams(uint16_t id, const char* content, uint16_t length)
 {
+  std::map<uint16_t, Request>::iterator it = requests_.find(id);
+  if (it == requests_.end())
+  {
+    return false;
+  }
   if (length > 0)
   {
-    paramsStream_.append(content, length);
+    it->second.paramsStream.append(content, length);
   }
-  else if (!parseAllParams())
+  else if (!parseAllParams(&it->second))
   {
     LOG_ERROR << "parseAllParams() failed";
     return false;
@@ -57,32 +25,48 @@ bool FastCgiCodec::onParams(const char* content, uint16_t length)
   return true;
 }
 
-void FastCgiCodec::onStdin(const char* content, uint16_t length)
+void FastCgiCodec::onStdin(uint16_t id, const char* content, uint16_t length)
 {
+  std::map<uint16_t, Request>::iterator it = requests_.find(id);
+  if (it == requests_.end())
+  {
+    return;
+  }
   if (length > 0)
   {
-    stdin_.append(content, length);
+    it->second.input.append(content, length);
   }
   else
   {
-    gotRequest_ = true;
+    ready_.push_back(id);
   }
 }
 
-bool FastCgiCodec::parseAllParams()
+void FastCgiCodec::onAbortRequest(uint16_t id)
 {
-  while (paramsStream_.readableBytes() > 0)
+  std::map<uint16_t, Request>::iterator it = requests_.find(id);
+  if (it != requests_.end() && !it->second.aborted)
   {
-    uint32_t nameLen = readLen();
+    it->second.aborted = true;
+    ready_.push_back(id);
+  }
+}
+
+bool FastCgiCodec::parseAllParams(Request* request)
+{
+  Buffer* paramsStream = &request->paramsStream;
+  while (paramsStream->readableBytes() > 0)
+  {
+    uint32_t nameLen = readLen(paramsStream);
     if (nameLen == static_cast<uint32_t>(-1))
       return false;
-    uint32_t valueLen = readLen();
+    uint32_t valueLen = readLen(paramsStream);
     if (valueLen == static_cast<uint32_t>(-1))
       return false;
-    if (paramsStream_.readableBytes() >= nameLen+valueLen)
+    if (paramsStream->readableBytes() >= nameLen+valueLen)
     {
-      std::string name = paramsStream_.retrieveAsString(nameLen);
-      params_[name] = paramsStream_.retrieveAsString(valueLen);
+      std::string name = paramsStream->retrieveAsString(nameLen);
+      request->params[name] = paramsStream->retrieveAsString(valueLen);
     }
     else
     {
@@ -92,16 +76,16 @@ bool FastCgiCodec::parseAllParams()
   return true;
 }
 
-uint32_t FastCgiCodec::readLen()
+uint32_t FastCgiCodec::readLen(Buffer* paramsStream)
 {
-  if (paramsStream_.readableBytes() >= 1)
+  if (paramsStream->readableBytes() >= 1)
   {
-    uint8_t byte = paramsStream_.peekInt8();
+    uint8_t byte = paramsStream->peekInt8();
     if (byte & 0x80)
     {
-      if (paramsStream_.readableBytes() >= sizeof(uint32_t))
+      if (paramsStream->readableBytes() >= sizeof(uint32_t))
       {
-        return paramsStream_.readInt32() & 0x7fffffff;
+        return paramsStream->readInt32() & 0x7fffffff;
       }
       else
       {
@@ -110,7 +94,7 @@ uint32_t FastCgiCodec::readLen()
     }
     else
     {
-      return paramsStream_.readInt8();
+      return paramsStream->readInt8();
     }
   }
   else
@@ -121,13 +105,13 @@ uint32_t FastCgiCodec::readLen()
 
 using muduo::net::Buffer;
 
-void FastCgiCodec::endStdout(Buffer* buf)
+void FastCgiCodec::endStdout(Buffer* buf, uint16_t id)
 {
   RecordHeader header =
   {
     1,
     kFcgiStdout,
-    sockets::hostToNetwork16(1),
+    sockets::hostToNetwork16(id),
     0,
     0,
     0,
@@ -135,13 +119,13 @@ void FastCgiCodec::endStdout(Buffer* buf)
   buf->append(&header, kRecordHeader);
 }
 
-void FastCgiCodec::endRequest(Buffer* buf)
+void FastCgiCodec::endRequest(Buffer* buf, uint16_t id)
 {
   RecordHeader header =
   {
     1,
     kFcgiEndRequest,
-    sockets::hostToNetwork16(1),
+    sockets::hostToNetwork16(id),
     sockets::hostToNetwork16(kRecordHeader),
     0,
     0,
@@ -151,7 +135,7 @@ void FastCgiCodec::endRequest(Buffer* buf)
   buf->appendInt32(0);
 }
 
-void FastCgiCodec::respond(Buffer* response)
+void FastCgiCodec::respond(Buffer* response, uint16_t requestId)
 {
   if (response->readableBytes() < 65536
       && response->prependableBytes() >= kRecordHeader)
@@ -160,7 +144,7 @@ void FastCgiCodec::respond(Buffer* response)
     {
       1,
       kFcgiStdout,
-      sockets::hostToNetwork16(1),
+      sockets::hostToNetwork16(requestId),
       sockets::hostToNetwork16(static_cast<uint16_t>(response->readableBytes())),
       static_cast<uint8_t>(-response->readableBytes() & 7),
       0,
@@ -173,8 +157,8 @@ void FastCgiCodec::respond(Buffer* response)
     // FIXME:
   }
 
-  endStdout(response);
-  endRequest(response);
+  endStdout(response, requestId);
+  endRequest(response, requestId);
 }
 
 bool FastCgiCodec::parseRequest(Buffer* buf)
@@ -195,11 +179,14 @@ bool FastCgiCodec::parseRequest(Buffer* buf)
           // FIXME: check
           break;
         case kFcgiParams:
-          onParams(buf->peek() + kRecordHeader, header.length);
+          onParams(header.id, buf->peek() + kRecordHeader, header.length);
           // FIXME: check
           break;
         case kFcgiStdin:
-          onStdin(buf->peek() + kRecordHeader, header.length);
+          onStdin(header.id, buf->peek() + kRecordHeader, header.length);
+          break;
+        case kFcgiAbortRequest:
+          onAbortRequest(header.id);
           break;
         case kFcgiData:
           // FIXME:
@@ -239,7 +226,7 @@ bool FastCgiCodec::onBeginRequest(const RecordHeader& header, const Buffer* buf)
     uint8_t flags = buf->peek()[kRecordHeader + sizeof(int16_t)];
     if (role == kFcgiResponder)
     {
-      keepConn_ = flags == kFcgiKeepConn;
+      requests_[header.id].keepConn = flags == kFcgiKeepConn;
       return true;
     }
   }
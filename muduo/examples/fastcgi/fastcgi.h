@@ -3,10 +3,38 @@
 
 #include "muduo/net/TcpConnection.h"
 #include <map>
+#include <vector>
+
+enum FcgiType
+{
+  kFcgiInvalid = 0,
+  kFcgiBeginRequest = 1,
+  kFcgiAbortRequest = 2,
+  kFcgiEndRequest = 3,
+  kFcgiParams = 4,
+  kFcgiStdin = 5,
+  kFcgiStdout = 6,
+  kFcgiStderr = 7,
+  kFcgiData = 8,
+  kFcgiGetValues = 9,
+  kFcgiGetValuesResult = 10,
+};
+
+enum FcgiRole
+{
+  // kFcgiInvalid = 0,
+  kFcgiResponder = 1,
+  kFcgiAuthorizer = 2,
+};
+
+enum FcgiConstant
+{
+  kFcgiKeepConn = 1,
+};
 
 // one FastCgiCodec per TcpConnection
-// both lighttpd and nginx do not implement multiplexing,
-// so there is no concurrent requests of one connection.
+// both lighttpd and nginx do not implement multiplexing, FastCgiClient
+// does, so requests are kept by id and their records may interleave.
 class FastCgiCodec : muduo::noncopyable
 {
  public:
@@ -15,10 +43,19 @@ class FastCgiCodec : muduo::noncopyable
                                 ParamMap&,
                                 muduo::net::Buffer*)> Callback;
 
+  struct RecordHeader
+  {
+    uint8_t version;
+    uint8_t type;
+    uint16_t id;
+    uint16_t length;
+    uint8_t padding;
+    uint8_t unused;
+  };
+
   explicit FastCgiCodec(const Callback& cb)
     : cb_(cb),
-      gotRequest_(false),
-      keepConn_(false)
+      requestId_(0)
   {
   }
 
@@ -27,42 +64,68 @@ class FastCgiCodec : muduo::noncopyable
                  muduo::Timestamp receiveTime)
   {
     parseRequest(buf);
-    if (gotRequest_)
+    bool keepConn = true;
+    for (uint16_t id : ready_)
     {
-      cb_(conn, params_, &stdin_);
-      stdin_.retrieveAll();
-      paramsStream_.retrieveAll();
-      params_.clear();
-      gotRequest_ = false;
-      if (!keepConn_)
+      std::map<uint16_t, Request>::iterator it = requests_.find(id);
+      if (it == requests_.end())  // aborted
+        continue;
+      if (it->second.aborted)
       {
-        conn->shutdown();
+        // the web server waits for it to reuse the id
+        muduo::net::Buffer response;
+        endRequest(&response, id);
+        conn->send(&response);
       }
+      else
+      {
+        requestId_ = id;
+        cb_(conn, it->second.params, &it->second.input);
+      }
+      keepConn = it->second.keepConn;
+      requests_.erase(it);
+    }
+    ready_.clear();
+    if (!keepConn)
+    {
+      conn->shutdown();
     }
   }
 
-  static void respond(muduo::net::Buffer* response);
+  /// Id of the request being called back.
+  uint16_t requestId() const { return requestId_; }
+
+  /// Wraps response in STDOUT records and ends the request, pass requestId().
+  static void respond(muduo::net::Buffer* response, uint16_t requestId);
+
+  const static unsigned kRecordHeader;
 
  private:
-  struct RecordHeader;
+  struct Request
+  {
+    Request() : keepConn(false), aborted(false) { }
+    bool keepConn;
+    bool aborted;  // by ABORT_REQUEST, ended without calling back
+    muduo::net::Buffer input;  // stdin
+    muduo::net::Buffer paramsStream;
+    ParamMap params;
+  };
+
   bool parseRequest(muduo::net::Buffer* buf);
   bool onBeginRequest(const RecordHeader& header, const muduo::net::Buffer* buf);
-  void onStdin(const char* content, uint16_t length);
-  bool onParams(const char* content, uint16_t length);
-  bool parseAllParams();
-  uint32_t readLen();
+  void onStdin(uint16_t id, const char* content, uint16_t length);
+  void onAbortRequest(uint16_t id);
+  bool onParams(uint16_t id, const char* content, uint16_t length);
+  static bool parseAllParams(Request* request);
+  static uint32_t readLen(muduo::net::Buffer* paramsStream);
 
-  static void endStdout(muduo::net::Buffer* buf);
-  static void endRequest(muduo::net::Buffer* buf);
+  static void endStdout(muduo::net::Buffer* buf, uint16_t id);
+  static void endRequest(muduo::net::Buffer* buf, uint16_t id);
 
   Callback cb_;
-  bool gotRequest_;
-  bool keepConn_;
-  muduo::net::Buffer stdin_;
-  muduo::net::Buffer paramsStream_;
-  ParamMap params_;
-
-  const static unsigned kRecordHeader;
+  std::map<uint16_t, Request> requests_;
+  std::vector<uint16_t> ready_;  // got all stdin, or aborted
+  uint16_t requestId_;
 };
 
 #endif  // MUDUO_EXAMPLES_FASTCGI_FASTCGI_H
@@ -0,0 +1,288 @@
+// FastCgiClient against a local responder stand-in which answers every
+// request at once, so the cost of the client side and of the connections
+// shows.  Compares one connection per request, a pool of keep-alive
+// connections, and requests multiplexed over a few connections.  Also
+// times encoding a request in place vs. through a temporary string.
+//
+// Usage: fastcgi_bench [concurrency] [seconds] [responder_threads]
+
+#include "examples/fastcgi/fastcgi_client.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/Endian.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+typedef std::shared_ptr<FastCgiCodec> CodecPtr;
+
+void onRequest(const TcpConnectionPtr& conn,
+               FastCgiCodec::ParamMap& params,
+               Buffer* in)
+{
+  const CodecPtr& codec = boost::any_cast<const CodecPtr&>(conn->getContext());
+  Buffer response;
+  response.append("Content-Type: text/plain\r\n\r\n");
+  response.append(params["REQUEST_URI"]);
+  FastCgiCodec::respond(&response, codec->requestId());
+  conn->send(&response);
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    CodecPtr codec(new FastCgiCodec(onRequest));
+    conn->setContext(codec);
+    conn->setMessageCallback(
+        std::bind(&FastCgiCodec::onMessage, codec, _1, _2, _3));
+    conn->setTcpNoDelay(true);
+  }
+}
+
+// what nginx passes with the stock fastcgi_params
+FastCgiClient::ParamMap makeParams()
+{
+  FastCgiClient::ParamMap params;
+  params["QUERY_STRING"] = "";
+  params["REQUEST_METHOD"] = "GET";
+  params["CONTENT_TYPE"] = "";
+  params["CONTENT_LENGTH"] = "";
+  params["SCRIPT_NAME"] = "/sudoku/";
+  params["REQUEST_URI"] = "/sudoku/000000010400000000020000000000050407008000300001090000300400200050100000000806000";
+  params["DOCUMENT_URI"] = params["REQUEST_URI"];
+  params["DOCUMENT_ROOT"] = "/usr/share/nginx/html";
+  params["SERVER_PROTOCOL"] = "HTTP/1.1";
+  params["REQUEST_SCHEME"] = "http";
+  params["GATEWAY_INTERFACE"] = "CGI/1.1";
+  params["SERVER_SOFTWARE"] = "nginx/1.24.0";
+  params["REMOTE_ADDR"] = "127.0.0.1";
+  params["REMOTE_PORT"] = "51234";
+  params["SERVER_ADDR"] = "127.0.0.1";
+  params["SERVER_PORT"] = "80";
+  params["SERVER_NAME"] = "localhost";
+  params["HTTP_HOST"] = "localhost";
+  params["HTTP_USER_AGENT"] = "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)";
+  params["HTTP_ACCEPT"] = "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8";
+  return params;
+}
+
+// Each user sends a request when the previous one is answered.
+class Users : noncopyable
+{
+ public:
+  Users(FastCgiClient* client, int users)
+    : client_(client),
+      params_(makeParams()),
+      responses_(0),
+      failures_(0),
+      stopped_(false)
+  {
+    for (int i = 0; i < users; ++i)
+    {
+      send();
+    }
+  }
+
+  int64_t responses() const { return responses_; }
+  int64_t failures() const { return failures_; }
+  std::vector<int>& latencies() { return latencies_; }
+
+  void reset()
+  {
+    responses_ = 0;
+    latencies_.clear();
+  }
+
+  void stop() { stopped_ = true; }
+
+ private:
+  void send()
+  {
+    Timestamp start(Timestamp::now());
+    client_->request(params_, StringPiece(), [this, start](Buffer* out)
+    {
+      if (out)
+      {
+        ++responses_;
+        latencies_.push_back(static_cast<int>(timeDifference(Timestamp::now(), start) * 1e6));
+      }
+      else
+      {
+        ++failures_;
+      }
+      if (!stopped_)
+        send();
+    });
+  }
+
+  FastCgiClient* client_;
+  const FastCgiClient::ParamMap params_;
+  int64_t responses_;
+  int64_t failures_;
+  std::vector<int> latencies_;
+  bool stopped_;
+};
+
+int percentile(const std::vector<int>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  return sorted[static_cast<size_t>(static_cast<double>(sorted.size() - 1) * p)];
+}
+
+void bench(const char* name, const InetAddress& addr, int users, int seconds,
+           bool keepAlive, int connections, int perConnection)
+{
+  EventLoop loop;
+  std::unique_ptr<FastCgiClient> client(new FastCgiClient(&loop, addr, name));
+  client->setKeepAlive(keepAlive);
+  client->setMaxConnections(connections);
+  client->setMaxRequestsPerConnection(perConnection);
+  Users all(client.get(), users);
+
+  // half a second of warm up
+  loop.runAfter(0.5, [&] { all.reset(); });
+  loop.runAfter(0.5 + seconds, [&] { loop.quit(); });
+  loop.loop();
+  all.stop();
+  int64_t responses = all.responses();
+  std::vector<int> latencies(all.latencies());
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-12s %5d %5d %10.0f %7d %7d %5lld\n",
+         name, connections, perConnection,
+         static_cast<double>(responses) / seconds,
+         percentile(latencies, 0.5), percentile(latencies, 0.99),
+         static_cast<long long>(all.failures()));
+
+  // drains the requests in flight, then lets the connections go
+  loop.runAfter(0.2, [&] { client.reset(); });
+  loop.runAfter(0.3, [&] { loop.quit(); });
+  loop.loop();
+}
+
+// the obvious way, each pair as a string, then the stream cut into records
+void encodeNaive(uint16_t id, const FastCgiClient::ParamMap& params, Buffer* out)
+{
+  FastCgiCodec::RecordHeader header = { 1, kFcgiBeginRequest, sockets::hostToNetwork16(id),
+                                        sockets::hostToNetwork16(8), 0, 0 };
+  out->append(&header, sizeof header);
+  out->append("\0\1\1\0\0\0\0\0", 8);
+
+  string stream;
+  for (const auto& kv : params)
+  {
+    string pair;
+    for (size_t len : { kv.first.size(), kv.second.size() })
+    {
+      if (len < 128)
+      {
+        pair += static_cast<char>(len);
+      }
+      else
+      {
+        uint32_t be32 = sockets::hostToNetwork32(static_cast<uint32_t>(len) | 0x80000000);
+        pair.append(reinterpret_cast<const char*>(&be32), sizeof be32);
+      }
+    }
+    pair += kv.first;
+    pair += kv.second;
+    stream += pair;
+  }
+  // ends with an empty record
+  size_t off = 0;
+  size_t n = 0;
+  do
+  {
+    n = std::min(stream.size() - off, size_t(65535));
+    header.type = kFcgiParams;
+    header.length = sockets::hostToNetwork16(static_cast<uint16_t>(n));
+    out->append(&header, sizeof header);
+    out->append(stream.data() + off, n);
+    off += n;
+  } while (n > 0);
+  header.type = kFcgiStdin;
+  header.length = 0;
+  out->append(&header, sizeof header);
+}
+
+void benchEncode()
+{
+  const FastCgiClient::ParamMap params(makeParams());
+  const int kN = 1000000;
+  Buffer out;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < kN; ++i)
+  {
+    encodeNaive(1, params, &out);
+    out.retrieveAll();
+  }
+  double naive = timeDifference(Timestamp::now(), start);
+  start = Timestamp::now();
+  for (int i = 0; i < kN; ++i)
+  {
+    FastCgiClient::encodeRequest(1, true, params, StringPiece(), &out);
+    out.retrieveAll();
+  }
+  double inPlace = timeDifference(Timestamp::now(), start);
+  printf("encode naive %.0f ns, in place %.0f ns per request\n\n",
+         naive * 1e9 / kN, inPlace * 1e9 / kN);
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::ERROR);
+  int users = argc > 1 ? atoi(argv[1]) : 64;
+  int seconds = argc > 2 ? atoi(argv[2]) : 2;
+  int threads = argc > 3 ? atoi(argv[3]) : 0;
+
+  benchEncode();
+
+  int probe = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(probe, InetAddress(0, true).getSockAddr());
+  InetAddress addr("127.0.0.1", InetAddress(sockets::getLocalAddr(probe)).port());
+  sockets::close(probe);
+
+  EventLoopThread responderThread;
+  EventLoop* responderLoop = responderThread.startLoop();
+  std::unique_ptr<TcpServer> responder;
+  CountDownLatch started(1);
+  responderLoop->runInLoop([&]
+  {
+    responder.reset(new TcpServer(responderLoop, addr, "Responder"));
+    responder->setConnectionCallback(onConnection);
+    responder->setThreadNum(threads);
+    responder->start();
+    started.countDown();
+  });
+  started.wait();
+
+  printf("%d users, responder threads %d\n", users, threads);
+  printf("%-12s %5s %5s %10s %7s %7s %5s\n",
+         "mode", "conns", "reqs", "req/s", "p50 us", "p99 us", "fail");
+  bench("per-request", addr, users, seconds, false, users, 1);
+  bench("keep-alive", addr, users, seconds, true, 4, 1);
+  bench("keep-alive", addr, users, seconds, true, users, 1);
+  bench("multiplexed", addr, users, seconds, true, 1, users);
+  bench("multiplexed", addr, users, seconds, true, 4, (users + 3) / 4);
+
+  CountDownLatch stopped(1);
+  responderLoop->runInLoop([&]
+  {
+    responder.reset();
+    stopped.countDown();
+  });
+  stopped.wait();
+}
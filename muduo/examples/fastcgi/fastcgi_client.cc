@@ -0,0 +1,492 @@
+#include "examples/fastcgi/fastcgi_client.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Endian.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// a multiple of 8, so that full records need no padding
+const size_t kMaxContent = 65528;
+
+// Appends a stream of records of one type.  Content goes right after the
+// record header in out, the header is filled in when the record is closed.
+class RecordWriter : noncopyable
+{
+ public:
+  RecordWriter(Buffer* out, uint8_t type, uint16_t id)
+    : out_(out),
+      type_(type),
+      id_(id),
+      headerOffset_(0),
+      length_(0)
+  {
+    open();
+  }
+
+  void append(const void* data, size_t len)
+  {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0)
+    {
+      size_t n = std::min(len, kMaxContent - length_);
+      out_->append(p, n);
+      length_ += n;
+      p += n;
+      len -= n;
+      if (length_ == kMaxContent)
+      {
+        close();
+        open();
+      }
+    }
+  }
+
+  void append(StringPiece s)
+  {
+    append(s.data(), s.size());
+  }
+
+  // of a name-value pair
+  void appendLength(size_t len)
+  {
+    if (len < 128)
+    {
+      uint8_t b = static_cast<uint8_t>(len);
+      append(&b, sizeof b);
+    }
+    else
+    {
+      uint32_t be32 = sockets::hostToNetwork32(static_cast<uint32_t>(len) | 0x80000000);
+      append(&be32, sizeof be32);
+    }
+  }
+
+  // with an empty record
+  void finish()
+  {
+    bool empty = length_ == 0;
+    close();
+    if (!empty)
+    {
+      open();
+      close();
+    }
+  }
+
+ private:
+  void open()
+  {
+    headerOffset_ = out_->readableBytes();
+    length_ = 0;
+    out_->ensureWritableBytes(FastCgiCodec::kRecordHeader);
+    out_->hasWritten(FastCgiCodec::kRecordHeader);
+  }
+
+  void close()
+  {
+    uint8_t padding = static_cast<uint8_t>(-length_ & 7);
+    out_->append("\0\0\0\0\0\0\0\0", padding);
+    FastCgiCodec::RecordHeader header =
+    {
+      1,
+      type_,
+      sockets::hostToNetwork16(id_),
+      sockets::hostToNetwork16(static_cast<uint16_t>(length_)),
+      padding,
+      0,
+    };
+    char* begin = out_->beginWrite() - out_->readableBytes();
+    memcpy(begin + headerOffset_, &header, sizeof header);
+  }
+
+  Buffer* out_;
+  const uint8_t type_;
+  const uint16_t id_;
+  size_t headerOffset_;
+  size_t length_;
+};
+
+}  // namespace
+
+// One connection to the responder, request ids 1..maxRequests.
+class FastCgiClient::Backend : noncopyable,
+                               public std::enable_shared_from_this<Backend>
+{
+ public:
+  Backend(FastCgiClient* owner, const string& name, int maxRequests)
+    : owner_(owner),
+      client_(owner->loop_, owner->backendAddr_, name),
+      slots_(maxRequests + 1),
+      flushing_(false),
+      closing_(false)
+  {
+    for (int id = maxRequests; id >= 1; --id)
+    {
+      freeIds_.push_back(static_cast<uint16_t>(id));
+    }
+    client_.setConnectionCallback(
+        std::bind(&Backend::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Backend::onMessage, this, _1, _2, _3));
+  }
+
+  ~Backend()
+  {
+    owner_->loop_->cancel(connectTimer_);
+    // the connection may outlive us
+    if (conn_)
+    {
+      conn_->setConnectionCallback(defaultConnectionCallback);
+      conn_->setMessageCallback(defaultMessageCallback);
+    }
+  }
+
+  // TcpClient retries forever, a dead responder must fail requests.
+  void connect(double timeout)
+  {
+    client_.connect();
+    std::weak_ptr<Backend> weakSelf(shared_from_this());
+    connectTimer_ = owner_->loop_->runAfter(timeout, [weakSelf]
+    {
+      BackendPtr self(weakSelf.lock());
+      if (self)
+        self->onConnectTimeout();
+    });
+  }
+
+  bool connected() const { return conn_ != NULL; }
+  bool full() const { return freeIds_.empty() || closing_; }
+  size_t freeIds() const { return freeIds_.size(); }
+
+  void send(const ParamMap& params, StringPiece body, const ResponseCallback& cb)
+  {
+    assert(!full());
+    uint16_t id = freeIds_.back();
+    freeIds_.pop_back();
+    slots_[id].cb = cb;
+    encodeRequest(id, owner_->keepAlive_, params, body, &output_);
+    if (!flushing_)
+    {
+      flushing_ = true;
+      std::weak_ptr<Backend> weakSelf(shared_from_this());
+      owner_->loop_->queueInLoop([weakSelf]
+      {
+        BackendPtr self(weakSelf.lock());
+        if (self)
+          self->flush();
+      });
+    }
+  }
+
+ private:
+  struct Slot
+  {
+    ResponseCallback cb;
+    Buffer out;
+  };
+
+  void flush()
+  {
+    flushing_ = false;
+    if (conn_)
+      conn_->send(&output_);
+    else
+      output_.retrieveAll();
+  }
+
+  void onConnectTimeout()
+  {
+    if (conn_ || closing_)
+      return;
+    LOG_ERROR << client_.name() << " connecting to "
+              << owner_->backendAddr_.toIpPort() << " timed out";
+    closing_ = true;
+    client_.stop();
+    // may delete this later
+    owner_->onConnectFailed(this);
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      owner_->loop_->cancel(connectTimer_);
+      if (closing_)
+      {
+        // timed out just before
+        conn->shutdown();
+        return;
+      }
+      conn->setTcpNoDelay(true);
+      conn_ = conn;
+      owner_->dispatch(this);
+    }
+    else
+    {
+      conn_.reset();
+      closing_ = true;
+      output_.retrieveAll();
+      std::vector<ResponseCallback> lost;
+      for (Slot& slot : slots_)
+      {
+        if (slot.cb)
+        {
+          lost.push_back(std::move(slot.cb));
+          slot.cb = nullptr;
+        }
+      }
+      if (!lost.empty())
+      {
+        LOG_WARN << conn->name() << " lost " << lost.size() << " requests";
+      }
+      // may delete this later
+      owner_->onClosed(this);
+      for (const ResponseCallback& cb : lost)
+      {
+        cb(NULL);
+      }
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    const size_t kHeader = FastCgiCodec::kRecordHeader;
+    while (buf->readableBytes() >= kHeader)
+    {
+      FastCgiCodec::RecordHeader header;
+      memcpy(&header, buf->peek(), kHeader);
+      uint16_t id = sockets::networkToHost16(header.id);
+      uint16_t length = sockets::networkToHost16(header.length);
+      size_t total = kHeader + length + header.padding;
+      if (buf->readableBytes() < total)
+        break;
+
+      const char* content = buf->peek() + kHeader;
+      if (id > 0 && id < slots_.size() && slots_[id].cb)
+      {
+        switch (header.type)
+        {
+          case kFcgiStdout:
+            slots_[id].out.append(content, length);
+            break;
+          case kFcgiStderr:
+            LOG_WARN << conn->name() << " stderr " << string(content, length);
+            break;
+          case kFcgiEndRequest:
+            complete(id);
+            break;
+          default:
+            break;
+        }
+      }
+      buf->retrieve(total);
+    }
+  }
+
+  void complete(uint16_t id)
+  {
+    Slot& slot = slots_[id];
+    ResponseCallback cb(std::move(slot.cb));
+    slot.cb = nullptr;
+    cb(&slot.out);
+    slot.out.retrieveAll();
+    if (!owner_->keepAlive_)
+    {
+      // the responder closes too
+      closing_ = true;
+      conn_->shutdown();
+    }
+    else
+    {
+      freeIds_.push_back(id);
+      owner_->dispatch(this);
+    }
+  }
+
+  FastCgiClient* owner_;
+  TcpClient client_;
+  TcpConnectionPtr conn_;
+  std::vector<Slot> slots_;  // by request id
+  std::vector<uint16_t> freeIds_;
+  Buffer output_;  // records of this loop iteration
+  TimerId connectTimer_;
+  bool flushing_;
+  bool closing_;
+};
+
+FastCgiClient::FastCgiClient(EventLoop* loop,
+                             const InetAddress& backendAddr,
+                             const string& name)
+  : loop_(loop),
+    backendAddr_(backendAddr),
+    name_(name),
+    maxConnections_(4),
+    maxRequestsPerConnection_(1),
+    keepAlive_(true),
+    connectTimeout_(5.0),
+    nextBackendId_(1)
+{
+}
+
+FastCgiClient::~FastCgiClient()
+{
+}
+
+void FastCgiClient::request(const ParamMap& params,
+                            StringPiece body,
+                            const ResponseCallback& cb)
+{
+  loop_->assertInLoopThread();
+  Backend* backend = pickBackend();
+  if (backend)
+  {
+    backend->send(params, body, cb);
+  }
+  else
+  {
+    Waiting w;
+    w.params = params;
+    body.CopyToString(&w.body);
+    w.cb = cb;
+    queue_.push_back(std::move(w));
+    connectMore();
+  }
+}
+
+// the least loaded
+FastCgiClient::Backend* FastCgiClient::pickBackend()
+{
+  Backend* best = NULL;
+  for (const BackendPtr& backend : backends_)
+  {
+    if (backend->connected() && !backend->full()
+        && (best == NULL || backend->freeIds() > best->freeIds()))
+    {
+      best = backend.get();
+    }
+  }
+  return best;
+}
+
+void FastCgiClient::connectMore()
+{
+  size_t connecting = 0;
+  for (const BackendPtr& backend : backends_)
+  {
+    if (!backend->connected() && !backend->full())
+      ++connecting;
+  }
+  int perConnection = keepAlive_ ? maxRequestsPerConnection_ : 1;
+  while (static_cast<int>(backends_.size()) < maxConnections_
+         && connecting * perConnection < queue_.size())
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%d", nextBackendId_++);
+    BackendPtr backend(new Backend(this, name_ + buf, perConnection));
+    backends_.push_back(backend);
+    backend->connect(connectTimeout_);
+    ++connecting;
+  }
+}
+
+void FastCgiClient::dispatch(Backend* backend)
+{
+  while (!queue_.empty() && backend->connected() && !backend->full())
+  {
+    Waiting w(std::move(queue_.front()));
+    queue_.pop_front();
+    backend->send(w.params, w.body, w.cb);
+  }
+}
+
+void FastCgiClient::onClosed(Backend* backend)
+{
+  removeBackend(backend);
+  connectMore();
+}
+
+void FastCgiClient::onConnectFailed(Backend* backend)
+{
+  removeBackend(backend);
+  for (const BackendPtr& b : backends_)
+  {
+    if (b->connected() || !b->full())
+      return;  // the queue waits for it
+  }
+  std::deque<Waiting> failed;
+  failed.swap(queue_);
+  if (!failed.empty())
+  {
+    LOG_WARN << name_ << " failed " << failed.size() << " queued requests";
+  }
+  for (const Waiting& w : failed)
+  {
+    w.cb(NULL);
+  }
+}
+
+void FastCgiClient::removeBackend(Backend* backend)
+{
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    if (backends_[i].get() == backend)
+    {
+      // TcpClient is still in use by the caller
+      BackendPtr b(backends_[i]);
+      loop_->queueInLoop([b] { });
+      backends_.erase(backends_.begin() + i);
+      break;
+    }
+  }
+}
+
+void FastCgiClient::encodeRequest(uint16_t id, bool keepConn,
+                                  const ParamMap& params,
+                                  StringPiece body,
+                                  Buffer* out)
+{
+  size_t estimated = 4 * FastCgiCodec::kRecordHeader + 16 + body.size();
+  for (const auto& kv : params)
+  {
+    estimated += 8 + kv.first.size() + kv.second.size();
+  }
+  out->ensureWritableBytes(estimated);
+
+  FastCgiCodec::RecordHeader header =
+  {
+    1,
+    kFcgiBeginRequest,
+    sockets::hostToNetwork16(id),
+    sockets::hostToNetwork16(8),
+    0,
+    0,
+  };
+  out->append(&header, FastCgiCodec::kRecordHeader);
+  out->appendInt16(static_cast<int16_t>(kFcgiResponder));
+  out->appendInt8(static_cast<int8_t>(keepConn ? kFcgiKeepConn : 0));
+  out->append("\0\0\0\0\0", 5);
+
+  RecordWriter paramsWriter(out, kFcgiParams, id);
+  for (const auto& kv : params)
+  {
+    paramsWriter.appendLength(kv.first.size());
+    paramsWriter.appendLength(kv.second.size());
+    paramsWriter.append(kv.first);
+    paramsWriter.append(kv.second);
+  }
+  paramsWriter.finish();
+
+  RecordWriter stdinWriter(out, kFcgiStdin, id);
+  stdinWriter.append(body);
+  stdinWriter.finish();
+}
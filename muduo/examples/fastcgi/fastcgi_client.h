@@ -0,0 +1,97 @@
+#ifndef MUDUO_EXAMPLES_FASTCGI_FASTCGI_CLIENT_H
+#define MUDUO_EXAMPLES_FASTCGI_FASTCGI_CLIENT_H
+
+#include "examples/fastcgi/fastcgi.h"
+
+#include "muduo/base/StringPiece.h"
+#include "muduo/net/InetAddress.h"
+
+#include <deque>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+class EventLoop;
+}
+}
+
+// Talks to a FastCGI responder, as a web server does.
+//
+// Up to maxConnections connections are kept open and reused, each carries
+// up to maxRequestsPerConnection requests at once, told apart by request id.
+// Requests beyond that wait in a queue.  Records of requests issued in one
+// loop iteration go out in one write.
+//
+// Not thread safe, all calls must be made in the loop thread.
+class FastCgiClient : muduo::noncopyable
+{
+ public:
+  typedef FastCgiCodec::ParamMap ParamMap;
+  /// out is the stdout of the responder, NULL if the connection was lost.
+  typedef std::function<void (muduo::net::Buffer* out)> ResponseCallback;
+
+  FastCgiClient(muduo::net::EventLoop* loop,
+                const muduo::net::InetAddress& backendAddr,
+                const muduo::string& name);
+  ~FastCgiClient();
+
+  /// Default 4.
+  void setMaxConnections(int n) { maxConnections_ = n; }
+  /// Default 1, more than 1 needs a responder which multiplexes.
+  void setMaxRequestsPerConnection(int n) { maxRequestsPerConnection_ = n; }
+  /// Default true.  If false, one connection per request, as nginx
+  /// does without fastcgi_keep_conn.
+  void setKeepAlive(bool on) { keepAlive_ = on; }
+  /// Gives up connecting after this long, default 5 seconds.  Queued
+  /// requests fail with NULL if no other connection is up or connecting.
+  void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+
+  void request(const ParamMap& params,
+               muduo::StringPiece body,
+               const ResponseCallback& cb);
+
+  int connections() const { return static_cast<int>(backends_.size()); }
+  size_t queued() const { return queue_.size(); }
+
+  /// Appends BEGIN_REQUEST, PARAMS and STDIN records of one request,
+  /// name-value pairs are encoded in place, long streams are split
+  /// into records of at most 65528 bytes, a multiple of 8 that needs
+  /// no padding.
+  static void encodeRequest(uint16_t id, bool keepConn,
+                            const ParamMap& params,
+                            muduo::StringPiece body,
+                            muduo::net::Buffer* out);
+
+ private:
+  class Backend;
+  typedef std::shared_ptr<Backend> BackendPtr;
+
+  struct Waiting
+  {
+    ParamMap params;
+    muduo::string body;
+    ResponseCallback cb;
+  };
+
+  Backend* pickBackend();
+  void connectMore();
+  void dispatch(Backend* backend);
+  void onClosed(Backend* backend);
+  void onConnectFailed(Backend* backend);
+  void removeBackend(Backend* backend);
+
+  muduo::net::EventLoop* loop_;
+  const muduo::net::InetAddress backendAddr_;
+  const muduo::string name_;
+  int maxConnections_;
+  int maxRequestsPerConnection_;
+  bool keepAlive_;
+  double connectTimeout_;
+  int nextBackendId_;
+  std::vector<BackendPtr> backends_;
+  std::deque<Waiting> queue_;
+};
+
+#endif  // MUDUO_EXAMPLES_FASTCGI_FASTCGI_CLIENT_H
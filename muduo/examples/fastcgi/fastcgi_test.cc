@@ -10,6 +10,8 @@ using namespace muduo::net;
 
 const string kPath = "/sudoku/";
 
+typedef std::shared_ptr<FastCgiCodec> CodecPtr;
+
 void onRequest(const TcpConnectionPtr& conn,
                FastCgiCodec::ParamMap& params,
                Buffer* in)
@@ -36,7 +38,8 @@ void onRequest(const TcpConnectionPtr& conn,
     response.append("bad request");
   }
 
-  FastCgiCodec::respond(&response);
+  const CodecPtr& codec = boost::any_cast<const CodecPtr&>(conn->getContext());
+  FastCgiCodec::respond(&response, codec->requestId());
   conn->send(&response);
 }
 
@@ -44,7 +47,6 @@ void onConnection(const TcpConnectionPtr& conn)
 {
   if (conn->connected())
   {
-    typedef std::shared_ptr<FastCgiCodec> CodecPtr;
     CodecPtr codec(new FastCgiCodec(onRequest));
     conn->setContext(codec);
     conn->setMessageCallback(
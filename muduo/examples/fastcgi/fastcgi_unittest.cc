@@ -0,0 +1,206 @@
+#include "examples/fastcgi/fastcgi.h"
+#include "examples/fastcgi/fastcgi_client.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Endian.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <set>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+typedef std::shared_ptr<FastCgiCodec> CodecPtr;
+
+const uint16_t kPort = 20281;
+
+struct Pending
+{
+  TcpConnectionPtr conn;
+  uint16_t id;
+  string uri;
+};
+
+// A responder which holds requests until it has 'batch' of them,
+// then answers in reverse order, so records of several ids interleave.
+class Responder
+{
+ public:
+  Responder(EventLoop* loop, uint16_t port, int batch)
+    : server_(loop, InetAddress(port, true), "Responder"),
+      batch_(batch),
+      calls_(0)
+  {
+    server_.setConnectionCallback(std::bind(&Responder::onConnection, this, _1));
+    server_.start();
+  }
+
+  int calls() const { return calls_; }
+  const std::set<uint16_t>& ids() const { return ids_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      CodecPtr codec(new FastCgiCodec(std::bind(&Responder::onRequest, this, _1, _2, _3)));
+      conn->setContext(codec);
+      conn->setMessageCallback(
+          std::bind(&FastCgiCodec::onMessage, codec, _1, _2, _3));
+    }
+  }
+
+  void onRequest(const TcpConnectionPtr& conn, FastCgiCodec::ParamMap& params, Buffer*)
+  {
+    const CodecPtr& codec = boost::any_cast<const CodecPtr&>(conn->getContext());
+    ++calls_;
+    ids_.insert(codec->requestId());
+    Pending p = { conn, codec->requestId(), params["REQUEST_URI"] };
+    pending_.push_back(p);
+    if (static_cast<int>(pending_.size()) == batch_)
+    {
+      while (!pending_.empty())
+      {
+        Buffer response;
+        response.append(pending_.back().uri);
+        FastCgiCodec::respond(&response, pending_.back().id);
+        pending_.back().conn->send(&response);
+        pending_.pop_back();
+      }
+    }
+  }
+
+  TcpServer server_;
+  const int batch_;
+  int calls_;
+  std::set<uint16_t> ids_;
+  std::vector<Pending> pending_;
+};
+
+void testMultiplexed()
+{
+  printf("multiplexed\n");
+  EventLoop loop;
+  const int kRequests = 4;
+  Responder responder(&loop, kPort, kRequests);
+  FastCgiClient client(&loop, InetAddress("127.0.0.1", kPort), "Client");
+  client.setMaxConnections(1);
+  client.setMaxRequestsPerConnection(kRequests);
+  int done = 0;
+  for (int i = 0; i < kRequests; ++i)
+  {
+    FastCgiClient::ParamMap params;
+    string uri = "/" + std::to_string(i);
+    params["REQUEST_URI"] = uri;
+    client.request(params, StringPiece(), [&, uri](Buffer* out)
+    {
+      assert(out != NULL);
+      assert(out->retrieveAllAsString() == uri);
+      if (++done == kRequests)
+        loop.quit();
+    });
+  }
+  loop.runAfter(5.0, [] { assert(!"timeout"); });
+  loop.loop();
+  assert(client.connections() == 1);
+  assert(responder.calls() == kRequests);
+  assert(static_cast<int>(responder.ids().size()) == kRequests);
+}
+
+// ABORT_REQUEST of a request without all of its stdin is answered by
+// END_REQUEST, without calling back.
+void testAbort()
+{
+  printf("abort\n");
+  EventLoop loop;
+  Responder responder(&loop, kPort + 1, 1);
+  TcpClient client(&loop, InetAddress("127.0.0.1", kPort + 1), "Raw");
+  std::vector<std::pair<int, uint16_t>> records;  // type, id
+  client.setConnectionCallback([](const TcpConnectionPtr& conn)
+  {
+    if (!conn->connected())
+      return;
+    FastCgiClient::ParamMap params;
+    params["REQUEST_URI"] = "/aborted";
+    Buffer buf;
+    FastCgiClient::encodeRequest(7, true, params, StringPiece(), &buf);
+    buf.unwrite(FastCgiCodec::kRecordHeader);  // the empty STDIN record
+    FastCgiCodec::RecordHeader header =
+    {
+      1,
+      kFcgiAbortRequest,
+      sockets::hostToNetwork16(7),
+      0,
+      0,
+      0,
+    };
+    buf.append(&header, FastCgiCodec::kRecordHeader);
+    params["REQUEST_URI"] = "/done";
+    FastCgiClient::encodeRequest(8, true, params, StringPiece(), &buf);
+    conn->send(&buf);
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp)
+  {
+    while (buf->readableBytes() >= FastCgiCodec::kRecordHeader)
+    {
+      FastCgiCodec::RecordHeader header;
+      memcpy(&header, buf->peek(), FastCgiCodec::kRecordHeader);
+      size_t total = FastCgiCodec::kRecordHeader + sockets::networkToHost16(header.length)
+                     + header.padding;
+      if (buf->readableBytes() < total)
+        break;
+      uint16_t id = sockets::networkToHost16(header.id);
+      records.push_back(std::make_pair(static_cast<int>(header.type), id));
+      buf->retrieve(total);
+      if (header.type == kFcgiEndRequest && id == 8)
+        loop.quit();
+    }
+  });
+  client.connect();
+  loop.runAfter(5.0, [] { assert(!"timeout"); });
+  loop.loop();
+  assert(responder.calls() == 1);
+  assert(*responder.ids().begin() == 8);
+  assert(!records.empty());
+  assert(records[0].first == kFcgiEndRequest && records[0].second == 7);
+  for (size_t i = 1; i < records.size(); ++i)
+    assert(records[i].second == 8);
+}
+
+// nothing listens, TcpClient would retry forever.
+void testConnectTimeout()
+{
+  printf("connect timeout\n");
+  EventLoop loop;
+  FastCgiClient client(&loop, InetAddress("127.0.0.1", 1), "Client");
+  client.setConnectTimeout(0.2);
+  int failed = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    client.request(FastCgiClient::ParamMap(), StringPiece(), [&](Buffer* out)
+    {
+      assert(out == NULL);
+      ++failed;
+    });
+  }
+  loop.runAfter(1.0, [&] { loop.quit(); });
+  loop.loop();
+  assert(failed == 3);
+  assert(client.queued() == 0);
+  assert(client.connections() == 0);
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  testMultiplexed();
+  testAbort();
+  testConnectTimeout();
+  printf("PASSED\n");
+}
@@ -0,0 +1,51 @@
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// RFC 862, idle connections are closed by TcpServer::setIdleTimeout(),
+// instead of the hand-made wheel in echo.cc and the list in sortedlist.cc.
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  LOG_INFO << "EchoServer - " << conn->peerAddress().toIpPort() << " -> "
+           << conn->localAddress().toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time)
+{
+  string msg(buf->retrieveAllAsString());
+  LOG_INFO << conn->name() << " echo " << msg.size()
+           << " bytes at " << time.toString();
+  conn->send(msg);
+}
+
+int main(int argc, char* argv[])
+{
+  EventLoop loop;
+  InetAddress listenAddr(2007);
+  int idleSeconds = 10;
+  int threads = 0;
+  if (argc > 1)
+  {
+    idleSeconds = atoi(argv[1]);
+  }
+  if (argc > 2)
+  {
+    threads = atoi(argv[2]);
+  }
+  LOG_INFO << "pid = " << getpid() << ", idle seconds = " << idleSeconds;
+  TcpServer server(&loop, listenAddr, "EchoServer");
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setThreadNum(threads);
+  server.setIdleTimeout(idleSeconds);
+  server.start();
+  loop.loop();
+}
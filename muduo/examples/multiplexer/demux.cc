@@ -7,6 +7,7 @@
 #include <queue>
 #include <utility>
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -29,15 +30,38 @@ struct Entry
   TcpClientPtr client;
   TcpConnectionPtr connection;
   Buffer pending;
+  int64_t sendCredit;  // bytes we may forward to server before next WINDOW
+  int64_t unacked;     // bytes from server not granted back yet
 };
 
+void appendFrames(Buffer* output, int connId, const char* data, size_t len)
+{
+  while (len > 0)
+  {
+    size_t n = std::min(len, kMaxPacketLen);
+    uint8_t header[kHeaderLen] = {
+      static_cast<uint8_t>(n),
+      static_cast<uint8_t>(connId & 0xFF),
+      static_cast<uint8_t>((connId & 0xFF00) >> 8)
+    };
+    output->append(header, kHeaderLen);
+    output->append(data, n);
+    data += n;
+    len -= n;
+  }
+}
+
+// window must match the one of multiplex_server, see there.
 class DemuxServer : noncopyable
 {
  public:
-  DemuxServer(EventLoop* loop, const InetAddress& listenAddr, const InetAddress& socksAddr)
+  DemuxServer(EventLoop* loop, const InetAddress& listenAddr,
+              const InetAddress& socksAddr, int64_t window)
     : loop_(loop),
       server_(loop, listenAddr, "DemuxServer"),
-      socksAddr_(socksAddr)
+      socksAddr_(socksAddr),
+      window_(window),
+      flushing_(false)
   {
     server_.setConnectionCallback(
         std::bind(&DemuxServer::onServerConnection, this, _1));
@@ -61,6 +85,8 @@ class DemuxServer : noncopyable
       else
       {
         serverConn_ = conn;
+        // we coalesce frames ourselves
+        serverConn_->setTcpNoDelay(true);
         LOG_INFO << "onServerConnection set serverConn_";
       }
     }
@@ -78,9 +104,11 @@ class DemuxServer : noncopyable
 
   void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
   {
-    while (buf->readableBytes() > kHeaderLen)
+    // consecutive frames of a connection go to socks in one send()
+    std::vector<int> touched;
+    while (buf->readableBytes() >= kHeaderLen)
     {
-      int len = static_cast<uint8_t>(*buf->peek());
+      size_t len = static_cast<uint8_t>(*buf->peek());
       if (buf->readableBytes() < len + kHeaderLen)
       {
         break;
@@ -93,16 +121,13 @@ class DemuxServer : noncopyable
         if (connId != 0)
         {
           assert(socksConns_.find(connId) != socksConns_.end());
-          TcpConnectionPtr& socksConn = socksConns_[connId].connection;
-          if (socksConn)
-          {
-            assert(socksConns_[connId].pending.readableBytes() == 0);
-            socksConn->send(buf->peek() + kHeaderLen, len);
-          }
-          else
+          Entry& entry = socksConns_[connId];
+          if (entry.pending.readableBytes() == 0)
           {
-            socksConns_[connId].pending.append(buf->peek() + kHeaderLen, len);
+            touched.push_back(connId);
           }
+          entry.pending.append(buf->peek() + kHeaderLen, len);
+          entry.unacked += static_cast<int64_t>(len);
         }
         else
         {
@@ -112,13 +137,39 @@ class DemuxServer : noncopyable
         buf->retrieve(len + kHeaderLen);
       }
     }
+    for (int connId : touched)
+    {
+      std::map<int, Entry>::iterator it = socksConns_.find(connId);
+      if (it != socksConns_.end() && it->second.connection)
+      {
+        it->second.connection->send(&it->second.pending);
+      }
+    }
   }
 
   void doCommand(const string& cmd)
   {
     static const string kConn = "CONN ";
 
-    int connId = atoi(&cmd[kConn.size()]);
+    int connId = 0;
+    long long credit = 0;
+    if (sscanf(cmd.c_str(), "WINDOW %d %lld", &connId, &credit) == 2)
+    {
+      std::map<int, Entry>::iterator it = socksConns_.find(connId);
+      if (it != socksConns_.end())
+      {
+        Entry& entry = it->second;
+        bool blocked = entry.sendCredit <= 0;
+        entry.sendCredit += credit;
+        if (blocked && entry.sendCredit > 0 && entry.connection)
+        {
+          entry.connection->startRead();
+        }
+      }
+      return;
+    }
+
+    connId = atoi(&cmd[kConn.size()]);
     bool isUp = cmd.find(" IS UP") != string::npos;
     LOG_INFO << "doCommand " << connId << " " << isUp;
     if (isUp)
@@ -128,12 +179,15 @@ class DemuxServer : noncopyable
       snprintf(connName, sizeof connName, "SocksClient %d", connId);
       Entry entry;
       entry.connId = connId;
+      entry.sendCredit = window_;
+      entry.unacked = 0;
       entry.client.reset(new TcpClient(loop_, socksAddr_, connName));
       entry.client->setConnectionCallback(
           std::bind(&DemuxServer::onSocksConnection, this, connId, _1));
       entry.client->setMessageCallback(
           std::bind(&DemuxServer::onSocksMessage, this, connId, _1, _2, _3));
-      // FIXME: setWriteCompleteCallback
+      entry.client->setWriteCompleteCallback(
+          std::bind(&DemuxServer::onSocksWriteComplete, this, connId, _1));
       socksConns_[connId] = entry;
       entry.client->connect();
     }
@@ -170,9 +224,7 @@ class DemuxServer : noncopyable
       {
         char buf[256];
         int len = snprintf(buf, sizeof(buf), "DISCONNECT %d\r\n", connId);
-        Buffer buffer;
-        buffer.append(buf, len);
-        sendServerPacket(0, &buffer);
+        sendServerPacket(0, buf, len);
       }
       else
       {
@@ -184,33 +236,52 @@ class DemuxServer : noncopyable
   void onSocksMessage(int connId, const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
   {
     assert(socksConns_.find(connId) != socksConns_.end());
-    while (buf->readableBytes() > kMaxPacketLen)
+    size_t len = buf->readableBytes();
+    sendServerPacket(connId, buf->peek(), len);
+    buf->retrieveAll();
+    Entry& entry = socksConns_[connId];
+    entry.sendCredit -= static_cast<int64_t>(len);
+    if (window_ > 0 && entry.sendCredit <= 0)
     {
-      Buffer packet;
-      packet.append(buf->peek(), kMaxPacketLen);
-      buf->retrieve(kMaxPacketLen);
-      sendServerPacket(connId, &packet);
+      conn->stopRead();
     }
-    if (buf->readableBytes() > 0)
+  }
+
+  void onSocksWriteComplete(int connId, const TcpConnectionPtr& conn)
+  {
+    std::map<int, Entry>::iterator it = socksConns_.find(connId);
+    if (window_ > 0 && it != socksConns_.end() && it->second.unacked >= window_ / 2)
     {
-      sendServerPacket(connId, buf);
+      char buf[64];
+      int len = snprintf(buf, sizeof buf, "WINDOW %d %" PRId64 "\r\n",
+                         connId, it->second.unacked);
+      it->second.unacked = 0;
+      sendServerPacket(0, buf, len);
     }
   }
 
-  void sendServerPacket(int connId, Buffer* buf)
+  // frames are coalesced until the end of current loop iteration.
+  void sendServerPacket(int connId, const char* data, size_t len)
   {
-    size_t len = buf->readableBytes();
     LOG_DEBUG << len;
-    assert(len <= kMaxPacketLen);
-    uint8_t header[kHeaderLen] = {
-      static_cast<uint8_t>(len),
-      static_cast<uint8_t>(connId & 0xFF),
-      static_cast<uint8_t>((connId & 0xFF00) >> 8)
-    };
-    buf->prepend(header, kHeaderLen);
+    appendFrames(&output_, connId, data, len);
+    if (!flushing_)
+    {
+      flushing_ = true;
+      loop_->queueInLoop(std::bind(&DemuxServer::flushServer, this));
+    }
+  }
+
+  void flushServer()
+  {
+    flushing_ = false;
     if (serverConn_)
     {
-      serverConn_->send(buf);
+      serverConn_->send(&output_);
+    }
+    else
+    {
+      output_.retrieveAll();
     }
   }
 
@@ -218,7 +289,10 @@ class DemuxServer : noncopyable
   TcpServer server_;
   TcpConnectionPtr serverConn_;
   const InetAddress socksAddr_;
+  const int64_t window_;
   std::map<int, Entry> socksConns_;
+  Buffer output_;
+  bool flushing_;
 };
 
 int main(int argc, char* argv[])
@@ -230,8 +304,13 @@ int main(int argc, char* argv[])
   {
     socksIp = argv[1];
   }
+  int64_t window = 0;
+  if (argc > 2)
+  {
+    window = atoll(argv[2]);
+  }
   InetAddress socksAddr(socksIp, kSocksPort);
-  DemuxServer server(&loop, listenAddr, socksAddr);
+  DemuxServer server(&loop, listenAddr, socksAddr, window);
 
   server.start();
 
@@ -1,4 +1,40 @@
 #!/bin/sh
+# ./run.sh                  the Java test harness, against multiplex_server
+# ./run.sh bench [bin_dir]  throughput and latency of many concurrent streams,
+#                           client -> multiplex_server -> multiplex_demux -> echo,
+#                           with and without flow control, with and without a
+#                           stream that never reads.
+
+if [ "$1" = "bench" ]; then
+  BIN=${2:-../../../../build/release-cpp11/bin}
+  STREAMS=${STREAMS:-"1 16 256"}
+  WINDOWS=${WINDOWS:-"0 65536"}
+  SLOW=${SLOW:-"0 1"}
+  MSG_SIZE=${MSG_SIZE:-1024}
+  DURATION=${DURATION:-5}
+  THREADS=${THREADS:-4}
+
+  $BIN/multiplex_bench echo & echo_pid=$!
+  echo "window slow streams msg_size msgs/s MiB/s p50_us p99_us p999_us server_rss_kb demux_rss_kb"
+  for window in $WINDOWS; do
+    for slow in $SLOW; do
+      for streams in $STREAMS; do
+        $BIN/multiplex_demux 127.0.0.1 $window > /dev/null 2>&1 & demux_pid=$!
+        sleep 0.5
+        $BIN/multiplex_server 127.0.0.1 $THREADS $window > /dev/null 2>&1 & server_pid=$!
+        sleep 0.5
+        result=$($BIN/multiplex_bench client 127.0.0.1 $streams $MSG_SIZE $DURATION $slow)
+        server_rss=$(ps -o rss= -p $server_pid)
+        demux_rss=$(ps -o rss= -p $demux_pid)
+        kill $server_pid $demux_pid
+        wait $server_pid $demux_pid 2> /dev/null
+        echo $window $result $server_rss $demux_rss
+      done
+    done
+  done
+  kill $echo_pid
+  exit 0
+fi
 
 CLASSPATH=lib/netty-3.2.4.Final.jar:lib/slf4j-api-1.6.1.jar:lib/slf4j-simple-1.6.1.jar:./bin
 
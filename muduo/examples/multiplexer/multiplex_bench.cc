@@ -0,0 +1,198 @@
+// Many concurrent streams through multiplex_server and multiplex_demux,
+// reports throughput and round trip latency, see harness/run.sh.
+//
+// Usage: multiplex_bench echo
+//          the socks server behind multiplex_demux, port 7777
+//        multiplex_bench client host streams msg_size seconds [slow_streams]
+//          ping-pong msg_size bytes on each stream to multiplex_server,
+//          slow streams keep sending and never read.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kClientPort = 3333;
+const uint16_t kSocksPort = 7777;
+const size_t kHighWaterMark = 1024 * 1024;
+
+// Echo, stops reading a connection when its output is not drained,
+// so that backpressure reaches the demux.
+void onEchoConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->setHighWaterMarkCallback(
+        [](const TcpConnectionPtr& c, size_t) { c->stopRead(); }, kHighWaterMark);
+  }
+}
+
+void onEchoMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+void onEchoWriteComplete(const TcpConnectionPtr& conn)
+{
+  if (!conn->isReading())
+  {
+    conn->startRead();
+  }
+}
+
+class Stream : noncopyable
+{
+ public:
+  Stream(EventLoop* loop, const InetAddress& serverAddr, int msgSize, bool slow,
+         std::vector<int>* latencies)
+    : client_(loop, serverAddr, "BenchStream"),
+      message_(msgSize, 'S'),
+      slow_(slow),
+      received_(0),
+      messages_(0),
+      latencies_(latencies)
+  {
+    client_.setConnectionCallback(
+        std::bind(&Stream::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Stream::onMessage, this, _1, _2, _3));
+    if (slow_)
+    {
+      client_.setWriteCompleteCallback(
+          [this](const TcpConnectionPtr& conn) { conn->send(message_); });
+    }
+    client_.connect();
+  }
+
+  int64_t messages() const { return messages_; }
+  void resetMessages() { messages_ = 0; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+      if (slow_)
+      {
+        conn->stopRead();
+      }
+      sent_ = Timestamp::now();
+      conn->send(message_);
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+  {
+    received_ += buf->readableBytes();
+    buf->retrieveAll();
+    if (received_ >= message_.size())
+    {
+      received_ -= message_.size();
+      latencies_->push_back(static_cast<int>(receiveTime.microSecondsSinceEpoch()
+                                             - sent_.microSecondsSinceEpoch()));
+      ++messages_;
+      sent_ = Timestamp::now();
+      conn->send(message_);
+    }
+  }
+
+  TcpClient client_;
+  const string message_;
+  const bool slow_;
+  size_t received_;
+  int64_t messages_;
+  Timestamp sent_;
+  std::vector<int>* latencies_;
+};
+
+int percentile(const std::vector<int>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  size_t i = static_cast<size_t>(static_cast<double>(sorted.size() - 1) * p);
+  return sorted[i];
+}
+
+int runClient(const char* host, int streams, int msgSize, int seconds, int slowStreams)
+{
+  EventLoop loop;
+  InetAddress serverAddr(host, kClientPort);
+  std::vector<int> latencies;
+  std::vector<std::unique_ptr<Stream>> all;
+  for (int i = 0; i < slowStreams; ++i)
+  {
+    all.emplace_back(new Stream(&loop, serverAddr, 64 * 1024, true, &latencies));
+  }
+  for (int i = 0; i < streams; ++i)
+  {
+    all.emplace_back(new Stream(&loop, serverAddr, msgSize, false, &latencies));
+  }
+
+  // one second of warm up
+  loop.runAfter(1.0, [&]
+  {
+    latencies.clear();
+    for (const auto& s : all)
+      s->resetMessages();
+  });
+  loop.runAfter(1.0 + seconds, [&] { loop.quit(); });
+  loop.loop();
+
+  int64_t messages = 0;
+  for (int i = slowStreams; i < static_cast<int>(all.size()); ++i)
+  {
+    messages += all[i]->messages();
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double msgsPerSecond = static_cast<double>(messages) / seconds;
+  printf("%d %d %d %.0f %.2f %d %d %d\n",
+         slowStreams, streams, msgSize, msgsPerSecond,
+         msgsPerSecond * msgSize / 1024 / 1024,
+         percentile(latencies, 0.5),
+         percentile(latencies, 0.99),
+         percentile(latencies, 0.999));
+  fflush(stdout);
+  // FIXME: slow streams are not drained, just exit.
+  _exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  if (argc > 1 && strcmp(argv[1], "echo") == 0)
+  {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kSocksPort), "BenchEcho");
+    server.setConnectionCallback(onEchoConnection);
+    server.setMessageCallback(onEchoMessage);
+    server.setWriteCompleteCallback(onEchoWriteComplete);
+    server.start();
+    loop.loop();
+  }
+  else if (argc > 5 && strcmp(argv[1], "client") == 0)
+  {
+    return runClient(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]),
+                     argc > 6 ? atoi(argv[6]) : 0);
+  }
+  else
+  {
+    printf("Usage: %s echo\n"
+           "       %s client host streams msg_size seconds [slow_streams]\n",
+           argv[0], argv[0]);
+  }
+}
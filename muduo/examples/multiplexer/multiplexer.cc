@@ -2,6 +2,7 @@
 #include "muduo/base/Logging.h"
 #include "muduo/base/Mutex.h"
 #include "muduo/base/Thread.h"
+#include "muduo/base/ThreadLocalSingleton.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/InetAddress.h"
 #include "muduo/net/TcpClient.h"
@@ -10,13 +11,14 @@
 #include <queue>
 #include <utility>
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
-const int kMaxConns = 10;  // 65535
+const int kMaxConns = 65535;
 const size_t kMaxPacketLen = 255;
 const size_t kHeaderLen = 3;
 
@@ -24,16 +26,67 @@ const uint16_t kClientPort = 3333;
 const char* backendIp = "127.0.0.1";
 const uint16_t kBackendPort = 9999;
 
+// Per client connection, only touched in the loop of that connection.
+struct Stream
+{
+  Stream(int streamId, int64_t window)
+    : id(streamId),
+      sendCredit(window),
+      unacked(0)
+  {
+  }
+
+  int id;
+  int64_t sendCredit;  // bytes we may forward to backend before next WINDOW
+  int64_t unacked;     // bytes written to client but not granted back yet
+};
+
+// Frames from one IO thread to backend, sent once per loop iteration.
+struct Batch
+{
+  Batch() : flushing(false) { }
+
+  Buffer frames;
+  bool flushing;
+};
+
+typedef ThreadLocalSingleton<Batch> LocalBatch;
+
+void appendFrames(Buffer* output, int id, const char* data, size_t len)
+{
+  while (len > 0)
+  {
+    size_t n = std::min(len, kMaxPacketLen);
+    uint8_t header[kHeaderLen] = {
+      static_cast<uint8_t>(n),
+      static_cast<uint8_t>(id & 0xFF),
+      static_cast<uint8_t>((id & 0xFF00) >> 8)
+    };
+    output->append(header, kHeaderLen);
+    output->append(data, n);
+    data += n;
+    len -= n;
+  }
+}
+
+// With window > 0, each stream may have at most window bytes in flight
+// per direction, the receiving end grants them back by "WINDOW id bytes"
+// on channel 0 once they are written out.  A client that does not read
+// stops only its own stream, instead of piling up in our output buffer
+// or holding up the shared backend link.  demux must run with the same
+// window.
 class MultiplexServer
 {
  public:
   MultiplexServer(EventLoop* loop,
                   const InetAddress& listenAddr,
                   const InetAddress& backendAddr,
-                  int numThreads)
+                  int numThreads,
+                  int64_t window)
     : server_(loop, listenAddr, "MultiplexServer"),
       backend_(loop, backendAddr, "MultiplexBackend"),
       numThreads_(numThreads),
+      window_(window),
       oldCounter_(0),
       startTime_(Timestamp::now())
   {
@@ -41,6 +94,8 @@ class MultiplexServer
         std::bind(&MultiplexServer::onClientConnection, this, _1));
     server_.setMessageCallback(
         std::bind(&MultiplexServer::onClientMessage, this, _1, _2, _3));
+    server_.setWriteCompleteCallback(
+        std::bind(&MultiplexServer::onClientWriteComplete, this, _1));
     server_.setThreadNum(numThreads);
 
     backend_.setConnectionCallback(
@@ -55,22 +110,39 @@ class MultiplexServer
 
   void start()
   {
-    LOG_INFO << "starting " << numThreads_ << " threads.";
+    LOG_INFO << "starting " << numThreads_ << " threads, window " << window_;
     backend_.connect();
     server_.start();
   }
 
  private:
-  void sendBackendPacket(int id, Buffer* buf)
+  // in the loop of a client connection, frames are coalesced until
+  // the end of current loop iteration.
+  void sendBackend(EventLoop* loop, int id, const char* data, size_t len)
   {
-    size_t len = buf->readableBytes();
-    assert(len <= kMaxPacketLen);
-    uint8_t header[kHeaderLen] = {
-      static_cast<uint8_t>(len),
-      static_cast<uint8_t>(id & 0xFF),
-      static_cast<uint8_t>((id & 0xFF00) >> 8)
-    };
-    buf->prepend(header, kHeaderLen);
+    Batch& batch = LocalBatch::instance();
+    appendFrames(&batch.frames, id, data, len);
+    if (!batch.flushing)
+    {
+      batch.flushing = true;
+      loop->queueInLoop(std::bind(&MultiplexServer::flushBackend, this));
+    }
+  }
+
+  void sendBackendString(EventLoop* loop, int id, const string& msg)
+  {
+    assert(msg.size() <= kMaxPacketLen);
+    sendBackend(loop, id, msg.data(), msg.size());
+  }
+
+  void flushBackend()
+  {
+    Batch& batch = LocalBatch::instance();
+    batch.flushing = false;
+    if (batch.frames.readableBytes() == 0)
+    {
+      return;
+    }
     TcpConnectionPtr backendConn;
     {
       MutexLockGuard lock(mutex_);
@@ -78,63 +150,83 @@ class MultiplexServer
     }
     if (backendConn)
     {
-      backendConn->send(buf);
+      backendConn->send(&batch.frames);
+    }
+    else
+    {
+      batch.frames.retrieveAll();
     }
   }
 
-  void sendBackendString(int id, const string& msg)
+  TcpConnectionPtr findClient(int id)
   {
-    assert(msg.size() <= kMaxPacketLen);
-    Buffer buf;
-    buf.append(msg);
-    sendBackendPacket(id, &buf);
+    MutexLockGuard lock(mutex_);
+    std::map<int, TcpConnectionPtr>::iterator it = clientConns_.find(id);
+    return it != clientConns_.end() ? it->second : TcpConnectionPtr();
+  }
+
+  // in backend loop, one hop to the client loop per stream per read.
+  void sendToClient(int id, string* data)
+  {
+    TcpConnectionPtr clientConn = findClient(id);
+    if (clientConn)
+    {
+      clientConn->getLoop()->runInLoop(
+          std::bind(&MultiplexServer::deliver, this, clientConn, std::move(*data)));
+    }
   }
 
-  void sendBackendBuffer(int id, Buffer* buf)
+  void deliver(const TcpConnectionPtr& clientConn, const string& data)
   {
-    while (buf->readableBytes() > kMaxPacketLen)
+    Stream* stream = boost::any_cast<Stream>(clientConn->getMutableContext());
+    if (stream && clientConn->connected())
     {
-      Buffer packet;
-      packet.append(buf->peek(), kMaxPacketLen);
-      buf->retrieve(kMaxPacketLen);
-      sendBackendPacket(id, &packet);
+      stream->unacked += static_cast<int64_t>(data.size());
+      clientConn->send(data);
     }
-    if (buf->readableBytes() > 0)
+  }
+
+  void onClientWriteComplete(const TcpConnectionPtr& conn)
+  {
+    Stream* stream = boost::any_cast<Stream>(conn->getMutableContext());
+    if (window_ > 0 && stream && stream->unacked >= window_ / 2)
     {
-      sendBackendPacket(id, buf);
+      char buf[64];
+      snprintf(buf, sizeof buf, "WINDOW %d %" PRId64 "\r\n", stream->id, stream->unacked);
+      stream->unacked = 0;
+      sendBackendString(conn->getLoop(), 0, buf);
     }
   }
 
-  void sendToClient(Buffer* buf)
+  void addCredit(const TcpConnectionPtr& conn, int64_t credit)
   {
-    while (buf->readableBytes() > kHeaderLen)
+    Stream* stream = boost::any_cast<Stream>(conn->getMutableContext());
+    if (stream)
     {
-      int len = static_cast<uint8_t>(*buf->peek());
-      if (buf->readableBytes() < len + kHeaderLen)
+      bool blocked = stream->sendCredit <= 0;
+      stream->sendCredit += credit;
+      if (blocked && stream->sendCredit > 0 && conn->connected())
       {
-        break;
+        conn->startRead();
       }
-      else
-      {
-        int id = static_cast<uint8_t>(buf->peek()[1]);
-        id |= (static_cast<uint8_t>(buf->peek()[2]) << 8);
+    }
+  }
 
-        TcpConnectionPtr clientConn;
-        {
-          MutexLockGuard lock(mutex_);
-          std::map<int, TcpConnectionPtr>::iterator it = clientConns_.find(id);
-          if (it != clientConns_.end())
-          {
-            clientConn = it->second;
-          }
-        }
-        if (clientConn)
-        {
-          clientConn->send(buf->peek() + kHeaderLen, len);
-        }
-        buf->retrieve(len + kHeaderLen);
+  void doCommand(const string& cmd)
+  {
+    int id = 0;
+    long long credit = 0;
+    if (sscanf(cmd.c_str(), "WINDOW %d %lld", &id, &credit) == 2 && id > 0)
+    {
+      // a late WINDOW for an id already reused only over-grants once.
+      TcpConnectionPtr clientConn = findClient(id);
+      if (clientConn)
+      {
+        clientConn->getLoop()->runInLoop(
+            std::bind(&MultiplexServer::addCredit, this, clientConn, static_cast<int64_t>(credit)));
       }
     }
+    // FIXME: DISCONNECT
   }
 
   void onClientConnection(const TcpConnectionPtr& conn)
@@ -161,23 +253,26 @@ class MultiplexServer
       }
       else
       {
-        conn->setContext(id);
+        conn->setContext(Stream(id, window_));
         char buf[256];
         snprintf(buf, sizeof(buf), "CONN %d FROM %s IS UP\r\n", id,
                  conn->peerAddress().toIpPort().c_str());
-        sendBackendString(0, buf);
+        sendBackendString(conn->getLoop(), 0, buf);
       }
     }
     else
     {
-      if (!conn->getContext().empty())
+      const Stream* stream = boost::any_cast<Stream>(&conn->getContext());
+      if (stream)
       {
-        int id = boost::any_cast<int>(conn->getContext());
+        int id = stream->id;
         assert(id > 0 && id <= kMaxConns);
         char buf[256];
         snprintf(buf, sizeof(buf), "CONN %d FROM %s IS DOWN\r\n",
                  id, conn->peerAddress().toIpPort().c_str());
-        sendBackendString(0, buf);
+        sendBackendString(conn->getLoop(), 0, buf);
+        // before the id can be reused by another IO thread
+        flushBackend();
 
         MutexLockGuard lock(mutex_);
         if (backendConn_)
@@ -199,11 +294,16 @@ class MultiplexServer
     size_t len = buf->readableBytes();
     transferred_.addAndGet(len);
     receivedMessages_.incrementAndGet();
-    if (!conn->getContext().empty())
+    Stream* stream = boost::any_cast<Stream>(conn->getMutableContext());
+    if (stream)
     {
-      int id = boost::any_cast<int>(conn->getContext());
-      sendBackendBuffer(id, buf);
-      // assert(buf->readableBytes() == 0);
+      sendBackend(conn->getLoop(), stream->id, buf->peek(), len);
+      buf->retrieveAll();
+      stream->sendCredit -= static_cast<int64_t>(len);
+      if (window_ > 0 && stream->sendCredit <= 0)
+      {
+        conn->stopRead();
+      }
     }
     else
     {
@@ -220,6 +320,8 @@ class MultiplexServer
     std::vector<TcpConnectionPtr> connsToDestroy;
     if (conn->connected())
     {
+      // we coalesce frames ourselves
+      conn->setTcpNoDelay(true);
       MutexLockGuard lock(mutex_);
       backendConn_ = conn;
       assert(availIds_.empty());
@@ -259,7 +361,33 @@ class MultiplexServer
     size_t len = buf->readableBytes();
     transferred_.addAndGet(len);
     receivedMessages_.incrementAndGet();
-    sendToClient(buf);
+    // consecutive frames of a stream go to the client in one send()
+    while (buf->readableBytes() >= kHeaderLen)
+    {
+      size_t packetLen = static_cast<uint8_t>(*buf->peek());
+      if (buf->readableBytes() < packetLen + kHeaderLen)
+      {
+        break;
+      }
+      int id = static_cast<uint8_t>(buf->peek()[1]);
+      id |= (static_cast<uint8_t>(buf->peek()[2]) << 8);
+      if (id == 0)
+      {
+        doCommand(string(buf->peek() + kHeaderLen, packetLen));
+      }
+      else
+      {
+        downstream_[id].append(buf->peek() + kHeaderLen, packetLen);
+      }
+      buf->retrieve(packetLen + kHeaderLen);
+    }
+    for (std::map<int, string>::iterator it = downstream_.begin();
+        it != downstream_.end();
+        ++it)
+    {
+      sendToClient(it->first, &it->second);
+    }
+    downstream_.clear();
   }
 
   void printStatistics()
@@ -281,10 +409,12 @@ class MultiplexServer
   TcpServer server_;
   TcpClient backend_;
   int numThreads_;
+  const int64_t window_;
   AtomicInt64 transferred_;
   AtomicInt64 receivedMessages_;
   int64_t oldCounter_;
   Timestamp startTime_;
+  std::map<int, string> downstream_;  // in backend loop
   MutexLock mutex_;
   TcpConnectionPtr backendConn_ GUARDED_BY(mutex_);
   std::map<int, TcpConnectionPtr> clientConns_ GUARDED_BY(mutex_);
@@ -303,10 +433,15 @@ int main(int argc, char* argv[])
   {
     numThreads = atoi(argv[2]);
   }
+  int64_t window = 0;
+  if (argc > 3)
+  {
+    window = atoll(argv[3]);
+  }
   EventLoop loop;
   InetAddress listenAddr(kClientPort);
   InetAddress backendAddr(backendIp, kBackendPort);
-  MultiplexServer server(&loop, listenAddr, backendAddr, numThreads);
+  MultiplexServer server(&loop, listenAddr, backendAddr, numThreads, window);
 
   server.start();
 
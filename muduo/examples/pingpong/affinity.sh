@@ -0,0 +1,27 @@
+#!/bin/sh
+# Compare pingpong throughput with and without pinning IO threads,
+# eg. ./affinity.sh ../../build/release-cpp11/bin 4 0-3 4-7
+# server threads run on the first cpulist, client threads on the second.
+
+BIN=${1:-.}
+THREADS=${2:-4}
+SERVER_CPUS=${3:-0-3}
+CLIENT_CPUS=${4:-4-7}
+BLOCKSIZE=16384
+SESSIONS="1 10 100 1000"
+TIME=10
+
+run()
+{
+  for sessions in $SESSIONS; do
+    echo "======> ($1) threads $THREADS sessions $sessions"
+    $BIN/pingpong_server 0.0.0.0 33333 $THREADS $2 & srvpid=$!
+    sleep 1
+    $BIN/pingpong_client 127.0.0.1 33333 $THREADS $BLOCKSIZE $sessions $TIME $3 2>&1 | grep MiB
+    kill -9 $srvpid
+    sleep 3
+  done
+}
+
+run floating
+run pinned $SERVER_CPUS $CLIENT_CPUS
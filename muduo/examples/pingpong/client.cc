@@ -1,6 +1,7 @@
 #include "muduo/net/TcpClient.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
 #include "muduo/base/Thread.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
@@ -82,7 +83,8 @@ class Client : noncopyable
          int blockSize,
          int sessionCount,
          int timeout,
-         int threadCount)
+         int threadCount,
+         const std::vector<int>& cpus)
     : loop_(loop),
       threadPool_(loop, "pingpong-client"),
       sessionCount_(sessionCount),
@@ -93,6 +95,7 @@ class Client : noncopyable
     {
       threadPool_.setThreadNum(threadCount);
     }
+    threadPool_.setCpuAffinity(cpus);
     threadPool_.start();
 
     for (int i = 0; i < blockSize; ++i)
@@ -187,10 +190,10 @@ void Session::onConnection(const TcpConnectionPtr& conn)
 
 int main(int argc, char* argv[])
 {
-  if (argc != 7)
+  if (argc != 7 && argc != 8)
   {
     fprintf(stderr, "Usage: client <host_ip> <port> <threads> <blocksize> ");
-    fprintf(stderr, "<sessions> <time>\n");
+    fprintf(stderr, "<sessions> <time> [cpulist]\n");
   }
   else
   {
@@ -203,11 +206,16 @@ int main(int argc, char* argv[])
     int blockSize = atoi(argv[4]);
     int sessionCount = atoi(argv[5]);
     int timeout = atoi(argv[6]);
+    std::vector<int> cpus;
+    if (argc > 7)
+    {
+      cpus = ProcessInfo::parseCpuList(argv[7]);
+    }
 
     EventLoop loop;
     InetAddress serverAddr(ip, port);
 
-    Client client(&loop, serverAddr, blockSize, sessionCount, timeout, threadCount);
+    Client client(&loop, serverAddr, blockSize, sessionCount, timeout, threadCount, cpus);
     loop.loop();
   }
 }
@@ -2,6 +2,7 @@
 
 #include "muduo/base/Atomic.h"
 #include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
 #include "muduo/base/Thread.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/InetAddress.h"
@@ -31,7 +32,7 @@ int main(int argc, char* argv[])
 {
   if (argc < 4)
   {
-    fprintf(stderr, "Usage: server <address> <port> <threads>\n");
+    fprintf(stderr, "Usage: server <address> <port> <threads> [cpulist]\n");
   }
   else
   {
@@ -54,6 +55,11 @@ int main(int argc, char* argv[])
     {
       server.setThreadNum(threadCount);
     }
+    if (argc > 4)
+    {
+      // eg. "0-3", IO threads are pinned one per CPU
+      server.setThreadCpuAffinity(ProcessInfo::parseCpuList(argv[4]));
+    }
 
     server.start();
 
@@ -1,10 +1,7 @@
 #include "muduo/base/Logging.h"
-#include "muduo/net/Channel.h"
 #include "muduo/net/EventLoop.h"
-#include "muduo/net/Socket.h"
-#include "muduo/net/SocketsOps.h"
-#include "muduo/net/TcpClient.h"
-#include "muduo/net/TcpServer.h"
+#include "muduo/net/UdpClient.h"
+#include "muduo/net/UdpServer.h"
 
 #include <stdio.h>
 
@@ -13,77 +10,50 @@ using namespace muduo::net;
 
 const size_t frameLen = 2*sizeof(int64_t);
 
-int createNonblockingUDP()
-{
-  int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
-  if (sockfd < 0)
-  {
-    LOG_SYSFATAL << "::socket";
-  }
-  return sockfd;
-}
-
 /////////////////////////////// Server ///////////////////////////////
 
-void serverReadCallback(int sockfd, muduo::Timestamp receiveTime)
+void serverMessageCallback(UdpSocket* sock,
+                           const StringPiece& data,
+                           const InetAddress& peerAddr,
+                           muduo::Timestamp receiveTime)
 {
-  int64_t message[2];
-  struct sockaddr peerAddr;
-  memZero(&peerAddr, sizeof peerAddr);
-  socklen_t addrLen = sizeof peerAddr;
-  ssize_t nr = ::recvfrom(sockfd, message, sizeof message, 0, &peerAddr, &addrLen);
-
-  char addrStr[64];
-  sockets::toIpPort(addrStr, sizeof addrStr, &peerAddr);
-  LOG_DEBUG << "received " << nr << " bytes from " << addrStr;
+  LOG_DEBUG << "received " << data.size() << " bytes from " << peerAddr.toIpPort();
 
-  if (nr < 0)
-  {
-    LOG_SYSERR << "::recvfrom";
-  }
-  else if (implicit_cast<size_t>(nr) == frameLen)
+  if (implicit_cast<size_t>(data.size()) == frameLen)
   {
+    int64_t message[2];
+    memcpy(message, data.data(), sizeof message);
     message[1] = receiveTime.microSecondsSinceEpoch();
-    ssize_t nw = ::sendto(sockfd, message, sizeof message, 0, &peerAddr, addrLen);
-    if (nw < 0)
-    {
-      LOG_SYSERR << "::sendto";
-    }
-    else if (implicit_cast<size_t>(nw) != frameLen)
-    {
-      LOG_ERROR << "Expect " << frameLen << " bytes, wrote " << nw << " bytes.";
-    }
+    sock->send(message, sizeof message, peerAddr);
   }
   else
   {
-    LOG_ERROR << "Expect " << frameLen << " bytes, received " << nr << " bytes.";
+    LOG_ERROR << "Expect " << frameLen << " bytes, received " << data.size() << " bytes.";
   }
 }
 
-void runServer(uint16_t port)
+void runServer(uint16_t port, int threads, int batch)
 {
-  Socket sock(createNonblockingUDP());
-  sock.bindAddress(InetAddress(port));
   EventLoop loop;
-  Channel channel(&loop, sock.fd());
-  channel.setReadCallback(std::bind(&serverReadCallback, sock.fd(), _1));
-  channel.enableReading();
+  UdpServer server(&loop, InetAddress(port), "RoundTripUdp");
+  server.setThreadNum(threads);
+  server.setBatchSize(batch);
+  server.setMessageCallback(serverMessageCallback);
+  server.start();
   loop.loop();
 }
 
 /////////////////////////////// Client ///////////////////////////////
 
-void clientReadCallback(int sockfd, muduo::Timestamp receiveTime)
+void clientMessageCallback(UdpSocket*,
+                           const StringPiece& data,
+                           const InetAddress&,
+                           muduo::Timestamp receiveTime)
 {
-  int64_t message[2];
-  ssize_t nr = sockets::read(sockfd, message, sizeof message);
-
-  if (nr < 0)
-  {
-    LOG_SYSERR << "::read";
-  }
-  else if (implicit_cast<size_t>(nr) == frameLen)
+  if (implicit_cast<size_t>(data.size()) == frameLen)
   {
+    int64_t message[2];
+    memcpy(message, data.data(), sizeof message);
     int64_t send = message[0];
     int64_t their = message[1];
     int64_t back = receiveTime.microSecondsSinceEpoch();
@@ -93,59 +63,110 @@ void clientReadCallback(int sockfd, muduo::Timestamp receiveTime)
   }
   else
   {
-    LOG_ERROR << "Expect " << frameLen << " bytes, received " << nr << " bytes.";
+    LOG_ERROR << "Expect " << frameLen << " bytes, received " << data.size() << " bytes.";
   }
 }
 
-void sendMyTime(int sockfd)
+void sendMyTime(UdpClient* client)
 {
   int64_t message[2] = { 0, 0 };
   message[0] = Timestamp::now().microSecondsSinceEpoch();
-  ssize_t nw = sockets::write(sockfd, message, sizeof message);
-  if (nw < 0)
-  {
-    LOG_SYSERR << "::write";
-  }
-  else if (implicit_cast<size_t>(nw) != frameLen)
+  client->send(message, sizeof message);
+}
+
+void runClient(const char* ip, uint16_t port)
+{
+  EventLoop loop;
+  UdpClient client(&loop, InetAddress(ip, port), "RoundTripUdp");
+  client.setMessageCallback(clientMessageCallback);
+  client.start();
+  loop.runEvery(0.2, std::bind(sendMyTime, &client));
+  loop.loop();
+}
+
+/////////////////////////////// Bench ///////////////////////////////
+
+// Keeps 'window' datagrams in flight on each client, counts echoes per second.
+int64_t g_received = 0;
+
+void benchMessageCallback(UdpSocket* sock,
+                          const StringPiece& data,
+                          const InetAddress& peerAddr,
+                          muduo::Timestamp)
+{
+  ++g_received;
+  sock->send(data);
+}
+
+void printStats(const std::vector<std::unique_ptr<UdpClient>>* clients, int64_t* last)
+{
+  int64_t recvCalls = 0, sendCalls = 0, dropped = 0;
+  for (const auto& client : *clients)
   {
-    LOG_ERROR << "Expect " << frameLen << " bytes, wrote " << nw << " bytes.";
+    recvCalls += client->socket()->recvCalls();
+    sendCalls += client->socket()->sendCalls();
+    dropped += client->socket()->droppedDatagrams();
   }
+  int64_t packets = g_received - last[0];
+  printf("%.0f packets/s, %.2f packets per recvmmsg, %.2f per sendmmsg, %ld dropped\n",
+         static_cast<double>(packets),
+         static_cast<double>(packets) / static_cast<double>(std::max<int64_t>(recvCalls - last[1], 1)),
+         static_cast<double>(packets) / static_cast<double>(std::max<int64_t>(sendCalls - last[2], 1)),
+         static_cast<long>(dropped));
+  last[0] = g_received;
+  last[1] = recvCalls;
+  last[2] = sendCalls;
 }
 
-void runClient(const char* ip, uint16_t port)
+void runBench(const char* ip, uint16_t port, int numClients, int window, int batch, int seconds)
 {
-  Socket sock(createNonblockingUDP());
+  EventLoop loop;
   InetAddress serverAddr(ip, port);
-  int ret = sockets::connect(sock.fd(), serverAddr.getSockAddr());
-  if (ret < 0)
+  std::vector<std::unique_ptr<UdpClient>> clients;
+  int64_t message[2] = { 0, 0 };
+  for (int i = 0; i < numClients; ++i)
   {
-    LOG_SYSFATAL << "::connect";
+    clients.emplace_back(new UdpClient(&loop, serverAddr, "RoundTripUdpBench"));
+    clients.back()->socket()->setBatchSize(batch);
+    clients.back()->setMessageCallback(benchMessageCallback);
+    clients.back()->start();
+    for (int j = 0; j < window; ++j)
+    {
+      clients.back()->send(message, sizeof message);
+    }
   }
-  EventLoop loop;
-  Channel channel(&loop, sock.fd());
-  channel.setReadCallback(std::bind(&clientReadCallback, sock.fd(), _1));
-  channel.enableReading();
-  loop.runEvery(0.2, std::bind(sendMyTime, sock.fd()));
+  int64_t last[3] = { 0, 0, 0 };
+  loop.runEvery(1.0, std::bind(printStats, &clients, last));
+  loop.runAfter(seconds, std::bind(&EventLoop::quit, &loop));
   loop.loop();
 }
 
 int main(int argc, char* argv[])
 {
-  if (argc > 2)
+  if (argc > 2 && strcmp(argv[1], "-s") == 0)
   {
     uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
-    if (strcmp(argv[1], "-s") == 0)
-    {
-      runServer(port);
-    }
-    else
-    {
-      runClient(argv[1], port);
-    }
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+    int batch = argc > 4 ? atoi(argv[4]) : 64;
+    runServer(port, threads, batch);
+  }
+  else if (argc > 3 && strcmp(argv[1], "-b") == 0)
+  {
+    uint16_t port = static_cast<uint16_t>(atoi(argv[3]));
+    int clients = argc > 4 ? atoi(argv[4]) : 1;
+    int window = argc > 5 ? atoi(argv[5]) : 64;
+    int batch = argc > 6 ? atoi(argv[6]) : 64;
+    int seconds = argc > 7 ? atoi(argv[7]) : 10;
+    runBench(argv[2], port, clients, window, batch, seconds);
+  }
+  else if (argc > 2)
+  {
+    runClient(argv[1], static_cast<uint16_t>(atoi(argv[2])));
   }
   else
   {
-    printf("Usage:\n%s -s port\n%s ip port\n", argv[0], argv[0]);
+    printf("Usage:\n%s -s port [threads] [batch]\n%s ip port\n"
+           "%s -b ip port [clients] [window] [batch] [seconds]\n",
+           argv[0], argv[0], argv[0]);
   }
 }
-
@@ -0,0 +1,188 @@
+#ifndef MUDUO_EXAMPLES_SHORTURL_REDIRECTSTORE_H
+#define MUDUO_EXAMPLES_SHORTURL_REDIRECTSTORE_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/ThreadLocal.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Read-mostly map from path to redirect target, with the 301 responses
+// prepared ahead.
+//
+// A table is immutable once built.  Updates copy the table under mutex_
+// and bump version_, RCU-like.  Each thread keeps its own snapshot and
+// refreshes it only when the version changes, so a lookup is one atomic
+// load plus an open addressing probe, with no lock and no shared
+// reference count.  An old table goes away when the last thread has
+// refreshed.
+class RedirectStore : muduo::noncopyable
+{
+ public:
+  struct Entry
+  {
+    muduo::string path;
+    muduo::string target;
+    muduo::string keepAliveResponse;
+    muduo::string closeResponse;
+  };
+  typedef std::shared_ptr<const Entry> EntryPtr;
+
+  class Table : muduo::noncopyable
+  {
+   public:
+    explicit Table(std::vector<EntryPtr> entries)
+      : entries_(std::move(entries))
+    {
+      size_t capacity = 16;
+      while (capacity < entries_.size() * 2)
+        capacity *= 2;
+      slots_.assign(capacity, Slot());
+      for (size_t i = 0; i < entries_.size(); ++i)
+      {
+        uint64_t h = hash(entries_[i]->path);
+        size_t pos = static_cast<size_t>(h) & (capacity - 1);
+        while (slots_[pos].index >= 0)
+          pos = (pos + 1) & (capacity - 1);
+        slots_[pos].hash = h;
+        slots_[pos].index = static_cast<int>(i);
+      }
+    }
+
+    const Entry* find(muduo::StringPiece path) const
+    {
+      uint64_t h = hash(path);
+      size_t mask = slots_.size() - 1;
+      for (size_t pos = static_cast<size_t>(h) & mask; slots_[pos].index >= 0; pos = (pos + 1) & mask)
+      {
+        const Slot& slot = slots_[pos];
+        if (slot.hash == h && path == entries_[slot.index]->path)
+          return entries_[slot.index].get();
+      }
+      return NULL;
+    }
+
+    const std::vector<EntryPtr>& entries() const { return entries_; }
+
+    // FNV-1a
+    static uint64_t hash(muduo::StringPiece s)
+    {
+      uint64_t h = 14695981039346656037ULL;
+      for (int i = 0; i < s.size(); ++i)
+      {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 1099511628211ULL;
+      }
+      return h;
+    }
+
+   private:
+    struct Slot
+    {
+      Slot() : hash(0), index(-1) { }
+      uint64_t hash;
+      int index;
+    };
+
+    std::vector<EntryPtr> entries_;
+    std::vector<Slot> slots_;
+  };
+
+  typedef std::shared_ptr<const Table> TablePtr;
+
+  RedirectStore()
+    : table_(new Table(std::vector<EntryPtr>())),
+      version_(0)
+  {
+  }
+
+  /// Returns false if target could break the Location header.
+  bool set(const muduo::string& path, const muduo::string& target)
+  {
+    if (path.empty() || path[0] != '/' ||
+        target.empty() || target.find_first_of("\r\n") != muduo::string::npos)
+      return false;
+    std::shared_ptr<Entry> entry(new Entry);
+    entry->path = path;
+    entry->target = target;
+    entry->keepAliveResponse = makeResponse(target, false);
+    entry->closeResponse = makeResponse(target, true);
+
+    // entries are shared by the copies
+    muduo::MutexLockGuard lock(mutex_);
+    std::vector<EntryPtr> entries;
+    entries.reserve(table_->entries().size() + 1);
+    for (const EntryPtr& e : table_->entries())
+    {
+      if (e->path != path)
+        entries.push_back(e);
+    }
+    entries.push_back(entry);
+    publish(std::move(entries));
+    return true;
+  }
+
+  bool remove(const muduo::string& path)
+  {
+    muduo::MutexLockGuard lock(mutex_);
+    if (!table_->find(path))
+      return false;
+    std::vector<EntryPtr> entries;
+    for (const EntryPtr& e : table_->entries())
+    {
+      if (e->path != path)
+        entries.push_back(e);
+    }
+    publish(std::move(entries));
+    return true;
+  }
+
+  /// Snapshot of calling thread, do not keep it across requests.
+  const TablePtr& local() const
+  {
+    Local& local = local_.value();
+    if (local.version != version_.load(std::memory_order_acquire) || !local.table)
+    {
+      muduo::MutexLockGuard lock(mutex_);
+      local.table = table_;
+      local.version = version_.load(std::memory_order_relaxed);
+    }
+    return local.table;
+  }
+
+  static muduo::string makeResponse(const muduo::string& target, bool close)
+  {
+    muduo::net::HttpResponse resp(close);
+    resp.setStatusCode(muduo::net::HttpResponse::k301MovedPermanently);
+    resp.setStatusMessage("Moved Permanently");
+    resp.addHeader("Location", target);
+    muduo::net::Buffer buf;
+    resp.appendToBuffer(&buf);
+    return buf.retrieveAllAsString();
+  }
+
+ private:
+  struct Local
+  {
+    Local() : version(~0ULL) { }
+    TablePtr table;
+    uint64_t version;
+  };
+
+  void publish(std::vector<EntryPtr> entries) REQUIRES(mutex_)
+  {
+    table_.reset(new Table(std::move(entries)));
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  mutable muduo::MutexLock mutex_;
+  TablePtr table_ GUARDED_BY(mutex_);
+  std::atomic<uint64_t> version_;
+  mutable muduo::ThreadLocal<Local> local_;
+};
+
+#endif  // MUDUO_EXAMPLES_SHORTURL_REDIRECTSTORE_H
@@ -1,3 +1,5 @@
+#include "examples/shorturl/RedirectStore.h"
+
 #include "muduo/net/http/HttpServer.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
@@ -15,7 +17,7 @@ using namespace muduo::net;
 extern char favicon[555];
 bool benchmark = false;
 
-std::map<string, string> redirections;
+RedirectStore redirections;
 
 void onRequest(const HttpRequest& req, HttpResponse* resp)
 {
@@ -31,15 +33,24 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     }
   }
 
-  // TODO: support PUT and DELETE to create new redirections on-the-fly.
+  if (req.method() == HttpRequest::kPut || req.method() == HttpRequest::kDelete)
+  {
+    // PUT /path with "Location: url" header, or DELETE /path
+    bool ok = req.method() == HttpRequest::kPut
+        ? redirections.set(req.path(), req.getHeader("Location"))
+        : redirections.remove(req.path());
+    resp->setStatusCode(ok ? HttpResponse::k200Ok : HttpResponse::k400BadRequest);
+    resp->setStatusMessage(ok ? "OK" : "Bad Request");
+    return;
+  }
 
-  std::map<string, string>::const_iterator it = redirections.find(req.path());
-  if (it != redirections.end())
+  const RedirectStore::TablePtr& table = redirections.local();
+  const RedirectStore::Entry* entry = table->find(req.path());
+  if (entry)
   {
-    resp->setStatusCode(HttpResponse::k301MovedPermanently);
-    resp->setStatusMessage("Moved Permanently");
-    resp->addHeader("Location", it->second);
-    // resp->setCloseConnection(true);
+    resp->setPrecomputed(resp->closeConnection() ? entry->closeResponse
+                                                 : entry->keepAliveResponse,
+                         table);
   }
   else if (req.path() == "/")
   {
@@ -47,11 +58,10 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     resp->setStatusMessage("OK");
     resp->setContentType("text/html");
     string now = Timestamp::now().toFormattedString();
-    std::map<string, string>::const_iterator i = redirections.begin();
     string text;
-    for (; i != redirections.end(); ++i)
+    for (const RedirectStore::EntryPtr& e : table->entries())
     {
-      text.append("<ul>" + i->first + " =&gt; " + i->second + "</ul>");
+      text.append("<ul>" + e->path + " =&gt; " + e->target + "</ul>");
     }
 
     resp->setBody("<html><head><title>My tiny short url service</title></head>"
@@ -77,8 +87,8 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
 
 int main(int argc, char* argv[])
 {
-  redirections["/1"] = "http://chenshuo.com";
-  redirections["/2"] = "http://blog.csdn.net/Solstice";
+  redirections.set("/1", "http://chenshuo.com");
+  redirections.set("/2", "http://blog.csdn.net/Solstice");
 
   int numThreads = 0;
   if (argc > 1)
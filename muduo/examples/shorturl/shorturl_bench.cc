@@ -0,0 +1,279 @@
+// Redirect lookups, std::map with a mutex and per-request response
+// building as shorturl used to do, vs. RedirectStore with precomputed
+// responses.  First in process with N reader threads and a writer,
+// then over HTTP with N loops on SO_REUSEPORT and keep-alive clients.
+//
+// Usage: shorturl_bench [max_threads] [seconds]
+
+#include "examples/shorturl/RedirectStore.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpServer.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kKeys = 10000;
+
+string keyOf(int i)
+{
+  return "/" + std::to_string(i);
+}
+
+class MapStore : noncopyable
+{
+ public:
+  void set(const string& path, const string& target)
+  {
+    MutexLockGuard lock(mutex_);
+    map_[path] = target;
+  }
+
+  // as shorturl used to
+  bool respond(const string& path, HttpResponse* resp)
+  {
+    string target;
+    {
+      MutexLockGuard lock(mutex_);
+      std::map<string, string>::const_iterator it = map_.find(path);
+      if (it == map_.end())
+        return false;
+      target = it->second;
+    }
+    resp->setStatusCode(HttpResponse::k301MovedPermanently);
+    resp->setStatusMessage("Moved Permanently");
+    resp->addHeader("Location", target);
+    return true;
+  }
+
+ private:
+  MutexLock mutex_;
+  std::map<string, string> map_ GUARDED_BY(mutex_);
+};
+
+bool respond(RedirectStore* store, const string& path, HttpResponse* resp)
+{
+  const RedirectStore::TablePtr& table = store->local();
+  const RedirectStore::Entry* entry = table->find(path);
+  if (entry == NULL)
+    return false;
+  resp->setPrecomputed(resp->closeConnection() ? entry->closeResponse
+                                               : entry->keepAliveResponse,
+                       table);
+  return true;
+}
+
+template<typename Respond>
+void benchLookup(const char* name, int threads, double seconds, Respond respondFunc,
+                 std::function<void (int)> update)
+{
+  std::vector<string> paths;
+  for (int i = 0; i < kKeys; ++i)
+    paths.push_back(keyOf(i));
+
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> total(0);
+  std::vector<std::unique_ptr<Thread>> readers;
+  for (int t = 0; t < threads; ++t)
+  {
+    readers.emplace_back(new Thread([&, t]
+    {
+      unsigned seed = t + 1;
+      int64_t n = 0;
+      Buffer output;
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        for (int i = 0; i < 100; ++i)
+        {
+          HttpResponse resp(false);
+          if (respondFunc(paths[rand_r(&seed) % kKeys], &resp))
+            resp.appendToBuffer(&output);
+          output.retrieveAll();
+        }
+        n += 100;
+      }
+      total += n;
+    }));
+  }
+  // one update per millisecond
+  Thread writer([&]
+  {
+    int i = 0;
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      update(i++ % kKeys);
+      usleep(1000);
+    }
+  });
+  for (auto& t : readers)
+    t->start();
+  writer.start();
+  usleep(static_cast<useconds_t>(seconds * 1e6));
+  stop = true;
+  for (auto& t : readers)
+    t->join();
+  writer.join();
+  printf("%-8s %7d %12.0f\n", name, threads, static_cast<double>(total.load()) / seconds);
+}
+
+// GET a random short url, wait for the response, repeat.
+class Client : noncopyable
+{
+ public:
+  Client(EventLoop* loop, const InetAddress& serverAddr, int seed)
+    : client_(loop, serverAddr, "BenchClient"),
+      seed_(seed),
+      responses_(0)
+  {
+    client_.setConnectionCallback([this](const TcpConnectionPtr& conn)
+    {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+        sendRequest(conn);
+      }
+    });
+    client_.setMessageCallback(
+        std::bind(&Client::onMessage, this, _1, _2, _3));
+    client_.connect();
+  }
+
+  int64_t responses() const { return responses_; }
+
+ private:
+  void sendRequest(const TcpConnectionPtr& conn)
+  {
+    char buf[64];
+    int n = snprintf(buf, sizeof buf, "GET /%d HTTP/1.1\r\nHost: bench\r\n\r\n",
+                     rand_r(&seed_) % kKeys);
+    conn->send(buf, n);
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    // redirects have no body
+    const char* end;
+    while ((end = static_cast<const char*>(memmem(buf->peek(), buf->readableBytes(), "\r\n\r\n", 4))))
+    {
+      buf->retrieveUntil(end + 4);
+      ++responses_;
+      sendRequest(conn);
+    }
+  }
+
+  TcpClient client_;
+  unsigned seed_;
+  int64_t responses_;
+};
+
+void benchHttp(const char* name, int threads, int seconds, HttpServer::HttpCallback cb)
+{
+  int probe = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(probe, InetAddress(0, true).getSockAddr());
+  uint16_t port = InetAddress(sockets::getLocalAddr(probe)).port();
+  sockets::close(probe);
+
+  // one HttpServer per loop, as shorturl does with SO_REUSEPORT
+  EventLoopThread baseThread;
+  EventLoop* baseLoop = baseThread.startLoop();
+  std::unique_ptr<EventLoopThreadPool> pool;
+  std::vector<std::unique_ptr<HttpServer>> servers;
+  CountDownLatch started(1);
+  baseLoop->runInLoop([&]
+  {
+    pool.reset(new EventLoopThreadPool(baseLoop, "bench"));
+    pool->setThreadNum(threads);
+    pool->start();
+    for (int i = 0; i < threads; ++i)
+    {
+      EventLoop* ioLoop = pool->getNextLoop();
+      servers.emplace_back(new HttpServer(ioLoop, InetAddress(port, true),
+                                          "shorturl", TcpServer::kReusePort));
+      servers.back()->setHttpCallback(cb);
+      HttpServer* server = servers.back().get();
+      ioLoop->runInLoop([server] { server->start(); });
+    }
+    started.countDown();
+  });
+  started.wait();
+
+  EventLoop loop;
+  std::vector<std::unique_ptr<Client>> clients;
+  loop.runAfter(0.1, [&]
+  {
+    for (int i = 0; i < 4 * threads; ++i)
+      clients.emplace_back(new Client(&loop, InetAddress("127.0.0.1", port), i + 1));
+  });
+  loop.runAfter(0.1 + seconds, [&] { loop.quit(); });
+  loop.loop();
+
+  int64_t responses = 0;
+  for (const auto& client : clients)
+    responses += client->responses();
+  printf("%-8s %7d %12.0f\n", name, threads, static_cast<double>(responses) / seconds);
+
+  CountDownLatch stopped(1);
+  baseLoop->runInLoop([&]
+  {
+    for (auto& server : servers)
+    {
+      HttpServer* s = server.release();
+      s->getLoop()->runInLoop([s] { delete s; });
+    }
+    stopped.countDown();
+  });
+  stopped.wait();
+  // the connections are reset by the server, then the clients go away
+  clients.clear();
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::ERROR);
+  int maxThreads = argc > 1 ? atoi(argv[1]) : 4;
+  int seconds = argc > 2 ? atoi(argv[2]) : 2;
+
+  MapStore mapStore;
+  RedirectStore store;
+  for (int i = 0; i < kKeys; ++i)
+  {
+    string target = "http://example.com/some/long/path/" + std::to_string(i);
+    mapStore.set(keyOf(i), target);
+    store.set(keyOf(i), target);
+  }
+
+  printf("%-8s %7s %12s\n", "store", "threads", "lookups/s");
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    benchLookup("map", threads, seconds,
+                [&](const string& path, HttpResponse* resp) { return mapStore.respond(path, resp); },
+                [&](int i) { mapStore.set(keyOf(i), "http://example.com/updated"); });
+    benchLookup("store", threads, seconds,
+                [&](const string& path, HttpResponse* resp) { return respond(&store, path, resp); },
+                [&](int i) { store.set(keyOf(i), "http://example.com/updated"); });
+  }
+
+  printf("\n%-8s %7s %12s\n", "store", "loops", "requests/s");
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    benchHttp("map", threads, seconds,
+              [&](const HttpRequest& req, HttpResponse* resp) { mapStore.respond(req.path(), resp); });
+    benchHttp("store", threads, seconds,
+              [&](const HttpRequest& req, HttpResponse* resp) { respond(&store, req.path(), resp); });
+  }
+}
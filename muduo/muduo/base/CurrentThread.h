@@ -8,6 +8,8 @@
 
 #include "muduo/base/Types.h"
 
+#include <vector>
+
 namespace muduo
 {
 namespace CurrentThread
@@ -17,6 +19,7 @@ namespace CurrentThread
   extern __thread char t_tidString[32];
   extern __thread int t_tidStringLength;
   extern __thread const char* t_threadName;
+  extern __thread int t_numaNode;
   void cacheTid();
 
   inline int tid()
@@ -45,6 +48,16 @@ namespace CurrentThread
 
   bool isMainThread();
 
+  // pins the calling thread, returns false if sched_setaffinity fails.
+  bool setCpuAffinity(const std::vector<int>& cpus);
+
+  // NUMA node of the CPUs this thread is pinned to,
+  // -1 if not pinned by setCpuAffinity() or spanning nodes.
+  inline int numaNode()
+  {
+    return t_numaNode;
+  }
+
   void sleepUsec(int64_t usec);  // for testing
 
   string stackTrace(bool demangle);
@@ -0,0 +1,413 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_LOCKFREEQUEUE_H
+#define MUDUO_BASE_LOCKFREEQUEUE_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace muduo
+{
+
+namespace detail
+{
+
+const size_t kCacheLineSize = 64;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+inline size_t roundUpToPowerOfTwo(size_t n)
+{
+  size_t size = 1;
+  while (size < n)
+  {
+    size <<= 1;
+  }
+  return size;
+}
+
+// Event count on a futex word, so that a blocked put() or take() sleeps in the
+// kernel.  The low bit of the word says somebody is waiting, the rest is an
+// epoch.  notify() costs a load when nobody waits, and only the first
+// notify() after a waiter arrives makes the wake-up syscall.
+//
+//   waiter:   key = prepareWait(); if (!ready()) wait(key);
+//   notifier: make ready; notify();
+class FutexEvent : noncopyable
+{
+ public:
+  FutexEvent()
+    : state_(0)
+  {
+  }
+
+  uint32_t prepareWait()
+  {
+    uint32_t key = state_.fetch_or(1, std::memory_order_seq_cst) | 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return key;
+  }
+
+  void wait(uint32_t key)
+  {
+    ::syscall(SYS_futex, &state_, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+  }
+
+  void notify()
+  {
+    // pairs with the fence in prepareWait(), so either the waiter sees
+    // the new element, or we see the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (state & 1)
+    {
+      // clears the bit and bumps the epoch
+      if (state_.compare_exchange_weak(state, state + 1, std::memory_order_release))
+      {
+        ::syscall(SYS_futex, &state_, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+        break;
+      }
+    }
+  }
+
+ private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex word must be 32-bit");
+  std::atomic<uint32_t> state_;
+};
+
+// Spinning only helps when the other side runs on another CPU.
+inline int spinsOnThisMachine(int spins)
+{
+  static const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 1 ? spins : 0;
+}
+
+// Spins for a while, then sleeps on the event until tryOp() succeeds.
+template<typename TryOp>
+void blockingRun(FutexEvent& event, int spins, TryOp tryOp)
+{
+  for (int i = 0; i < spins; ++i)
+  {
+    if (tryOp())
+      return;
+    cpuRelax();
+  }
+  while (true)
+  {
+    uint32_t key = event.prepareWait();
+    if (tryOp())
+      return;
+    event.wait(key);
+  }
+}
+
+}  // namespace detail
+
+///
+/// Bounded queue for exactly one producer thread and one consumer thread.
+///
+/// Lamport's ring buffer, head and tail live in their own cache lines, and
+/// each side caches the other side's index to avoid bouncing it.
+/// tryPut()/tryTake() never block, put()/take() spin briefly then sleep on
+/// a futex, no spinning on a uniprocessor.  Capacity is rounded up to a
+/// power of 2.
+///
+template<typename T>
+class BoundedSpscQueue : noncopyable
+{
+ public:
+  explicit BoundedSpscQueue(int maxSize, int spins = 100)
+    : capacity_(detail::roundUpToPowerOfTwo(static_cast<size_t>(maxSize))),
+      mask_(capacity_ - 1),
+      spins_(detail::spinsOnThisMachine(spins)),
+      slots_(new Slot[capacity_]),
+      head_(0),
+      cachedTail_(0),
+      tail_(0),
+      cachedHead_(0)
+  {
+    assert(maxSize > 0);
+  }
+
+  ~BoundedSpscQueue()
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i)
+    {
+      element(i)->~T();
+    }
+  }
+
+  // producer side
+
+  bool tryPut(const T& x) { return emplace(x); }
+  bool tryPut(T&& x) { return emplace(std::move(x)); }
+
+  void put(const T& x)
+  {
+    detail::blockingRun(notFull_, spins_, [&] { return emplace(x); });
+  }
+
+  void put(T&& x)
+  {
+    // emplace() moves only when it succeeds
+    detail::blockingRun(notFull_, spins_, [&] { return emplace(std::move(x)); });
+  }
+
+  // consumer side
+
+  bool tryTake(T* x)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cachedTail_)
+    {
+      cachedTail_ = tail_.load(std::memory_order_acquire);
+      if (head == cachedTail_)
+        return false;
+    }
+    T* elem = element(head);
+    *x = std::move(*elem);
+    elem->~T();
+    head_.store(head + 1, std::memory_order_release);
+    notFull_.notify();
+    return true;
+  }
+
+  T take()
+  {
+    T x;
+    detail::blockingRun(notEmpty_, spins_, [&] { return tryTake(&x); });
+    return x;
+  }
+
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() >= capacity_; }
+
+  size_t size() const
+  {
+    size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+  T* element(size_t index) { return reinterpret_cast<T*>(&slots_[index & mask_]); }
+
+  template<typename U>
+  bool emplace(U&& x)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cachedHead_ >= capacity_)
+    {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail - cachedHead_ >= capacity_)
+        return false;
+    }
+    new (element(tail)) T(std::forward<U>(x));
+    tail_.store(tail + 1, std::memory_order_release);
+    notEmpty_.notify();
+    return true;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  const int spins_;
+  std::unique_ptr<Slot[]> slots_;
+
+  char pad0_[detail::kCacheLineSize];
+  // written by consumer
+  std::atomic<size_t> head_;
+  size_t cachedTail_;
+  detail::FutexEvent notFull_;
+
+  char pad1_[detail::kCacheLineSize];
+  // written by producer
+  std::atomic<size_t> tail_;
+  size_t cachedHead_;
+  detail::FutexEvent notEmpty_;
+  char pad2_[detail::kCacheLineSize];
+};
+
+///
+/// Bounded queue for many producers and many consumers.
+///
+/// Dmitry Vyukov's array queue: every slot carries a sequence number, so
+/// producers and consumers claim slots with one CAS on their own index and
+/// never touch each other's cache line.  Same put/take API as
+/// BoundedBlockingQueue, plus non-blocking tryPut()/tryTake().
+/// Capacity is rounded up to a power of 2.
+///
+template<typename T>
+class BoundedMpmcQueue : noncopyable
+{
+ public:
+  explicit BoundedMpmcQueue(int maxSize, int spins = 100)
+    : capacity_(detail::roundUpToPowerOfTwo(static_cast<size_t>(maxSize))),
+      mask_(capacity_ - 1),
+      spins_(detail::spinsOnThisMachine(spins)),
+      cells_(new Cell[capacity_]),
+      enqueuePos_(0),
+      dequeuePos_(0)
+  {
+    assert(maxSize > 0);
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~BoundedMpmcQueue()
+  {
+    T x;
+    while (tryTake(&x))
+    {
+    }
+  }
+
+  bool tryPut(const T& x) { return emplace(x); }
+  bool tryPut(T&& x) { return emplace(std::move(x)); }
+
+  void put(const T& x)
+  {
+    detail::blockingRun(notFull_, spins_, [&] { return emplace(x); });
+  }
+
+  void put(T&& x)
+  {
+    detail::blockingRun(notFull_, spins_, [&] { return emplace(std::move(x)); });
+  }
+
+  bool tryTake(T* x)
+  {
+    Cell* cell;
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0)
+      {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;  // empty
+      }
+      else
+      {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    T* elem = cell->element();
+    *x = std::move(*elem);
+    elem->~T();
+    cell->sequence.store(pos + capacity_, std::memory_order_release);
+    notFull_.notify();
+    return true;
+  }
+
+  T take()
+  {
+    T x;
+    detail::blockingRun(notEmpty_, spins_, [&] { return tryTake(&x); });
+    return x;
+  }
+
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() >= capacity_; }
+
+  /// Approximate when other threads are running.
+  size_t size() const
+  {
+    size_t dequeue = dequeuePos_.load(std::memory_order_acquire);
+    size_t enqueue = enqueuePos_.load(std::memory_order_acquire);
+    return enqueue > dequeue ? enqueue - dequeue : 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* element() { return reinterpret_cast<T*>(&storage); }
+  };
+
+  template<typename U>
+  bool emplace(U&& x)
+  {
+    Cell* cell;
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0)
+      {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;  // full
+      }
+      else
+      {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->element()) T(std::forward<U>(x));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    notEmpty_.notify();
+    return true;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  const int spins_;
+  std::unique_ptr<Cell[]> cells_;
+
+  char pad0_[detail::kCacheLineSize];
+  std::atomic<size_t> enqueuePos_;
+  detail::FutexEvent notEmpty_;
+
+  char pad1_[detail::kCacheLineSize];
+  std::atomic<size_t> dequeuePos_;
+  detail::FutexEvent notFull_;
+  char pad2_[detail::kCacheLineSize];
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_LOCKFREEQUEUE_H
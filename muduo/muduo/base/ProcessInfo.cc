@@ -10,6 +10,7 @@
 #include <algorithm>
 
 #include <assert.h>
+#include <ctype.h>
 #include <dirent.h>
 #include <pwd.h>
 #include <stdio.h> // snprintf
@@ -244,3 +245,70 @@ std::vector<pid_t> ProcessInfo::threads()
   return result;
 }
 
+int ProcessInfo::numCpus()
+{
+  return static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+std::vector<int> ProcessInfo::parseCpuList(StringPiece list)
+{
+  std::vector<int> result;
+  const char* p = list.begin();
+  while (p < list.end())
+  {
+    char* end = NULL;
+    long first = ::strtol(p, &end, 10);
+    if (end == p)
+      break;
+    long last = first;
+    p = end;
+    if (p < list.end() && *p == '-')
+    {
+      last = ::strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu)
+    {
+      result.push_back(static_cast<int>(cpu));
+    }
+    while (p < list.end() && (*p == ',' || ::isspace(*p)))
+      ++p;
+  }
+  return result;
+}
+
+int ProcessInfo::numaNodeOfCpu(int cpu)
+{
+  const int kMaxNodes = 1024;
+  for (int node = 0; node < kMaxNodes; ++node)
+  {
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+    string cpulist;
+    if (FileUtil::readFile(path, 65536, &cpulist) != 0)
+      break;
+    std::vector<int> cpus = parseCpuList(cpulist);
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+      return node;
+  }
+  return 0;
+}
+
+std::vector<int> ProcessInfo::cpusOfNumaNode(int node)
+{
+  char path[64];
+  snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+  string cpulist;
+  std::vector<int> result;
+  if (FileUtil::readFile(path, 65536, &cpulist) == 0)
+  {
+    result = parseCpuList(cpulist);
+  }
+  if (result.empty())
+  {
+    for (int cpu = 0; cpu < numCpus(); ++cpu)
+      result.push_back(cpu);
+  }
+  return result;
+}
+
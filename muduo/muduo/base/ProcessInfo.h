@@ -61,6 +61,18 @@ namespace ProcessInfo
 
   int numThreads();
   std::vector<pid_t> threads();
+
+  /// number of online CPUs
+  int numCpus();
+
+  /// parse a CPU list like "0-3,8,10-11", as in /sys and taskset -c
+  std::vector<int> parseCpuList(StringPiece list);
+
+  /// read /sys/devices/system/node/node*/cpulist, 0 if unknown
+  int numaNodeOfCpu(int cpu);
+
+  /// all online CPUs if the node is unknown
+  std::vector<int> cpusOfNumaNode(int node);
 }  // namespace ProcessInfo
 
 }  // namespace muduo
@@ -7,10 +7,14 @@
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/Exception.h"
 #include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
 
+#include <algorithm>
 #include <type_traits>
 
+#include <ctype.h>
 #include <errno.h>
+#include <sched.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/prctl.h>
@@ -49,33 +53,54 @@ class ThreadNameInitializer
 
 ThreadNameInitializer init;
 
+// PR_SET_NAME truncates to 15 chars, "EchoServerLoop12" would become
+// "EchoServerLoop1", so keep the trailing index and cut the prefix instead.
+string kernelThreadName(const string& name)
+{
+  const size_t kMaxLen = 15;
+  if (name.size() <= kMaxLen)
+    return name;
+  size_t digits = name.size();
+  while (digits > 0 && ::isdigit(name[digits-1]))
+    --digits;
+  size_t suffixLen = std::min(name.size() - digits, kMaxLen);
+  return name.substr(0, kMaxLen - suffixLen) + name.substr(name.size() - suffixLen);
+}
+
 struct ThreadData
 {
   typedef muduo::Thread::ThreadFunc ThreadFunc;
   ThreadFunc func_;
   string name_;
+  std::vector<int> cpus_;
   pid_t* tid_;
   CountDownLatch* latch_;
 
   ThreadData(ThreadFunc func,
              const string& name,
+             const std::vector<int>& cpus,
              pid_t* tid,
              CountDownLatch* latch)
     : func_(std::move(func)),
       name_(name),
+      cpus_(cpus),
       tid_(tid),
       latch_(latch)
   { }
 
   void runInThread()
   {
+    if (!cpus_.empty())
+    {
+      muduo::CurrentThread::setCpuAffinity(cpus_);
+    }
     *tid_ = muduo::CurrentThread::tid();
     tid_ = NULL;
     latch_->countDown();
     latch_ = NULL;
 
     muduo::CurrentThread::t_threadName = name_.empty() ? "muduoThread" : name_.c_str();
-    ::prctl(PR_SET_NAME, muduo::CurrentThread::t_threadName);
+    ::prctl(PR_SET_NAME, kernelThreadName(muduo::CurrentThread::t_threadName).c_str());
     try
     {
       func_();
@@ -129,6 +154,36 @@ bool CurrentThread::isMainThread()
   return tid() == ::getpid();
 }
 
+bool CurrentThread::setCpuAffinity(const std::vector<int>& cpus)
+{
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus)
+  {
+    if (0 <= cpu && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &cpuset);
+  }
+  int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof cpuset, &cpuset);
+  if (ret != 0)
+  {
+    errno = ret;
+    LOG_SYSERR << "pthread_setaffinity_np";
+    return false;
+  }
+
+  int node = cpus.empty() ? -1 : ProcessInfo::numaNodeOfCpu(cpus[0]);
+  for (int cpu : cpus)
+  {
+    if (ProcessInfo::numaNodeOfCpu(cpu) != node)
+    {
+      node = -1;
+      break;
+    }
+  }
+  t_numaNode = node;
+  return true;
+}
+
 void CurrentThread::sleepUsec(int64_t usec)
 {
   struct timespec ts = { 0, 0 };
@@ -175,7 +230,7 @@ void Thread::start()
   assert(!started_);
   started_ = true;
   // FIXME: move(func_)
-  detail::ThreadData* data = new detail::ThreadData(func_, name_, &tid_, &latch_);
+  detail::ThreadData* data = new detail::ThreadData(func_, name_, cpus_, &tid_, &latch_);
   if (pthread_create(&pthreadId_, NULL, &detail::startThread, data))
   {
     started_ = false;
@@ -12,6 +12,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 #include <pthread.h>
 
 namespace muduo
@@ -26,6 +27,11 @@ class Thread : noncopyable
   // FIXME: make it movable in C++11
   ~Thread();
 
+  // Must be called before start().
+  // The new thread pins itself to these CPUs before running func.
+  void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+  const std::vector<int>& cpuAffinity() const { return cpus_; }
+
   void start();
   int join(); // return pthread_join()
 
@@ -45,6 +51,7 @@ class Thread : noncopyable
   pid_t      tid_;
   ThreadFunc func_;
   string     name_;
+  std::vector<int> cpus_;
   CountDownLatch latch_;
 
   static AtomicInt32 numCreated_;
@@ -41,6 +41,7 @@ void ThreadPool::start(int numThreads)
     snprintf(id, sizeof id, "%d", i+1);
     threads_.emplace_back(new muduo::Thread(
           std::bind(&ThreadPool::runInThread, this), name_+id));
+    threads_[i]->setCpuAffinity(cpus_);
     threads_[i]->start();
   }
   if (numThreads == 0 && threadInitCallback_)
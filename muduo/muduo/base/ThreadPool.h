@@ -29,6 +29,10 @@ class ThreadPool : noncopyable
   void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
   void setThreadInitCallback(const Task& cb)
   { threadInitCallback_ = cb; }
+  // Workers may run on any of these CPUs, eg. ProcessInfo::cpusOfNumaNode()
+  // of the IO loop feeding this pool, see CurrentThread::numaNode().
+  void setCpuAffinity(const std::vector<int>& cpus)
+  { cpus_ = cpus; }
 
   void start(int numThreads);
   void stop();
@@ -56,6 +60,7 @@ class ThreadPool : noncopyable
   Condition notFull_ GUARDED_BY(mutex_);
   string name_;
   Task threadInitCallback_;
+  std::vector<int> cpus_;
   std::vector<std::unique_ptr<muduo::Thread>> threads_;
   std::deque<Task> queue_ GUARDED_BY(mutex_);
   size_t maxQueueSize_;
@@ -8,6 +8,7 @@
 #include "muduo/base/Date.h"
 
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -81,6 +82,28 @@ inline void fillHMS(unsigned seconds, struct tm* utc)
   utc->tm_hour = minutes / 60;
 }
 
+// Date fields of one local day packed into 32 bits, so that the day number and
+// its date fit in a single std::atomic<uint64_t> and can be published without
+// a lock:  valid:1 yday:9 wday:3 mday:5 mon:4 year-1900:10
+inline uint32_t packDate(const struct tm& t)
+{
+  return (1u << 31)
+      | (static_cast<uint32_t>(t.tm_yday) << 22)
+      | (static_cast<uint32_t>(t.tm_wday) << 19)
+      | (static_cast<uint32_t>(t.tm_mday) << 14)
+      | (static_cast<uint32_t>(t.tm_mon) << 10)
+      | static_cast<uint32_t>(t.tm_year);
+}
+
+inline void unpackDate(uint32_t packed, struct tm* t)
+{
+  t->tm_yday = static_cast<int>((packed >> 22) & 0x1ff);
+  t->tm_wday = static_cast<int>((packed >> 19) & 0x7);
+  t->tm_mday = static_cast<int>((packed >> 14) & 0x1f);
+  t->tm_mon = static_cast<int>((packed >> 10) & 0xf);
+  t->tm_year = static_cast<int>(packed & 0x3ff);
+}
+
 }  // namespace detail
 const int kSecondsPerDay = 24*60*60;
 }  // namespace muduo
@@ -94,6 +117,16 @@ struct TimeZone::Data
   vector<detail::Localtime> localtimes;
   vector<string> names;
   string abbreviation;
+
+  // dayOffsets[d] is the index into localtimes in effect during the whole
+  // UTC day d (days since 1970-01-01), or kTransitionDay if some transition
+  // happens within that day, in which case we fall back to binary search.
+  static const uint8_t kTransitionDay = 0xff;
+  vector<uint8_t> dayOffsets;
+
+  // last (local day, packed date) seen by toLocalTime(), most calls are
+  // for "now" so this saves the civil date computation in the common case.
+  mutable std::atomic<uint64_t> lastLocalDay { 0 };
 };
 
 namespace muduo
@@ -220,6 +253,43 @@ bool readTimeZoneFile(const char* zonefile, struct TimeZone::Data* data)
   return true;
 }
 
+// TimeZone for 1970~2038, stop at the end of 32-bit time_t.
+const int kDaysInTable = 24856;
+
+void buildDayOffsets(TimeZone::Data* data)
+{
+  if (data->transitions.empty()
+      || data->localtimes.size() >= TimeZone::Data::kTransitionDay)
+    return;
+
+  data->dayOffsets.resize(kDaysInTable);
+  size_t next = 0;  // first transition after the current day begins
+  int idx = -1;     // localtime in effect before transitions[next]
+  while (next < data->transitions.size() && data->transitions[next].gmttime <= 0)
+  {
+    idx = data->transitions[next].localtimeIdx;
+    ++next;
+  }
+  for (int day = 0; day < kDaysInTable; ++day)
+  {
+    time_t dayEnd = static_cast<time_t>(day + 1) * kSecondsPerDay;
+    if (next < data->transitions.size() && data->transitions[next].gmttime < dayEnd)
+    {
+      data->dayOffsets[day] = TimeZone::Data::kTransitionDay;
+      while (next < data->transitions.size() && data->transitions[next].gmttime < dayEnd)
+      {
+        idx = data->transitions[next].localtimeIdx;
+        ++next;
+      }
+    }
+    else
+    {
+      // same rule as findLocaltime() for times before the first transition
+      data->dayOffsets[day] = static_cast<uint8_t>(idx >= 0 ? idx : 0);
+    }
+  }
+}
+
 const Localtime* findLocaltime(const TimeZone::Data& data, Transition sentry, Comp comp)
 {
   const Localtime* local = NULL;
@@ -254,6 +324,59 @@ const Localtime* findLocaltime(const TimeZone::Data& data, Transition sentry, Co
   return local;
 }
 
+const Localtime* findLocaltimeCached(const TimeZone::Data& data, time_t seconds)
+{
+  if (data.transitions.empty())
+  {
+    return &data.localtimes.front();
+  }
+
+  if (seconds >= 0 && seconds < static_cast<time_t>(data.dayOffsets.size()) * kSecondsPerDay)
+  {
+    uint8_t idx = data.dayOffsets[static_cast<size_t>(seconds / kSecondsPerDay)];
+    if (idx != TimeZone::Data::kTransitionDay)
+    {
+      return &data.localtimes[idx];
+    }
+  }
+
+  Transition sentry(seconds, 0, 0);
+  return findLocaltime(data, sentry, Comp(true));
+}
+
+void fillLocalTime(const TimeZone::Data& data, time_t localSeconds, struct tm* localTime)
+{
+  int seconds = static_cast<int>(localSeconds % kSecondsPerDay);
+  int days = static_cast<int>(localSeconds / kSecondsPerDay);
+  if (seconds < 0)
+  {
+    seconds += kSecondsPerDay;
+    --days;
+  }
+  fillHMS(seconds, localTime);
+
+  // Racing threads may both compute and store the same day, either result is fine.
+  uint64_t last = data.lastLocalDay.load(std::memory_order_relaxed);
+  uint32_t packed = static_cast<uint32_t>(last);
+  if ((packed >> 31) && static_cast<int32_t>(last >> 32) == days)
+  {
+    unpackDate(packed, localTime);
+    return;
+  }
+
+  struct tm date = TimeZone::toUtcTime(static_cast<time_t>(days) * kSecondsPerDay, true);
+  localTime->tm_year = date.tm_year;
+  localTime->tm_mon = date.tm_mon;
+  localTime->tm_mday = date.tm_mday;
+  localTime->tm_wday = date.tm_wday;
+  localTime->tm_yday = date.tm_yday;
+  if (date.tm_year >= 0 && date.tm_year < 1024)
+  {
+    uint64_t entry = (static_cast<uint64_t>(static_cast<uint32_t>(days)) << 32) | packDate(date);
+    data.lastLocalDay.store(entry, std::memory_order_relaxed);
+  }
+}
+
 }  // namespace detail
 }  // namespace muduo
 
@@ -265,6 +388,10 @@ TimeZone::TimeZone(const char* zonefile)
   {
     data_.reset();
   }
+  else
+  {
+    detail::buildDayOffsets(data_.get());
+  }
 }
 
 TimeZone::TimeZone(int eastOfUtc, const char* name)
@@ -281,13 +408,12 @@ struct tm TimeZone::toLocalTime(time_t seconds) const
   assert(data_ != NULL);
   const Data& data(*data_);
 
-  detail::Transition sentry(seconds, 0, 0);
-  const detail::Localtime* local = findLocaltime(data, sentry, detail::Comp(true));
+  const detail::Localtime* local = detail::findLocaltimeCached(data, seconds);
 
   if (local)
   {
     time_t localSeconds = seconds + local->gmtOffset;
-    ::gmtime_r(&localSeconds, &localTime); // FIXME: fromUtcTime
+    detail::fillLocalTime(data, localSeconds, &localTime);
     localTime.tm_isdst = local->isDst;
     localTime.tm_gmtoff = local->gmtOffset;
     localTime.tm_zone = &data.abbreviation[local->arrbIdx];
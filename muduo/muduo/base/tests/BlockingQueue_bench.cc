@@ -1,5 +1,7 @@
 #include "muduo/base/BlockingQueue.h"
+#include "muduo/base/BoundedBlockingQueue.h"
 #include "muduo/base/CountDownLatch.h"
+#include "muduo/base/LockFreeQueue.h"
 #include "muduo/base/Logging.h"
 #include "muduo/base/Thread.h"
 #include "muduo/base/Timestamp.h"
@@ -8,16 +10,34 @@
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 bool g_verbose = false;
 
+const int kCapacity = 1024;
+
+template<typename Queue>
+struct QueueMaker
+{
+  static Queue* make() { return new Queue(kCapacity); }
+};
+
+template<typename T>
+struct QueueMaker<muduo::BlockingQueue<T>>
+{
+  static muduo::BlockingQueue<T>* make() { return new muduo::BlockingQueue<T>; }
+};
+
 // Many threads, one queue.
+template<template<typename> class Queue>
 class Bench
 {
  public:
   Bench(int numThreads)
-    : latch_(numThreads)
+    : queue_(QueueMaker<Queue<muduo::Timestamp>>::make()),
+      delay_queue_(QueueMaker<Queue<int>>::make()),
+      latch_(numThreads)
   {
     threads_.reserve(numThreads);
     for (int i = 0; i < numThreads; ++i)
@@ -42,17 +62,38 @@ class Bench
     for (int i = 0; i < times; ++i)
     {
       muduo::Timestamp now(muduo::Timestamp::now());
-      queue_.put(now);
-      total_delay += delay_queue_.take();
+      queue_->put(now);
+      total_delay += delay_queue_->take();
     }
     printf("Average delay: %.3fus\n", static_cast<double>(total_delay) / times);
   }
 
+  // One producer, one consumer, as fast as they can.
+  void throughput(int64_t times)
+  {
+    muduo::Timestamp start(muduo::Timestamp::now());
+    muduo::Thread consumer([this, times]
+    {
+      for (int64_t i = 0; i < times; ++i)
+      {
+        delay_queue_->take();
+      }
+    });
+    consumer.start();
+    for (int64_t i = 0; i < times; ++i)
+    {
+      delay_queue_->put(static_cast<int>(i));
+    }
+    consumer.join();
+    double seconds = timeDifference(muduo::Timestamp::now(), start);
+    printf("Throughput: %.2f M items/s\n", static_cast<double>(times) / seconds / 1e6);
+  }
+
   void joinAll()
   {
     for (size_t i = 0; i < threads_.size(); ++i)
     {
-      queue_.put(muduo::Timestamp::invalid());
+      queue_->put(muduo::Timestamp::invalid());
     }
 
     for (auto& thr : threads_)
@@ -77,7 +118,7 @@ class Bench
     bool running = true;
     while (running)
     {
-      muduo::Timestamp t(queue_.take());
+      muduo::Timestamp t(queue_->take());
       muduo::Timestamp now(muduo::Timestamp::now());
       if (t.valid())
       {
@@ -85,7 +126,7 @@ class Bench
         // printf("tid=%d, latency = %d us\n",
         //        muduo::CurrentThread::tid(), delay);
         ++delays[delay];
-        delay_queue_.put(delay);
+        delay_queue_->put(delay);
       }
       running = t.valid();
     }
@@ -104,17 +145,36 @@ class Bench
     }
   }
 
-  muduo::BlockingQueue<muduo::Timestamp> queue_;
-  muduo::BlockingQueue<int> delay_queue_;
+  std::unique_ptr<Queue<muduo::Timestamp>> queue_;
+  std::unique_ptr<Queue<int>> delay_queue_;
   muduo::CountDownLatch latch_;
   std::vector<std::unique_ptr<muduo::Thread>> threads_;
 };
 
+template<template<typename> class Queue>
+void runBench(const char* name, int threads)
+{
+  printf("%s\n", name);
+  Bench<Queue> t(threads);
+  t.run(100000);
+  t.joinAll();
+  // workers have stopped, delay_queue_ is free now
+  t.throughput(1000 * 1000);
+}
+
 int main(int argc, char* argv[])
 {
   int threads = argc > 1 ? atoi(argv[1]) : 1;
+  const char* which = argc > 2 ? argv[2] : "all";
+  bool all = strcmp(which, "all") == 0;
 
-  Bench t(threads);
-  t.run(100000);
-  t.joinAll();
+  if (all || strcmp(which, "blocking") == 0)
+    runBench<muduo::BlockingQueue>("BlockingQueue", threads);
+  if (all || strcmp(which, "bounded") == 0)
+    runBench<muduo::BoundedBlockingQueue>("BoundedBlockingQueue", threads);
+  // one producer and one consumer on each queue only with one worker
+  if ((all && threads == 1) || strcmp(which, "spsc") == 0)
+    runBench<muduo::BoundedSpscQueue>("BoundedSpscQueue", 1);
+  if (all || strcmp(which, "mpmc") == 0)
+    runBench<muduo::BoundedMpmcQueue>("BoundedMpmcQueue", threads);
 }
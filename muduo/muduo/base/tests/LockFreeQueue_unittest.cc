@@ -0,0 +1,130 @@
+#include "muduo/base/LockFreeQueue.h"
+#include "muduo/base/Thread.h"
+
+#include <memory>
+#include <vector>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+
+using muduo::BoundedMpmcQueue;
+using muduo::BoundedSpscQueue;
+
+const int kCount = 1000 * 1000;
+
+void testSpscOrder()
+{
+  BoundedSpscQueue<int> queue(100);
+  assert(queue.capacity() == 128);
+  assert(queue.empty());
+
+  muduo::Thread consumer([&queue]
+  {
+    for (int i = 0; i < kCount; ++i)
+    {
+      int x = queue.take();
+      assert(x == i);
+      (void)x;
+    }
+  });
+  consumer.start();
+  for (int i = 0; i < kCount; ++i)
+  {
+    queue.put(i);
+  }
+  consumer.join();
+  assert(queue.empty());
+}
+
+template<typename Queue>
+void testTry()
+{
+  Queue queue(4);
+  for (int i = 0; i < 4; ++i)
+  {
+    assert(queue.tryPut(std::unique_ptr<int>(new int(i))));
+  }
+  assert(queue.full());
+  std::unique_ptr<int> p(new int(4));
+  assert(!queue.tryPut(std::move(p)));
+  assert(p && *p == 4);  // not moved from
+  assert(queue.size() == 4);
+
+  std::unique_ptr<int> x;
+  assert(queue.tryTake(&x) && *x == 0);
+  assert(queue.tryPut(std::move(p)));
+  for (int i = 1; i < 5; ++i)
+  {
+    assert(*queue.take() == i);
+  }
+  assert(!queue.tryTake(&x));
+
+  // leftovers are destroyed
+  queue.put(std::unique_ptr<int>(new int(5)));
+}
+
+void testMpmcSum(int producers, int consumers)
+{
+  BoundedMpmcQueue<int64_t> queue(64);
+  const int perProducer = kCount / producers;
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  std::vector<int64_t> sums(consumers);
+  for (int i = 0; i < producers; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([&queue, perProducer]
+    {
+      for (int j = 1; j <= perProducer; ++j)
+      {
+        queue.put(j);
+      }
+    }));
+  }
+  for (int i = 0; i < consumers; ++i)
+  {
+    int64_t* sum = &sums[i];
+    threads.emplace_back(new muduo::Thread([&queue, sum]
+    {
+      int64_t x;
+      while ((x = queue.take()) != 0)
+      {
+        *sum += x;
+      }
+    }));
+  }
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  for (int i = 0; i < producers; ++i)
+  {
+    threads[i]->join();
+  }
+  for (int i = 0; i < consumers; ++i)
+  {
+    queue.put(0);
+  }
+  for (int i = 0; i < consumers; ++i)
+  {
+    threads[producers + i]->join();
+  }
+
+  int64_t total = 0;
+  for (int64_t sum : sums)
+  {
+    total += sum;
+  }
+  assert(total == static_cast<int64_t>(producers) * perProducer * (perProducer + 1) / 2);
+  assert(queue.empty());
+}
+
+int main()
+{
+  testSpscOrder();
+  testTry<BoundedSpscQueue<std::unique_ptr<int>>>();
+  testTry<BoundedMpmcQueue<std::unique_ptr<int>>>();
+  testMpmcSum(1, 1);
+  testMpmcSum(4, 4);
+  testMpmcSum(8, 2);
+  printf("OK\n");
+}
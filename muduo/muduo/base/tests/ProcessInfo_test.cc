@@ -13,5 +13,8 @@ int main()
   printf("opened files = %d\n", muduo::ProcessInfo::openedFiles());
   printf("threads = %zd\n", muduo::ProcessInfo::threads().size());
   printf("num threads = %d\n", muduo::ProcessInfo::numThreads());
+  printf("num cpus = %d\n", muduo::ProcessInfo::numCpus());
+  printf("numa node of cpu 0 = %d\n", muduo::ProcessInfo::numaNodeOfCpu(0));
+  printf("cpus of numa node 0 = %zd\n", muduo::ProcessInfo::cpusOfNumaNode(0).size());
   printf("status = %s\n", muduo::ProcessInfo::procStatus().c_str());
 }
@@ -0,0 +1,90 @@
+#include "muduo/base/TimeZone.h"
+#include "muduo/base/Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+using namespace muduo;
+
+const int N = 10*1000*1000;
+
+// 'seconds' holds the timestamps to convert, 'sum' keeps the loops alive.
+template<typename Func>
+void bench(const char* name, const std::vector<time_t>& seconds, Func func)
+{
+  int64_t sum = 0;
+  Timestamp start(Timestamp::now());
+  for (time_t t : seconds)
+  {
+    struct tm tm = func(t);
+    sum += tm.tm_hour + tm.tm_mday;
+  }
+  Timestamp end(Timestamp::now());
+  double elapsed = timeDifference(end, start);
+  printf("%-24s %6.2f ns/call  %ld\n", name,
+         elapsed * 1e9 / static_cast<double>(seconds.size()),
+         static_cast<long>(sum));
+}
+
+void benchAll(const char* title, const TimeZone& tz, const std::vector<time_t>& seconds)
+{
+  printf("%s\n", title);
+  bench("localtime_r", seconds, [](time_t t)
+  {
+    struct tm tm;
+    ::localtime_r(&t, &tm);
+    return tm;
+  });
+  bench("gmtime_r", seconds, [](time_t t)
+  {
+    struct tm tm;
+    ::gmtime_r(&t, &tm);
+    return tm;
+  });
+  bench("TimeZone::toUtcTime", seconds, [](time_t t)
+  {
+    return TimeZone::toUtcTime(t);
+  });
+  bench("TimeZone::toLocalTime", seconds, [&tz](time_t t)
+  {
+    return tz.toLocalTime(t);
+  });
+}
+
+int main(int argc, char* argv[])
+{
+  const char* zone = argc > 1 ? argv[1] : "America/New_York";
+  char zonefile[256];
+  snprintf(zonefile, sizeof zonefile, "/usr/share/zoneinfo/%s", zone);
+  TimeZone tz(zonefile);
+  setenv("TZ", zone, 1);
+  tzset();
+  printf("zone %s\n", zone);
+
+  std::vector<time_t> seconds;
+  seconds.reserve(N);
+
+  // like Logger: consecutive calls with the current time
+  time_t now = ::time(NULL);
+  for (int i = 0; i < N; ++i)
+    seconds.push_back(now + i / 1000);
+  benchAll("now, 1000 calls per second", tz, seconds);
+
+  // walking across the spring-forward and fall-back days of each year
+  seconds.clear();
+  const time_t kStart = TimeZone::fromUtcTime(2000, 1, 1, 0, 0, 0);
+  const time_t kEnd = TimeZone::fromUtcTime(2030, 1, 1, 0, 0, 0);
+  const time_t step = (kEnd - kStart) / N;
+  for (int i = 0; i < N; ++i)
+    seconds.push_back(kStart + i * step);
+  benchAll("sequential 2000~2030", tz, seconds);
+
+  // random, defeats any last-day cache
+  seconds.clear();
+  srand(42);
+  for (int i = 0; i < N; ++i)
+    seconds.push_back(kStart + static_cast<time_t>(rand()) % (kEnd - kStart));
+  benchAll("random 2000~2030", tz, seconds);
+}
@@ -265,6 +265,35 @@ void testFixedTimezone()
   }
 }
 
+// compare with localtime_r(3), walking across DST boundaries of many years
+void testLocaltime(const char* zone)
+{
+  char zonefile[256];
+  snprintf(zonefile, sizeof zonefile, "/usr/share/zoneinfo/%s", zone);
+  TimeZone tz(zonefile);
+  setenv("TZ", zone, 1);
+  tzset();
+
+  const time_t kStart = getGmt(1990, 1, 1, 0, 0, 0);
+  const time_t kEnd = getGmt(2030, 1, 1, 0, 0, 0);
+  for (time_t t = kStart; t < kEnd; t += 1799)
+  {
+    struct tm t1;
+    localtime_r(&t, &t1);
+    struct tm t2 = tz.toLocalTime(t);
+    char buf1[80], buf2[80];
+    strftime(buf1, sizeof buf1, "%F %T %u %j %z(%Z)", &t1);
+    strftime(buf2, sizeof buf2, "%F %T %u %j %z(%Z)", &t2);
+    if (strcmp(buf1, buf2) != 0 || t1.tm_isdst != t2.tm_isdst)
+    {
+      printf("WRONG %s: '%s' != '%s'\n", zone, buf1, buf2);
+      assert(0);
+    }
+  }
+  unsetenv("TZ");
+  tzset();
+}
+
 int main()
 {
   testNewYork();
@@ -272,5 +301,8 @@ int main()
   testSydney();
   testHongKong();
   testFixedTimezone();
+  testLocaltime("America/New_York");
+  testLocaltime("Europe/London");
+  testLocaltime("Australia/Sydney");
   testUtc();
 }
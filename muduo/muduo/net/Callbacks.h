@@ -58,6 +58,8 @@ namespace net
 // All client visible callbacks go here.
 
 class Buffer;
+class ConnectionFilter;
+class InetAddress;
 class TcpConnection;
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
 typedef std::function<void()> TimerCallback;
@@ -71,6 +73,10 @@ typedef std::function<void (const TcpConnectionPtr&,
                             Buffer*,
                             Timestamp)> MessageCallback;
 
+// creates the filter of a new connection, see ConnectionFilter.h
+typedef std::function<std::unique_ptr<ConnectionFilter> (int sockfd,
+                                                         const InetAddress& peerAddr)> ConnectionFilterFactory;
+
 void defaultConnectionCallback(const TcpConnectionPtr& conn);
 void defaultMessageCallback(const TcpConnectionPtr& conn,
                             Buffer* buffer,
@@ -0,0 +1,63 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_CONNECTIONFILTER_H
+#define MUDUO_NET_CONNECTIONFILTER_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <sys/types.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Buffer;
+
+///
+/// Transforms the bytes of a TcpConnection between the socket and the
+/// buffers, e.g. TLS, see muduo/net/ssl/TlsFilter.h.
+///
+/// A filter is bound to the socket when created.  TcpConnection drives
+/// the handshake first, and calls back connection up only after it's done.
+/// Then user sees plain data in message callback and sends plain data.
+///
+/// All calls are made in the loop thread of the connection.
+///
+class ConnectionFilter : noncopyable
+{
+ public:
+  enum Result { kDone, kWantRead, kWantWrite, kError };
+
+  virtual ~ConnectionFilter();
+
+  /// Called when connection is established, and then whenever the socket
+  /// is ready as wanted, until kDone or kError.
+  virtual Result handshake() = 0;
+
+  /// Reads from the socket all available, appends decoded data to buf.
+  /// Returns bytes appended, 0 on end of stream, -1 on error with errno set,
+  /// EAGAIN if there is nothing to deliver yet.
+  virtual ssize_t read(Buffer* buf) = 0;
+
+  /// Appends the encoded data to out, which goes to the socket as is.
+  virtual void encode(const void* data, size_t len, Buffer* out) = 0;
+
+  /// Ends the stream before the socket is shut down, e.g. TLS close_notify.
+  /// Called once, when nothing is pending in out.
+  virtual void shutdown(Buffer* out) = 0;
+
+  /// True if the kernel encodes what is written to the socket, e.g. kTLS,
+  /// then plain data, and files with sendfile(2), go to the socket as is.
+  virtual bool passThrough() const = 0;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_CONNECTIONFILTER_H
@@ -11,10 +11,13 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/DnsResolver.h"
+#include "muduo/net/Endian.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/SocketsOps.h"
 
 #include <errno.h>
+#include <stdio.h>  // snprintf
 
 using namespace muduo;
 using namespace muduo::net;
@@ -25,9 +28,38 @@ const int Connector::kMaxRetryDelayMs;
 Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
     serverAddr_(serverAddr),
+    resolver_(NULL),
+    port_(serverAddr.port()),
+    nextAddress_(0),
     connect_(false),
     state_(kDisconnected),
-    retryDelayMs_(kInitRetryDelayMs)
+    retryDelayMs_(kInitRetryDelayMs),
+    initRetryDelayMs_(kInitRetryDelayMs),
+    maxRetryDelayMs_(kMaxRetryDelayMs),
+    jitter_(false),
+    random_(static_cast<unsigned>(Timestamp::now().microSecondsSinceEpoch())
+            ^ static_cast<unsigned>(reinterpret_cast<uintptr_t>(this)))
+{
+  // 这里没有init channel，因为只有连接成功的时候才会有一个有效的fd
+  LOG_DEBUG << "ctor[" << this << "]";
+}
+
+Connector::Connector(EventLoop* loop, DnsResolver* resolver,
+                     const string& host, uint16_t port)
+  : loop_(loop),
+    serverAddr_(port),
+    resolver_(CHECK_NOTNULL(resolver)),
+    host_(host),
+    port_(port),
+    nextAddress_(0),
+    connect_(false),
+    state_(kDisconnected),
+    retryDelayMs_(kInitRetryDelayMs),
+    initRetryDelayMs_(kInitRetryDelayMs),
+    maxRetryDelayMs_(kMaxRetryDelayMs),
+    jitter_(false),
+    random_(static_cast<unsigned>(Timestamp::now().microSecondsSinceEpoch())
+            ^ static_cast<unsigned>(reinterpret_cast<uintptr_t>(this)))
 {
   // 这里没有init channel，因为只有连接成功的时候才会有一个有效的fd
   LOG_DEBUG << "ctor[" << this << "]";
@@ -51,7 +83,20 @@ void Connector::startInLoop()
   assert(state_ == kDisconnected);
   if (connect_)
   {
-    connect();//  调用connect()（socket，connect）
+    if (resolver_)
+    {
+      // resolver may run in another loop
+      EventLoop* loop = loop_;
+      std::shared_ptr<Connector> self(shared_from_this());
+      resolver_->resolve(host_, [loop, self](const std::vector<InetAddress>& addresses)
+      {
+        loop->runInLoop(std::bind(&Connector::onResolved, self, addresses));
+      });
+    }
+    else
+    {
+      connect();//  调用connect()（socket，connect）
+    }
   }
   else
   {
@@ -77,6 +122,39 @@ void Connector::stopInLoop()
   }
 }
 
+void Connector::onResolved(const std::vector<InetAddress>& addresses)
+{
+  loop_->assertInLoopThread();
+  if (!connect_ || state_ != kDisconnected)
+  {
+    LOG_DEBUG << "do not connect";
+  }
+  else if (addresses.empty())
+  {
+    LOG_ERROR << "Connector::onResolved - Unable to resolve " << host_;
+    retryLater();
+  }
+  else
+  {
+    struct sockaddr_in addr = *sockets::sockaddr_in_cast(
+        addresses[nextAddress_ % addresses.size()].getSockAddr());
+    addr.sin_port = sockets::hostToNetwork16(port_);
+    serverAddr_ = InetAddress(addr);
+    connect();
+  }
+}
+
+string Connector::serverName() const
+{
+  if (resolver_)
+  {
+    char buf[16];
+    snprintf(buf, sizeof buf, ":%u", port_);
+    return host_ + buf;
+  }
+  return serverAddr_.toIpPort();
+}
+
 void Connector::connect()
 {
   // 创建非阻塞套接字
@@ -123,9 +201,19 @@ void Connector::restart()
 {
   loop_->assertInLoopThread();
   setState(kDisconnected);
-  retryDelayMs_ = kInitRetryDelayMs;
+  retryDelayMs_ = initRetryDelayMs_;
   connect_ = true;
-  startInLoop();
+  if (jitter_)
+  {
+    // 断线后不立即重连，随机等待一段时间
+    std::uniform_int_distribution<int> dist(0, std::max(initRetryDelayMs_ - 1, 0));
+    loop_->runAfter(dist(random_)/1000.0,
+                    std::bind(&Connector::startInLoop, shared_from_this()));
+  }
+  else
+  {
+    startInLoop();
+  }
 }
 
 void Connector::connecting(int sockfd)
@@ -215,14 +303,20 @@ void Connector::handleError()
 void Connector::retry(int sockfd)
 {
   sockets::close(sockfd);
+  ++nextAddress_;  // try the next address of host
+  retryLater();
+}
+
+void Connector::retryLater()
+{
   setState(kDisconnected);
   if (connect_)
   {
-    LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
-             << " in " << retryDelayMs_ << " milliseconds. ";
-    loop_->runAfter(retryDelayMs_/1000.0,
+    int delayMs = nextRetryDelayMs();
+    LOG_INFO << "Connector::retry - Retry connecting to " << serverName()
+             << " in " << delayMs << " milliseconds. ";
+    loop_->runAfter(delayMs/1000.0,
                     std::bind(&Connector::startInLoop, shared_from_this()));
-    retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
   }
   else
   {// 此时connect_被stop()设置为false，因此打印对应log
@@ -230,3 +324,20 @@ void Connector::retry(int sockfd)
   }
 }
 
+int Connector::nextRetryDelayMs()
+{
+  int delayMs = retryDelayMs_;
+  if (jitter_)
+  {
+    // https://aws.amazon.com/blogs/architecture/exponential-backoff-and-jitter/
+    int upper = std::max(initRetryDelayMs_, std::min(retryDelayMs_, maxRetryDelayMs_ / 3) * 3);
+    std::uniform_int_distribution<int> dist(initRetryDelayMs_, upper);
+    delayMs = std::min(dist(random_), maxRetryDelayMs_);
+    retryDelayMs_ = delayMs;
+  }
+  else
+  {
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+  }
+  return delayMs;
+}
@@ -12,10 +12,13 @@
 #define MUDUO_NET_CONNECTOR_H
 
 #include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
 #include "muduo/net/InetAddress.h"
 
 #include <functional>
 #include <memory>
+#include <random>
+#include <vector>
 
 namespace muduo
 {
@@ -23,6 +26,7 @@ namespace net
 {
 
 class Channel;
+class DnsResolver;
 class EventLoop;
 
 class Connector : noncopyable,
@@ -32,6 +36,8 @@ class Connector : noncopyable,
   typedef std::function<void (int sockfd)> NewConnectionCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
+  /// Resolves @c host before every try, addresses are rotated on retry.
+  Connector(EventLoop* loop, DnsResolver* resolver, const string& host, uint16_t port);
   ~Connector();
 
   void setNewConnectionCallback(const NewConnectionCallback& cb)
@@ -44,7 +50,24 @@ class Connector : noncopyable,
   // 断开连接
   void stop();  // can be called in any thread
 
+  /// The last resolved address if connecting by name.
   const InetAddress& serverAddress() const { return serverAddr_; }
+  /// host:port or ip:port
+  string serverName() const;
+
+  // Must be called before start().
+  void setRetryDelay(int initMs, int maxMs)
+  {
+    initRetryDelayMs_ = initMs;
+    maxRetryDelayMs_ = maxMs;
+    retryDelayMs_ = initMs;
+  }
+
+  // "decorrelated jitter" backoff: each delay is picked uniformly from
+  // [initMs, 3 * previous delay], and restart() waits a random [0, initMs)
+  // first, so that many clients of a restarted server don't reconnect in lockstep.
+  // 随机化重连间隔，避免大量client同时重连
+  void enableJitter(bool on) { jitter_ = on; }
 
  private:
   enum States { kDisconnected, kConnecting, kConnected };
@@ -68,15 +91,23 @@ class Connector : noncopyable,
   void handleError();
   // connect_为false：close fd；为true（重新socket，connect等步骤）
   void retry(int sockfd);
+  void retryLater();
+  void onResolved(const std::vector<InetAddress>& addresses);
   // 将channel从loop中移除（同时返回socketfd）
   int removeAndResetChannel();
   // 释放持有channel的ptr
   void resetChannel();
+  // 计算下一次重连的间隔
+  int nextRetryDelayMs();
 
   // 对应的eventloop
   EventLoop* loop_;
   // 要连接的服务端地址
   InetAddress serverAddr_;
+  DnsResolver* resolver_;  // not own, NULL if connecting by address
+  const string host_;
+  const uint16_t port_;
+  size_t nextAddress_;
   // 是否开始连接
   bool connect_; // atomic
   // connector的状态
@@ -85,6 +116,10 @@ class Connector : noncopyable,
   NewConnectionCallback newConnectionCallback_;
   // 默认重连的时间参数
   int retryDelayMs_;
+  int initRetryDelayMs_;
+  int maxRetryDelayMs_;
+  bool jitter_;
+  std::minstd_rand random_;
 };
 
 }  // namespace net
@@ -0,0 +1,515 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/DnsResolver.h"
+
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/Endian.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/UdpSocket.h"
+
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <string.h>
+#include <sys/random.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kTypeA = 1;
+const uint16_t kTypeSoa = 6;
+const uint16_t kClassIn = 1;
+const uint16_t kFlagResponse = 0x8000;
+const uint16_t kFlagRecursionDesired = 0x0100;
+const int kRcodeNoError = 0;
+const int kRcodeNameError = 3;  // NXDOMAIN
+// each query in flight holds a socket
+const size_t kMaxQueries = 1000;
+
+// unpredictable, so that off-path attackers can't forge answers.
+uint16_t randomId()
+{
+  uint16_t id = 0;
+  if (::getrandom(&id, sizeof id, 0) != static_cast<ssize_t>(sizeof id))
+  {
+    LOG_SYSFATAL << "DnsResolver - getrandom";
+  }
+  return id;
+}
+
+// connecting autobinds to a random ephemeral port, -1 if failed.
+int createQuerySocket(const InetAddress& nameServer)
+{
+  int sockfd = ::socket(nameServer.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSERR << "DnsResolver - socket";
+    return -1;
+  }
+  if (sockets::connect(sockfd, nameServer.getSockAddr()) < 0)
+  {
+    LOG_SYSERR << "DnsResolver - connect " << nameServer.toIpPort();
+    sockets::close(sockfd);
+    return -1;
+  }
+  return sockfd;
+}
+
+// lower case without the trailing dot, false if not a valid domain name.
+bool normalizeName(const string& hostname, string* name)
+{
+  name->clear();
+  size_t labelLen = 0;
+  for (size_t i = 0; i < hostname.size(); ++i)
+  {
+    char c = hostname[i];
+    if (c == '.')
+    {
+      if (labelLen == 0)
+        return false;
+      labelLen = 0;
+    }
+    else if (++labelLen > 63 || c <= ' ' || c >= 0x7f)
+    {
+      return false;
+    }
+    if (c != '.' || i + 1 < hostname.size())
+      name->push_back(static_cast<char>(::tolower(c)));
+  }
+  return !name->empty() && name->size() <= 253;
+}
+
+void appendName(const string& name, Buffer* buf)
+{
+  size_t start = 0;
+  while (start < name.size())
+  {
+    size_t dot = name.find('.', start);
+    if (dot == string::npos)
+      dot = name.size();
+    buf->appendInt8(static_cast<int8_t>(dot - start));
+    buf->append(name.data() + start, dot - start);
+    start = dot + 1;
+  }
+  buf->appendInt8(0);
+}
+
+// Bounds checked reader of DNS messages, sticky error.
+class MessageReader
+{
+ public:
+  MessageReader(const char* data, size_t len)
+    : data_(data), len_(len), pos_(0), ok_(true)
+  {
+  }
+
+  bool ok() const { return ok_; }
+
+  uint16_t readUint16()
+  {
+    uint16_t be16 = 0;
+    if (check(sizeof be16))
+    {
+      memcpy(&be16, data_ + pos_, sizeof be16);
+      pos_ += sizeof be16;
+    }
+    return sockets::networkToHost16(be16);
+  }
+
+  uint32_t readUint32()
+  {
+    uint32_t be32 = 0;
+    if (check(sizeof be32))
+    {
+      memcpy(&be32, data_ + pos_, sizeof be32);
+      pos_ += sizeof be32;
+    }
+    return sockets::networkToHost32(be32);
+  }
+
+  const char* read(size_t n)
+  {
+    if (!check(n))
+      return NULL;
+    const char* p = data_ + pos_;
+    pos_ += n;
+    return p;
+  }
+
+  // reads a name in lower case, follows compression pointers.
+  void readName(string* name)
+  {
+    name->clear();
+    size_t pos = pos_;
+    size_t end = 0;  // after the first pointer
+    for (int hops = 0; ok_; )
+    {
+      if (pos >= len_)
+      {
+        ok_ = false;
+        break;
+      }
+      uint8_t len = static_cast<uint8_t>(data_[pos]);
+      if ((len & 0xc0) == 0xc0)
+      {
+        if (pos + 1 >= len_ || ++hops > 32)
+        {
+          ok_ = false;
+          break;
+        }
+        if (end == 0)
+          end = pos + 2;
+        pos = (static_cast<size_t>(len & 0x3f) << 8) | static_cast<uint8_t>(data_[pos + 1]);
+      }
+      else if (len == 0)
+      {
+        if (end == 0)
+          end = pos + 1;
+        break;
+      }
+      else if (len > 63 || pos + 1 + len > len_)
+      {
+        ok_ = false;
+      }
+      else
+      {
+        if (!name->empty())
+          name->push_back('.');
+        for (size_t i = 0; i < len; ++i)
+          name->push_back(static_cast<char>(::tolower(data_[pos + 1 + i])));
+        pos += 1 + len;
+      }
+    }
+    if (ok_)
+      pos_ = end;
+  }
+
+ private:
+  bool check(size_t n)
+  {
+    if (pos_ + n > len_)
+      ok_ = false;
+    return ok_;
+  }
+
+  const char* data_;
+  size_t len_;
+  size_t pos_;
+  bool ok_;
+};
+
+}  // namespace
+
+DnsResolver::DnsResolver(EventLoop* loop, const InetAddress& nameServer)
+  : loop_(CHECK_NOTNULL(loop)),
+    nameServer_(nameServer),
+    timeout_(2.0),
+    retries_(2),
+    negativeTtl_(10.0),
+    maxTtl_(3600.0),
+    maxCacheSize_(10000),
+    queriesSent_(0),
+    cacheHits_(0)
+{
+}
+
+DnsResolver::~DnsResolver()
+{
+  loop_->assertInLoopThread();
+  for (const auto& item : queries_)
+  {
+    loop_->cancel(item.second.timer);
+  }
+}
+
+InetAddress DnsResolver::defaultNameServer()
+{
+  string content;
+  FileUtil::readFile("/etc/resolv.conf", 65536, &content);
+  size_t pos = 0;
+  while (pos < content.size())
+  {
+    size_t eol = content.find('\n', pos);
+    if (eol == string::npos)
+      eol = content.size();
+    string line(content, pos, eol - pos);
+    pos = eol + 1;
+
+    char ip[64] = "";
+    if (::sscanf(line.c_str(), " nameserver %63s", ip) == 1)
+    {
+      bool ipv6 = ::strchr(ip, ':') != NULL;
+      if (ipv6 && ::strchr(ip, '%'))
+        continue;  // scoped address
+      return InetAddress(ip, 53, ipv6);
+    }
+  }
+  return InetAddress("127.0.0.1", 53);
+}
+
+void DnsResolver::resolve(const string& hostname, const Callback& cb)
+{
+  if (loop_->isInLoopThread())
+  {
+    resolveInLoop(hostname, cb);
+  }
+  else
+  {
+    loop_->runInLoop(std::bind(&DnsResolver::resolveInLoop, this, hostname, cb));
+  }
+}
+
+void DnsResolver::resolveInLoop(const string& hostname, const Callback& cb)
+{
+  loop_->assertInLoopThread();
+  std::vector<InetAddress> addresses;
+  struct sockaddr_in addr;
+  memZero(&addr, sizeof addr);
+  addr.sin_family = AF_INET;
+  if (::inet_pton(AF_INET, hostname.c_str(), &addr.sin_addr) == 1)
+  {
+    addresses.push_back(InetAddress(addr));
+    cb(addresses);
+    return;
+  }
+
+  string name;
+  if (!normalizeName(hostname, &name))
+  {
+    LOG_ERROR << "DnsResolver::resolve - invalid name " << hostname;
+    cb(addresses);
+    return;
+  }
+  if (name == "localhost")
+  {
+    addresses.push_back(InetAddress(0, true));
+    cb(addresses);
+    return;
+  }
+
+  auto cached = cache_.find(name);
+  if (cached != cache_.end())
+  {
+    if (cached->second.expiration > Timestamp::now())
+    {
+      ++cacheHits_;
+      addresses = cached->second.addresses;  // cb may change the cache
+      cb(addresses);
+      return;
+    }
+    cache_.erase(cached);
+  }
+
+  auto pending = pending_.find(name);
+  if (pending != pending_.end())
+  {
+    queries_[pending->second].callbacks.push_back(cb);
+    return;
+  }
+
+  if (queries_.size() >= kMaxQueries)
+  {
+    LOG_ERROR << "DnsResolver::resolve - too many queries in flight";
+    cb(addresses);
+    return;
+  }
+  int sockfd = createQuerySocket(nameServer_);
+  if (sockfd < 0)
+  {
+    cb(addresses);
+    return;
+  }
+  uint16_t id = randomId();
+  while (queries_.find(id) != queries_.end())
+  {
+    id = randomId();
+  }
+  Query& query = queries_[id];
+  query.name = name;
+  query.socket.reset(new UdpSocket(loop_, sockfd, "DnsResolver"));
+  query.socket->setBatchSize(4);
+  query.socket->setMessageCallback(
+      std::bind(&DnsResolver::onMessage, this, id, _1, _2, _3, std::placeholders::_4));
+  query.socket->start();
+  query.triesLeft = retries_;
+  query.callbacks.push_back(cb);
+  pending_[name] = id;
+  sendQuery(id, query);
+}
+
+void DnsResolver::sendQuery(uint16_t id, const Query& query)
+{
+  Buffer buf;
+  buf.appendInt16(static_cast<int16_t>(id));
+  buf.appendInt16(static_cast<int16_t>(kFlagRecursionDesired));
+  buf.appendInt16(1);  // QDCOUNT
+  buf.appendInt16(0);  // ANCOUNT
+  buf.appendInt16(0);  // NSCOUNT
+  buf.appendInt16(0);  // ARCOUNT
+  appendName(query.name, &buf);
+  buf.appendInt16(static_cast<int16_t>(kTypeA));
+  buf.appendInt16(static_cast<int16_t>(kClassIn));
+  query.socket->send(buf.toStringPiece());
+  ++queriesSent_;
+  queries_[id].timer = loop_->runAfter(timeout_, std::bind(&DnsResolver::onTimeout, this, id));
+}
+
+void DnsResolver::onTimeout(uint16_t id)
+{
+  auto it = queries_.find(id);
+  if (it == queries_.end())
+    return;
+  Query& query = it->second;
+  if (query.triesLeft > 0)
+  {
+    --query.triesLeft;
+    LOG_DEBUG << "DnsResolver - resend query of " << query.name;
+    sendQuery(id, query);
+  }
+  else
+  {
+    LOG_WARN << "DnsResolver - query of " << query.name << " timed out";
+    finish(id, std::vector<InetAddress>(), 0);
+  }
+}
+
+void DnsResolver::onMessage(uint16_t queryId, UdpSocket*, const StringPiece& data,
+                            const InetAddress&, Timestamp)
+{
+  MessageReader reader(data.data(), data.size());
+  uint16_t id = reader.readUint16();
+  uint16_t flags = reader.readUint16();
+  uint16_t qdcount = reader.readUint16();
+  uint16_t ancount = reader.readUint16();
+  uint16_t nscount = reader.readUint16();
+  reader.readUint16();  // ARCOUNT
+
+  auto it = queries_.find(id);
+  if (!reader.ok() || id != queryId || it == queries_.end()
+      || !(flags & kFlagResponse) || qdcount != 1)
+  {
+    LOG_DEBUG << "DnsResolver - unexpected message of " << data.size() << " bytes";
+    return;
+  }
+
+  string name;
+  reader.readName(&name);
+  reader.readUint16();  // QTYPE
+  reader.readUint16();  // QCLASS
+  if (!reader.ok() || name != it->second.name)
+  {
+    LOG_WARN << "DnsResolver - answer of " << name << " doesn't match question "
+             << it->second.name;
+    return;
+  }
+
+  const int rcode = flags & 0xf;
+  if (rcode != kRcodeNoError && rcode != kRcodeNameError)
+  {
+    LOG_WARN << "DnsResolver - query of " << name << " failed, rcode " << rcode;
+    finish(id, std::vector<InetAddress>(), 0);
+    return;
+  }
+
+  std::vector<InetAddress> addresses;
+  uint32_t minTtl = UINT32_MAX;
+  uint32_t negativeTtl = 0;
+  bool hasSoa = false;
+  for (int i = 0; i < ancount + nscount && reader.ok(); ++i)
+  {
+    string owner;
+    reader.readName(&owner);
+    uint16_t type = reader.readUint16();
+    uint16_t klass = reader.readUint16();
+    uint32_t ttl = reader.readUint32();
+    uint16_t rdlength = reader.readUint16();
+    const char* rdata = reader.read(rdlength);
+    if (!reader.ok())
+      break;
+
+    if (i < ancount && type == kTypeA && klass == kClassIn && rdlength == 4)
+    {
+      // owner may be an alias of name
+      struct sockaddr_in addr;
+      memZero(&addr, sizeof addr);
+      addr.sin_family = AF_INET;
+      memcpy(&addr.sin_addr, rdata, 4);
+      addresses.push_back(InetAddress(addr));
+      minTtl = std::min(minTtl, ttl);
+    }
+    else if (i >= ancount && type == kTypeSoa && rdlength >= 4)
+    {
+      uint32_t minimum = 0;
+      memcpy(&minimum, rdata + rdlength - 4, sizeof minimum);
+      negativeTtl = std::min(ttl, sockets::networkToHost32(minimum));
+      hasSoa = true;
+    }
+  }
+
+  if (!addresses.empty())
+  {
+    finish(id, addresses, std::min(static_cast<double>(minTtl), maxTtl_));
+  }
+  else
+  {
+    LOG_DEBUG << "DnsResolver - no address of " << name << ", rcode " << rcode;
+    double ttl = hasSoa ? std::min(static_cast<double>(negativeTtl), maxTtl_) : negativeTtl_;
+    finish(id, addresses, ttl);
+  }
+}
+
+void DnsResolver::finish(uint16_t id, const std::vector<InetAddress>& addresses, double ttl)
+{
+  auto it = queries_.find(id);
+  assert(it != queries_.end());
+  loop_->cancel(it->second.timer);
+  pending_.erase(it->second.name);
+  if (ttl > 0)
+  {
+    insertCache(it->second.name, addresses, ttl);
+  }
+  std::vector<Callback> callbacks;
+  callbacks.swap(it->second.callbacks);
+  // may be in its message callback, destroyed after this loop iteration
+  std::shared_ptr<UdpSocket> socket(std::move(it->second.socket));
+  socket->stop();
+  loop_->queueInLoop([socket] {});
+  queries_.erase(it);
+
+  for (const auto& cb : callbacks)
+  {
+    cb(addresses);
+  }
+}
+
+void DnsResolver::insertCache(const string& name, const std::vector<InetAddress>& addresses, double ttl)
+{
+  if (cache_.size() >= maxCacheSize_)
+  {
+    Timestamp now = Timestamp::now();
+    for (auto it = cache_.begin(); it != cache_.end(); )
+    {
+      if (it->second.expiration < now)
+        it = cache_.erase(it);
+      else
+        ++it;
+    }
+    if (cache_.size() >= maxCacheSize_)
+    {
+      cache_.clear();
+    }
+  }
+  CacheEntry& entry = cache_[name];
+  entry.addresses = addresses;
+  entry.expiration = addTime(Timestamp::now(), ttl);
+}
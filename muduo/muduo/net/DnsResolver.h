@@ -0,0 +1,120 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_DNSRESOLVER_H
+#define MUDUO_NET_DNSRESOLVER_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TimerId.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class UdpSocket;
+
+///
+/// Asynchronous DNS stub resolver of IPv4 addresses, in one loop.
+///
+/// Sends A queries over UDP to one name server, without blocking the loop.
+/// Answers are cached for their TTL, NXDOMAIN and empty answers for the TTL
+/// of the SOA record (RFC 2308), or negativeTtl() without one.  Concurrent
+/// queries of the same name share one request on the wire.
+///
+/// Each query is sent from its own connected socket, on a source port
+/// chosen by the kernel, with an ID from getrandom(2), against spoofing.
+///
+/// Doesn't read /etc/hosts, except for "localhost".
+class DnsResolver : noncopyable
+{
+ public:
+  /// addresses have port 0, empty if failed.
+  typedef std::function<void (const std::vector<InetAddress>&)> Callback;
+
+  explicit DnsResolver(EventLoop* loop,
+                       const InetAddress& nameServer = defaultNameServer());
+  ~DnsResolver();  // in loop thread, pending callbacks are dropped.
+
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Per try, default 2 seconds.
+  void setTimeout(double seconds) { timeout_ = seconds; }
+  /// Resend this many times after timeout, default 2.
+  void setRetries(int retries) { retries_ = retries; }
+  /// Cache failed names for this long without a SOA record, default 10 seconds.
+  void setNegativeTtl(double seconds) { negativeTtl_ = seconds; }
+  double negativeTtl() const { return negativeTtl_; }
+  /// Cap TTLs from the server, default 1 hour.
+  void setMaxTtl(double seconds) { maxTtl_ = seconds; }
+  void setMaxCacheSize(size_t size) { maxCacheSize_ = size; }
+
+  /// Callback is called in loop thread, before resolve() returns if
+  /// @c hostname is an IP address or is in the cache.
+  /// Thread safe.
+  void resolve(const string& hostname, const Callback& cb);
+
+  void clearCache() { cache_.clear(); }
+  size_t cacheSize() const { return cache_.size(); }
+  int64_t queriesSent() const { return queriesSent_; }
+  int64_t cacheHits() const { return cacheHits_; }
+
+  /// The first nameserver in /etc/resolv.conf, or 127.0.0.1:53.
+  static InetAddress defaultNameServer();
+
+ private:
+  struct CacheEntry
+  {
+    std::vector<InetAddress> addresses;
+    Timestamp expiration;
+  };
+
+  struct Query
+  {
+    string name;
+    int triesLeft;
+    TimerId timer;
+    std::shared_ptr<UdpSocket> socket;
+    std::vector<Callback> callbacks;
+  };
+
+  void resolveInLoop(const string& hostname, const Callback& cb);
+  void sendQuery(uint16_t id, const Query& query);
+  void onTimeout(uint16_t id);
+  void onMessage(uint16_t id, UdpSocket*, const StringPiece& data, const InetAddress&, Timestamp);
+  void finish(uint16_t id, const std::vector<InetAddress>& addresses, double ttl);
+  void insertCache(const string& name, const std::vector<InetAddress>& addresses, double ttl);
+
+  EventLoop* loop_;
+  const InetAddress nameServer_;
+  double timeout_;
+  int retries_;
+  double negativeTtl_;
+  double maxTtl_;
+  size_t maxCacheSize_;
+  std::unordered_map<string, CacheEntry> cache_;
+  std::map<uint16_t, Query> queries_;  // in flight, by id
+  std::unordered_map<string, uint16_t> pending_;  // name to id of queries_
+  int64_t queriesSent_;
+  int64_t cacheHits_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_DNSRESOLVER_H
@@ -32,6 +32,10 @@ class EventLoopThread : noncopyable
   ~EventLoopThread();
   EventLoop* startLoop();
 
+  // Must be called before startLoop().
+  void setCpuAffinity(const std::vector<int>& cpus)
+  { thread_.setCpuAffinity(cpus); }
+
  private:
   void threadFunc();
 
@@ -43,6 +43,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
     char buf[name_.size() + 32];
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
     EventLoopThread* t = new EventLoopThread(cb, buf);
+    if (!cpus_.empty())
+    {
+      t->setCpuAffinity(std::vector<int>(1, cpus_[i % cpus_.size()]));
+    }
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));
     loops_.push_back(t->startLoop());
   }
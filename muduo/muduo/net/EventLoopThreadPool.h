@@ -37,6 +37,12 @@ class EventLoopThreadPool : noncopyable
   ~EventLoopThreadPool();
   // 设置threadpool中thread的数量
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+  /// Must be called before start().
+  /// The i-th IO thread is pinned to cpus[i % cpus.size()], so its loop
+  /// doesn't migrate and its memory comes from the local NUMA node.
+  // 绑定io线程到cpu上，ThreadInitCallback中可以用CurrentThread::numaNode()
+  // 得到所在的NUMA节点
+  void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
   // pool开始工作（由tcpserver调用）
   void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
@@ -70,6 +76,8 @@ class EventLoopThreadPool : noncopyable
   int numThreads_;
   // 用于从loops_中选取loop（用于负载均衡）
   int next_;
+  // io线程绑定的cpu
+  std::vector<int> cpus_;
   // 存放eventloopthread*的pool
   std::vector<std::unique_ptr<EventLoopThread>> threads_;
   // 存放eventloop*的pool（也可以理解为是一个线程池，主eventloop没放进来的）
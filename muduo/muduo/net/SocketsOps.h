@@ -24,6 +24,8 @@ namespace sockets
 /// Creates a non-blocking socket file descriptor,
 /// abort if any error.
 int createNonblockingOrDie(sa_family_t family);
+/// Same for UDP.
+int createNonblockingUdpOrDie(sa_family_t family);
 
 int  connect(int sockfd, const struct sockaddr* addr);
 void bindOrDie(int sockfd, const struct sockaddr* addr);
@@ -32,6 +34,7 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+ssize_t sendfile(int sockfd, int fd, int64_t* offset, size_t count);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -10,6 +10,7 @@
 #include "muduo/net/TcpClient.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/net/ConnectionFilter.h"
 #include "muduo/net/Connector.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/SocketsOps.h"
@@ -24,12 +25,6 @@ using namespace muduo::net;
 // {
 // }
 
-// TcpClient::TcpClient(EventLoop* loop, const string& host, uint16_t port)
-//   : loop_(CHECK_NOTNULL(loop)),
-//     serverAddr_(host, port)
-// {
-// }
-
 namespace muduo
 {
 namespace net
@@ -70,6 +65,26 @@ TcpClient::TcpClient(EventLoop* loop,
            << "] - connector " << get_pointer(connector_);
 }
 
+TcpClient::TcpClient(EventLoop* loop,
+                     DnsResolver* resolver,
+                     const string& host,
+                     uint16_t port,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    connector_(new Connector(loop, resolver, host, port)),
+    name_(nameArg),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    retry_(false),
+    connect_(true),
+    nextConnId_(1)
+{
+  connector_->setNewConnectionCallback(
+      std::bind(&TcpClient::newConnection, this, _1));
+  LOG_INFO << "TcpClient::TcpClient[" << name_
+           << "] - connector " << get_pointer(connector_);
+}
+
 TcpClient::~TcpClient()
 {
   LOG_INFO << "TcpClient::~TcpClient[" << name_
@@ -101,11 +116,21 @@ TcpClient::~TcpClient()
   }
 }
 
+void TcpClient::setRetryDelay(int initMs, int maxMs)
+{
+  connector_->setRetryDelay(initMs, maxMs);
+}
+
+void TcpClient::enableRetryJitter()
+{
+  connector_->enableJitter(true);
+}
+
 void TcpClient::connect()
 {
   // FIXME: check state
   LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
-           << connector_->serverAddress().toIpPort();
+           << connector_->serverName();
   connect_ = true;
   connector_->start();
 }
@@ -152,6 +177,10 @@ void TcpClient::newConnection(int sockfd)
   conn->setWriteCompleteCallback(writeCompleteCallback_);
   conn->setCloseCallback(
       std::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
+  if (filterFactory_)
+  {
+    conn->setFilter(filterFactory_(sockfd, peerAddr));
+  }
   {
     MutexLockGuard lock(mutex_);
     connection_ = conn;
@@ -174,7 +203,7 @@ void TcpClient::removeConnection(const TcpConnectionPtr& conn)
   if (retry_ && connect_)
   {
     LOG_INFO << "TcpClient::connect[" << name_ << "] - Reconnecting to "
-             << connector_->serverAddress().toIpPort();
+             << connector_->serverName();
     connector_->restart();
   }
 }
@@ -20,6 +20,7 @@ namespace net
 {
 
 class Connector;
+class DnsResolver;
 typedef std::shared_ptr<Connector> ConnectorPtr;
 
 class TcpClient : noncopyable
@@ -30,6 +31,13 @@ class TcpClient : noncopyable
   TcpClient(EventLoop* loop,
             const InetAddress& serverAddr,
             const string& nameArg);
+  /// Connects by name, @c host is resolved by @c resolver before every try,
+  /// so the IO loop never blocks on DNS.  @c resolver must outlive this.
+  TcpClient(EventLoop* loop,
+            DnsResolver* resolver,
+            const string& host,
+            uint16_t port,
+            const string& nameArg);
   ~TcpClient();  // force out-line dtor, for std::unique_ptr members.
 
   void connect();
@@ -46,6 +54,12 @@ class TcpClient : noncopyable
   bool retry() const { return retry_; }
   void enableRetry() { retry_ = true; }
 
+  /// Must be called before connect().
+  void setRetryDelay(int initMs, int maxMs);
+  /// Randomize reconnect delays, see Connector::enableJitter().
+  /// Must be called before connect().
+  void enableRetryJitter();
+
   const string& name() const
   { return name_; }
 
@@ -64,6 +78,11 @@ class TcpClient : noncopyable
   void setWriteCompleteCallback(WriteCompleteCallback cb)
   { writeCompleteCallback_ = std::move(cb); }
 
+  /// Set filter factory, e.g. TLS, see ConnectionFilter.
+  /// Not thread safe.
+  void setConnectionFilterFactory(ConnectionFilterFactory factory)
+  { filterFactory_ = std::move(factory); }
+
  private:
   /// Not thread safe, but in loop
   void newConnection(int sockfd);
@@ -79,6 +98,7 @@ class TcpClient : noncopyable
   ConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
+  ConnectionFilterFactory filterFactory_;
   // 失败时是否重连
   bool retry_;   // atomic
   bool connect_; // atomic
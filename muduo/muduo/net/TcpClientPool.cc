@@ -0,0 +1,210 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/TcpClientPool.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+TcpClientPool::TcpClientPool(EventLoop* loop,
+                             const InetAddress& serverAddr,
+                             const string& nameArg,
+                             int numConnections)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(nameArg),
+    entries_(numConnections),
+    next_(0),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    healthCheckInterval_(0),
+    healthCheckTimeout_(0)
+{
+  assert(numConnections > 0);
+  for (int i = 0; i < numConnections; ++i)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%d", i);
+    Entry& entry = entries_[i];
+    entry.client.reset(new TcpClient(loop, serverAddr, name_ + buf));
+    entry.client->enableRetry();
+    entry.client->enableRetryJitter();
+    entry.client->setConnectionCallback(
+        std::bind(&TcpClientPool::onConnection, this, i, _1));
+    entry.client->setMessageCallback(
+        std::bind(&TcpClientPool::onMessage, this, i, _1, _2, _3));
+    entry.outstanding = 0;
+  }
+}
+
+TcpClientPool::~TcpClientPool()
+{
+  loop_->cancel(healthCheckTimer_);
+  for (auto& entry : entries_)
+  {
+    if (entry.connection)
+    {
+      // the connection may outlive us, see TcpClient::~TcpClient()
+      entry.connection->setConnectionCallback(defaultConnectionCallback);
+      entry.connection->setMessageCallback(defaultMessageCallback);
+      // so that TcpClient holds the last reference and closes it
+      entry.connection.reset();
+    }
+  }
+}
+
+void TcpClientPool::setHealthCheck(double interval, double timeout, HealthCheckCallback cb)
+{
+  healthCheckInterval_ = interval;
+  healthCheckTimeout_ = timeout;
+  healthCheckCallback_ = std::move(cb);
+}
+
+void TcpClientPool::start()
+{
+  loop_->assertInLoopThread();
+  for (auto& entry : entries_)
+  {
+    entry.client->connect();
+  }
+  if (healthCheckInterval_ > 0)
+  {
+    healthCheckTimer_ = loop_->runEvery(healthCheckInterval_,
+        std::bind(&TcpClientPool::onHealthCheck, this));
+  }
+}
+
+void TcpClientPool::stop()
+{
+  loop_->assertInLoopThread();
+  loop_->cancel(healthCheckTimer_);
+  for (auto& entry : entries_)
+  {
+    entry.client->stop();
+    entry.client->disconnect();
+  }
+}
+
+TcpConnectionPtr TcpClientPool::acquire()
+{
+  loop_->assertInLoopThread();
+  if (entries_.empty())
+  {
+    return TcpConnectionPtr();
+  }
+  Entry* best = NULL;
+  // start from a rotating position, so that ties are spread evenly
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    Entry& entry = entries_[(next_ + i) % entries_.size()];
+    if (entry.connection && (!best || entry.outstanding < best->outstanding))
+    {
+      best = &entry;
+    }
+  }
+  next_ = (next_ + 1) % entries_.size();
+
+  TcpConnectionPtr conn;
+  if (best)
+  {
+    ++best->outstanding;
+    conn = best->connection;
+  }
+  return conn;
+}
+
+void TcpClientPool::release(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  Entry* entry = findEntry(conn);
+  if (entry && entry->outstanding > 0)
+  {
+    --entry->outstanding;
+  }
+}
+
+int TcpClientPool::numConnected() const
+{
+  loop_->assertInLoopThread();
+  int n = 0;
+  for (const auto& entry : entries_)
+  {
+    if (entry.connection)
+      ++n;
+  }
+  return n;
+}
+
+int TcpClientPool::outstanding(const TcpConnectionPtr& conn) const
+{
+  loop_->assertInLoopThread();
+  for (const auto& entry : entries_)
+  {
+    if (entry.connection == conn)
+      return entry.outstanding;
+  }
+  return 0;
+}
+
+void TcpClientPool::onConnection(size_t index, const TcpConnectionPtr& conn)
+{
+  Entry& entry = entries_[index];
+  if (conn->connected())
+  {
+    entry.connection = conn;
+    entry.outstanding = 0;
+    entry.lastReceive = Timestamp::now();
+  }
+  else
+  {
+    // requests in flight on this connection are lost
+    entry.connection.reset();
+    entry.outstanding = 0;
+  }
+  connectionCallback_(conn);
+}
+
+void TcpClientPool::onMessage(size_t index, const TcpConnectionPtr& conn,
+                              Buffer* buf, Timestamp receiveTime)
+{
+  entries_[index].lastReceive = receiveTime;
+  messageCallback_(conn, buf, receiveTime);
+}
+
+void TcpClientPool::onHealthCheck()
+{
+  Timestamp now(Timestamp::now());
+  for (auto& entry : entries_)
+  {
+    if (!entry.connection)
+      continue;
+    double idle = timeDifference(now, entry.lastReceive);
+    if (healthCheckTimeout_ > 0 && idle >= healthCheckTimeout_)
+    {
+      LOG_WARN << "TcpClientPool::onHealthCheck [" << name_ << "] - "
+               << entry.connection->name() << " silent for " << idle << "s, reconnecting";
+      // TcpClient will reconnect, as retry is enabled
+      entry.connection->forceClose();
+    }
+    else if (idle >= healthCheckInterval_ && healthCheckCallback_)
+    {
+      healthCheckCallback_(entry.connection);
+    }
+  }
+}
+
+TcpClientPool::Entry* TcpClientPool::findEntry(const TcpConnectionPtr& conn)
+{
+  for (auto& entry : entries_)
+  {
+    if (entry.connection == conn)
+      return &entry;
+  }
+  return NULL;
+}
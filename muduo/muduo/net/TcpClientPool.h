@@ -0,0 +1,99 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TCPCLIENTPOOL_H
+#define MUDUO_NET_TCPCLIENTPOOL_H
+
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TimerId.h"
+
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Keeps N warmed connections to one endpoint.
+///
+/// Every TcpClient reconnects with jittered backoff, acquire() returns the
+/// connected one with the fewest outstanding requests.
+/// Not thread safe, all member functions must be called in loop thread.
+///
+class TcpClientPool : noncopyable
+{
+ public:
+  typedef std::function<void (const TcpConnectionPtr&)> HealthCheckCallback;
+
+  TcpClientPool(EventLoop* loop,
+                const InetAddress& serverAddr,
+                const string& nameArg,
+                int numConnections);
+  ~TcpClientPool();
+
+  /// Must be called before start().
+  void setConnectionCallback(ConnectionCallback cb)
+  { connectionCallback_ = std::move(cb); }
+
+  /// Must be called before start().
+  void setMessageCallback(MessageCallback cb)
+  { messageCallback_ = std::move(cb); }
+
+  /// Every @c interval seconds, @c cb is called for each connection that
+  /// received nothing during the last interval, eg. to send a ping.
+  /// A connection that stays silent for @c timeout seconds is closed and
+  /// reconnected.  Must be called before start().
+  void setHealthCheck(double interval, double timeout, HealthCheckCallback cb);
+
+  void start();
+  void stop();
+
+  /// Connected connection with the fewest outstanding requests,
+  /// its count is increased by one.  Null if none is connected.
+  TcpConnectionPtr acquire();
+  /// A request sent on the connection returned by acquire() is done.
+  void release(const TcpConnectionPtr& conn);
+
+  int numConnected() const;
+  int outstanding(const TcpConnectionPtr& conn) const;
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+
+ private:
+  struct Entry
+  {
+    std::unique_ptr<TcpClient> client;
+    TcpConnectionPtr connection;
+    int outstanding;
+    Timestamp lastReceive;
+  };
+
+  void onConnection(size_t index, const TcpConnectionPtr& conn);
+  void onMessage(size_t index, const TcpConnectionPtr& conn,
+                 Buffer* buf, Timestamp receiveTime);
+  void onHealthCheck();
+  Entry* findEntry(const TcpConnectionPtr& conn);
+
+  EventLoop* loop_;
+  const string name_;
+  std::vector<Entry> entries_;
+  size_t next_;
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  HealthCheckCallback healthCheckCallback_;
+  double healthCheckInterval_;
+  double healthCheckTimeout_;
+  TimerId healthCheckTimer_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TCPCLIENTPOOL_H
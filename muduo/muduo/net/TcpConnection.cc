@@ -11,11 +11,15 @@
 #include "muduo/base/Logging.h"
 #include "muduo/base/WeakCallback.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/ConnectionFilter.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/Socket.h"
 #include "muduo/net/SocketsOps.h"
 
+#include <algorithm>
+
 #include <errno.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -35,6 +39,8 @@ void muduo::net::defaultMessageCallback(const TcpConnectionPtr&,
   buf->retrieveAll();
 }
 
+ConnectionFilter::~ConnectionFilter() = default;
+
 TcpConnection::TcpConnection(EventLoop* loop,
                              const string& nameArg,
                              int sockfd,
@@ -48,7 +54,12 @@ TcpConnection::TcpConnection(EventLoop* loop,
     channel_(new Channel(loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)
+    highWaterMark_(64*1024*1024),
+    idleWheel_(NULL),
+    filterReady_(false),
+    filterFlushing_(false),
+    filterShutdown_(false),
+    filterPending_(0)
 {
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, _1));
@@ -73,6 +84,18 @@ TcpConnection::~TcpConnection()
   assert(state_ == kDisconnected);
 }
 
+void TcpConnection::setFilter(std::unique_ptr<ConnectionFilter> filter)
+{
+  assert(state_ == kConnecting);
+  filter_ = std::move(filter);
+  if (filter_)
+  {
+    // records are batched by flushFilterInLoop(), Nagle only delays
+    // the flights of handshake
+    socket_->setTcpNoDelay(true);
+  }
+}
+
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
 {
   return socket_->getTcpInfo(tcpi);
@@ -133,6 +156,146 @@ void TcpConnection::send(Buffer* buf)
   }
 }
 
+void TcpConnection::sendFile(int fd, int64_t offset, size_t count,
+                             const std::shared_ptr<const void>& owner)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendFileInLoop(fd, offset, count, owner);
+    }
+    else
+    {
+      loop_->runInLoop(
+          std::bind(&TcpConnection::sendFileInLoop,
+                    this,     // FIXME
+                    fd, offset, count, owner));
+    }
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, int64_t offset, size_t count,
+                                   const std::shared_ptr<const void>& owner)
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+  PendingFile file = { fd, offset, count, owner, Buffer() };
+  if (filter_ && !filterReady_)
+  {
+    // after filterPending_, started when the handshake is done
+    pendingFiles_.push_back(std::move(file));
+    return;
+  }
+  if (filter_ && pendingFiles_.empty())
+  {
+    // keep the order
+    flushFilterInLoop();
+  }
+  pendingFiles_.push_back(std::move(file));
+  // if no thing in output queue, try sending directly
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0
+      && pendingFiles_.size() == 1)
+  {
+    ssize_t n = writeFile();
+    if (n >= 0 && pendingFiles_.empty() && outputBuffer_.readableBytes() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      return;
+    }
+    if (n < 0 && errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "TcpConnection::sendFileInLoop";
+      pendingFiles_.clear();
+      return;
+    }
+  }
+  if (!channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+}
+
+// sendfile() the first pending file, moves data sent after it
+// to outputBuffer_ when it's done.
+// If the filter encodes, reads a chunk of the file and encodes it to
+// outputBuffer_ instead, handleWrite() sends it.
+ssize_t TcpConnection::writeFile()
+{
+  assert(outputBuffer_.readableBytes() == 0);
+  PendingFile& file = pendingFiles_.front();
+  bool encode = filter_ && !filter_->passThrough();
+  ssize_t n = 0;
+  if (encode)
+  {
+    if (fileBuffer_.empty())
+    {
+      fileBuffer_.resize(64 * 1024);
+    }
+    n = ::pread(file.fd, fileBuffer_.data(), std::min(fileBuffer_.size(), file.remaining),
+                file.offset);
+    if (n > 0)
+    {
+      file.offset += n;
+      filter_->encode(fileBuffer_.data(), static_cast<size_t>(n), &outputBuffer_);
+    }
+  }
+  else
+  {
+    n = sockets::sendfile(channel_->fd(), file.fd, &file.offset, file.remaining);
+  }
+  if (n > 0)
+  {
+    file.remaining -= static_cast<size_t>(n);
+    if (file.remaining == 0)
+    {
+      if (encode)
+      {
+        filter_->encode(file.following.peek(), file.following.readableBytes(), &outputBuffer_);
+      }
+      else
+      {
+        outputBuffer_.swap(file.following);
+      }
+      pendingFiles_.pop_front();
+    }
+  }
+  else if (n == 0 || encode || errno != EAGAIN)
+  {
+    // file was truncated or can't be read, peer would wait for the rest
+    // forever, and handleWrite() would spin on it.
+    if (n == 0)
+    {
+      LOG_ERROR << "TcpConnection::writeFile [" << name_ << "] unexpected EOF of fd "
+                << file.fd << " at " << file.offset;
+    }
+    else
+    {
+      LOG_SYSERR << "TcpConnection::writeFile [" << name_ << "] fd " << file.fd;
+    }
+    pendingFiles_.clear();
+    if (channel_->isWriting())
+    {
+      channel_->disableWriting();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    errno = EIO;
+    n = -1;
+  }
+  return n;
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
   sendInLoop(message.data(), message.size());
@@ -149,6 +312,22 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     LOG_WARN << "disconnected, give up writing";
     return;
   }
+  if (!pendingFiles_.empty())
+  {
+    // after the file being sent
+    pendingFiles_.back().following.append(data, len);
+    return;
+  }
+  if (filter_ && !(filterReady_ && filter_->passThrough()))
+  {
+    filterPending_.append(data, len);
+    if (!filterFlushing_)
+    {
+      filterFlushing_ = true;
+      loop_->queueInLoop(std::bind(&TcpConnection::flushFilterInLoop, shared_from_this()));
+    }
+    return;
+  }
   // if no thing in output queue, try writing directly
   if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
   {
@@ -207,6 +386,20 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
   loop_->assertInLoopThread();
+  if (filter_ && filterReady_ && !filterShutdown_)
+  {
+    flushFilterInLoop();
+    if (!channel_->isWriting() && pendingFiles_.empty())
+    {
+      filterShutdown_ = true;
+      filter_->shutdown(&outputBuffer_);
+      if (outputBuffer_.readableBytes() > 0)
+      {
+        // handleWrite() calls us again when it's sent
+        channel_->enableWriting();
+      }
+    }
+  }
   if (!channel_->isWriting())
   {
     // we are not writing
@@ -214,6 +407,117 @@ void TcpConnection::shutdownInLoop()
   }
 }
 
+// encodes what was sent in this loop iteration in one go,
+// fewer and fuller TLS records, written in one syscall.
+void TcpConnection::flushFilterInLoop()
+{
+  loop_->assertInLoopThread();
+  filterFlushing_ = false;
+  if (state_ == kDisconnected || !filterReady_ || filterPending_.readableBytes() == 0)
+  {
+    return;
+  }
+  if (filter_->passThrough())
+  {
+    Buffer pending;
+    pending.swap(filterPending_);
+    if (pendingFiles_.empty())
+    {
+      sendInLoop(pending.peek(), pending.readableBytes());
+    }
+    else
+    {
+      // ahead of the files queued during the handshake
+      outputBuffer_.append(pending.peek(), pending.readableBytes());
+      if (!channel_->isWriting())
+      {
+        channel_->enableWriting();
+      }
+    }
+    return;
+  }
+
+  size_t oldLen = outputBuffer_.readableBytes();
+  filter_->encode(filterPending_.peek(), filterPending_.readableBytes(), &outputBuffer_);
+  filterPending_.retrieveAll();
+  size_t newLen = outputBuffer_.readableBytes();
+  if (newLen >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  if (!channel_->isWriting())
+  {
+    ssize_t nwrote = sockets::write(channel_->fd(), outputBuffer_.peek(), newLen);
+    if (nwrote >= 0)
+    {
+      outputBuffer_.retrieve(nwrote);
+      if (outputBuffer_.readableBytes() == 0 && pendingFiles_.empty())
+      {
+        if (writeCompleteCallback_)
+        {
+          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        return;
+      }
+    }
+    else if (errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "TcpConnection::flushFilterInLoop";
+      if (errno == EPIPE || errno == ECONNRESET)
+      {
+        return;
+      }
+    }
+    channel_->enableWriting();
+  }
+}
+
+void TcpConnection::handshakeInLoop()
+{
+  loop_->assertInLoopThread();
+  switch (filter_->handshake())
+  {
+    case ConnectionFilter::kDone:
+      filterReady_ = true;
+      if (channel_->isWriting())
+      {
+        channel_->disableWriting();
+      }
+      connectionCallback_(shared_from_this());
+      // sent before the handshake was done
+      flushFilterInLoop();
+      if (!pendingFiles_.empty() && state_ != kDisconnected && !channel_->isWriting())
+      {
+        channel_->enableWriting();
+      }
+      if (state_ == kConnected)
+      {
+        // records after the handshake may have been read ahead with it,
+        // epoll won't tell about them
+        handleRead(Timestamp::now());
+      }
+      break;
+    case ConnectionFilter::kWantRead:
+      if (channel_->isWriting())
+      {
+        channel_->disableWriting();
+      }
+      break;
+    case ConnectionFilter::kWantWrite:
+      if (!channel_->isWriting())
+      {
+        channel_->enableWriting();
+      }
+      break;
+    case ConnectionFilter::kError:
+      LOG_ERROR << "TcpConnection::handshakeInLoop [" << name_ << "] - failed";
+      handleClose();
+      break;
+  }
+}
+
 // void TcpConnection::shutdownAndForceCloseAfter(double seconds)
 // {
 //   // FIXME: use compare and swap
@@ -328,12 +632,29 @@ void TcpConnection::connectEstablished()
 {
   loop_->assertInLoopThread();
   assert(state_ == kConnecting);
+  if (CurrentThread::numaNode() >= 0)
+  {
+    // buffer是在acceptor线程中分配的，在io线程中重新分配，
+    // 使内存位于io线程所在的NUMA节点（first touch）
+    inputBuffer_.shrink(0);
+    outputBuffer_.shrink(0);
+  }
   // 将当前connection设置为kconnected状态
   setState(kConnected);
   channel_->tie(shared_from_this());
   // 让fd关注可读事件
   channel_->enableReading();
+  if (idleWheel_)
+  {
+    idleWheel_->add(this);
+  }
 
+  if (filter_)
+  {
+    // connection is up when the handshake is done
+    handshakeInLoop();
+    return;
+  }
   // 调用自定义的connection callback
   connectionCallback_(shared_from_this());
 }
@@ -348,7 +669,14 @@ void TcpConnection::connectDestroyed()
     // 对所有事件都不感兴趣
     channel_->disableAll();
     // 调用自定义的connection callback
-    connectionCallback_(shared_from_this());
+    if (!filter_ || filterReady_)
+    {
+      connectionCallback_(shared_from_this());
+    }
+  }
+  if (idleWheel_)
+  {
+    idleWheel_->remove(this);
   }
   channel_->remove();
 }
@@ -356,11 +684,43 @@ void TcpConnection::connectDestroyed()
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
   loop_->assertInLoopThread();
+  if (filter_)
+  {
+    if (!filterReady_)
+    {
+      // which reads too, when it's done
+      handshakeInLoop();
+      return;
+    }
+    ssize_t n = filter_->read(&inputBuffer_);
+    if (n > 0)
+    {
+      if (idleWheel_)
+      {
+        idleWheel_->touch(this);
+      }
+      messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    else if (n == 0)
+    {
+      handleClose();
+    }
+    else if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "TcpConnection::handleRead [" << name_ << "] - filter";
+      handleClose();
+    }
+    return;
+  }
   int savedErrno = 0;
   // 读入数据到buffer中（将Tcp接收缓冲区数据拷贝到用户定义的缓冲区中）；会一次性将数据读完
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0) // 有数据读入，调用可读事件的callback
   {
+    if (idleWheel_)
+    {
+      idleWheel_->touch(this);
+    }
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
   }
   else if (n == 0) // 无数据读入（说明client关闭，则close fd）
@@ -380,13 +740,29 @@ void TcpConnection::handleWrite()
   loop_->assertInLoopThread();
   if (channel_->isWriting())
   {// 当前fd可写（对写事件感兴趣）
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    if (filter_ && !filterReady_)
+    {
+      handshakeInLoop();
+      return;
+    }
+    ssize_t n = 0;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+      n = sockets::write(channel_->fd(),
+                         outputBuffer_.peek(),
+                         outputBuffer_.readableBytes());
+      if (n > 0)
+      {// n为成功写入数据的长度
+        outputBuffer_.retrieve(n);
+      }
+    }
+    else if (!pendingFiles_.empty())
+    {
+      n = writeFile();
+    }
     if (n > 0)
-    {// n为成功写入数据的长度
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0)
+    {
+      if (outputBuffer_.readableBytes() == 0 && pendingFiles_.empty())
       {// 数据全部写入，就取消对写事件的关注
         channel_->disableWriting();
         if (writeCompleteCallback_)
@@ -425,11 +801,21 @@ void TcpConnection::handleClose()
   setState(kDisconnected);
   // channel对所有事件都不敢兴趣（避免触发epoll）（可以理解为将channel从监听器中移除）
   channel_->disableAll();
+  pendingFiles_.clear();
+  if (idleWheel_)
+  {
+    idleWheel_->remove(this);
+  }
+
+  filterPending_.retrieveAll();
 
   // 获取当前connection的指针（防止在close的时候connection被析构）
   TcpConnectionPtr guardThis(shared_from_this());
   // 调用用户自定义的close的处理函数
-  connectionCallback_(guardThis);
+  if (!filter_ || filterReady_)
+  {
+    connectionCallback_(guardThis);
+  }
   // must be the last line
   // 处理tcp连接关闭
   closeCallback_(guardThis);
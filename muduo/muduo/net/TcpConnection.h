@@ -17,8 +17,11 @@
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
 #include "muduo/net/InetAddress.h"
+#include "muduo/net/TimingWheel.h"
 
+#include <deque>
 #include <memory>
+#include <vector>
 
 #include <boost/any.hpp>
 
@@ -31,6 +34,7 @@ namespace net
 {
 
 class Channel;
+class ConnectionFilter;
 class EventLoop;
 class Socket;
 
@@ -39,7 +43,8 @@ class Socket;
 ///
 /// This is an interface class, so don't expose too much details.
 class TcpConnection : noncopyable,
-                      public std::enable_shared_from_this<TcpConnection>
+                      public std::enable_shared_from_this<TcpConnection>,
+                      public TimingWheelEntry
 {
  public:
   /// Constructs a TcpConnection with a connected sockfd
@@ -67,6 +72,10 @@ class TcpConnection : noncopyable,
   void send(const StringPiece& message);
   // void send(Buffer&& message); // C++11
   void send(Buffer* message);  // this one will swap data
+  /// Sends count bytes of fd from offset with sendfile(2), in order with send().
+  /// owner keeps fd open until it's sent or the connection is closed.
+  void sendFile(int fd, int64_t offset, size_t count,
+                const std::shared_ptr<const void>& owner);
   // 将connection设置为kDisconnecting，并关闭fd的写功能
   void shutdown(); // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
@@ -105,16 +114,30 @@ class TcpConnection : noncopyable,
   { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
   /// Advanced interface
+  /// With a filter, outputBuffer() holds encoded data.
   Buffer* inputBuffer()
   { return &inputBuffer_; }
 
   Buffer* outputBuffer()
   { return &outputBuffer_; }
 
+  /// NULL if no filter.
+  ConnectionFilter* filter() const
+  { return filter_.get(); }
+
   /// Internal use only.
   void setCloseCallback(const CloseCallback& cb)
   { closeCallback_ = cb; }
 
+  /// Internal use only, must be called before connectEstablished().
+  // 空闲连接检测：每次读到数据时在时间轮中更新位置
+  void setIdleWheel(TimingWheel* wheel)
+  { idleWheel_ = wheel; }
+
+  /// Internal use only, must be called before connectEstablished().
+  /// TcpServer and TcpClient do it with their filter factory.
+  void setFilter(std::unique_ptr<ConnectionFilter> filter);
+
   // called when TcpServer accepts a new connection
   // 建立connection（只会被调用一次）
   void connectEstablished();   // should be called only once
@@ -124,6 +147,14 @@ class TcpConnection : noncopyable,
 
  private:
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+  struct PendingFile
+  {
+    int fd;
+    int64_t offset;
+    size_t remaining;
+    std::shared_ptr<const void> owner;
+    Buffer following;  // sent after this file
+  };
   // 处理fd的可读事件
   void handleRead(Timestamp receiveTime);
   // 处理fd的可写事件
@@ -135,6 +166,11 @@ class TcpConnection : noncopyable,
   // void sendInLoop(string&& message);
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
+  void sendFileInLoop(int fd, int64_t offset, size_t count,
+                      const std::shared_ptr<const void>& owner);
+  ssize_t writeFile();
+  void handshakeInLoop();
+  void flushFilterInLoop();
   // 在loop中注册的callback（关闭fd的写功能）
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
@@ -175,7 +211,19 @@ class TcpConnection : noncopyable,
   Buffer inputBuffer_;
   // TCP连接的输出缓冲区
   Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  // sendFile() queued after outputBuffer_
+  std::deque<PendingFile> pendingFiles_;
+  // chunk of a pending file to encode, allocated on first use
+  std::vector<char> fileBuffer_;
   boost::any context_;
+  // 所在loop的时间轮，没有设置空闲超时则为NULL
+  TimingWheel* idleWheel_;
+  std::unique_ptr<ConnectionFilter> filter_;
+  bool filterReady_;     // handshake done
+  bool filterFlushing_;
+  bool filterShutdown_;
+  // sent in this loop iteration, encoded together
+  Buffer filterPending_;
   // FIXME: creationTime_, lastReceiveTime_
   //        bytesReceived_, bytesSent_
 };
@@ -10,6 +10,7 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/net/Acceptor.h"
+#include "muduo/net/ConnectionFilter.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/SocketsOps.h"
@@ -19,6 +20,24 @@
 using namespace muduo;
 using namespace muduo::net;
 
+namespace muduo
+{
+namespace net
+{
+namespace detail
+{
+
+void closeIdleConnection(TimingWheelEntry* entry)
+{
+  TcpConnection* conn = static_cast<TcpConnection*>(entry);
+  LOG_INFO << "TcpServer - idle connection " << conn->name() << " timeout";
+  conn->forceClose();
+}
+
+}  // namespace detail
+}  // namespace net
+}  // namespace muduo
+
 TcpServer::TcpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
                      const string& nameArg,
@@ -27,6 +46,8 @@ TcpServer::TcpServer(EventLoop* loop,
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
     acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    idleTimeout_(0),
+    idleTick_(1.0),
     threadPool_(new EventLoopThreadPool(loop, name_)),
     connectionCallback_(defaultConnectionCallback), //  先放置一个默认的callback
     messageCallback_(defaultMessageCallback), //  先放置一个默认的callback
@@ -53,6 +74,10 @@ TcpServer::~TcpServer()
     conn->getLoop()->runInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
   }
+  for (auto& wheel : idleWheels_)
+  {
+    wheel->getLoop()->runInLoop(std::bind(&TimingWheel::stop, get_pointer(wheel)));
+  }
 }
 
 void TcpServer::setThreadNum(int numThreads)
@@ -61,11 +86,31 @@ void TcpServer::setThreadNum(int numThreads)
   threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setThreadCpuAffinity(const std::vector<int>& cpus)
+{
+  threadPool_->setCpuAffinity(cpus);
+}
+
+void TcpServer::setIdleTimeout(double seconds, double tick)
+{
+  assert(seconds > 0 && tick > 0);
+  idleTimeout_ = seconds;
+  idleTick_ = tick;
+}
+
 void TcpServer::start()
 {
   if (started_.getAndSet(1) == 0) //  将started_设置为1
   {
     threadPool_->start(threadInitCallback_);
+    if (idleTimeout_ > 0)
+    {
+      for (EventLoop* ioLoop : threadPool_->getAllLoops())
+      {
+        idleWheels_.emplace_back(new TimingWheel(
+            ioLoop, idleTimeout_, idleTick_, &detail::closeIdleConnection));
+      }
+    }
 
     assert(!acceptor_->listening());
     // 调用acceptor中的listen
@@ -107,9 +152,24 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
   // 发生了close事件，就需要将connection从tcpserver中移除
   conn->setCloseCallback(
       std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+  conn->setIdleWheel(idleWheelOf(ioLoop));
+  if (filterFactory_)
+  {
+    conn->setFilter(filterFactory_(sockfd, peerAddr));
+  }
   ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
+TimingWheel* TcpServer::idleWheelOf(EventLoop* ioLoop) const
+{
+  for (const auto& wheel : idleWheels_)
+  {
+    if (wheel->getLoop() == ioLoop)
+      return get_pointer(wheel);
+  }
+  return NULL;
+}
+
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
   // FIXME: unsafe
@@ -16,6 +16,7 @@
 #include "muduo/net/TcpConnection.h"
 
 #include <map>
+#include <vector>
 
 namespace muduo
 {
@@ -63,6 +64,16 @@ class TcpServer : noncopyable
   ///   are assigned on a round-robin basis.
   // 设置poll的thread的数量（一般默认是单reactor）
   void setThreadNum(int numThreads);
+  /// Pin the IO threads to cpus, round-robin.
+  /// Must be called before @c start
+  // 设置io线程绑定的cpu
+  void setThreadCpuAffinity(const std::vector<int>& cpus);
+
+  /// Close connections that received nothing for @c seconds,
+  /// checked every @c tick seconds by a timing wheel in each IO loop.
+  /// Must be called before @c start
+  // 设置空闲连接的超时时间（每个io loop一个时间轮）
+  void setIdleTimeout(double seconds, double tick = 1.0);
   // 设置thread的callback
   void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
@@ -92,6 +103,11 @@ class TcpServer : noncopyable
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }
 
+  /// Set filter factory, e.g. TLS, see ConnectionFilter.
+  /// Not thread safe.
+  void setConnectionFilterFactory(const ConnectionFilterFactory& factory)
+  { filterFactory_ = factory; }
+
  private:
   /// Not thread safe, but in loop
   // 出现新的connection（acceptor的fd发生了可读事件）
@@ -102,6 +118,8 @@ class TcpServer : noncopyable
   /// Not thread safe, but in loop
   // 实际上移除connection的callback
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  // 查找loop对应的时间轮
+  TimingWheel* idleWheelOf(EventLoop* ioLoop) const;
 
   typedef std::map<string, TcpConnectionPtr> ConnectionMap;
 
@@ -112,6 +130,11 @@ class TcpServer : noncopyable
   const string name_;
   // 指向acceptor的指针
   std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
+  // 空闲超时的秒数，0表示不检测
+  double idleTimeout_;
+  double idleTick_;
+  // 每个io loop的时间轮，必须在threadPool_之后析构
+  std::vector<std::unique_ptr<TimingWheel>> idleWheels_;
   // 用于实现多recator模式的线程池
   std::shared_ptr<EventLoopThreadPool> threadPool_;
   // 创建connection时的ptr
@@ -119,6 +142,7 @@ class TcpServer : noncopyable
   MessageCallback messageCallback_;
   // write complete的callback
   WriteCompleteCallback writeCompleteCallback_;
+  ConnectionFilterFactory filterFactory_;
   // thread的callback
   ThreadInitCallback threadInitCallback_;
   // 表示tcpserver是否开始start
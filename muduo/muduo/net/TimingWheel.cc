@@ -0,0 +1,53 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/TimingWheel.h"
+
+#include "muduo/net/EventLoop.h"
+
+#include <math.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+TimingWheel::TimingWheel(EventLoop* loop, double timeout, double tick, const ExpireCallback& cb)
+  : loop_(loop),
+    expireCallback_(cb),
+    // an entry touched just before a tick must survive 'timeout' seconds
+    buckets_(static_cast<size_t>(::ceil(timeout / tick)) + 1),
+    current_(0),
+    size_(0)
+{
+  assert(timeout > 0 && tick > 0);
+  if (loop_)
+  {
+    timer_ = loop_->runEvery(tick, std::bind(&TimingWheel::onTick, this));
+  }
+}
+
+TimingWheel::~TimingWheel()
+{
+  // entries are not owned
+}
+
+void TimingWheel::stop()
+{
+  if (loop_)
+  {
+    loop_->assertInLoopThread();
+    loop_->cancel(timer_);
+  }
+}
+
+void TimingWheel::onTick()
+{
+  current_ = static_cast<int>((current_ + 1) % buckets_.size());
+  // expireCallback_ may remove other entries, but must not touch this one
+  while (TimingWheelEntry* entry = buckets_[current_])
+  {
+    unlink(entry);
+    expireCallback_(entry);
+  }
+}
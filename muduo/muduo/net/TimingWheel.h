@@ -0,0 +1,125 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TIMINGWHEEL_H
+#define MUDUO_NET_TIMINGWHEEL_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/TimerId.h"
+
+#include <functional>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// Intrusive node of TimingWheel, derive from it.
+///
+class TimingWheelEntry
+{
+ public:
+  TimingWheelEntry()
+    : prev_(NULL),
+      next_(NULL),
+      bucket_(-1)
+  {
+  }
+
+  bool linked() const { return bucket_ >= 0; }
+
+ private:
+  friend class TimingWheel;
+
+  TimingWheelEntry* prev_;
+  TimingWheelEntry* next_;
+  int bucket_;
+};
+
+///
+/// Expires entries that were not touched for a given time.
+///
+/// A circular array of intrusive lists, one per tick.  touch() moves an entry
+/// to the list of the current tick in O(1) without allocation, every tick the
+/// oldest list is expired as a whole.  Idle time before expiry is in
+/// [timeout, timeout + tick).  Not thread safe, use in loop thread only.
+///
+/// See examples/idleconnection for the shared_ptr based version.
+class TimingWheel : noncopyable
+{
+ public:
+  typedef std::function<void (TimingWheelEntry*)> ExpireCallback;
+
+  /// If loop is NULL, the owner calls onTick() every tick seconds.
+  TimingWheel(EventLoop* loop, double timeout, double tick, const ExpireCallback& cb);
+  ~TimingWheel();
+
+  void add(TimingWheelEntry* entry) { touch(entry); }
+  void touch(TimingWheelEntry* entry)
+  {
+    if (entry->bucket_ != current_)
+    {
+      unlink(entry);
+      link(entry, current_);
+    }
+  }
+  void remove(TimingWheelEntry* entry) { unlink(entry); }
+
+  /// Must be called in loop thread while the loop is alive.
+  void stop();
+
+  EventLoop* getLoop() const { return loop_; }
+  size_t size() const { return size_; }
+
+  /// Advance one tick, normally called by the timer.
+  void onTick();
+
+ private:
+  void link(TimingWheelEntry* entry, int bucket)
+  {
+    entry->bucket_ = bucket;
+    entry->prev_ = NULL;
+    entry->next_ = buckets_[bucket];
+    if (entry->next_)
+      entry->next_->prev_ = entry;
+    buckets_[bucket] = entry;
+    ++size_;
+  }
+
+  void unlink(TimingWheelEntry* entry)
+  {
+    if (!entry->linked())
+      return;
+    if (entry->prev_)
+      entry->prev_->next_ = entry->next_;
+    else
+      buckets_[entry->bucket_] = entry->next_;
+    if (entry->next_)
+      entry->next_->prev_ = entry->prev_;
+    entry->prev_ = NULL;
+    entry->next_ = NULL;
+    entry->bucket_ = -1;
+    --size_;
+  }
+
+  EventLoop* loop_;
+  ExpireCallback expireCallback_;
+  std::vector<TimingWheelEntry*> buckets_;
+  int current_;
+  size_t size_;
+  TimerId timer_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TIMINGWHEEL_H
@@ -0,0 +1,47 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/UdpClient.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/SocketsOps.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+int createConnectedUdp(const InetAddress& serverAddr)
+{
+  int sockfd = sockets::createNonblockingUdpOrDie(serverAddr.family());
+  if (sockets::connect(sockfd, serverAddr.getSockAddr()) < 0)
+  {
+    LOG_SYSFATAL << "UdpClient - connect " << serverAddr.toIpPort();
+  }
+  return sockfd;
+}
+
+}  // namespace
+
+UdpClient::UdpClient(EventLoop* loop,
+                     const InetAddress& serverAddr,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    serverAddr_(serverAddr),
+    socket_(new UdpSocket(loop, createConnectedUdp(serverAddr), nameArg))
+{
+}
+
+UdpClient::~UdpClient()
+{
+  LOG_TRACE << "UdpClient::~UdpClient [" << name() << "] destructing";
+}
+
+void UdpClient::start()
+{
+  loop_->runInLoop(std::bind(&UdpSocket::start, get_pointer(socket_)));
+}
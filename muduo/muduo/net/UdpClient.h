@@ -0,0 +1,58 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPCLIENT_H
+#define MUDUO_NET_UDPCLIENT_H
+
+#include "muduo/net/UdpSocket.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// UDP client, a connected UdpSocket.
+///
+/// Datagrams from other peers are filtered by the kernel, ICMP errors
+/// like port unreachable are reported on the next send or receive.
+class UdpClient : noncopyable
+{
+ public:
+  UdpClient(EventLoop* loop,
+            const InetAddress& serverAddr,
+            const string& nameArg);
+  ~UdpClient();  // force out-line dtor, for std::unique_ptr members.
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return socket_->name(); }
+  const InetAddress& serverAddress() const { return serverAddr_; }
+  UdpSocket* socket() const { return socket_.get(); }
+
+  /// Not thread safe.
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { socket_->setMessageCallback(cb); }
+
+  /// Starts reading.
+  /// Thread safe.
+  void start();
+
+  /// Thread safe.
+  void send(const StringPiece& data) { socket_->send(data); }
+  void send(const void* data, size_t len)
+  { socket_->send(StringPiece(static_cast<const char*>(data), static_cast<int>(len))); }
+
+ private:
+  EventLoop* loop_;
+  const InetAddress serverAddr_;
+  std::unique_ptr<UdpSocket> socket_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_UDPCLIENT_H
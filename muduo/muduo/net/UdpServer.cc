@@ -0,0 +1,81 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/UdpServer.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+UdpServer::UdpServer(EventLoop* loop,
+                     const InetAddress& listenAddr,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    ipPort_(listenAddr.toIpPort()),
+    name_(nameArg),
+    listenAddr_(listenAddr),
+    threadPool_(new EventLoopThreadPool(loop, name_)),
+    batchSize_(64),
+    maxDatagramSize_(2048),
+    gro_(false),
+    gso_(false),
+    started_(false)
+{
+}
+
+UdpServer::~UdpServer()
+{
+  loop_->assertInLoopThread();
+  LOG_TRACE << "UdpServer::~UdpServer [" << name_ << "] destructing";
+
+  // destroy each socket in its loop, before the pool quits the loops.
+  for (auto& sock : sockets_)
+  {
+    UdpSocket* s = sock.release();
+    s->getLoop()->runInLoop([s] { delete s; });
+  }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+  loop_->assertInLoopThread();
+  if (started_)
+    return;
+  started_ = true;
+
+  threadPool_->start(threadInitCallback_);
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "%s#%zd", name_.c_str(), i);
+    std::unique_ptr<UdpSocket> udp(
+        new UdpSocket(loops[i], sockets::createNonblockingUdpOrDie(listenAddr_.family()), buf));
+    udp->bindAddress(listenAddr_, loops.size() > 1);
+    udp->setBatchSize(batchSize_);
+    udp->setMaxDatagramSize(maxDatagramSize_);
+    if (gro_)
+      udp->enableGro();
+    if (gso_)
+      udp->enableGso();
+    udp->setMessageCallback(messageCallback_);
+    loops[i]->runInLoop(std::bind(&UdpSocket::start, get_pointer(udp)));
+    sockets_.push_back(std::move(udp));
+  }
+  LOG_INFO << "UdpServer [" << name_ << "] listening on " << ipPort_
+           << " with " << loops.size() << " socket(s)";
+}
@@ -0,0 +1,84 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSERVER_H
+#define MUDUO_NET_UDPSERVER_H
+
+#include "muduo/base/Atomic.h"
+#include "muduo/net/UdpSocket.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoopThreadPool;
+
+///
+/// UDP server, one socket per IO loop.
+///
+/// With more than one loop, every loop binds its own socket to the same
+/// address with SO_REUSEPORT, the kernel spreads flows among them by hash.
+/// Replies should be sent with the UdpSocket passed to the message callback.
+class UdpServer : noncopyable
+{
+ public:
+  typedef std::function<void(EventLoop*)> ThreadInitCallback;
+
+  UdpServer(EventLoop* loop,
+            const InetAddress& listenAddr,
+            const string& nameArg);
+  ~UdpServer();  // force out-line dtor, for std::unique_ptr members.
+
+  const string& ipPort() const { return ipPort_; }
+  const string& name() const { return name_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Set the number of IO threads, see TcpServer::setThreadNum().
+  /// Must be called before @c start
+  void setThreadNum(int numThreads);
+  void setThreadInitCallback(const ThreadInitCallback& cb)
+  { threadInitCallback_ = cb; }
+
+  /// See UdpSocket, must be called before @c start
+  void setBatchSize(int batch) { batchSize_ = batch; }
+  void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+  void enableGro() { gro_ = true; }
+  void enableGso() { gso_ = true; }
+
+  /// Not thread safe.
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Binds the sockets and starts reading.
+  /// Must be called in loop thread.
+  void start();
+
+  /// valid after calling start()
+  const std::vector<std::unique_ptr<UdpSocket>>& sockets() const
+  { return sockets_; }
+
+ private:
+  EventLoop* loop_;  // the base loop
+  const string ipPort_;
+  const string name_;
+  const InetAddress listenAddr_;
+  std::shared_ptr<EventLoopThreadPool> threadPool_;
+  std::vector<std::unique_ptr<UdpSocket>> sockets_;
+  UdpMessageCallback messageCallback_;
+  ThreadInitCallback threadInitCallback_;
+  int batchSize_;
+  size_t maxDatagramSize_;
+  bool gro_;
+  bool gso_;
+  bool started_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_UDPSERVER_H
@@ -0,0 +1,407 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/UdpSocket.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/Socket.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kMaxQueuedBytes = 4 * 1024 * 1024;
+// limits of one UDP_SEGMENT send, see udp_send_skb() in linux
+const size_t kMaxGsoSegments = 64;
+const size_t kMaxGsoBytes = 65000;
+
+bool samePeer(const InetAddress& lhs, const InetAddress& rhs)
+{
+  if (lhs.family() != rhs.family())
+    return false;
+  size_t len = lhs.family() == AF_INET6 ? sizeof(struct sockaddr_in6)
+                                        : sizeof(struct sockaddr_in);
+  return ::memcmp(lhs.getSockAddr(), rhs.getSockAddr(), len) == 0;
+}
+
+}  // namespace
+
+UdpSocket::UdpSocket(EventLoop* loop, int sockfd, const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    socket_(new Socket(sockfd)),
+    channel_(new Channel(loop, sockfd)),
+    batchSize_(64),
+    maxDatagramSize_(2048),
+    gro_(false),
+    gso_(false),
+    connected_(false),
+    started_(false),
+    reading_(false),
+    flushQueued_(false),
+    outputStart_(0),
+    receivedDatagrams_(0),
+    sentDatagrams_(0),
+    droppedDatagrams_(0),
+    recvCalls_(0),
+    sendCalls_(0),
+    alive_(std::make_shared<bool>(true))
+{
+  struct sockaddr_in6 peer;
+  socklen_t len = static_cast<socklen_t>(sizeof peer);
+  connected_ = ::getpeername(sockfd, sockets::sockaddr_cast(&peer), &len) == 0;
+  channel_->setReadCallback(
+      std::bind(&UdpSocket::handleRead, this, _1));
+  channel_->setWriteCallback(
+      std::bind(&UdpSocket::handleWrite, this));
+  LOG_DEBUG << "UdpSocket::ctor[" << name_ << "] at " << this
+            << " fd=" << sockfd << (connected_ ? " connected" : "");
+}
+
+UdpSocket::~UdpSocket()
+{
+  LOG_DEBUG << "UdpSocket::dtor[" << name_ << "] at " << this
+            << " fd=" << channel_->fd();
+  if (started_)
+  {
+    loop_->assertInLoopThread();
+    stop();
+  }
+}
+
+int UdpSocket::fd() const
+{
+  return socket_->fd();
+}
+
+void UdpSocket::bindAddress(const InetAddress& addr, bool reusePort)
+{
+  socket_->setReuseAddr(true);
+  if (reusePort)
+  {
+    socket_->setReusePort(true);
+  }
+  socket_->bindAddress(addr);
+}
+
+void UdpSocket::setBatchSize(int batch)
+{
+  assert(!started_);
+  batchSize_ = std::max(batch, 1);
+}
+
+void UdpSocket::enableGro()
+{
+#ifdef UDP_GRO
+  int on = 1;
+  if (::setsockopt(fd(), SOL_UDP, UDP_GRO, &on, static_cast<socklen_t>(sizeof on)) == 0)
+  {
+    gro_ = true;
+    maxDatagramSize_ = std::max(maxDatagramSize_, size_t(65535));
+  }
+  else
+  {
+    LOG_SYSERR << "UDP_GRO failed.";
+  }
+#else
+  LOG_ERROR << "UDP_GRO is not supported.";
+#endif
+}
+
+void UdpSocket::start()
+{
+  loop_->assertInLoopThread();
+  assert(!started_);
+  started_ = true;
+
+  const size_t batch = static_cast<size_t>(batchSize_);
+  inputData_.resize(batch * maxDatagramSize_);
+  inputAddrs_.resize(batch);
+  inputControl_.resize(batch * CMSG_SPACE(sizeof(int)));
+  inputIovs_.resize(batch);
+  inputMsgs_.resize(batch);
+  memZero(&inputMsgs_[0], batch * sizeof inputMsgs_[0]);
+  for (size_t i = 0; i < batch; ++i)
+  {
+    inputIovs_[i].iov_base = &inputData_[i * maxDatagramSize_];
+    inputIovs_[i].iov_len = maxDatagramSize_;
+    struct msghdr& hdr = inputMsgs_[i].msg_hdr;
+    hdr.msg_iov = &inputIovs_[i];
+    hdr.msg_iovlen = 1;
+  }
+
+  outputIovs_.resize(batch);
+  outputControl_.resize(batch * CMSG_SPACE(sizeof(uint16_t)));
+  outputMsgs_.resize(batch);
+  segments_.resize(batch);
+  channel_->enableReading();
+}
+
+void UdpSocket::stop()
+{
+  loop_->assertInLoopThread();
+  if (started_)
+  {
+    started_ = false;
+    channel_->disableAll();
+    channel_->remove();
+    droppedDatagrams_ += static_cast<int64_t>(queuedDatagrams());
+    outputData_.clear();
+    outputs_.clear();
+    outputStart_ = 0;
+  }
+}
+
+void UdpSocket::send(const StringPiece& data, const InetAddress& peer)
+{
+  if (loop_->isInLoopThread())
+  {
+    queue(data.data(), data.size(), peer);
+  }
+  else
+  {
+    // the functor runs in loop thread, where this is destroyed as well,
+    // so checking the token there is race free.
+    std::weak_ptr<bool> alive(alive_);
+    string message(data.as_string());
+    loop_->runInLoop([this, alive, message, peer]
+    {
+      if (!alive.expired())
+      {
+        queue(message.data(), message.size(), peer);
+      }
+    });
+  }
+}
+
+void UdpSocket::queue(const char* data, size_t len, const InetAddress& peer)
+{
+  loop_->assertInLoopThread();
+  if (!started_ || outputData_.size() + len > kMaxQueuedBytes)
+  {
+    ++droppedDatagrams_;
+    return;
+  }
+  Output out = { outputData_.size(), len, peer };
+  outputs_.push_back(out);
+  outputData_.append(data, len);
+
+  if (channel_->isWriting() || reading_)
+  {
+    // flushed by handleWrite() or at the end of handleRead()
+  }
+  else if (queuedDatagrams() >= static_cast<size_t>(batchSize_) || !loop_->eventHandling())
+  {
+    flush();
+  }
+  else if (!flushQueued_)
+  {
+    // gather other sends of this loop iteration, eg. by other channels or timers
+    flushQueued_ = true;
+    std::weak_ptr<bool> alive(alive_);
+    loop_->queueInLoop([this, alive]
+    {
+      if (!alive.expired())
+      {
+        flushQueued_ = false;
+        flush();
+      }
+    });
+  }
+}
+
+int UdpSocket::buildSendBatch()
+{
+  int n = 0;
+  size_t i = outputStart_;
+  char* control = outputControl_.data();
+  while (i < outputs_.size() && n < batchSize_)
+  {
+    const Output& first = outputs_[i];
+    size_t j = i + 1;
+    size_t bytes = first.len;
+#ifdef UDP_SEGMENT
+    if (gso_ && first.len > 0)
+    {
+      // all segments but the last have the same size
+      while (j < outputs_.size()
+             && j - i < kMaxGsoSegments
+             && bytes + outputs_[j].len <= kMaxGsoBytes
+             && outputs_[j - 1].len == first.len
+             && outputs_[j].len > 0
+             && outputs_[j].len <= first.len
+             && samePeer(outputs_[j].peer, first.peer))
+      {
+        bytes += outputs_[j].len;
+        ++j;
+      }
+    }
+#endif
+
+    // outputs are contiguous in outputData_
+    outputIovs_[n].iov_base = &outputData_[first.offset];
+    outputIovs_[n].iov_len = bytes;
+    struct msghdr& hdr = outputMsgs_[n].msg_hdr;
+    memZero(&hdr, sizeof hdr);
+    hdr.msg_iov = &outputIovs_[n];
+    hdr.msg_iovlen = 1;
+    if (!connected_)
+    {
+      hdr.msg_name = const_cast<struct sockaddr*>(first.peer.getSockAddr());
+      hdr.msg_namelen = static_cast<socklen_t>(sizeof(struct sockaddr_in6));
+    }
+#ifdef UDP_SEGMENT
+    if (j - i > 1)
+    {
+      char* buf = control + static_cast<size_t>(n) * CMSG_SPACE(sizeof(uint16_t));
+      hdr.msg_control = buf;
+      hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t segment = static_cast<uint16_t>(first.len);
+      memcpy(CMSG_DATA(cm), &segment, sizeof segment);
+    }
+#endif
+    segments_[n] = j - i;
+    i = j;
+    ++n;
+  }
+  return n;
+}
+
+void UdpSocket::flush()
+{
+  loop_->assertInLoopThread();
+  while (queuedDatagrams() > 0)
+  {
+    int n = buildSendBatch();
+    int ret = ::sendmmsg(fd(), outputMsgs_.data(), static_cast<unsigned>(n), 0);
+    ++sendCalls_;
+    if (ret > 0)
+    {
+      for (int k = 0; k < ret; ++k)
+      {
+        outputStart_ += segments_[k];
+        sentDatagrams_ += static_cast<int64_t>(segments_[k]);
+      }
+    }
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      if (!channel_->isWriting())
+      {
+        channel_->enableWriting();
+      }
+      return;
+    }
+    else if (gso_ && segments_[0] > 1 && (errno == EIO || errno == EINVAL))
+    {
+      // kernel or NIC can't segment, fallback
+      LOG_SYSERR << "UdpSocket::flush [" << name_ << "] UDP_SEGMENT failed, GSO disabled.";
+      gso_ = false;
+    }
+    else
+    {
+      LOG_SYSERR << "UdpSocket::flush [" << name_ << "] "
+                 << outputs_[outputStart_].peer.toIpPort();
+      outputStart_ += segments_[0];
+      droppedDatagrams_ += static_cast<int64_t>(segments_[0]);
+    }
+  }
+  outputData_.clear();
+  outputs_.clear();
+  outputStart_ = 0;
+  if (channel_->isWriting())
+  {
+    channel_->disableWriting();
+  }
+}
+
+void UdpSocket::handleWrite()
+{
+  flush();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  const size_t batch = static_cast<size_t>(batchSize_);
+  const size_t controlLen = CMSG_SPACE(sizeof(int));
+  for (size_t i = 0; i < batch; ++i)
+  {
+    struct msghdr& hdr = inputMsgs_[i].msg_hdr;
+    hdr.msg_name = &inputAddrs_[i];
+    hdr.msg_namelen = static_cast<socklen_t>(sizeof inputAddrs_[i]);
+    hdr.msg_control = gro_ ? &inputControl_[i * controlLen] : NULL;
+    hdr.msg_controllen = gro_ ? controlLen : 0;
+  }
+
+  int n = ::recvmmsg(fd(), inputMsgs_.data(), static_cast<unsigned>(batch), 0, NULL);
+  ++recvCalls_;
+  if (n < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "UdpSocket::handleRead [" << name_ << "]";
+    }
+    return;
+  }
+
+  reading_ = true;
+  for (int i = 0; i < n; ++i)
+  {
+    struct msghdr& hdr = inputMsgs_[i].msg_hdr;
+    const char* data = &inputData_[static_cast<size_t>(i) * maxDatagramSize_];
+    const size_t len = inputMsgs_[i].msg_len;
+    if (hdr.msg_flags & MSG_TRUNC)
+    {
+      LOG_WARN << "UdpSocket::handleRead [" << name_ << "] datagram truncated to " << len;
+    }
+    size_t segment = len;
+#ifdef UDP_GRO
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm != NULL; cm = CMSG_NXTHDR(&hdr, cm))
+    {
+      if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+      {
+        int gsoSize = 0;
+        memcpy(&gsoSize, CMSG_DATA(cm), sizeof gsoSize);
+        if (gsoSize > 0)
+          segment = static_cast<size_t>(gsoSize);
+      }
+    }
+#endif
+    InetAddress peer(inputAddrs_[i]);
+    size_t offset = 0;
+    do
+    {
+      size_t segmentLen = std::min(segment, len - offset);
+      ++receivedDatagrams_;
+      if (messageCallback_)
+      {
+        messageCallback_(this, StringPiece(data + offset, static_cast<int>(segmentLen)),
+                         peer, receiveTime);
+      }
+      offset += segmentLen;
+    } while (offset < len);
+  }
+  reading_ = false;
+  if (!channel_->isWriting())
+  {
+    flush();
+  }
+}
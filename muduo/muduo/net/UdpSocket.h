@@ -0,0 +1,164 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSOCKET_H
+#define MUDUO_NET_UDPSOCKET_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/InetAddress.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Channel;
+class EventLoop;
+class Socket;
+class UdpSocket;
+
+// the datagram is valid during the callback only.
+typedef std::function<void (UdpSocket*,
+                            const StringPiece&,
+                            const InetAddress&,
+                            Timestamp)> UdpMessageCallback;
+
+///
+/// A non-blocking UDP socket in one loop, batching with recvmmsg/sendmmsg.
+///
+/// One recvmmsg(2) per readable event receives up to batchSize() datagrams.
+/// send() queues datagrams, the queue is flushed by one sendmmsg(2) after
+/// the current batch of message callbacks, or at the end of this loop
+/// iteration if called elsewhere.  If the queue is full, new datagrams are
+/// dropped as the network would do.
+///
+/// Must be destroyed in loop thread, not within its own callbacks.
+///
+/// With GRO the kernel may coalesce datagrams of one flow into a large one,
+/// which is split back before calling back.  With GSO consecutive datagrams
+/// of equal size to the same peer are sent as one super-datagram.
+class UdpSocket : noncopyable
+{
+ public:
+  /// Takes ownership of a non-blocking UDP @c sockfd.
+  UdpSocket(EventLoop* loop, int sockfd, const string& name);
+  ~UdpSocket();
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+  int fd() const;
+
+  /// Binds to @c addr, with SO_REUSEPORT if @c reusePort.
+  void bindAddress(const InetAddress& addr, bool reusePort = false);
+
+  /// Must be called before start().
+  void setBatchSize(int batch);
+  int batchSize() const { return batchSize_; }
+  /// Largest datagram to receive, must be called before start().
+  void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+  /// Receive coalesced datagrams, if supported by the kernel.
+  /// Must be called before start().
+  void enableGro();
+  /// Send runs of same size datagrams as one, if supported by the kernel.
+  void enableGso() { gso_ = true; }
+
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Starts reading, in loop thread.
+  void start();
+  /// Stops reading and drops queued datagrams, in loop thread.
+  void stop();
+
+  /// Thread safe, datagrams sent from other threads are dropped
+  /// if the socket is destroyed before they are queued in loop thread.
+  /// @c peer is ignored for connected sockets.
+  void send(const StringPiece& data, const InetAddress& peer);
+  void send(const void* data, size_t len, const InetAddress& peer)
+  { send(StringPiece(static_cast<const char*>(data), static_cast<int>(len)), peer); }
+  /// For connected sockets, thread safe.
+  void send(const StringPiece& data) { send(data, InetAddress()); }
+
+  /// Sends queued datagrams now, in loop thread.
+  void flush();
+
+  size_t queuedDatagrams() const { return outputs_.size() - outputStart_; }
+  int64_t receivedDatagrams() const { return receivedDatagrams_; }
+  int64_t sentDatagrams() const { return sentDatagrams_; }
+  int64_t droppedDatagrams() const { return droppedDatagrams_; }
+  int64_t recvCalls() const { return recvCalls_; }
+  int64_t sendCalls() const { return sendCalls_; }
+
+ private:
+  struct Output
+  {
+    size_t offset;  // in outputData_
+    size_t len;
+    InetAddress peer;
+  };
+
+  void handleRead(Timestamp receiveTime);
+  void handleWrite();
+  void queue(const char* data, size_t len, const InetAddress& peer);
+  // builds outputMsgs_ from pending outputs_, returns the number of messages,
+  // segments_[i] is the number of datagrams in message i.
+  int buildSendBatch();
+
+  EventLoop* loop_;
+  const string name_;
+  std::unique_ptr<Socket> socket_;
+  std::unique_ptr<Channel> channel_;
+  UdpMessageCallback messageCallback_;
+  int batchSize_;
+  size_t maxDatagramSize_;
+  bool gro_;
+  bool gso_;
+  bool connected_;
+  bool started_;
+  bool reading_;  // in message callbacks, flush afterwards
+  bool flushQueued_;
+
+  // receive side, allocated in start()
+  std::vector<char> inputData_;
+  std::vector<struct sockaddr_in6> inputAddrs_;
+  std::vector<char> inputControl_;
+  std::vector<struct iovec> inputIovs_;
+  std::vector<struct mmsghdr> inputMsgs_;
+
+  // send side
+  string outputData_;
+  size_t outputStart_;  // first unsent Output
+  std::vector<Output> outputs_;
+  std::vector<struct iovec> outputIovs_;
+  std::vector<char> outputControl_;
+  std::vector<struct mmsghdr> outputMsgs_;
+  std::vector<size_t> segments_;
+
+  int64_t receivedDatagrams_;
+  int64_t sentDatagrams_;
+  int64_t droppedDatagrams_;
+  int64_t recvCalls_;
+  int64_t sendCalls_;
+  // functors queued to the loop hold a weak_ptr of it,
+  // they do nothing once this socket is destroyed.
+  std::shared_ptr<bool> alive_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_UDPSOCKET_H
@@ -45,13 +45,26 @@ class ZlibInputStream : noncopyable
 class ZlibOutputStream : noncopyable
 {
  public:
-  explicit ZlibOutputStream(Buffer* output)
+  enum Format
+  {
+    kZlib,  // RFC 1950, HTTP "deflate"
+    kGzip,  // RFC 1952
+    kRaw,   // RFC 1951
+  };
+
+  explicit ZlibOutputStream(Buffer* output,
+                            int level = Z_DEFAULT_COMPRESSION,
+                            Format format = kZlib)
     : output_(output),
       zerror_(Z_OK),
-      bufferSize_(1024)
+      bufferSize_(1024),
+      ended_(false)
   {
     memZero(&zstream_, sizeof zstream_);
-    zerror_ = deflateInit(&zstream_, Z_DEFAULT_COMPRESSION);
+    const int windowBits = format == kGzip ? 16 + MAX_WBITS
+                         : format == kRaw ? -MAX_WBITS : MAX_WBITS;
+    zerror_ = deflateInit2(&zstream_, level, Z_DEFLATED, windowBits,
+                           8, Z_DEFAULT_STRATEGY);
   }
 
   ~ZlibOutputStream()
@@ -106,6 +119,19 @@ class ZlibOutputStream : noncopyable
   }
 
   bool finish()
+  {
+    if (ended_)
+      return false;
+
+    bool ok = zerror_ == Z_STREAM_END || finishStream();
+    ok = deflateEnd(&zstream_) == Z_OK && ok;
+    ended_ = true;
+    zerror_ = Z_STREAM_END;
+    return ok;
+  }
+
+  // Ends the current stream but keeps the deflate state, see reset().
+  bool finishStream()
   {
     if (zerror_ != Z_OK)
       return false;
@@ -114,10 +140,19 @@ class ZlibOutputStream : noncopyable
     {
       zerror_ = compress(Z_FINISH);
     }
-    zerror_ = deflateEnd(&zstream_);
-    bool ok = zerror_ == Z_OK;
-    zerror_ = Z_STREAM_END;
-    return ok;
+    return zerror_ == Z_STREAM_END;
+  }
+
+  // Starts a new stream into output with same level and format,
+  // much cheaper than constructing a new ZlibOutputStream.
+  bool reset(Buffer* output)
+  {
+    if (ended_)
+      return false;
+
+    output_ = output;
+    zerror_ = deflateReset(&zstream_);
+    return zerror_ == Z_OK;
   }
 
  private:
@@ -139,6 +174,7 @@ class ZlibOutputStream : noncopyable
   z_stream zstream_;
   int zerror_;
   int bufferSize_;
+  bool ended_;
 };
 
 }  // namespace net
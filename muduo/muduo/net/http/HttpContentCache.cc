@@ -0,0 +1,108 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpContentCache.h"
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/http/HttpRequest.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+HttpContentCache::HttpContentCache(int level)
+  : level_(level),
+    compressions_(0)
+{
+  assert(1 <= level && level <= 9);
+}
+
+void HttpContentCache::put(const string& path, const string& contentType, const string& body)
+{
+  std::shared_ptr<Entry> entry(new Entry);
+  entry->contentType = contentType;
+  entry->compressible = HttpResponse::isCompressible(contentType) &&
+                        body.size() >= HttpResponse::kDefaultMinCompressSize;
+  entry->bodies[HttpResponse::kIdentity].reset(new string(body));
+  MutexLockGuard lock(mutex_);
+  entries_[path] = entry;
+}
+
+void HttpContentCache::remove(const string& path)
+{
+  MutexLockGuard lock(mutex_);
+  entries_.erase(path);
+}
+
+bool HttpContentCache::respond(const string& path, const HttpRequest& req, HttpResponse* resp)
+{
+  return respond(path,
+                 HttpResponse::negotiateEncoding(req.getHeader("Accept-Encoding")),
+                 resp);
+}
+
+bool HttpContentCache::respond(const string& path,
+                               HttpResponse::ContentEncoding encoding,
+                               HttpResponse* resp)
+{
+  std::shared_ptr<Entry> entry;
+  std::shared_ptr<const string> body;
+  std::shared_ptr<const string> identity;
+  {
+    MutexLockGuard lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end())
+      return false;
+    entry = it->second;
+    if (!entry->compressible)
+      encoding = HttpResponse::kIdentity;
+    body = entry->bodies[encoding];
+    identity = entry->bodies[HttpResponse::kIdentity];
+  }
+
+  if (!body)
+  {
+    // compress outside of the lock, others may race to do the same.
+    Buffer compressed;
+    if (HttpResponse::compress(*identity, encoding, level_, &compressed) &&
+        compressed.readableBytes() < identity->size())
+    {
+      body.reset(new string(compressed.retrieveAllAsString()));
+    }
+    else
+    {
+      body = identity;
+    }
+    MutexLockGuard lock(mutex_);
+    entry->bodies[encoding] = body;
+    ++compressions_;
+  }
+
+  resp->setContentType(entry->contentType);
+  resp->setSharedBody(body);
+  if (entry->compressible)
+  {
+    resp->addHeader("Vary", "Accept-Encoding");
+  }
+  if (body != identity)
+  {
+    resp->addHeader("Content-Encoding", HttpResponse::encodingName(encoding));
+  }
+  // already as small as it gets
+  resp->setCompression(HttpResponse::kIdentity, 0);
+  return true;
+}
+
+size_t HttpContentCache::size() const
+{
+  MutexLockGuard lock(mutex_);
+  return entries_.size();
+}
+
+int64_t HttpContentCache::compressions() const
+{
+  MutexLockGuard lock(mutex_);
+  return compressions_;
+}
@@ -0,0 +1,66 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPCONTENTCACHE_H
+#define MUDUO_NET_HTTP_HTTPCONTENTCACHE_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <map>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpRequest;
+
+///
+/// Static content with precompressed copies, shared by all loops of a HttpServer.
+///
+/// Each body is compressed once per encoding, on first request, usually at
+/// a higher level than worth it per response.  Responses share the cached
+/// bytes instead of copying them.
+///
+class HttpContentCache : noncopyable
+{
+ public:
+  explicit HttpContentCache(int level = 9);
+
+  /// Adds or replaces content of path.  Thread safe.
+  void put(const string& path, const string& contentType, const string& body);
+  void remove(const string& path);
+
+  /// Fills body, Content-Type and Content-Encoding of response with the copy
+  /// the client accepts, returns false if path is not cached.  Thread safe.
+  bool respond(const string& path, const HttpRequest& req, HttpResponse* resp);
+  bool respond(const string& path, HttpResponse::ContentEncoding encoding, HttpResponse* resp);
+
+  size_t size() const;
+  int64_t compressions() const;
+
+ private:
+  struct Entry
+  {
+    string contentType;
+    bool compressible;
+    // by HttpResponse::ContentEncoding, made on demand
+    std::shared_ptr<const string> bodies[3];
+  };
+
+  const int level_;
+  mutable MutexLock mutex_;
+  std::map<string, std::shared_ptr<Entry>> entries_ GUARDED_BY(mutex_);
+  int64_t compressions_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPCONTENTCACHE_H
@@ -0,0 +1,398 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpFileHandler.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct HttpFileHandler::File : noncopyable
+{
+  File()
+    : fd(-1), size(0), mtime(0), dev(0), ino(0), contentType(NULL)
+  {
+  }
+
+  ~File()
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  bool sameAs(const struct stat& st) const
+  {
+    return st.st_dev == dev && st.st_ino == ino &&
+           static_cast<size_t>(st.st_size) == size && st.st_mtime == mtime;
+  }
+
+  int fd;  // -1 if in content
+  size_t size;
+  time_t mtime;
+  dev_t dev;
+  ino_t ino;
+  string lastModified;
+  const char* contentType;
+  string content;  // whole file if small
+  mutable Timestamp validated;  // guarded by HttpFileHandler::mutex_
+};
+
+namespace
+{
+
+int hexValue(char c)
+{
+  if ('0' <= c && c <= '9')
+    return c - '0';
+  if ('a' <= c && c <= 'f')
+    return c - 'a' + 10;
+  if ('A' <= c && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Decodes %XX, rejects anything that may escape the root.
+bool decodePath(const string& raw, string* path)
+{
+  if (raw.empty() || raw[0] != '/')
+    return false;
+  path->clear();
+  path->reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i)
+  {
+    char c = raw[i];
+    if (c == '%')
+    {
+      int hi = i + 2 < raw.size() ? hexValue(raw[i+1]) : -1;
+      int lo = hi >= 0 ? hexValue(raw[i+2]) : -1;
+      if (lo < 0)
+        return false;
+      c = static_cast<char>(hi * 16 + lo);
+      i += 2;
+    }
+    if (c == '\0' || c == '\\')
+      return false;
+    path->push_back(c);
+  }
+  // no "." or ".." segment
+  for (size_t pos = 0; pos < path->size(); )
+  {
+    size_t next = path->find('/', pos + 1);
+    if (next == string::npos)
+      next = path->size();
+    size_t len = next - pos - 1;
+    if ((len == 1 && (*path)[pos+1] == '.') ||
+        (len == 2 && (*path)[pos+1] == '.' && (*path)[pos+2] == '.'))
+      return false;
+    pos = next;
+  }
+  if (path->back() == '/')
+    path->append("index.html");
+  return true;
+}
+
+// Single range only, "bytes=0-99", "bytes=100-" or "bytes=-100".
+// Returns 1 for a range, 0 to ignore the header, -1 if not satisfiable.
+int parseRange(const string& range, size_t size, size_t* offset, size_t* length)
+{
+  if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != string::npos)
+    return 0;
+  const char* p = range.c_str() + 6;
+  const char* dash = strchr(p, '-');
+  if (dash == NULL)
+    return 0;
+  char* end = NULL;
+  if (dash == p)
+  {
+    // suffix
+    unsigned long long suffix = ::strtoull(dash + 1, &end, 10);
+    if (end == dash + 1 || *end != '\0')
+      return 0;
+    if (suffix == 0 || size == 0)
+      return -1;
+    *length = static_cast<size_t>(std::min<unsigned long long>(suffix, size));
+    *offset = size - *length;
+    return 1;
+  }
+  unsigned long long first = ::strtoull(p, &end, 10);
+  if (end != dash)
+    return 0;
+  unsigned long long last = size > 0 ? size - 1 : 0;
+  if (dash[1] != '\0')
+  {
+    last = ::strtoull(dash + 1, &end, 10);
+    if (*end != '\0' || last < first)
+      return 0;
+  }
+  if (first >= size)
+    return -1;
+  last = std::min<unsigned long long>(last, size - 1);
+  *offset = static_cast<size_t>(first);
+  *length = static_cast<size_t>(last - first + 1);
+  return 1;
+}
+
+}  // namespace
+
+HttpFileHandler::HttpFileHandler(const string& root)
+  : root_(root.size() > 1 && root[root.size()-1] == '/' ? root.substr(0, root.size()-1) : root),
+    memoryThreshold_(64 * 1024),
+    revalidateInterval_(1.0),
+    maxOpenFiles_(1024),
+    hits_(0),
+    misses_(0)
+{
+}
+
+HttpFileHandler::~HttpFileHandler() = default;
+
+string HttpFileHandler::formatHttpDate(time_t t)
+{
+  struct tm tm;
+  ::gmtime_r(&t, &tm);
+  char buf[64];
+  ::strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return buf;
+}
+
+time_t HttpFileHandler::parseHttpDate(const string& date)
+{
+  struct tm tm;
+  memZero(&tm, sizeof tm);
+  const char* end = ::strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (end == NULL || *end != '\0')
+    return -1;
+  return ::timegm(&tm);
+}
+
+const char* HttpFileHandler::contentType(const string& path)
+{
+  static const struct
+  {
+    const char* extension;
+    const char* type;
+  } kTypes[] = {
+    { ".html", "text/html; charset=utf-8" },
+    { ".htm", "text/html; charset=utf-8" },
+    { ".css", "text/css" },
+    { ".js", "application/javascript" },
+    { ".json", "application/json" },
+    { ".txt", "text/plain; charset=utf-8" },
+    { ".xml", "application/xml" },
+    { ".svg", "image/svg+xml" },
+    { ".png", "image/png" },
+    { ".jpg", "image/jpeg" },
+    { ".jpeg", "image/jpeg" },
+    { ".gif", "image/gif" },
+    { ".ico", "image/x-icon" },
+    { ".webp", "image/webp" },
+    { ".pdf", "application/pdf" },
+    { ".wasm", "application/wasm" },
+    { ".woff2", "font/woff2" },
+    { ".mp4", "video/mp4" },
+  };
+  size_t dot = path.rfind('.');
+  if (dot != string::npos && path.find('/', dot) == string::npos)
+  {
+    for (const auto& t : kTypes)
+    {
+      if (::strcasecmp(path.c_str() + dot, t.extension) == 0)
+        return t.type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+HttpFileHandler::FilePtr HttpFileHandler::load(const string& path, Timestamp now, size_t memoryThreshold)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return FilePtr();
+  std::shared_ptr<File> file(new File);
+  file->fd = fd;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return FilePtr();
+  file->size = static_cast<size_t>(st.st_size);
+  file->mtime = st.st_mtime;
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+  file->lastModified = formatHttpDate(st.st_mtime);
+  file->contentType = contentType(path);
+  file->validated = now;
+  // copied rather than mmap()ed, which would SIGBUS us if the file is
+  // truncated in place.  A short read means it is being rewritten, it is
+  // sent by sendfile(2) then, until revalidated.
+  if (file->size > 0 && file->size <= memoryThreshold)
+  {
+    string content(file->size, '\0');
+    ssize_t n = ::pread(fd, &content[0], file->size, 0);
+    if (n == static_cast<ssize_t>(file->size))
+    {
+      file->content.swap(content);
+      ::close(file->fd);
+      file->fd = -1;
+    }
+    else if (n < 0)
+    {
+      LOG_SYSERR << "HttpFileHandler read " << path;
+    }
+  }
+  return file;
+}
+
+HttpFileHandler::FilePtr HttpFileHandler::open(const string& path, Timestamp now)
+{
+  FilePtr cached;
+  {
+    MutexLockGuard lock(mutex_);
+    auto it = files_.find(path);
+    if (it != files_.end())
+    {
+      cached = it->second;
+      if (timeDifference(now, cached->validated) < revalidateInterval_)
+      {
+        ++hits_;
+        return cached;
+      }
+    }
+  }
+
+  string fullPath = root_ + path;
+  struct stat st;
+  if (::stat(fullPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    MutexLockGuard lock(mutex_);
+    if (cached)
+      files_.erase(path);
+    ++misses_;
+    return FilePtr();
+  }
+  if (cached && cached->sameAs(st))
+  {
+    MutexLockGuard lock(mutex_);
+    cached->validated = now;
+    ++hits_;
+    return cached;
+  }
+
+  FilePtr file = load(fullPath, now, memoryThreshold_);
+  MutexLockGuard lock(mutex_);
+  ++misses_;
+  if (file)
+  {
+    if (files_.size() >= maxOpenFiles_ && files_.find(path) == files_.end())
+    {
+      // responses in flight keep their File alive
+      files_.erase(files_.begin());
+    }
+    files_[path] = file;
+  }
+  return file;
+}
+
+bool HttpFileHandler::handle(const HttpRequest& req, HttpResponse* resp)
+{
+  // FIXME: HEAD, HttpResponse always sends the body it has
+  if (req.method() != HttpRequest::kGet)
+    return false;
+  string path;
+  if (!decodePath(req.path(), &path))
+    return false;
+  FilePtr file = open(path, req.receiveTime().valid() ? req.receiveTime() : Timestamp::now());
+  if (!file)
+    return false;
+
+  resp->setContentType(file->contentType);
+  resp->addHeader("Last-Modified", file->lastModified);
+  resp->addHeader("Accept-Ranges", "bytes");
+
+  const string& ims = req.getHeader("If-Modified-Since");
+  if (!ims.empty())
+  {
+    time_t since = parseHttpDate(ims);
+    if (since >= 0 && file->mtime <= since)
+    {
+      resp->setStatusCode(HttpResponse::k304NotModified);
+      resp->setStatusMessage("Not Modified");
+      resp->setBody(string());
+      return true;
+    }
+  }
+
+  size_t offset = 0;
+  size_t length = file->size;
+  int range = 0;
+  const string& rangeHeader = req.getHeader("Range");
+  if (!rangeHeader.empty())
+  {
+    range = parseRange(rangeHeader, file->size, &offset, &length);
+  }
+  char buf[64];
+  if (range < 0)
+  {
+    resp->setStatusCode(HttpResponse::k416RangeNotSatisfiable);
+    resp->setStatusMessage("Range Not Satisfiable");
+    snprintf(buf, sizeof buf, "bytes */%zu", file->size);
+    resp->addHeader("Content-Range", buf);
+    resp->setBody(string());
+    return true;
+  }
+  else if (range > 0)
+  {
+    resp->setStatusCode(HttpResponse::k206PartialContent);
+    resp->setStatusMessage("Partial Content");
+    snprintf(buf, sizeof buf, "bytes %zu-%zu/%zu", offset, offset + length - 1, file->size);
+    resp->addHeader("Content-Range", buf);
+    // ranges are of the identity encoding
+    resp->setCompression(HttpResponse::kIdentity, 0);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+  }
+
+  if (file->fd < 0)
+  {
+    resp->setBody(StringPiece(file->content.data() + offset, static_cast<int>(length)),
+                  file);
+  }
+  else
+  {
+    resp->setFileBody(file->fd, static_cast<int64_t>(offset), length, file);
+  }
+  return true;
+}
+
+size_t HttpFileHandler::openFiles() const
+{
+  MutexLockGuard lock(mutex_);
+  return files_.size();
+}
+
+int64_t HttpFileHandler::hits() const
+{
+  MutexLockGuard lock(mutex_);
+  return hits_;
+}
+
+int64_t HttpFileHandler::misses() const
+{
+  MutexLockGuard lock(mutex_);
+  return misses_;
+}
@@ -0,0 +1,91 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPFILEHANDLER_H
+#define MUDUO_NET_HTTP_HTTPFILEHANDLER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpRequest;
+class HttpResponse;
+
+///
+/// Serves static files under a directory from a HttpCallback.
+///
+/// Open files are cached with their stat(2), and revalidated at most once
+/// per revalidate interval, so a hot file costs no open/stat/close per
+/// request.  Bodies go out by sendfile(2), small files are kept in memory and
+/// sent with the headers in one write.  Supports single byte ranges and
+/// If-Modified-Since.
+///
+/// @code
+///   HttpFileHandler files("/var/www");
+///   server.setHttpCallback([&](const HttpRequest& req, HttpResponse* resp)
+///   {
+///     if (!files.handle(req, resp))
+///       notFound(resp);
+///   });
+/// @endcode
+class HttpFileHandler : noncopyable
+{
+ public:
+  explicit HttpFileHandler(const string& root);
+  ~HttpFileHandler();
+
+  /// Files up to this size are kept in memory, default 64KiB, 0 to disable.
+  void setMemoryThreshold(size_t size) { memoryThreshold_ = size; }
+  /// stat(2) cached files again after this long, default 1 second.
+  void setRevalidateInterval(double seconds) { revalidateInterval_ = seconds; }
+  /// Default 1024.
+  void setMaxOpenFiles(size_t n) { maxOpenFiles_ = n; }
+
+  /// Fills resp for GET and HEAD of an existing regular file,
+  /// returns false otherwise, so caller can try other handlers.
+  /// Thread safe.
+  bool handle(const HttpRequest& req, HttpResponse* resp);
+
+  size_t openFiles() const;
+  int64_t hits() const;
+  int64_t misses() const;
+
+  /// "Sun, 06 Nov 1994 08:49:37 GMT"
+  static string formatHttpDate(time_t t);
+  /// -1 if not valid
+  static time_t parseHttpDate(const string& date);
+  static const char* contentType(const string& path);
+
+ private:
+  struct File;
+  typedef std::shared_ptr<const File> FilePtr;
+
+  FilePtr open(const string& path, Timestamp now);
+  static FilePtr load(const string& path, Timestamp now, size_t memoryThreshold);
+
+  const string root_;
+  size_t memoryThreshold_;
+  double revalidateInterval_;
+  size_t maxOpenFiles_;
+  mutable MutexLock mutex_;
+  std::unordered_map<string, FilePtr> files_ GUARDED_BY(mutex_);
+  int64_t hits_ GUARDED_BY(mutex_);
+  int64_t misses_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPFILEHANDLER_H
@@ -8,15 +8,195 @@
 //
 
 #include "muduo/net/http/HttpResponse.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/ThreadLocalSingleton.h"
 #include "muduo/net/Buffer.h"
+#include "muduo/net/ZlibStream.h"
+
+#include <algorithm>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+// deflate state is up to 256KiB at level 9, keep one per encoding and level
+// in each thread, ZlibOutputStream::reset() is cheap.
+class Deflaters : noncopyable
+{
+ public:
+  ZlibOutputStream* get(HttpResponse::ContentEncoding encoding, int level, Buffer* output)
+  {
+    assert(encoding == HttpResponse::kGzip || encoding == HttpResponse::kDeflate);
+    assert(1 <= level && level <= 9);
+    std::unique_ptr<ZlibOutputStream>& stream =
+        streams_[encoding == HttpResponse::kGzip ? 0 : 1][level];
+    if (!stream || !stream->reset(output))
+    {
+      stream.reset(new ZlibOutputStream(output, level,
+            encoding == HttpResponse::kGzip ? ZlibOutputStream::kGzip
+                                            : ZlibOutputStream::kZlib));
+    }
+    return stream.get();
+  }
+
+  Buffer& scratch()
+  {
+    // don't hold on to a huge body forever
+    if (scratch_.internalCapacity() > kMaxScratch)
+    {
+      scratch_.shrink(0);
+    }
+    scratch_.retrieveAll();
+    return scratch_;
+  }
+
+ private:
+  static const size_t kMaxScratch = 1024 * 1024;
+  std::unique_ptr<ZlibOutputStream> streams_[2][10];
+  Buffer scratch_;
+};
+
+StringPiece trim(const char* start, const char* end)
+{
+  while (start < end && (*start == ' ' || *start == '\t'))
+    ++start;
+  while (start < end && (end[-1] == ' ' || end[-1] == '\t'))
+    --end;
+  return StringPiece(start, static_cast<int>(end - start));
+}
+
+bool equalsIgnoreCase(const StringPiece& a, const char* b)
+{
+  size_t len = strlen(b);
+  return static_cast<size_t>(a.size()) == len && ::strncasecmp(a.data(), b, len) == 0;
+}
+
+}  // namespace
+
+const char* HttpResponse::encodingName(ContentEncoding encoding)
+{
+  switch (encoding)
+  {
+    case kGzip:
+      return "gzip";
+    case kDeflate:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+HttpResponse::ContentEncoding HttpResponse::negotiateEncoding(const string& acceptEncoding)
+{
+  // e.g. "gzip, deflate;q=0.5, *;q=0"
+  double gzip = -1, deflate = -1, any = -1;
+  const char* p = acceptEncoding.c_str();
+  const char* end = p + acceptEncoding.size();
+  while (p < end)
+  {
+    const char* comma = std::find(p, end, ',');
+    const char* semicolon = std::find(p, comma, ';');
+    StringPiece coding = trim(p, semicolon);
+    double q = 1.0;
+    if (semicolon != comma)
+    {
+      StringPiece param = trim(semicolon + 1, comma);
+      if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+      {
+        string value(param.data() + 2, param.size() - 2);
+        q = ::strtod(value.c_str(), NULL);
+      }
+    }
+    if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip"))
+      gzip = q;
+    else if (equalsIgnoreCase(coding, "deflate"))
+      deflate = q;
+    else if (coding == "*")
+      any = q;
+    p = comma + 1;
+  }
+
+  if (gzip < 0)
+    gzip = any;
+  if (deflate < 0)
+    deflate = any;
+  if (gzip > 0 && gzip >= deflate)
+    return kGzip;
+  else if (deflate > 0)
+    return kDeflate;
+  return kIdentity;
+}
+
+bool HttpResponse::isCompressible(const string& contentType)
+{
+  StringPiece type(contentType);
+  int semicolon = static_cast<int>(contentType.find(';'));
+  if (semicolon >= 0)
+    type = StringPiece(contentType.data(), semicolon);
+  return type.empty()
+      || type.starts_with("text/")
+      || type == "application/javascript"
+      || type == "application/json"
+      || type == "application/xml"
+      || type == "image/svg+xml"
+      || (type.size() > 4 && (StringPiece(type.end() - 4, 4) == "+xml" ||
+                              (type.size() > 5 && StringPiece(type.end() - 5, 5) == "+json")));
+}
+
+bool HttpResponse::compress(const StringPiece& data, ContentEncoding encoding,
+                            int level, Buffer* output)
+{
+  ZlibOutputStream* stream =
+      ThreadLocalSingleton<Deflaters>::instance().get(encoding, level, output);
+  bool ok = stream->write(data) && stream->finishStream();
+  if (!ok)
+  {
+    LOG_ERROR << "HttpResponse::compress " << stream->zlibErrorCode();
+  }
+  return ok;
+}
+
+bool HttpResponse::shouldCompress() const
+{
+  if (compressionLevel_ <= 0 || hasFileBody() ||
+      static_cast<size_t>(body().size()) < minCompressSize_)
+    return false;
+  if (headers_.find("Content-Encoding") != headers_.end())
+    return false;
+  auto it = headers_.find("Content-Type");
+  return isCompressible(it != headers_.end() ? it->second : string());
+}
+
 void HttpResponse::appendToBuffer(Buffer* output) const
 {
+  if (precomputed_)
+  {
+    output->append(externalBody_);
+    return;
+  }
+  StringPiece content(body());
+  const char* encoding = NULL;
+  bool vary = shouldCompress();
+  if (vary && encoding_ != kIdentity)
+  {
+    Buffer& compressed = ThreadLocalSingleton<Deflaters>::instance().scratch();
+    int level = std::min(compressionLevel_, 9);
+    // use it only if it's smaller
+    if (compress(content, encoding_, level, &compressed) &&
+        compressed.readableBytes() < static_cast<size_t>(content.size()))
+    {
+      content = compressed.toStringPiece();
+      encoding = encodingName(encoding_);
+    }
+  }
+
   char buf[32];
   snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
   output->append(buf);
@@ -29,11 +209,23 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
   else
   {
-    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
+    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n",
+             hasFileBody() ? fileLength_ : static_cast<size_t>(content.size()));
     output->append(buf);
     output->append("Connection: Keep-Alive\r\n");
   }
 
+  if (encoding)
+  {
+    output->append("Content-Encoding: ");
+    output->append(encoding);
+    output->append("\r\n");
+  }
+  if (vary && headers_.find("Vary") == headers_.end())
+  {
+    output->append("Vary: Accept-Encoding\r\n");
+  }
+
   for (const auto& header : headers_)
   {
     output->append(header.first);
@@ -43,5 +235,5 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
 
   output->append("\r\n");
-  output->append(body_);
+  output->append(content);
 }
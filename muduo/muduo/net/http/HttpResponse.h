@@ -12,9 +12,11 @@
 #define MUDUO_NET_HTTP_HTTPRESPONSE_H
 
 #include "muduo/base/copyable.h"
+#include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 
 #include <map>
+#include <memory>
 
 namespace muduo
 {
@@ -22,6 +24,7 @@ namespace net
 {
 
 class Buffer;
+
 class HttpResponse : public muduo::copyable
 {
  public:
@@ -29,14 +32,32 @@ class HttpResponse : public muduo::copyable
   {
     kUnknown,
     k200Ok = 200,
+    k206PartialContent = 206,
     k301MovedPermanently = 301,
+    k304NotModified = 304,
     k400BadRequest = 400,
+    k403Forbidden = 403,
     k404NotFound = 404,
+    k416RangeNotSatisfiable = 416,
+  };
+
+  enum ContentEncoding
+  {
+    kIdentity,
+    kGzip,
+    kDeflate,
   };
 
   explicit HttpResponse(bool close)
     : statusCode_(kUnknown),
-      closeConnection_(close)
+      closeConnection_(close),
+      fileFd_(-1),
+      fileOffset_(0),
+      fileLength_(0),
+      precomputed_(false),
+      encoding_(kIdentity),
+      compressionLevel_(0),
+      minCompressSize_(kDefaultMinCompressSize)
   {
   }
 
@@ -60,17 +81,98 @@ class HttpResponse : public muduo::copyable
   { headers_[key] = value; }
 
   void setBody(const string& body)
-  { body_ = body; }
+  { body_ = body; clearExternalBody(); }
+
+  /// Body outside of this object, e.g. a cached file, owner keeps it alive.
+  void setBody(const StringPiece& body, const std::shared_ptr<const void>& owner)
+  { clearExternalBody(); body_.clear(); externalBody_ = body; bodyOwner_ = owner; }
+
+  /// For static content, saves a copy per response.
+  void setSharedBody(const std::shared_ptr<const string>& body)
+  { setBody(*body, body); }
+
+  /// Body is sent from file with sendfile(2) after the headers,
+  /// owner keeps fd open.
+  void setFileBody(int fd, int64_t offset, size_t length,
+                   const std::shared_ptr<const void>& owner)
+  {
+    body_.clear();
+    clearExternalBody();
+    fileFd_ = fd;
+    fileOffset_ = offset;
+    fileLength_ = length;
+    bodyOwner_ = owner;
+  }
+
+  /// Whole response, status line, headers and body, prepared ahead and
+  /// sent as is, owner keeps it alive.  It must agree with closeConnection().
+  void setPrecomputed(const StringPiece& message, const std::shared_ptr<const void>& owner)
+  { setBody(message, owner); precomputed_ = true; }
+
+  bool isPrecomputed() const { return precomputed_; }
+
+  StringPiece body() const
+  { return bodyOwner_ ? externalBody_ : StringPiece(body_); }
+
+  bool hasFileBody() const { return fileFd_ >= 0; }
+  int fileFd() const { return fileFd_; }
+  int64_t fileOffset() const { return fileOffset_; }
+  size_t fileLength() const { return fileLength_; }
+  const std::shared_ptr<const void>& bodyOwner() const { return bodyOwner_; }
+
+  /// Compresses the body in appendToBuffer() with level 1 to 9, 0 to disable.
+  /// Skipped for small bodies, incompressible Content-Type or if
+  /// Content-Encoding is set, e.g. precompressed by HttpContentCache.
+  /// HttpServer::setCompressionLevel() calls this with the negotiated encoding.
+  void setCompression(ContentEncoding encoding, int level)
+  { encoding_ = encoding; compressionLevel_ = level; }
+
+  ContentEncoding contentEncoding() const
+  { return encoding_; }
+
+  void setMinCompressSize(size_t size)
+  { minCompressSize_ = size; }
 
   void appendToBuffer(Buffer* output) const;
 
+  /// Best encoding by the Accept-Encoding request header, gzip preferred.
+  static ContentEncoding negotiateEncoding(const string& acceptEncoding);
+
+  /// text/*, JavaScript, JSON, XML and SVG, or empty.
+  static bool isCompressible(const string& contentType);
+
+  static const char* encodingName(ContentEncoding encoding);
+
+  /// Appends compressed data to output, reuses a deflate state per thread.
+  static bool compress(const StringPiece& data, ContentEncoding encoding,
+                       int level, Buffer* output);
+
+  static const size_t kDefaultMinCompressSize = 256;
+
  private:
+  bool shouldCompress() const;
+  void clearExternalBody()
+  {
+    externalBody_.clear(); bodyOwner_.reset();
+    fileFd_ = -1; fileOffset_ = 0; fileLength_ = 0;
+    precomputed_ = false;
+  }
+
   std::map<string, string> headers_;
   HttpStatusCode statusCode_;
   // FIXME: add http version
   string statusMessage_;
   bool closeConnection_;
   string body_;
+  StringPiece externalBody_;
+  std::shared_ptr<const void> bodyOwner_;
+  int fileFd_;
+  int64_t fileOffset_;
+  size_t fileLength_;
+  bool precomputed_;
+  ContentEncoding encoding_;
+  int compressionLevel_;
+  size_t minCompressSize_;
 };
 
 }  // namespace net
@@ -40,7 +40,8 @@ HttpServer::HttpServer(EventLoop* loop,
                        const string& name,
                        TcpServer::Option option)
   : server_(loop, listenAddr, name, option),
-    httpCallback_(detail::defaultHttpCallback)
+    httpCallback_(detail::defaultHttpCallback),
+    compressionLevel_(0)
 {
   server_.setConnectionCallback(
       std::bind(&HttpServer::onConnection, this, _1));
@@ -69,17 +70,23 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
 {
   HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
-  if (!context->parseRequest(buf, receiveTime))
+  // pipelined requests may arrive together
+  do
   {
-    conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-    conn->shutdown();
-  }
+    if (!context->parseRequest(buf, receiveTime))
+    {
+      conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+      conn->shutdown();
+      break;
+    }
 
-  if (context->gotAll())
-  {
+    if (!context->gotAll())
+    {
+      break;
+    }
     onRequest(conn, context->request());
     context->reset();
-  }
+  } while (buf->readableBytes() > 0 && conn->connected());
 }
 
 void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
@@ -88,10 +95,28 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
   bool close = connection == "close" ||
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
   HttpResponse response(close);
+  if (compressionLevel_ > 0)
+  {
+    response.setCompression(
+        HttpResponse::negotiateEncoding(req.getHeader("Accept-Encoding")),
+        compressionLevel_);
+  }
   httpCallback_(req, &response);
-  Buffer buf;
-  response.appendToBuffer(&buf);
-  conn->send(&buf);
+  if (response.isPrecomputed())
+  {
+    conn->send(response.body());
+  }
+  else
+  {
+    Buffer buf;
+    response.appendToBuffer(&buf);
+    conn->send(&buf);
+  }
+  if (response.hasFileBody())
+  {
+    conn->sendFile(response.fileFd(), response.fileOffset(),
+                   response.fileLength(), response.bodyOwner());
+  }
   if (response.closeConnection())
   {
     conn->shutdown();
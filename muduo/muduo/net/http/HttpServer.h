@@ -49,6 +49,14 @@ class HttpServer : noncopyable
     server_.setThreadNum(numThreads);
   }
 
+  /// Compresses responses with gzip or deflate if the client accepts it,
+  /// level 1 to 9, 0 to disable (default).  Callbacks may override it
+  /// by HttpResponse::setCompression().
+  void setCompressionLevel(int level)
+  {
+    compressionLevel_ = level;
+  }
+
   void start();
 
  private:
@@ -60,6 +68,7 @@ class HttpServer : noncopyable
 
   TcpServer server_;
   HttpCallback httpCallback_;
+  int compressionLevel_;
 };
 
 }  // namespace net
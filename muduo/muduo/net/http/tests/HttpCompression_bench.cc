@@ -0,0 +1,140 @@
+// Bytes on the wire and CPU time per response, by compression level.
+//
+// Usage: httpcompression_bench [responses]
+
+#include "muduo/net/http/HttpContentCache.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/Buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const char* kWords[] = {
+  "muduo", "event", "loop", "buffer", "connection", "server", "client",
+  "timer", "thread", "callback", "channel", "poller", "socket", "address",
+  "message", "codec", "protobuf", "http", "request", "response",
+};
+
+string makeHtml(size_t size)
+{
+  string body = "<!DOCTYPE html>\n<html><head><title>muduo</title></head><body><ul>\n";
+  unsigned seed = 1;
+  while (body.size() < size)
+  {
+    body += "<li class=\"item\"><a href=\"/";
+    body += kWords[rand_r(&seed) % 20];
+    body += "/";
+    body += std::to_string(rand_r(&seed) % 100000);
+    body += "\">";
+    for (int i = 0; i < 6; ++i)
+    {
+      body += kWords[rand_r(&seed) % 20];
+      body += ' ';
+    }
+    body += "</a></li>\n";
+  }
+  return body;
+}
+
+string makeJson(size_t size)
+{
+  string body = "[";
+  unsigned seed = 2;
+  while (body.size() < size)
+  {
+    body += "{\"id\":";
+    body += std::to_string(rand_r(&seed));
+    body += ",\"name\":\"";
+    body += kWords[rand_r(&seed) % 20];
+    body += "\",\"score\":";
+    body += std::to_string(rand_r(&seed) % 1000);
+    body += ",\"tags\":[\"";
+    body += kWords[rand_r(&seed) % 20];
+    body += "\",\"";
+    body += kWords[rand_r(&seed) % 20];
+    body += "\"]},";
+  }
+  body += "{}]";
+  return body;
+}
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// level 0 for no compression, -1 for HttpContentCache
+void bench(const char* name, const string& contentType, const string& body,
+           int level, int responses)
+{
+  HttpContentCache cache;
+  cache.put("/", contentType, body);
+  {
+    HttpResponse warmUp(false);
+    cache.respond("/", HttpResponse::kGzip, &warmUp);
+  }
+  Buffer output;
+  size_t bytes = 0;
+  double start = threadCpuSeconds();
+  for (int i = 0; i < responses; ++i)
+  {
+    HttpResponse resp(false);
+    resp.setStatusCode(HttpResponse::k200Ok);
+    resp.setStatusMessage("OK");
+    if (level >= 0)
+    {
+      resp.setContentType(contentType);
+      resp.setBody(body);
+      resp.setCompression(level > 0 ? HttpResponse::kGzip : HttpResponse::kIdentity, level);
+    }
+    else
+    {
+      cache.respond("/", HttpResponse::kGzip, &resp);
+    }
+    resp.appendToBuffer(&output);
+    bytes += output.readableBytes();
+    output.retrieveAll();
+  }
+  double cpu = threadCpuSeconds() - start;
+  char levelName[16];
+  snprintf(levelName, sizeof levelName, level < 0 ? "cache" : level == 0 ? "off" : "%d", level);
+  printf("%-6s %7zd %-6s %9zd %6.1f%% %9.2f %9.1f\n",
+         name, body.size(), levelName,
+         bytes / responses,
+         100.0 * static_cast<double>(bytes / responses) / static_cast<double>(body.size()),
+         cpu * 1e6 / responses,
+         static_cast<double>(responses) / cpu);
+}
+
+int main(int argc, char* argv[])
+{
+  int responses = argc > 1 ? atoi(argv[1]) : 2000;
+  struct
+  {
+    const char* name;
+    const char* contentType;
+    string body;
+  } bodies[] = {
+    { "html", "text/html", makeHtml(2 * 1024) },
+    { "html", "text/html", makeHtml(32 * 1024) },
+    { "json", "application/json", makeJson(256 * 1024) },
+  };
+  const int levels[] = { 0, 1, 3, 6, 9, -1 };
+
+  printf("%-6s %7s %-6s %9s %7s %9s %9s\n",
+         "body", "size", "level", "bytes", "ratio", "cpu_us", "resp/s");
+  for (const auto& b : bodies)
+  {
+    for (int level : levels)
+    {
+      int n = b.body.size() > 100 * 1024 ? responses / 10 : responses;
+      bench(b.name, b.contentType, b.body, level, n);
+    }
+  }
+}
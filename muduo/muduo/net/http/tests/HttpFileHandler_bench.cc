@@ -0,0 +1,217 @@
+// Static files by HttpFileHandler vs. reading them in a plain HttpCallback,
+// keep-alive clients over loopback, reports requests/s and server CPU.
+//
+// Usage: httpfilehandler_bench [connections] [seconds]
+
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/http/HttpFileHandler.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/http/HttpServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+string g_root;
+
+void plainCallback(const HttpRequest& req, HttpResponse* resp)
+{
+  string content;
+  if (FileUtil::readFile(g_root + req.path(), 64 * 1024 * 1024, &content) == 0)
+  {
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    resp->setContentType("application/octet-stream");
+    resp->setBody(content);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
+
+// Sends a GET, waits for the whole response, repeats.
+class Client : noncopyable
+{
+ public:
+  Client(EventLoop* loop, const InetAddress& serverAddr, const string& path)
+    : client_(loop, serverAddr, "BenchClient"),
+      request_("GET " + path + " HTTP/1.1\r\nHost: bench\r\n\r\n"),
+      bodyRemaining_(-1),
+      responses_(0),
+      bytes_(0)
+  {
+    client_.setConnectionCallback([this](const TcpConnectionPtr& conn)
+    {
+      if (conn->connected())
+      {
+        conn->setTcpNoDelay(true);
+        conn->send(request_);
+      }
+    });
+    client_.setMessageCallback(
+        std::bind(&Client::onMessage, this, _1, _2, _3));
+    client_.connect();
+  }
+
+  int64_t responses() const { return responses_; }
+  int64_t bytes() const { return bytes_; }
+
+ private:
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    while (true)
+    {
+      if (bodyRemaining_ < 0)
+      {
+        const char* end = buf->findCRLF();
+        const char* headerEnd = NULL;
+        while (end)
+        {
+          if (end == buf->peek() || (end - 2 >= buf->peek() && end[-1] == '\n'))
+          {
+            headerEnd = end + 2;
+            break;
+          }
+          end = buf->findCRLF(end + 2);
+        }
+        if (!headerEnd)
+          return;
+        string headers(buf->peek(), headerEnd);
+        size_t pos = headers.find("Content-Length: ");
+        bodyRemaining_ = pos != string::npos ? atoll(headers.c_str() + pos + 16) : 0;
+        bytes_ += headerEnd - buf->peek();
+        buf->retrieveUntil(headerEnd);
+      }
+      int64_t n = std::min(bodyRemaining_, static_cast<int64_t>(buf->readableBytes()));
+      buf->retrieve(n);
+      bodyRemaining_ -= n;
+      bytes_ += n;
+      if (bodyRemaining_ > 0)
+        return;
+      bodyRemaining_ = -1;
+      ++responses_;
+      conn->send(request_);
+      if (buf->readableBytes() == 0)
+        return;
+    }
+  }
+
+  TcpClient client_;
+  const string request_;
+  int64_t bodyRemaining_;
+  int64_t responses_;
+  int64_t bytes_;
+};
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+void bench(const char* mode, const string& path, size_t size, int connections, int seconds)
+{
+  int probe = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(probe, InetAddress(0, true).getSockAddr());
+  uint16_t port = InetAddress(sockets::getLocalAddr(probe)).port();
+  sockets::close(probe);
+
+  HttpFileHandler handler(g_root);
+  EventLoopThread serverThread;
+  EventLoop* serverLoop = serverThread.startLoop();
+  std::unique_ptr<HttpServer> server;
+  double serverCpu = 0;
+  serverLoop->runInLoop([&]
+  {
+    server.reset(new HttpServer(serverLoop, InetAddress(port, true), "BenchServer"));
+    if (strcmp(mode, "plain") == 0)
+    {
+      server->setHttpCallback(plainCallback);
+    }
+    else
+    {
+      server->setHttpCallback([&handler](const HttpRequest& req, HttpResponse* resp)
+      {
+        if (!handler.handle(req, resp))
+          plainCallback(req, resp);
+      });
+    }
+    server->start();
+    serverCpu = threadCpuSeconds();
+  });
+
+  EventLoop loop;
+  std::vector<std::unique_ptr<Client>> clients;
+  loop.runAfter(0.01, [&]
+  {
+    for (int i = 0; i < connections; ++i)
+      clients.emplace_back(new Client(&loop, InetAddress("127.0.0.1", port), path));
+  });
+  loop.runAfter(seconds, [&] { loop.quit(); });
+  loop.loop();
+
+  CountDownLatch done(1);
+  serverLoop->runInLoop([&]
+  {
+    serverCpu = threadCpuSeconds() - serverCpu;
+    server.reset();
+    done.countDown();
+  });
+  done.wait();
+
+  int64_t responses = 0, bytes = 0;
+  for (const auto& client : clients)
+  {
+    responses += client->responses();
+    bytes += client->bytes();
+  }
+  printf("%-8s %9zd %10.0f %9.1f %10.2f\n", mode, size,
+         static_cast<double>(responses) / seconds,
+         static_cast<double>(bytes) / seconds / 1024 / 1024,
+         serverCpu * 1e6 / static_cast<double>(std::max<int64_t>(responses, 1)));
+  // the connections are reset by the server, then the clients go away
+  clients.clear();
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::ERROR);
+  int connections = argc > 1 ? atoi(argv[1]) : 4;
+  int seconds = argc > 2 ? atoi(argv[2]) : 3;
+
+  char tmpl[] = "/tmp/httpfilehandler_bench_XXXXXX";
+  g_root = ::mkdtemp(tmpl);
+  const size_t sizes[] = { 1024, 16 * 1024, 1024 * 1024 };
+  string content(1024 * 1024, 'x');
+  for (size_t size : sizes)
+  {
+    string path = g_root + "/" + std::to_string(size);
+    FILE* fp = ::fopen(path.c_str(), "w");
+    ::fwrite(content.data(), 1, size, fp);
+    ::fclose(fp);
+  }
+
+  printf("%-8s %9s %10s %9s %10s\n", "mode", "size", "req/s", "MiB/s", "cpu_us/req");
+  for (size_t size : sizes)
+  {
+    string path = "/" + std::to_string(size);
+    bench("plain", path, size, connections, seconds);
+    bench("handler", path, size, connections, seconds);
+    ::unlink((g_root + path).c_str());
+  }
+  ::rmdir(g_root.c_str());
+}
@@ -0,0 +1,281 @@
+#include "muduo/net/http/HttpFileHandler.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/http/HttpServer.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/SocketsOps.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+struct Fixture
+{
+  Fixture()
+  {
+    char tmpl[] = "/tmp/httpfilehandler_XXXXXX";
+    root = ::mkdtemp(tmpl);
+    small = makeContent(1000);
+    large = makeContent(3 * 1000 * 1000);
+    write("/small.txt", small);
+    write("/large.bin", large);
+    ::mkdir((root + "/dir").c_str(), 0755);
+    write("/dir/index.html", "<html>index</html>");
+  }
+
+  ~Fixture()
+  {
+    ::unlink((root + "/small.txt").c_str());
+    ::unlink((root + "/large.bin").c_str());
+    ::unlink((root + "/dir/index.html").c_str());
+    ::rmdir((root + "/dir").c_str());
+    ::rmdir(root.c_str());
+  }
+
+  static string makeContent(size_t size)
+  {
+    string content(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+      content[i] = static_cast<char>('a' + (i * 7 + i / 1000) % 26);
+    return content;
+  }
+
+  void write(const string& path, const string& content)
+  {
+    FILE* fp = ::fopen((root + path).c_str(), "w");
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+  }
+
+  string root;
+  string small;
+  string large;
+};
+
+HttpRequest makeRequest(const string& path, const string& headers = "")
+{
+  HttpRequest req;
+  string get = "GET";
+  req.setMethod(get.data(), get.data() + get.size());
+  req.setPath(path.data(), path.data() + path.size());
+  req.setReceiveTime(Timestamp::now());
+  size_t pos = 0;
+  while (pos < headers.size())
+  {
+    size_t eol = headers.find('\n', pos);
+    if (eol == string::npos)
+      eol = headers.size();
+    const char* start = headers.data() + pos;
+    const char* colon = headers.data() + headers.find(':', pos);
+    req.addHeader(start, colon, headers.data() + eol);
+    pos = eol + 1;
+  }
+  return req;
+}
+
+// whole body, from memory or from file
+string bodyOf(const HttpResponse& resp)
+{
+  if (!resp.hasFileBody())
+    return resp.body().as_string();
+  string body(resp.fileLength(), '\0');
+  ssize_t n = ::pread(resp.fileFd(), &body[0], body.size(), resp.fileOffset());
+  BOOST_CHECK_EQUAL(n, static_cast<ssize_t>(body.size()));
+  return body;
+}
+
+string headersOf(const HttpResponse& resp)
+{
+  Buffer buf;
+  resp.appendToBuffer(&buf);
+  string text = buf.retrieveAllAsString();
+  return text.substr(0, text.find("\r\n\r\n") + 4);
+}
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_CASE(testServeFiles, Fixture)
+{
+  HttpFileHandler handler(root);
+  HttpResponse resp(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/small.txt"), &resp));
+  BOOST_CHECK(!resp.hasFileBody());  // in memory
+  BOOST_CHECK(bodyOf(resp) == small);
+  BOOST_CHECK(headersOf(resp).find("Content-Type: text/plain") != string::npos);
+
+  HttpResponse resp2(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/large.bin"), &resp2));
+  BOOST_CHECK(resp2.hasFileBody());
+  BOOST_CHECK(bodyOf(resp2) == large);
+  BOOST_CHECK(headersOf(resp2).find("Content-Length: 3000000\r\n") != string::npos);
+
+  HttpResponse resp3(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/dir/"), &resp3));
+  BOOST_CHECK_EQUAL(bodyOf(resp3), "<html>index</html>");
+
+  // cached
+  BOOST_CHECK_EQUAL(handler.misses(), 3);
+  HttpResponse resp4(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/large.bin"), &resp4));
+  BOOST_CHECK_EQUAL(resp4.fileFd(), resp2.fileFd());
+  BOOST_CHECK_EQUAL(handler.hits(), 1);
+  BOOST_CHECK_EQUAL(handler.openFiles(), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(testRejects, Fixture)
+{
+  HttpFileHandler handler(root);
+  HttpResponse resp(false);
+  BOOST_CHECK(!handler.handle(makeRequest("/none.txt"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("/dir"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("/../etc/passwd"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("/dir/%2e%2e/small.txt"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("/small.txt%00"), &resp));
+  BOOST_CHECK(handler.handle(makeRequest("/%73mall.txt"), &resp));
+}
+
+BOOST_FIXTURE_TEST_CASE(testRange, Fixture)
+{
+  HttpFileHandler handler(root);
+  {
+    HttpResponse resp(false);
+    BOOST_REQUIRE(handler.handle(makeRequest("/large.bin", "Range: bytes=100-199"), &resp));
+    BOOST_CHECK(bodyOf(resp) == large.substr(100, 100));
+    string headers = headersOf(resp);
+    BOOST_CHECK(headers.find("HTTP/1.1 206 ") == 0);
+    BOOST_CHECK(headers.find("Content-Range: bytes 100-199/3000000\r\n") != string::npos);
+  }
+  {
+    HttpResponse resp(false);
+    BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "Range: bytes=-10"), &resp));
+    BOOST_CHECK(bodyOf(resp) == small.substr(990));
+  }
+  {
+    HttpResponse resp(false);
+    BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "Range: bytes=900-"), &resp));
+    BOOST_CHECK(bodyOf(resp) == small.substr(900));
+  }
+  {
+    HttpResponse resp(false);
+    BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "Range: bytes=5000-"), &resp));
+    string headers = headersOf(resp);
+    BOOST_CHECK(headers.find("HTTP/1.1 416 ") == 0);
+    BOOST_CHECK(headers.find("Content-Range: bytes */1000\r\n") != string::npos);
+  }
+  {
+    // multiple ranges are not supported, whole file
+    HttpResponse resp(false);
+    BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "Range: bytes=0-1,5-6"), &resp));
+    BOOST_CHECK(bodyOf(resp) == small);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(testIfModifiedSince, Fixture)
+{
+  struct stat st;
+  ::stat((root + "/small.txt").c_str(), &st);
+  string lastModified = HttpFileHandler::formatHttpDate(st.st_mtime);
+  BOOST_CHECK_EQUAL(HttpFileHandler::parseHttpDate(lastModified), st.st_mtime);
+  BOOST_CHECK_EQUAL(HttpFileHandler::parseHttpDate("yesterday"), -1);
+
+  HttpFileHandler handler(root);
+  HttpResponse resp(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "If-Modified-Since: " + lastModified), &resp));
+  BOOST_CHECK(headersOf(resp).find("HTTP/1.1 304 ") == 0);
+  BOOST_CHECK(bodyOf(resp).empty());
+
+  HttpResponse resp2(false);
+  string before = HttpFileHandler::formatHttpDate(st.st_mtime - 10);
+  BOOST_REQUIRE(handler.handle(makeRequest("/small.txt", "If-Modified-Since: " + before), &resp2));
+  BOOST_CHECK(headersOf(resp2).find("HTTP/1.1 200 ") == 0);
+  BOOST_CHECK(headersOf(resp2).find("Last-Modified: " + lastModified) != string::npos);
+}
+
+BOOST_FIXTURE_TEST_CASE(testRevalidate, Fixture)
+{
+  HttpFileHandler handler(root);
+  handler.setRevalidateInterval(0);
+  HttpResponse resp(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/small.txt"), &resp));
+  string bigger = small + small;
+  write("/small.txt", bigger);
+  HttpResponse resp2(false);
+  BOOST_REQUIRE(handler.handle(makeRequest("/small.txt"), &resp2));
+  BOOST_CHECK(bodyOf(resp2) == bigger);
+  BOOST_CHECK_EQUAL(handler.misses(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(testSendFileOverTcp, Fixture)
+{
+  HttpFileHandler handler(root);
+  // a free port
+  int probe = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(probe, InetAddress(0, true).getSockAddr());
+  uint16_t port = InetAddress(sockets::getLocalAddr(probe)).port();
+  sockets::close(probe);
+
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+  std::unique_ptr<HttpServer> server;
+  loop->runInLoop([&]
+  {
+    server.reset(new HttpServer(loop, InetAddress(port, true), "FileServer"));
+    server->setHttpCallback([&](const HttpRequest& req, HttpResponse* resp)
+    {
+      BOOST_CHECK(handler.handle(req, resp));
+    });
+    server->start();
+  });
+  while (!server) usleep(1000);
+  usleep(10 * 1000);
+
+  int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  InetAddress serverAddr("127.0.0.1", port);
+  BOOST_REQUIRE_EQUAL(::connect(sockfd, serverAddr.getSockAddr(), sizeof(struct sockaddr_in)), 0);
+  // pipelined, the small response must follow the whole large file
+  string requests = "GET /large.bin HTTP/1.1\r\nRange: bytes=10-2999999\r\n\r\n"
+                    "GET /small.txt HTTP/1.1\r\n\r\n";
+  BOOST_REQUIRE_EQUAL(::write(sockfd, requests.data(), requests.size()),
+                      static_cast<ssize_t>(requests.size()));
+  string received;
+  char buf[65536];
+  const size_t expected = large.size() - 10 + small.size();
+  while (received.size() < expected + 300)
+  {
+    ssize_t n = ::read(sockfd, buf, sizeof buf);
+    if (n <= 0)
+      break;
+    received.append(buf, n);
+    size_t second = received.find("HTTP/1.1 200 OK");
+    if (second != string::npos)
+    {
+      size_t bodyStart = received.find("\r\n\r\n", second);
+      if (bodyStart != string::npos && received.size() - bodyStart - 4 == small.size())
+        break;
+    }
+  }
+  ::close(sockfd);
+
+  size_t firstBody = received.find("\r\n\r\n") + 4;
+  BOOST_CHECK_EQUAL(received.find("HTTP/1.1 206 Partial Content"), 0);
+  BOOST_CHECK(received.compare(firstBody, large.size() - 10, large, 10, string::npos) == 0);
+  size_t second = firstBody + large.size() - 10;
+  BOOST_CHECK_EQUAL(received.find("HTTP/1.1 200 OK", second), second);
+  BOOST_CHECK(received.substr(received.find("\r\n\r\n", second) + 4) == small);
+
+  loop->runInLoop([&] { server.reset(); });
+  while (server) usleep(1000);
+}
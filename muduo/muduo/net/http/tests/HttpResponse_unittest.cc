@@ -0,0 +1,205 @@
+#include "muduo/net/http/HttpContentCache.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/Buffer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#include <zlib.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::HttpContentCache;
+using muduo::net::HttpResponse;
+
+namespace
+{
+
+string makeBody(size_t size)
+{
+  string body;
+  while (body.size() < size)
+  {
+    body += "<li><a href=\"/item/";
+    body += std::to_string(body.size() % 97);
+    body += "\">muduo network library</a></li>\n";
+  }
+  body.resize(size);
+  return body;
+}
+
+string inflateBody(const string& data, bool gzip)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof zs);
+  BOOST_REQUIRE_EQUAL(inflateInit2(&zs, gzip ? 16 + MAX_WBITS : MAX_WBITS), Z_OK);
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = static_cast<uInt>(data.size());
+  string result;
+  char buf[4096];
+  int err = Z_OK;
+  while (err == Z_OK)
+  {
+    zs.next_out = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = sizeof buf;
+    err = inflate(&zs, Z_NO_FLUSH);
+    result.append(buf, sizeof buf - zs.avail_out);
+  }
+  BOOST_CHECK_EQUAL(err, Z_STREAM_END);
+  inflateEnd(&zs);
+  return result;
+}
+
+struct Parsed
+{
+  std::map<string, string> headers;
+  string body;
+};
+
+Parsed parse(const HttpResponse& resp)
+{
+  Buffer buf;
+  resp.appendToBuffer(&buf);
+  string text = buf.retrieveAllAsString();
+  Parsed result;
+  size_t headerEnd = text.find("\r\n\r\n");
+  BOOST_REQUIRE(headerEnd != string::npos);
+  size_t pos = text.find("\r\n") + 2;
+  while (pos < headerEnd)
+  {
+    size_t eol = text.find("\r\n", pos);
+    size_t colon = text.find(": ", pos);
+    result.headers[text.substr(pos, colon - pos)] = text.substr(colon + 2, eol - colon - 2);
+    pos = eol + 2;
+  }
+  result.body = text.substr(headerEnd + 4);
+  return result;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testNegotiateEncoding)
+{
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding(""), HttpResponse::kIdentity);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("gzip, deflate, br"), HttpResponse::kGzip);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("deflate"), HttpResponse::kDeflate);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("GZIP"), HttpResponse::kGzip);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("gzip;q=0.5, deflate"), HttpResponse::kDeflate);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("gzip;q=0, deflate;q=0"), HttpResponse::kIdentity);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("*"), HttpResponse::kGzip);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("gzip;q=0, *"), HttpResponse::kDeflate);
+  BOOST_CHECK_EQUAL(HttpResponse::negotiateEncoding("br, identity"), HttpResponse::kIdentity);
+}
+
+BOOST_AUTO_TEST_CASE(testIsCompressible)
+{
+  BOOST_CHECK(HttpResponse::isCompressible("text/html; charset=utf-8"));
+  BOOST_CHECK(HttpResponse::isCompressible("application/json"));
+  BOOST_CHECK(HttpResponse::isCompressible("application/atom+xml"));
+  BOOST_CHECK(HttpResponse::isCompressible(""));
+  BOOST_CHECK(!HttpResponse::isCompressible("image/png"));
+  BOOST_CHECK(!HttpResponse::isCompressible("application/octet-stream"));
+}
+
+BOOST_AUTO_TEST_CASE(testCompressResponse)
+{
+  const string body = makeBody(10000);
+  for (int encoding = HttpResponse::kGzip; encoding <= HttpResponse::kDeflate; ++encoding)
+  {
+    for (int level = 1; level <= 9; level += 4)
+    {
+      HttpResponse resp(false);
+      resp.setStatusCode(HttpResponse::k200Ok);
+      resp.setStatusMessage("OK");
+      resp.setContentType("text/html");
+      resp.setBody(body);
+      resp.setCompression(static_cast<HttpResponse::ContentEncoding>(encoding), level);
+      Parsed parsed = parse(resp);
+      BOOST_CHECK_EQUAL(parsed.headers["Content-Encoding"],
+                        encoding == HttpResponse::kGzip ? "gzip" : "deflate");
+      BOOST_CHECK_EQUAL(parsed.headers["Vary"], "Accept-Encoding");
+      BOOST_CHECK_EQUAL(parsed.headers["Content-Length"], std::to_string(parsed.body.size()));
+      BOOST_CHECK_LT(parsed.body.size(), body.size() / 4);
+      BOOST_CHECK(inflateBody(parsed.body, encoding == HttpResponse::kGzip) == body);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testSkipCompression)
+{
+  HttpResponse resp(false);
+  resp.setBody(makeBody(100));
+  resp.setCompression(HttpResponse::kGzip, 6);
+  Parsed parsed = parse(resp);  // too small
+  BOOST_CHECK_EQUAL(parsed.headers.count("Content-Encoding"), 0);
+  BOOST_CHECK_EQUAL(parsed.headers.count("Vary"), 0);
+
+  resp.setBody(makeBody(10000));
+  resp.setContentType("image/png");
+  parsed = parse(resp);
+  BOOST_CHECK_EQUAL(parsed.headers.count("Content-Encoding"), 0);
+  BOOST_CHECK_EQUAL(parsed.body.size(), 10000);
+
+  // client doesn't accept, but the response varies
+  resp.setContentType("text/plain");
+  resp.setCompression(HttpResponse::kIdentity, 6);
+  parsed = parse(resp);
+  BOOST_CHECK_EQUAL(parsed.headers.count("Content-Encoding"), 0);
+  BOOST_CHECK_EQUAL(parsed.headers["Vary"], "Accept-Encoding");
+  BOOST_CHECK_EQUAL(parsed.body.size(), 10000);
+}
+
+BOOST_AUTO_TEST_CASE(testContentCache)
+{
+  HttpContentCache cache;
+  const string body = makeBody(20000);
+  cache.put("/index.html", "text/html", body);
+  cache.put("/logo.png", "image/png", body);
+
+  HttpResponse miss(false);
+  BOOST_CHECK(!cache.respond("/none", HttpResponse::kGzip, &miss));
+
+  for (int i = 0; i < 3; ++i)
+  {
+    HttpResponse resp(false);
+    resp.setCompression(HttpResponse::kGzip, 1);  // as HttpServer does
+    BOOST_CHECK(cache.respond("/index.html", HttpResponse::kGzip, &resp));
+    Parsed parsed = parse(resp);
+    BOOST_CHECK_EQUAL(parsed.headers["Content-Encoding"], "gzip");
+    BOOST_CHECK_EQUAL(parsed.headers["Content-Type"], "text/html");
+    BOOST_CHECK(inflateBody(parsed.body, true) == body);
+  }
+  BOOST_CHECK_EQUAL(cache.compressions(), 1);
+
+  HttpResponse identity(false);
+  BOOST_CHECK(cache.respond("/index.html", HttpResponse::kIdentity, &identity));
+  BOOST_CHECK(parse(identity).body == body);
+
+  HttpResponse png(false);
+  BOOST_CHECK(cache.respond("/logo.png", HttpResponse::kGzip, &png));
+  Parsed parsed = parse(png);
+  BOOST_CHECK_EQUAL(parsed.headers.count("Content-Encoding"), 0);
+  BOOST_CHECK(parsed.body == body);
+  BOOST_CHECK_EQUAL(cache.compressions(), 1);
+
+  cache.remove("/logo.png");
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(testPrecomputed)
+{
+  std::shared_ptr<string> message(new string("HTTP/1.1 301 Moved Permanently\r\n"
+                                             "Content-Length: 0\r\n\r\n"));
+  HttpResponse resp(false);
+  resp.addHeader("Location", "ignored");
+  resp.setPrecomputed(*message, message);
+  BOOST_CHECK(resp.isPrecomputed());
+  Buffer buf;
+  resp.appendToBuffer(&buf);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), *message);
+
+  resp.setBody("hello");
+  BOOST_CHECK(!resp.isPrecomputed());
+}
@@ -14,6 +14,7 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/http/HttpRequest.h"
 #include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/inspect/MetricsSampler.h"
 #include "muduo/net/inspect/ProcessInspector.h"
 #include "muduo/net/inspect/PerformanceInspector.h"
 #include "muduo/net/inspect/SystemInspector.h"
@@ -61,10 +62,13 @@ extern char favicon[1743];
 
 Inspector::Inspector(EventLoop* loop,
                      const InetAddress& httpAddr,
-                     const string& name)
+                     const string& name,
+                     double sampleInterval,
+                     int maxSamples)
     : server_(loop, httpAddr, "Inspector:"+name),
       processInspector_(new ProcessInspector),
-      systemInspector_(new SystemInspector)
+      systemInspector_(new SystemInspector),
+      sampler_(sampleInterval > 0 ? new MetricsSampler(loop, sampleInterval, maxSamples) : NULL)
 {
   assert(CurrentThread::isMainThread());
   assert(g_globalInspector == 0);
@@ -72,6 +76,10 @@ Inspector::Inspector(EventLoop* loop,
   server_.setHttpCallback(std::bind(&Inspector::onRequest, this, _1, _2));
   processInspector_->registerCommands(this);
   systemInspector_->registerCommands(this);
+  if (sampler_)
+  {
+    sampler_->registerCommands(this);
+  }
 #ifdef HAVE_TCMALLOC
   performanceInspector_.reset(new PerformanceInspector);
   performanceInspector_->registerCommands(this);
@@ -108,6 +116,10 @@ void Inspector::remove(const string& module, const string& command)
 
 void Inspector::start()
 {
+  if (sampler_)
+  {
+    sampler_->start();
+  }
   server_.start();
 }
 
@@ -22,6 +22,7 @@ namespace muduo
 namespace net
 {
 
+class MetricsSampler;
 class ProcessInspector;
 class PerformanceInspector;
 class SystemInspector;
@@ -33,11 +34,18 @@ class Inspector : noncopyable
  public:
   typedef std::vector<string> ArgList;
   typedef std::function<string (HttpRequest::Method, const ArgList& args)> Callback;
+  /// Samples /proc every sampleInterval seconds in loop, keeps maxSamples,
+  /// off by default.
   Inspector(EventLoop* loop,
             const InetAddress& httpAddr,
-            const string& name);
+            const string& name,
+            double sampleInterval = 0,
+            int maxSamples = 600);
   ~Inspector();
 
+  /// NULL if sampling is disabled.
+  MetricsSampler* sampler() { return sampler_.get(); }
+
   /// Add a Callback for handling the special uri : /mudule/command
   void add(const string& module,
            const string& command,
@@ -56,6 +64,7 @@ class Inspector : noncopyable
   std::unique_ptr<ProcessInspector> processInspector_;
   std::unique_ptr<PerformanceInspector> performanceInspector_;
   std::unique_ptr<SystemInspector> systemInspector_;
+  std::unique_ptr<MetricsSampler> sampler_;
   MutexLock mutex_;
   std::map<string, CommandList> modules_ GUARDED_BY(mutex_);
   std::map<string, HelpList> helps_ GUARDED_BY(mutex_);
@@ -0,0 +1,406 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/inspect/MetricsSampler.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/inspect/Inspector.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+int openProcFile(const char* path)
+{
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG_SYSERR << "MetricsSampler open " << path;
+  }
+  return fd;
+}
+
+// Reads from the beginning, procfs regenerates the content on each read.
+ssize_t readProcFile(int fd, char* buf, size_t len)
+{
+  ssize_t n = fd >= 0 ? ::pread(fd, buf, len - 1, 0) : -1;
+  buf[n > 0 ? n : 0] = '\0';
+  return n;
+}
+
+const char* skipSpaces(const char* p, const char* end)
+{
+  while (p < end && *p == ' ')
+    ++p;
+  return p;
+}
+
+// Returns NULL if no number at p.
+const char* parseInt(const char* p, const char* end, int64_t* value)
+{
+  p = skipSpaces(p, end);
+  bool negative = p < end && *p == '-';
+  if (negative)
+    ++p;
+  if (p == end || *p < '0' || *p > '9')
+    return NULL;
+  int64_t v = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    v = v * 10 + (*p - '0');
+    ++p;
+  }
+  *value = negative ? -v : v;
+  return p;
+}
+
+int64_t getKb(const char* meminfo, const char* key)
+{
+  const char* p = strstr(meminfo, key);
+  int64_t kb = 0;
+  if (p)
+  {
+    p += strlen(key);
+    parseInt(p, p + strlen(p), &kb);
+  }
+  return kb;
+}
+
+void appendInts(string* out, const char* name,
+                const std::vector<MetricsSampler::Sample>& samples,
+                int64_t (*field)(const MetricsSampler::Sample&))
+{
+  char buf[32];
+  out->append(",\"");
+  out->append(name);
+  out->append("\":[");
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    int n = snprintf(buf, sizeof buf, i == 0 ? "%" PRId64 : ",%" PRId64, field(samples[i]));
+    out->append(buf, n);
+  }
+  out->append("]");
+}
+
+void appendDoubles(string* out, const char* name,
+                   const std::vector<MetricsSampler::Sample>& samples,
+                   double (*field)(const MetricsSampler::Sample&))
+{
+  char buf[32];
+  out->append(",\"");
+  out->append(name);
+  out->append("\":[");
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    int n = snprintf(buf, sizeof buf, i == 0 ? "%.3f" : ",%.3f", field(samples[i]));
+    out->append(buf, n);
+  }
+  out->append("]");
+}
+
+void appendMetric(string* out, const char* name, const char* type,
+                  const char* label, double value)
+{
+  char buf[256];
+  if (type)
+  {
+    snprintf(buf, sizeof buf, "# TYPE %s %s\n", name, type);
+    out->append(buf);
+  }
+  snprintf(buf, sizeof buf, "%s%s %.17g\n", name, label, value);
+  out->append(buf);
+}
+
+}  // namespace
+
+MetricsSampler::MetricsSampler(EventLoop* loop, double interval, int capacity)
+  : loop_(loop),
+    interval_(interval),
+    capacity_(capacity > 1 ? capacity : 2),
+    slots_(new Slot[capacity_]),
+    count_(0),
+    guard_(std::make_shared<Guard>()),
+    procStatFd_(openProcFile("/proc/self/stat")),
+    systemStatFd_(openProcFile("/proc/stat")),
+    loadavgFd_(openProcFile("/proc/loadavg")),
+    meminfoFd_(openProcFile("/proc/meminfo"))
+{
+  for (int i = 0; i < capacity_; ++i)
+  {
+    slots_[i].seq.store(0, std::memory_order_relaxed);
+  }
+  MutexLockGuard lock(guard_->mutex);
+  guard_->sampler = this;
+}
+
+MetricsSampler::~MetricsSampler()
+{
+  {
+    MutexLockGuard lock(guard_->mutex);
+    guard_->sampler = NULL;
+    loop_->cancel(guard_->timer);
+  }
+  for (int fd : { procStatFd_, systemStatFd_, loadavgFd_, meminfoFd_ })
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+}
+
+void MetricsSampler::start()
+{
+  loop_->assertInLoopThread();
+  sample();
+  MutexLockGuard lock(guard_->mutex);
+  guard_->timer = loop_->runEvery(interval_, std::bind(&MetricsSampler::onTimer, guard_));
+}
+
+void MetricsSampler::onTimer(const std::shared_ptr<Guard>& guard)
+{
+  MutexLockGuard lock(guard->mutex);
+  if (guard->sampler)
+  {
+    guard->sampler->sample();
+  }
+}
+
+bool MetricsSampler::parseProcStat(StringPiece stat, Sample* out)
+{
+  // pid (comm) state ppid ..., comm may contain spaces and parentheses.
+  const char* rp = stat.end();
+  while (rp > stat.begin() && rp[-1] != ')')
+    --rp;
+  if (rp == stat.begin() || stat.end() - rp < 3)
+    return false;
+  const char* p = rp + 2;  // field 4, ppid
+  const char* end = stat.end();
+  int64_t fields[25];
+  for (int i = 4; i <= 24; ++i)
+  {
+    p = parseInt(p, end, &fields[i]);
+    if (p == NULL)
+      return false;
+  }
+  static const double hz = static_cast<double>(ProcessInfo::clockTicksPerSecond());
+  static const int64_t pageKb = ProcessInfo::pageSize() / 1024;
+  out->minorFaults = fields[10];
+  out->majorFaults = fields[12];
+  out->userSeconds = static_cast<double>(fields[14]) / hz;
+  out->systemSeconds = static_cast<double>(fields[15]) / hz;
+  out->threads = static_cast<int>(fields[20]);
+  out->virtualMemoryKb = fields[23] / 1024;
+  out->residentMemoryKb = fields[24] * pageKb;
+  return true;
+}
+
+bool MetricsSampler::parseSystemStat(StringPiece stat, Sample* out)
+{
+  // cpu  user nice system idle iowait irq softirq steal guest guest_nice
+  if (!stat.starts_with("cpu "))
+    return false;
+  const char* p = stat.data() + 4;
+  const char* end = stat.end();
+  int64_t ticks[8];
+  for (int i = 0; i < 8; ++i)
+  {
+    p = parseInt(p, end, &ticks[i]);
+    if (p == NULL)
+      return false;
+  }
+  int64_t total = 0;
+  for (int64_t t : ticks)
+    total += t;
+  out->cpuTotalTicks = total;
+  out->cpuBusyTicks = total - ticks[3] - ticks[4];
+  return true;
+}
+
+void MetricsSampler::sample()
+{
+  Sample s;
+  memZero(&s, sizeof s);
+  s.microSecondsSinceEpoch = Timestamp::now().microSecondsSinceEpoch();
+
+  char buf[1024];
+  ssize_t n = readProcFile(procStatFd_, buf, sizeof buf);
+  if (n > 0)
+  {
+    parseProcStat(StringPiece(buf, static_cast<int>(n)), &s);
+  }
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+    s.voluntaryContextSwitches = usage.ru_nvcsw;
+    s.involuntaryContextSwitches = usage.ru_nivcsw;
+  }
+
+  // only the first line, the aggregate of all cpus
+  n = readProcFile(systemStatFd_, buf, 256);
+  if (n > 0)
+  {
+    parseSystemStat(StringPiece(buf, static_cast<int>(n)), &s);
+  }
+  if (readProcFile(loadavgFd_, buf, 64) > 0)
+  {
+    s.loadavg1 = ::strtod(buf, NULL);
+  }
+  if (readProcFile(meminfoFd_, buf, 256) > 0)
+  {
+    s.memTotalKb = getKb(buf, "MemTotal:");
+    s.memAvailableKb = getKb(buf, "MemAvailable:");
+  }
+
+  // single writer, readers check seq before and after copying.
+  uint64_t index = count_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[index % capacity_];
+  slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot.sample, &s, sizeof s);
+  slot.seq.store(2 * index + 2, std::memory_order_release);
+  count_.store(index + 1, std::memory_order_release);
+}
+
+bool MetricsSampler::read(uint64_t index, Sample* out) const
+{
+  const Slot& slot = slots_[index % capacity_];
+  uint64_t seq = slot.seq.load(std::memory_order_acquire);
+  if (seq != 2 * index + 2)
+    return false;
+  memcpy(out, &slot.sample, sizeof *out);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool MetricsSampler::latest(Sample* out) const
+{
+  uint64_t count = count_.load(std::memory_order_acquire);
+  return count > 0 && read(count - 1, out);
+}
+
+std::vector<MetricsSampler::Sample> MetricsSampler::recent(int n) const
+{
+  std::vector<Sample> result;
+  uint64_t count = count_.load(std::memory_order_acquire);
+  uint64_t want = std::min<uint64_t>(count, static_cast<uint64_t>(std::max(std::min(n, capacity_), 0)));
+  result.reserve(want);
+  Sample s;
+  for (uint64_t i = count - want; i < count; ++i)
+  {
+    // overwritten meanwhile if false
+    if (read(i, &s))
+      result.push_back(s);
+  }
+  return result;
+}
+
+string MetricsSampler::toJson(int n) const
+{
+  std::vector<Sample> samples = recent(n);
+  string result;
+  result.reserve(256 + samples.size() * 15 * 12);
+  char buf[64];
+  snprintf(buf, sizeof buf, "{\"interval\":%g,\"count\":%zd", interval_, samples.size());
+  result += buf;
+  appendInts(&result, "time_ms", samples,
+             [](const Sample& s) { return s.microSecondsSinceEpoch / 1000; });
+  appendDoubles(&result, "user_seconds", samples,
+                [](const Sample& s) { return s.userSeconds; });
+  appendDoubles(&result, "system_seconds", samples,
+                [](const Sample& s) { return s.systemSeconds; });
+  appendInts(&result, "rss_kb", samples,
+             [](const Sample& s) { return s.residentMemoryKb; });
+  appendInts(&result, "vm_kb", samples,
+             [](const Sample& s) { return s.virtualMemoryKb; });
+  appendInts(&result, "threads", samples,
+             [](const Sample& s) { return static_cast<int64_t>(s.threads); });
+  appendInts(&result, "minor_faults", samples,
+             [](const Sample& s) { return s.minorFaults; });
+  appendInts(&result, "major_faults", samples,
+             [](const Sample& s) { return s.majorFaults; });
+  appendInts(&result, "voluntary_ctxsw", samples,
+             [](const Sample& s) { return s.voluntaryContextSwitches; });
+  appendInts(&result, "involuntary_ctxsw", samples,
+             [](const Sample& s) { return s.involuntaryContextSwitches; });
+  appendDoubles(&result, "loadavg1", samples,
+                [](const Sample& s) { return s.loadavg1; });
+  appendInts(&result, "cpu_busy_ticks", samples,
+             [](const Sample& s) { return s.cpuBusyTicks; });
+  appendInts(&result, "cpu_total_ticks", samples,
+             [](const Sample& s) { return s.cpuTotalTicks; });
+  appendInts(&result, "mem_total_kb", samples,
+             [](const Sample& s) { return s.memTotalKb; });
+  appendInts(&result, "mem_available_kb", samples,
+             [](const Sample& s) { return s.memAvailableKb; });
+  result += "}\n";
+  return result;
+}
+
+string MetricsSampler::toPrometheus() const
+{
+  std::vector<Sample> samples = recent(2);
+  if (samples.empty())
+    return string();
+  const Sample& s = samples.back();
+  string result;
+  result.reserve(1024);
+  appendMetric(&result, "process_cpu_seconds_total", "counter", "{mode=\"user\"}", s.userSeconds);
+  appendMetric(&result, "process_cpu_seconds_total", NULL, "{mode=\"system\"}", s.systemSeconds);
+  appendMetric(&result, "process_resident_memory_bytes", "gauge", "",
+               static_cast<double>(s.residentMemoryKb) * 1024);
+  appendMetric(&result, "process_virtual_memory_bytes", "gauge", "",
+               static_cast<double>(s.virtualMemoryKb) * 1024);
+  appendMetric(&result, "process_threads", "gauge", "", s.threads);
+  appendMetric(&result, "process_start_time_seconds", "gauge", "",
+               static_cast<double>(ProcessInfo::startTime().secondsSinceEpoch()));
+  appendMetric(&result, "process_page_faults_total", "counter", "{type=\"minor\"}",
+               static_cast<double>(s.minorFaults));
+  appendMetric(&result, "process_page_faults_total", NULL, "{type=\"major\"}",
+               static_cast<double>(s.majorFaults));
+  appendMetric(&result, "process_context_switches_total", "counter", "{type=\"voluntary\"}",
+               static_cast<double>(s.voluntaryContextSwitches));
+  appendMetric(&result, "process_context_switches_total", NULL, "{type=\"involuntary\"}",
+               static_cast<double>(s.involuntaryContextSwitches));
+  appendMetric(&result, "node_load1", "gauge", "", s.loadavg1);
+  if (samples.size() == 2 && s.cpuTotalTicks > samples[0].cpuTotalTicks)
+  {
+    appendMetric(&result, "node_cpu_busy_ratio", "gauge", "",
+                 static_cast<double>(s.cpuBusyTicks - samples[0].cpuBusyTicks) /
+                 static_cast<double>(s.cpuTotalTicks - samples[0].cpuTotalTicks));
+  }
+  appendMetric(&result, "node_memory_MemTotal_bytes", "gauge", "",
+               static_cast<double>(s.memTotalKb) * 1024);
+  appendMetric(&result, "node_memory_MemAvailable_bytes", "gauge", "",
+               static_cast<double>(s.memAvailableKb) * 1024);
+  return result;
+}
+
+void MetricsSampler::registerCommands(Inspector* ins)
+{
+  ins->add("metrics", "json",
+           [this](HttpRequest::Method, const Inspector::ArgList& args)
+           {
+             return toJson(args.empty() ? capacity_ : atoi(args[0].c_str()));
+           },
+           "sampled time series in JSON, /metrics/json/<count>");
+  ins->add("metrics", "prometheus",
+           [this](HttpRequest::Method, const Inspector::ArgList&)
+           {
+             return toPrometheus();
+           },
+           "latest sample in Prometheus text format");
+}
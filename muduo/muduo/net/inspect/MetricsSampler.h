@@ -0,0 +1,128 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_INSPECT_METRICSSAMPLER_H
+#define MUDUO_NET_INSPECT_METRICSSAMPLER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/TimerId.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class Inspector;
+
+///
+/// Samples process and system metrics from /proc at a fixed interval,
+/// keeps the recent ones in a ring.
+///
+/// The /proc files are kept open and parsed in place, no allocation per
+/// sample.  Readers in any thread copy samples out of the ring without
+/// locking, a sample being overwritten is detected by its sequence number
+/// and skipped.
+///
+class MetricsSampler : noncopyable
+{
+ public:
+  struct Sample
+  {
+    int64_t microSecondsSinceEpoch;
+    // this process
+    double userSeconds;
+    double systemSeconds;
+    int64_t virtualMemoryKb;
+    int64_t residentMemoryKb;
+    int64_t minorFaults;
+    int64_t majorFaults;
+    int64_t voluntaryContextSwitches;
+    int64_t involuntaryContextSwitches;
+    int threads;
+    // the system
+    double loadavg1;
+    int64_t cpuBusyTicks;   // all cpus
+    int64_t cpuTotalTicks;
+    int64_t memTotalKb;
+    int64_t memAvailableKb;
+  };
+
+  /// Samples in the loop every interval seconds, keeps at most capacity.
+  MetricsSampler(EventLoop* loop, double interval, int capacity);
+  /// In any thread, waits for a sample in progress.
+  ~MetricsSampler();
+
+  /// Must be called in loop thread.
+  void start();
+
+  /// Takes a sample now, must not be called concurrently with itself.
+  void sample();
+
+  /// Thread safe.  Returns false if no sample yet.
+  bool latest(Sample* out) const;
+  /// Thread safe.  At most n recent samples, oldest first.
+  std::vector<Sample> recent(int n) const;
+
+  double interval() const { return interval_; }
+  int capacity() const { return capacity_; }
+
+  /// Column per metric,
+  /// {"interval":1,"time":[...],"user_seconds":[...],...}
+  string toJson(int n) const;
+  /// The latest sample in Prometheus text exposition format.
+  string toPrometheus() const;
+
+  void registerCommands(Inspector* ins);
+
+  /// Parses /proc/[pid]/stat, returns false if malformed.
+  static bool parseProcStat(StringPiece stat, Sample* out);
+  /// Parses the "cpu" line of /proc/stat.
+  static bool parseSystemStat(StringPiece stat, Sample* out);
+
+ private:
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;  // 2*i+2 when it holds the i-th sample, odd while writing
+    Sample sample;
+  };
+
+  // shared with the timer callback, which may run after we are gone,
+  // as cancel() from other threads is queued in the loop.
+  struct Guard
+  {
+    MutexLock mutex;
+    MetricsSampler* sampler GUARDED_BY(mutex);
+    TimerId timer GUARDED_BY(mutex);
+  };
+
+  bool read(uint64_t index, Sample* out) const;
+  static void onTimer(const std::shared_ptr<Guard>& guard);
+
+  EventLoop* loop_;
+  const double interval_;
+  const int capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> count_;
+  std::shared_ptr<Guard> guard_;
+  int procStatFd_;
+  int systemStatFd_;
+  int loadavgFd_;
+  int meminfoFd_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_METRICSSAMPLER_H
@@ -9,7 +9,7 @@ int main()
 {
   EventLoop loop;
   EventLoopThread t;
-  Inspector ins(t.startLoop(), InetAddress(12345), "test");
+  Inspector ins(t.startLoop(), InetAddress(12345), "test", 1.0);
   loop.loop();
 }
 
@@ -0,0 +1,78 @@
+// Cost of one sample by MetricsSampler, vs. reading and parsing the /proc
+// files afresh the way the text pages of Inspector do, and cost of
+// rendering the time series.
+//
+// Usage: metricssampler_bench [iterations]
+
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/ProcessInfo.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/inspect/MetricsSampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+long getLong(const string& content, const char* key)
+{
+  size_t pos = content.find(key);
+  return pos != string::npos ? ::atol(content.c_str() + pos + strlen(key)) : 0;
+}
+
+// what ProcessInspector::overview and SystemInspector::overview read
+void naiveSample(MetricsSampler::Sample* s)
+{
+  string status = ProcessInfo::procStatus();
+  s->residentMemoryKb = getLong(status, "VmRSS:");
+  s->virtualMemoryKb = getLong(status, "VmSize:");
+  s->threads = static_cast<int>(getLong(status, "Threads:"));
+  s->voluntaryContextSwitches = getLong(status, "voluntary_ctxt_switches:");
+  ProcessInfo::CpuTime t = ProcessInfo::cpuTime();
+  s->userSeconds = t.userSeconds;
+  s->systemSeconds = t.systemSeconds;
+  string content;
+  FileUtil::readFile("/proc/stat", 65536, &content);
+  MetricsSampler::parseSystemStat(content, s);
+  FileUtil::readFile("/proc/loadavg", 65536, &content);
+  s->loadavg1 = ::strtod(content.c_str(), NULL);
+  FileUtil::readFile("/proc/meminfo", 65536, &content);
+  s->memTotalKb = getLong(content, "MemTotal:");
+  s->memAvailableKb = getLong(content, "MemAvailable:");
+}
+
+template<typename Func>
+void bench(const char* name, int iterations, Func func)
+{
+  double start = threadCpuSeconds();
+  for (int i = 0; i < iterations; ++i)
+    func();
+  double us = (threadCpuSeconds() - start) * 1e6 / iterations;
+  printf("%-22s %10.3f us %12.4f%% cpu at 1s interval\n", name, us, us / 1e4);
+}
+
+int main(int argc, char* argv[])
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+  EventLoop loop;
+  MetricsSampler sampler(&loop, 1.0, 600);
+  MetricsSampler::Sample s;
+
+  bench("naive", iterations, [&] { naiveSample(&s); });
+  bench("sampler", iterations, [&] { sampler.sample(); });
+  bench("latest", iterations * 100, [&] { sampler.latest(&s); });
+  string text;
+  bench("json 600 samples", iterations / 10, [&] { text = sampler.toJson(600); });
+  printf("%-22s %10zd bytes\n", "", text.size());
+  bench("prometheus", iterations, [&] { text = sampler.toPrometheus(); });
+  printf("%-22s %10zd bytes\n", "", text.size());
+}
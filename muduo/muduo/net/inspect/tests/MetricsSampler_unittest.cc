@@ -0,0 +1,125 @@
+#include "muduo/net/inspect/MetricsSampler.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <string.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+BOOST_AUTO_TEST_CASE(testParse)
+{
+  MetricsSampler::Sample s;
+  memZero(&s, sizeof s);
+  const char stat[] = "1234 (a (weird) name) S 1 1234 1234 0 -1 4194560 "
+                      "300 0 7 0 250 50 0 0 20 0 3 0 100 10485760 256 "
+                      "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0";
+  BOOST_REQUIRE(MetricsSampler::parseProcStat(stat, &s));
+  BOOST_CHECK_EQUAL(s.minorFaults, 300);
+  BOOST_CHECK_EQUAL(s.majorFaults, 7);
+  BOOST_CHECK_EQUAL(s.threads, 3);
+  BOOST_CHECK_EQUAL(s.virtualMemoryKb, 10240);
+  BOOST_CHECK_EQUAL(s.residentMemoryKb, 256 * (sysconf(_SC_PAGE_SIZE) / 1024));
+  BOOST_CHECK_CLOSE(s.userSeconds, 250.0 / static_cast<double>(sysconf(_SC_CLK_TCK)), 1e-9);
+  BOOST_CHECK(!MetricsSampler::parseProcStat("1234 (truncated) S 1 2", &s));
+
+  BOOST_REQUIRE(MetricsSampler::parseSystemStat("cpu  10 1 5 80 4 0 0 0 0 0\ncpu0 ...", &s));
+  BOOST_CHECK_EQUAL(s.cpuTotalTicks, 100);
+  BOOST_CHECK_EQUAL(s.cpuBusyTicks, 16);
+  BOOST_CHECK(!MetricsSampler::parseSystemStat("intr 1 2 3", &s));
+}
+
+BOOST_AUTO_TEST_CASE(testSample)
+{
+  EventLoop loop;
+  MetricsSampler sampler(&loop, 1.0, 4);
+  MetricsSampler::Sample s;
+  BOOST_CHECK(!sampler.latest(&s));
+  BOOST_CHECK(sampler.recent(10).empty());
+
+  sampler.sample();
+  BOOST_REQUIRE(sampler.latest(&s));
+  BOOST_CHECK(s.residentMemoryKb > 0);
+  BOOST_CHECK(s.threads >= 1);
+  BOOST_CHECK(s.cpuTotalTicks > 0);
+  BOOST_CHECK(s.memTotalKb >= s.memAvailableKb);
+
+  // burn some cpu, procfs must be read again, not cached by the open fd
+  double before = s.userSeconds + s.systemSeconds;
+  Timestamp start = Timestamp::now();
+  volatile int64_t x = 0;
+  while (timeDifference(Timestamp::now(), start) < 0.1)
+    for (int i = 0; i < 10000; ++i)
+      x = x + i;
+  for (int i = 0; i < 5; ++i)
+    sampler.sample();
+  BOOST_REQUIRE(sampler.latest(&s));
+  BOOST_CHECK(s.userSeconds + s.systemSeconds > before);
+
+  std::vector<MetricsSampler::Sample> samples = sampler.recent(10);
+  BOOST_CHECK_EQUAL(samples.size(), 4);
+  for (size_t i = 1; i < samples.size(); ++i)
+    BOOST_CHECK(samples[i].microSecondsSinceEpoch >= samples[i-1].microSecondsSinceEpoch);
+  BOOST_CHECK_EQUAL(sampler.recent(2).size(), 2);
+
+  string json = sampler.toJson(3);
+  BOOST_CHECK(json.find("{\"interval\":1,\"count\":3,\"time_ms\":[") == 0);
+  BOOST_CHECK(json.find("\"rss_kb\":[") != string::npos);
+  string prom = sampler.toPrometheus();
+  BOOST_CHECK(prom.find("# TYPE process_cpu_seconds_total counter\n") != string::npos);
+  BOOST_CHECK(prom.find("process_threads 1\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testConcurrentReaders)
+{
+  EventLoop loop;
+  MetricsSampler sampler(&loop, 1.0, 8);
+  std::atomic<bool> done(false);
+  std::atomic<int> bad(0);
+  Thread reader([&]
+  {
+    MetricsSampler::Sample s;
+    while (!done)
+    {
+      for (const auto& sample : sampler.recent(8))
+      {
+        // every field of a sample comes from the same write
+        if (sample.memTotalKb == 0 || sample.cpuTotalTicks == 0)
+          ++bad;
+      }
+      if (sampler.latest(&s) && s.threads == 0)
+        ++bad;
+    }
+  });
+  reader.start();
+  for (int i = 0; i < 2000; ++i)
+    sampler.sample();
+  done = true;
+  reader.join();
+  BOOST_CHECK_EQUAL(bad.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testDestroyInOtherThread)
+{
+  EventLoopThread thread;
+  EventLoop* loop = thread.startLoop();
+  for (int i = 0; i < 20; ++i)
+  {
+    std::unique_ptr<MetricsSampler> sampler(new MetricsSampler(loop, 0.0001, 4));
+    CountDownLatch started(1);
+    loop->runInLoop([&] { sampler->start(); started.countDown(); });
+    started.wait();
+    usleep(2000);
+    // the timer may fire while or after we are destroyed
+    sampler.reset();
+  }
+  usleep(10000);
+}
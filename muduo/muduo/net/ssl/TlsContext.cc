@@ -0,0 +1,202 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/ssl/TlsContext.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/ssl/TlsFilter.h"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+TlsContext::TlsContext(Mode mode)
+  : mode_(mode),
+    ctx_(SSL_CTX_new(mode == kServer ? TLS_server_method() : TLS_client_method())),
+    resumption_(true)
+{
+  if (ctx_ == NULL)
+  {
+    logErrors("TlsContext::TlsContext");
+    LOG_FATAL << "SSL_CTX_new";
+  }
+  SSL_CTX_set_app_data(ctx_, this);
+  SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+  // peers often close without close_notify
+  SSL_CTX_set_options(ctx_, SSL_OP_IGNORE_UNEXPECTED_EOF);
+  // idle connections keep no record buffers
+  SSL_CTX_set_mode(ctx_, SSL_MODE_RELEASE_BUFFERS);
+  // a read(2) for many records, instead of two for each
+  SSL_CTX_set_read_ahead(ctx_, 1);
+  setKernelTls(true);
+  setSessionResumption(true);
+  if (mode == kClient)
+  {
+    if (SSL_CTX_set_default_verify_paths(ctx_) != 1)
+    {
+      logErrors("TlsContext::TlsContext");
+    }
+    setVerifyPeer(true);
+  }
+}
+
+TlsContext::~TlsContext()
+{
+  MutexLockGuard lock(mutex_);
+  for (auto& item : sessions_)
+  {
+    SSL_SESSION_free(item.second);
+  }
+  SSL_CTX_free(ctx_);
+}
+
+bool TlsContext::useCertificate(const string& certFile, const string& keyFile)
+{
+  if (SSL_CTX_use_certificate_chain_file(ctx_, certFile.c_str()) != 1
+      || SSL_CTX_use_PrivateKey_file(ctx_, keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+      || SSL_CTX_check_private_key(ctx_) != 1)
+  {
+    logErrors("TlsContext::useCertificate");
+    return false;
+  }
+  return true;
+}
+
+bool TlsContext::useSelfSignedCertificate(const string& commonName)
+{
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  bool ok = key && cert
+      && X509_set_version(cert, 2)
+      && ASN1_INTEGER_set(X509_get_serialNumber(cert), 1)
+      && X509_gmtime_adj(X509_getm_notBefore(cert), 0)
+      && X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600)
+      && X509_set_pubkey(cert, key);
+  if (ok)
+  {
+    X509_NAME* name = X509_get_subject_name(cert);
+    ok = X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                    reinterpret_cast<const unsigned char*>(commonName.c_str()),
+                                    -1, -1, 0)
+        && X509_set_issuer_name(cert, name)
+        && X509_sign(cert, key, EVP_sha256()) > 0
+        && SSL_CTX_use_certificate(ctx_, cert) == 1
+        && SSL_CTX_use_PrivateKey(ctx_, key) == 1;
+  }
+  if (!ok)
+  {
+    logErrors("TlsContext::useSelfSignedCertificate");
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ok;
+}
+
+bool TlsContext::verifyPeer(const string& caFile)
+{
+  int ret = caFile.empty() ? SSL_CTX_set_default_verify_paths(ctx_)
+                           : SSL_CTX_load_verify_locations(ctx_, caFile.c_str(), NULL);
+  if (ret != 1)
+  {
+    logErrors("TlsContext::verifyPeer");
+    return false;
+  }
+  SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, NULL);
+  return true;
+}
+
+void TlsContext::setVerifyPeer(bool on)
+{
+  SSL_CTX_set_verify(ctx_, on ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+}
+
+void TlsContext::setSessionResumption(bool on)
+{
+  resumption_ = on;
+  if (mode_ == kServer)
+  {
+    static const unsigned char kContext[] = "muduo";
+    SSL_CTX_set_session_id_context(ctx_, kContext, sizeof kContext - 1);
+    SSL_CTX_set_session_cache_mode(ctx_, on ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+    if (on)
+    {
+      SSL_CTX_clear_options(ctx_, SSL_OP_NO_TICKET);
+      SSL_CTX_set_num_tickets(ctx_, 2);
+    }
+    else
+    {
+      SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+      SSL_CTX_set_num_tickets(ctx_, 0);
+    }
+  }
+  else
+  {
+    // sessions_ instead of the internal cache, which is keyed by session id
+    SSL_CTX_set_session_cache_mode(ctx_, on ? SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE
+                                            : SSL_SESS_CACHE_OFF);
+    SSL_CTX_sess_set_new_cb(ctx_, on ? &TlsContext::onNewSession : NULL);
+  }
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  if (on)
+    SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+  else
+    SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS);
+#endif
+}
+
+ConnectionFilterFactory TlsContext::filterFactory(const string& serverName)
+{
+  TlsContextPtr self(shared_from_this());
+  return [self, serverName](int sockfd, const InetAddress& peerAddr)
+  {
+    return std::unique_ptr<ConnectionFilter>(new TlsFilter(self, sockfd, serverName, peerAddr));
+  };
+}
+
+void TlsContext::resumeSession(SSL* ssl, const string& key)
+{
+  if (!resumption_)
+    return;
+  MutexLockGuard lock(mutex_);
+  std::map<string, SSL_SESSION*>::iterator it = sessions_.find(key);
+  if (it != sessions_.end())
+  {
+    SSL_set_session(ssl, it->second);
+  }
+}
+
+// takes the session if returns 1
+int TlsContext::onNewSession(SSL* ssl, SSL_SESSION* session)
+{
+  TlsFilter* filter = static_cast<TlsFilter*>(SSL_get_app_data(ssl));
+  TlsContext* context = static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  MutexLockGuard lock(context->mutex_);
+  SSL_SESSION*& saved = context->sessions_[filter->sessionKey()];
+  if (saved)
+  {
+    SSL_SESSION_free(saved);
+  }
+  saved = session;
+  return 1;
+}
+
+void TlsContext::logErrors(const char* where)
+{
+  unsigned long err = 0;
+  while ((err = ERR_get_error()) != 0)
+  {
+    char buf[256];
+    ERR_error_string_n(err, buf, sizeof buf);
+    LOG_ERROR << where << " - " << buf;
+  }
+}
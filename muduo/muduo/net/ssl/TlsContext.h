@@ -0,0 +1,91 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SSL_TLSCONTEXT_H
+#define MUDUO_NET_SSL_TLSCONTEXT_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Callbacks.h"
+
+#include <map>
+#include <memory>
+
+struct ssl_ctx_st;
+struct ssl_session_st;
+struct ssl_st;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Settings shared by TLS connections, a wrapper of SSL_CTX.
+///
+/// Set it up first, then hand filterFactory() to TcpServer or TcpClient,
+/// which creates a TlsFilter for each connection.  Thread safe after
+/// being set up.
+///
+/// Sessions are resumed, by TLS 1.3 tickets or the session cache of
+/// server.  The client keeps the latest session of each server.
+///
+/// kTLS is tried when the handshake is done, if the kernel takes it,
+/// the kernel encrypts and TcpConnection::sendFile() stays zero copy.
+///
+class TlsContext : noncopyable,
+                   public std::enable_shared_from_this<TlsContext>
+{
+ public:
+  enum Mode { kServer, kClient };
+
+  explicit TlsContext(Mode mode);
+  ~TlsContext();
+
+  Mode mode() const { return mode_; }
+
+  /// PEM files.  Returns false on error, which is logged.
+  bool useCertificate(const string& certFile, const string& keyFile);
+  /// Generates a key and a self-signed certificate, for tests and benchmarks.
+  bool useSelfSignedCertificate(const string& commonName);
+  /// Verifies peer certificate with CA file, or the default CA paths if empty.
+  bool verifyPeer(const string& caFile);
+  /// Clients verify the server with the default CA paths, and its name
+  /// given to filterFactory(), or its IP address without a name, unless
+  /// turned off, e.g. for self-signed certificates in tests.
+  void setVerifyPeer(bool on);
+
+  /// Default true.
+  void setSessionResumption(bool on);
+  /// Default true.
+  void setKernelTls(bool on);
+
+  /// serverName is sent with SNI by client, checked against the server
+  /// certificate, and is a part of the key of its session cache.
+  ConnectionFilterFactory filterFactory(const string& serverName = string());
+
+  struct ssl_ctx_st* nativeHandle() { return ctx_; }
+
+ private:
+  friend class TlsFilter;
+  void resumeSession(struct ssl_st* ssl, const string& key);
+  static int onNewSession(struct ssl_st* ssl, struct ssl_session_st* session);
+  static void logErrors(const char* where);
+
+  const Mode mode_;
+  struct ssl_ctx_st* ctx_;
+  bool resumption_;
+  MutexLock mutex_;
+  std::map<string, struct ssl_session_st*> sessions_ GUARDED_BY(mutex_);
+};
+
+typedef std::shared_ptr<TlsContext> TlsContextPtr;
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SSL_TLSCONTEXT_H
@@ -0,0 +1,236 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/ssl/TlsFilter.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+
+#include <errno.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// A sink BIO which appends to the Buffer in its data.
+
+int bufferWrite(BIO* bio, const char* data, int len)
+{
+  Buffer* buf = static_cast<Buffer*>(BIO_get_data(bio));
+  buf->append(data, static_cast<size_t>(len));
+  return len;
+}
+
+long bufferCtrl(BIO* bio, int cmd, long num, void* ptr)
+{
+  return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+int bufferCreate(BIO* bio)
+{
+  BIO_set_init(bio, 1);
+  return 1;
+}
+
+BIO_METHOD* bufferMethod()
+{
+  static BIO_METHOD* method = []
+  {
+    BIO_METHOD* m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "muduo Buffer");
+    BIO_meth_set_write(m, bufferWrite);
+    BIO_meth_set_ctrl(m, bufferCtrl);
+    BIO_meth_set_create(m, bufferCreate);
+    return m;
+  }();
+  return method;
+}
+
+const size_t kMaxRecord = 16 * 1024;
+
+}  // namespace
+
+TlsFilter::TlsFilter(const TlsContextPtr& context, int sockfd,
+                     const string& serverName, const InetAddress& peerAddr)
+  : context_(context),
+    ssl_(SSL_new(context->nativeHandle())),
+    bufferBio_(NULL),
+    kernelSend_(false),
+    spill_(0)
+{
+  if (ssl_ == NULL)
+  {
+    TlsContext::logErrors("TlsFilter::TlsFilter");
+    LOG_FATAL << "SSL_new";
+  }
+  SSL_set_app_data(ssl_, this);
+  // a socket BIO which leaves sockfd open
+  SSL_set_fd(ssl_, sockfd);
+  if (context_->mode() == TlsContext::kClient)
+  {
+    SSL_set_connect_state(ssl_);
+    if (!serverName.empty())
+    {
+      // SSL_set_tlsext_host_name(), without its C cast
+      SSL_ctrl(ssl_, SSL_CTRL_SET_TLSEXT_HOSTNAME, TLSEXT_NAMETYPE_host_name,
+               const_cast<char*>(serverName.c_str()));
+      SSL_set1_host(ssl_, serverName.c_str());
+    }
+    else
+    {
+      // without a name, the certificate must be issued to the address
+      X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl_), peerAddr.toIp().c_str());
+    }
+    sessionKey_ = serverName + "/" + peerAddr.toIpPort();
+    context_->resumeSession(ssl_, sessionKey_);
+  }
+  else
+  {
+    SSL_set_accept_state(ssl_);
+  }
+}
+
+TlsFilter::~TlsFilter()
+{
+  // SSL_free() drops the session unless both sides have shut down, but
+  // EOF without close_notify is common, see SSL_OP_IGNORE_UNEXPECTED_EOF.
+  // Fatal errors have dropped it already.
+  SSL_set_shutdown(ssl_, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  SSL_free(ssl_);
+}
+
+ConnectionFilter::Result TlsFilter::handshake()
+{
+  ERR_clear_error();
+  int ret = SSL_do_handshake(ssl_);
+  if (ret == 1)
+  {
+    kernelSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+    if (!kernelSend_)
+    {
+      // records go to Buffer from now on
+      bufferBio_ = BIO_new(bufferMethod());
+      BIO_set_data(bufferBio_, &spill_);
+      SSL_set0_wbio(ssl_, bufferBio_);
+    }
+    LOG_DEBUG << "TlsFilter::handshake " << description()
+              << (resumed() ? " resumed" : "")
+              << (kernelSend_ ? " kTLS" : "");
+    return kDone;
+  }
+  switch (SSL_get_error(ssl_, ret))
+  {
+    case SSL_ERROR_WANT_READ:
+      return kWantRead;
+    case SSL_ERROR_WANT_WRITE:
+      return kWantWrite;
+    default:
+      TlsContext::logErrors("TlsFilter::handshake");
+      return kError;
+  }
+}
+
+ssize_t TlsFilter::read(Buffer* buf)
+{
+  // drains OpenSSL, epoll won't tell about records it has read ahead
+  ssize_t total = 0;
+  for (;;)
+  {
+    buf->ensureWritableBytes(kMaxRecord);
+    int len = static_cast<int>(std::min(buf->writableBytes(), size_t(1) << 30));
+    ERR_clear_error();
+    int n = SSL_read(ssl_, buf->beginWrite(), len);
+    if (n > 0)
+    {
+      buf->hasWritten(n);
+      total += n;
+      continue;
+    }
+    int err = SSL_get_error(ssl_, n);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    {
+      if (total > 0)
+        return total;
+      errno = EAGAIN;
+      return -1;
+    }
+    else if (err == SSL_ERROR_ZERO_RETURN)
+    {
+      // close_notify, or EOF
+      return total;
+    }
+    else
+    {
+      int savedErrno = errno;
+      TlsContext::logErrors("TlsFilter::read");
+      if (total > 0)
+        return total;
+      errno = (err == SSL_ERROR_SYSCALL && savedErrno != 0) ? savedErrno : EPROTO;
+      return -1;
+    }
+  }
+}
+
+void TlsFilter::encode(const void* data, size_t len, Buffer* out)
+{
+  assert(bufferBio_ != NULL);
+  if (spill_.readableBytes() > 0)
+  {
+    out->append(spill_.peek(), spill_.readableBytes());
+    spill_.retrieveAll();
+  }
+  BIO_set_data(bufferBio_, out);
+  const char* p = static_cast<const char*>(data);
+  while (len > 0)
+  {
+    int n = SSL_write(ssl_, p, static_cast<int>(std::min(len, size_t(1) << 30)));
+    if (n <= 0)
+    {
+      TlsContext::logErrors("TlsFilter::encode");
+      break;
+    }
+    p += n;
+    len -= static_cast<size_t>(n);
+  }
+  BIO_set_data(bufferBio_, &spill_);
+}
+
+void TlsFilter::shutdown(Buffer* out)
+{
+  ERR_clear_error();
+  if (kernelSend_)
+  {
+    // the alert goes to the socket
+    SSL_shutdown(ssl_);
+    return;
+  }
+  BIO_set_data(bufferBio_, out);
+  SSL_shutdown(ssl_);
+  BIO_set_data(bufferBio_, &spill_);
+}
+
+bool TlsFilter::resumed() const
+{
+  return SSL_session_reused(ssl_) == 1;
+}
+
+string TlsFilter::description() const
+{
+  string result = SSL_get_version(ssl_);
+  result += ' ';
+  result += SSL_get_cipher_name(ssl_);
+  return result;
+}
+
+TlsFilter* TlsFilter::of(const TcpConnectionPtr& conn)
+{
+  return dynamic_cast<TlsFilter*>(conn->filter());
+}
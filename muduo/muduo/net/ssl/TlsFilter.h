@@ -0,0 +1,69 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_SSL_TLSFILTER_H
+#define MUDUO_NET_SSL_TLSFILTER_H
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/ConnectionFilter.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/ssl/TlsContext.h"
+
+struct bio_st;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// TLS of one TcpConnection, created by TlsContext::filterFactory().
+///
+/// OpenSSL reads and handshakes on the socket directly.  Afterwards, if
+/// the kernel took the keys (kTLS), writes go to the socket as is.
+/// Otherwise records are written into the output Buffer of TcpConnection,
+/// which batches them in one write(2).
+///
+class TlsFilter : public ConnectionFilter
+{
+ public:
+  /// serverName and peerAddr are for client.
+  TlsFilter(const TlsContextPtr& context, int sockfd,
+            const string& serverName, const InetAddress& peerAddr);
+  ~TlsFilter() override;
+
+  Result handshake() override;
+  ssize_t read(Buffer* buf) override;
+  void encode(const void* data, size_t len, Buffer* out) override;
+  void shutdown(Buffer* out) override;
+  bool passThrough() const override { return kernelSend_; }
+
+  /// After handshake.
+  bool resumed() const;
+  bool kernelTls() const { return kernelSend_; }
+  /// e.g. "TLSv1.3 TLS_AES_256_GCM_SHA384"
+  string description() const;
+  const string& sessionKey() const { return sessionKey_; }
+
+  /// TLS of conn, NULL if it has none.
+  static TlsFilter* of(const TcpConnectionPtr& conn);
+
+  struct ssl_st* nativeHandle() { return ssl_; }
+
+ private:
+  TlsContextPtr context_;
+  struct ssl_st* ssl_;
+  struct bio_st* bufferBio_;  // writes into a Buffer, after handshake
+  string sessionKey_;  // of client
+  bool kernelSend_;
+  Buffer spill_;  // written by SSL_read(), e.g. KeyUpdate
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_SSL_TLSFILTER_H
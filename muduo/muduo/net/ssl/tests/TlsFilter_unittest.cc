@@ -0,0 +1,278 @@
+#include "muduo/net/ssl/TlsContext.h"
+#include "muduo/net/ssl/TlsFilter.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// "file" sends a header, a file and a trailer then shuts down,
+// anything else is echoed.
+class Server : noncopyable
+{
+ public:
+  explicit Server(const string& filePath)
+    : loop_(thread_.startLoop()),
+      context_(new TlsContext(TlsContext::kServer)),
+      filePath_(filePath),
+      up_(0)
+  {
+    BOOST_REQUIRE(context_->useSelfSignedCertificate("localhost"));
+    int probe = sockets::createNonblockingOrDie(AF_INET);
+    sockets::bindOrDie(probe, InetAddress(0, true).getSockAddr());
+    addr_ = InetAddress("127.0.0.1", InetAddress(sockets::getLocalAddr(probe)).port());
+    sockets::close(probe);
+    loop_->runInLoop([this]
+    {
+      server_.reset(new TcpServer(loop_, addr_, "TlsServer"));
+      server_->setConnectionFilterFactory(context_->filterFactory());
+      server_->setConnectionCallback([this](const TcpConnectionPtr& conn)
+      {
+        if (conn->connected())
+          ++up_;
+      });
+      server_->setMessageCallback(std::bind(&Server::onMessage, this, _1, _2));
+      server_->start();
+    });
+    usleep(10 * 1000);
+  }
+
+  ~Server()
+  {
+    loop_->runInLoop([this] { server_.reset(); });
+    usleep(10 * 1000);
+  }
+
+  const InetAddress& address() const { return addr_; }
+  const TlsContextPtr& context() const { return context_; }
+  int up() const { return up_; }
+
+ private:
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+  {
+    if (buf->readableBytes() == 4 && memcmp(buf->peek(), "file", 4) == 0)
+    {
+      buf->retrieveAll();
+      int fd = ::open(filePath_.c_str(), O_RDONLY);
+      std::shared_ptr<int> owner(new int(fd), [](int* p) { ::close(*p); delete p; });
+      conn->send("header\n");
+      conn->sendFile(fd, 0, static_cast<size_t>(::lseek(fd, 0, SEEK_END)), owner);
+      conn->send("trailer\n");
+      conn->shutdown();
+    }
+    else
+    {
+      conn->send(buf);
+    }
+  }
+
+  EventLoopThread thread_;
+  EventLoop* loop_;
+  TlsContextPtr context_;
+  const string filePath_;
+  InetAddress addr_;
+  std::unique_ptr<TcpServer> server_;
+  std::atomic<int> up_;
+};
+
+// Connects, sends request, collects until the peer closes or
+// expected bytes are received.
+struct Result
+{
+  Result() : connected(false), resumed(false), closed(false) { }
+  bool connected;
+  bool resumed;
+  bool closed;
+  string description;
+  string received;
+};
+
+Result exchange(const InetAddress& addr, const TlsContextPtr& context,
+                const string& request, size_t expected)
+{
+  Result result;
+  EventLoop loop;
+  TcpClient client(&loop, addr, "TlsClient");
+  if (context)
+    client.setConnectionFilterFactory(context->filterFactory("localhost"));
+  client.setConnectionCallback([&](const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      result.connected = true;
+      TlsFilter* tls = TlsFilter::of(conn);
+      if (tls)
+      {
+        result.resumed = tls->resumed();
+        result.description = tls->description();
+      }
+      conn->send(request);
+    }
+    else
+    {
+      result.closed = true;
+      loop.quit();
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    result.received += buf->retrieveAllAsString();
+    if (expected > 0 && result.received.size() >= expected)
+    {
+      // lets the session ticket in
+      loop.runAfter(0.01, [&] { loop.quit(); });
+    }
+  });
+  client.connect();
+  loop.runAfter(5.0, [&] { loop.quit(); });
+  loop.loop();
+  client.disconnect();
+  return result;
+}
+
+// the server is self-signed
+TlsContextPtr newClientContext()
+{
+  TlsContextPtr context(new TlsContext(TlsContext::kClient));
+  context->setVerifyPeer(false);
+  return context;
+}
+
+// Returns whether the handshake with the server succeeds.
+bool handshakes(const InetAddress& addr, const TlsContextPtr& context,
+                const string& serverName)
+{
+  EventLoop loop;
+  TcpClient client(&loop, addr, "TlsClient");
+  client.setConnectionFilterFactory(context->filterFactory(serverName));
+  bool connected = false;
+  client.setConnectionCallback([&](const TcpConnectionPtr& conn)
+  {
+    connected = connected || conn->connected();
+  });
+  client.connect();
+  loop.runAfter(0.5, [&] { loop.quit(); });
+  loop.loop();
+  client.disconnect();
+  return connected;
+}
+
+string makeContent(size_t size)
+{
+  string content(size, '\0');
+  for (size_t i = 0; i < size; ++i)
+    content[i] = static_cast<char>('a' + (i * 7 + i / 1000) % 26);
+  return content;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testEchoAndResumption)
+{
+  Server server("");
+  TlsContextPtr client(newClientContext());
+
+  string small("hello, world\n");
+  Result first = exchange(server.address(), client, small, small.size());
+  BOOST_CHECK(first.connected);
+  BOOST_CHECK(!first.resumed);
+  BOOST_CHECK_EQUAL(first.received, small);
+  BOOST_CHECK_EQUAL(first.description.substr(0, 7), "TLSv1.3");
+
+  // many records
+  string large(makeContent(3 * 1000 * 1000));
+  Result second = exchange(server.address(), client, large, large.size());
+  BOOST_CHECK(second.resumed);
+  BOOST_CHECK(second.received == large);
+  BOOST_CHECK_EQUAL(server.up(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(testNoResumption)
+{
+  Server server("");
+  TlsContextPtr client(newClientContext());
+  client->setSessionResumption(false);
+  exchange(server.address(), client, "a", 1);
+  Result second = exchange(server.address(), client, "b", 1);
+  BOOST_CHECK(!second.resumed);
+  BOOST_CHECK_EQUAL(second.received, "b");
+}
+
+BOOST_AUTO_TEST_CASE(testSendFileAndCloseNotify)
+{
+  char path[] = "/tmp/tlsfilter_XXXXXX";
+  int fd = ::mkstemp(path);
+  string content(makeContent(1000 * 1000));
+  BOOST_REQUIRE_EQUAL(::write(fd, content.data(), content.size()),
+                      static_cast<ssize_t>(content.size()));
+  ::close(fd);
+
+  {
+    Server server(path);
+    TlsContextPtr client(newClientContext());
+    Result result = exchange(server.address(), client, "file", 0);
+    BOOST_CHECK(result.closed);
+    BOOST_CHECK(result.received == "header\n" + content + "trailer\n");
+  }
+  ::unlink(path);
+}
+
+BOOST_AUTO_TEST_CASE(testPlainClient)
+{
+  Server server("");
+  // not a ClientHello
+  Result result = exchange(server.address(), TlsContextPtr(), "GET / HTTP/1.0\r\n\r\n", 0);
+  BOOST_CHECK(result.connected);
+  BOOST_CHECK(result.closed);
+  BOOST_CHECK_EQUAL(server.up(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testVerifyByDefault)
+{
+  Server server("");
+  TlsContextPtr client(new TlsContext(TlsContext::kClient));
+  BOOST_CHECK(!handshakes(server.address(), client, "localhost"));
+  BOOST_CHECK_EQUAL(server.up(), 0);
+}
+
+// the certificate of the server is trusted, but only for "localhost"
+BOOST_AUTO_TEST_CASE(testVerifyName)
+{
+  Server server("");
+  char caFile[] = "/tmp/tlsfilter_unittest_XXXXXX";
+  int fd = ::mkstemp(caFile);
+  BOOST_REQUIRE(fd >= 0);
+  FILE* fp = ::fdopen(fd, "w");
+  BOOST_REQUIRE(PEM_write_X509(fp, SSL_CTX_get0_certificate(server.context()->nativeHandle())));
+  ::fclose(fp);
+
+  TlsContextPtr client(new TlsContext(TlsContext::kClient));
+  BOOST_REQUIRE(client->verifyPeer(caFile));
+  ::unlink(caFile);
+  BOOST_CHECK(handshakes(server.address(), client, "localhost"));
+  BOOST_CHECK(!handshakes(server.address(), client, "example.com"));
+  // without a name, 127.0.0.1 isn't in the certificate
+  BOOST_CHECK(!handshakes(server.address(), client, ""));
+  BOOST_CHECK_EQUAL(server.up(), 1);
+}
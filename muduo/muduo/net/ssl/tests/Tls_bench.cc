@@ -0,0 +1,177 @@
+// TLS over loopback vs. plain TCP: handshakes/s, full and resumed, and
+// throughput of large and small sends.  Reports whether kTLS was used.
+//
+// Usage: tls_bench [handshakes] [megabytes]
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+#include "muduo/net/ssl/TlsContext.h"
+#include "muduo/net/ssl/TlsFilter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Request "<size> <count>\n", replies count messages of size bytes,
+// each by a send().
+class Server : noncopyable
+{
+ public:
+  Server(const InetAddress& addr, const TlsContextPtr& context)
+    : loop_(thread_.startLoop())
+  {
+    loop_->runInLoop([this, addr, context]
+    {
+      server_.reset(new TcpServer(loop_, addr, "TlsBench"));
+      if (context)
+        server_->setConnectionFilterFactory(context->filterFactory());
+      server_->setMessageCallback(std::bind(&Server::onMessage, this, _1, _2));
+      server_->start();
+    });
+    usleep(10 * 1000);
+  }
+
+  ~Server()
+  {
+    loop_->runInLoop([this] { server_.reset(); });
+    usleep(10 * 1000);
+  }
+
+ private:
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+  {
+    const char* crlf = buf->findEOL();
+    if (crlf == NULL)
+      return;
+    size_t size = 0, count = 0;
+    sscanf(buf->peek(), "%zu %zu", &size, &count);
+    buf->retrieveUntil(crlf + 1);
+    string message(size, 'x');
+    for (size_t i = 0; i < count; ++i)
+    {
+      conn->send(message);
+    }
+  }
+
+  EventLoopThread thread_;
+  EventLoop* loop_;
+  std::unique_ptr<TcpServer> server_;
+};
+
+struct Stats
+{
+  Stats() : resumed(0), kernelTls(false) { }
+  int resumed;
+  bool kernelTls;
+};
+
+// One connection, which sends request, waits for expected bytes, then
+// for the connection going down.
+void exchange(EventLoop* loop, const InetAddress& addr, const TlsContextPtr& context,
+              const string& request, size_t expected, Stats* stats)
+{
+  TcpClient client(loop, addr, "TlsBenchClient");
+  if (context)
+    client.setConnectionFilterFactory(context->filterFactory("localhost"));
+  size_t received = 0;
+  client.setConnectionCallback([&](const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      TlsFilter* tls = TlsFilter::of(conn);
+      if (tls)
+      {
+        stats->resumed += tls->resumed();
+        stats->kernelTls = tls->kernelTls();
+      }
+      conn->send(request);
+    }
+    else
+    {
+      loop->quit();
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+  {
+    received += buf->readableBytes();
+    buf->retrieveAll();
+    if (received >= expected)
+      conn->shutdown();
+  });
+  client.connect();
+  loop->loop();
+}
+
+void benchHandshakes(const char* name, const InetAddress& addr,
+                     const TlsContextPtr& context, int n)
+{
+  EventLoop loop;
+  Stats stats;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    exchange(&loop, addr, context, "1 1\n", 1, &stats);
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-20s %8.0f connections/s  %d resumed\n",
+         name, n / seconds, stats.resumed);
+}
+
+void benchThroughput(const char* name, const InetAddress& addr,
+                     const TlsContextPtr& context, size_t size, size_t total)
+{
+  EventLoop loop;
+  Stats stats;
+  size_t count = total / size;
+  char request[64];
+  snprintf(request, sizeof request, "%zu %zu\n", size, count);
+  Timestamp start(Timestamp::now());
+  exchange(&loop, addr, context, request, size * count, &stats);
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-20s %6zu bytes/send %8.1f MiB/s%s\n",
+         name, size, static_cast<double>(size * count) / seconds / 1024 / 1024,
+         stats.kernelTls ? "  kTLS" : "");
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  int handshakes = argc > 1 ? atoi(argv[1]) : 500;
+  size_t megabytes = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 64;
+
+  TlsContextPtr serverContext(new TlsContext(TlsContext::kServer));
+  if (!serverContext->useSelfSignedCertificate("localhost"))
+    return 1;
+  TlsContextPtr resuming(new TlsContext(TlsContext::kClient));
+  TlsContextPtr full(new TlsContext(TlsContext::kClient));
+  full->setSessionResumption(false);
+  // self-signed
+  resuming->setVerifyPeer(false);
+  full->setVerifyPeer(false);
+
+  InetAddress plainAddr("127.0.0.1", 20443);
+  InetAddress tlsAddr("127.0.0.1", 20444);
+  Server plain(plainAddr, TlsContextPtr());
+  Server tls(tlsAddr, serverContext);
+
+  benchHandshakes("plain", plainAddr, TlsContextPtr(), handshakes);
+  benchHandshakes("tls full", tlsAddr, full, handshakes);
+  benchHandshakes("tls resumed", tlsAddr, resuming, handshakes);
+
+  size_t total = megabytes * 1024 * 1024;
+  const size_t sizes[] = { 64 * 1024, 1024, 64 };
+  for (size_t size : sizes)
+  {
+    // small sends in one callback are encoded into a few large records
+    size_t bytes = size < 1024 ? total / 8 : total;
+    benchThroughput("plain", plainAddr, TlsContextPtr(), size, bytes);
+    benchThroughput("tls", tlsAddr, resuming, size, bytes);
+  }
+}
@@ -0,0 +1,262 @@
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/DnsResolver.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/UdpServer.h"
+
+#include <map>
+#include <set>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// A stub name server, answers A queries from a table.
+class StubServer
+{
+ public:
+  struct Record
+  {
+    std::vector<string> ips;  // empty for NXDOMAIN
+    uint32_t ttl;
+    bool drop;  // doesn't answer
+  };
+
+  explicit StubServer(EventLoop* loop)
+    : server_(loop, InetAddress(0, true), "StubDns")
+  {
+    server_.setMessageCallback(
+        std::bind(&StubServer::onMessage, this, _1, _2, _3));
+    server_.start();
+  }
+
+  InetAddress address() const
+  {
+    struct sockaddr_in6 addr;
+    socklen_t len = static_cast<socklen_t>(sizeof addr);
+    ::getsockname(server_.sockets()[0]->fd(), sockets::sockaddr_cast(&addr), &len);
+    return InetAddress(addr);
+  }
+
+  void add(const string& name, const std::vector<string>& ips, uint32_t ttl, bool drop = false)
+  {
+    Record r = { ips, ttl, drop };
+    records_[name] = r;
+  }
+
+  int queries() { return queries_.get(); }
+  // distinct source ports of queries
+  size_t ports() { MutexLockGuard lock(mutex_); return ports_.size(); }
+
+ private:
+  void onMessage(UdpSocket* sock, const StringPiece& data, const InetAddress& peer)
+  {
+    queries_.increment();
+    {
+      MutexLockGuard lock(mutex_);
+      ports_.insert(peer.port());
+    }
+    // header, then labels
+    string name;
+    size_t pos = 12;
+    while (pos < static_cast<size_t>(data.size()) && data[static_cast<int>(pos)] != 0)
+    {
+      size_t len = static_cast<uint8_t>(data[static_cast<int>(pos)]);
+      if (!name.empty())
+        name += '.';
+      name.append(data.data() + pos + 1, len);
+      pos += 1 + len;
+    }
+    const size_t questionEnd = pos + 1 + 4;
+    assert(questionEnd <= static_cast<size_t>(data.size()));
+
+    auto it = records_.find(name);
+    if (it != records_.end() && it->second.drop)
+      return;
+
+    Buffer buf;
+    buf.append(data.data(), 2);  // id
+    bool found = it != records_.end() && !it->second.ips.empty();
+    buf.appendInt16(static_cast<int16_t>(found ? 0x8180 : 0x8183));
+    buf.appendInt16(1);
+    buf.appendInt16(static_cast<int16_t>(found ? it->second.ips.size() : 0));
+    buf.appendInt16(found ? 0 : 1);
+    buf.appendInt16(0);
+    buf.append(data.data() + 12, questionEnd - 12);
+    uint32_t ttl = it != records_.end() ? it->second.ttl : 60;
+    if (found)
+    {
+      for (const string& ip : it->second.ips)
+      {
+        buf.appendInt16(static_cast<int16_t>(0xc00c));
+        buf.appendInt16(1);  // A
+        buf.appendInt16(1);  // IN
+        buf.appendInt32(static_cast<int32_t>(ttl));
+        buf.appendInt16(4);
+        struct in_addr addr;
+        ::inet_pton(AF_INET, ip.c_str(), &addr);
+        buf.append(&addr, 4);
+      }
+    }
+    else
+    {
+      buf.appendInt16(static_cast<int16_t>(0xc00c));
+      buf.appendInt16(6);  // SOA
+      buf.appendInt16(1);
+      buf.appendInt32(static_cast<int32_t>(ttl));
+      buf.appendInt16(22);
+      buf.appendInt8(0);  // MNAME
+      buf.appendInt8(0);  // RNAME
+      for (int i = 0; i < 4; ++i)
+        buf.appendInt32(3600);
+      buf.appendInt32(static_cast<int32_t>(ttl));  // MINIMUM
+    }
+    sock->send(buf.toStringPiece(), peer);
+  }
+
+  UdpServer server_;
+  std::map<string, Record> records_;
+  AtomicInt32 queries_;
+  MutexLock mutex_;
+  std::set<uint16_t> ports_ GUARDED_BY(mutex_);
+};
+
+std::vector<InetAddress> resolve(DnsResolver* resolver, const string& name)
+{
+  CountDownLatch latch(1);
+  std::vector<InetAddress> result;
+  resolver->resolve(name, [&](const std::vector<InetAddress>& addresses)
+  {
+    result = addresses;
+    latch.countDown();
+  });
+  latch.wait();
+  return result;
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+  std::unique_ptr<StubServer> stub;
+  std::unique_ptr<DnsResolver> resolver;
+  loop->runInLoop([&] { stub.reset(new StubServer(loop)); });
+  while (!stub) usleep(1000);
+  stub->add("a.test", { "10.0.0.1", "10.0.0.2" }, 60);
+  stub->add("short.test", { "10.0.0.3" }, 1);
+  stub->add("drop.test", { "10.0.0.4" }, 60, true);
+  stub->add("server.test", { "127.0.0.1" }, 60);
+  stub->add("nodata.test", { }, 1);
+  resolver.reset(new DnsResolver(loop, stub->address()));
+
+  // literals
+  std::vector<InetAddress> addrs = resolve(get_pointer(resolver), "192.168.1.2");
+  assert(addrs.size() == 1 && addrs[0].toIp() == "192.168.1.2");
+  addrs = resolve(get_pointer(resolver), "localhost");
+  assert(addrs.size() == 1 && addrs[0].toIp() == "127.0.0.1");
+  assert(resolve(get_pointer(resolver), "bad..name").empty());
+  assert(stub->queries() == 0);
+
+  // positive cache
+  addrs = resolve(get_pointer(resolver), "A.Test.");
+  assert(addrs.size() == 2 && addrs[0].toIp() == "10.0.0.1" && addrs[1].toIp() == "10.0.0.2");
+  assert(stub->queries() == 1);
+  addrs = resolve(get_pointer(resolver), "a.test");
+  assert(addrs.size() == 2);
+  assert(stub->queries() == 1);
+  assert(resolver->cacheHits() == 1);
+
+  // coalescing
+  {
+    CountDownLatch latch(10);
+    loop->runInLoop([&]
+    {
+      resolver->clearCache();
+      for (int i = 0; i < 10; ++i)
+      {
+        resolver->resolve("a.test", [&](const std::vector<InetAddress>& result)
+        {
+          assert(result.size() == 2);
+          latch.countDown();
+        });
+      }
+    });
+    latch.wait();
+    assert(stub->queries() == 2);
+  }
+
+  // negative cache, TTL from SOA
+  assert(resolve(get_pointer(resolver), "nx.test").empty());
+  assert(resolve(get_pointer(resolver), "nx.test").empty());
+  assert(stub->queries() == 3);
+  assert(resolve(get_pointer(resolver), "nodata.test").empty());
+  assert(stub->queries() == 4);
+
+  // expiry
+  assert(resolve(get_pointer(resolver), "short.test").size() == 1);
+  assert(resolve(get_pointer(resolver), "short.test").size() == 1);
+  assert(resolve(get_pointer(resolver), "nodata.test").empty());
+  assert(stub->queries() == 5);
+  usleep(1100 * 1000);
+  assert(resolve(get_pointer(resolver), "short.test").size() == 1);
+  assert(resolve(get_pointer(resolver), "nodata.test").empty());
+  assert(stub->queries() == 7);
+
+  // timeout and retry
+  loop->runInLoop([&] { resolver->setTimeout(0.1); resolver->setRetries(1); });
+  Timestamp start = Timestamp::now();
+  assert(resolve(get_pointer(resolver), "drop.test").empty());
+  assert(timeDifference(Timestamp::now(), start) >= 0.2);
+  assert(stub->queries() == 9);
+
+  // each query from its own socket, on a random port
+  assert(stub->ports() > 1);
+
+  // TcpClient by name, the kernel completes the handshake without accept()
+  {
+    int listenfd = sockets::createNonblockingOrDie(AF_INET);
+    InetAddress listenAddr(0, true);
+    sockets::bindOrDie(listenfd, listenAddr.getSockAddr());
+    sockets::listenOrDie(listenfd);
+    uint16_t port = InetAddress(sockets::getLocalAddr(listenfd)).port();
+
+    CountDownLatch connected(1);
+    CountDownLatch disconnected(1);
+    TcpClient client(loop, get_pointer(resolver), "server.test", port, "Client");
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn)
+    {
+      if (conn->connected())
+      {
+        assert(conn->peerAddress().toIpPort() == InetAddress("127.0.0.1", port).toIpPort());
+        connected.countDown();
+      }
+      else
+      {
+        disconnected.countDown();
+      }
+    });
+    client.connect();
+    connected.wait();
+    assert(stub->queries() == 10);
+    sockets::close(listenfd);  // resets the connection
+    disconnected.wait();
+    // TcpClient::removeConnection() runs right after the callback
+    CountDownLatch removed(1);
+    loop->queueInLoop([&] { removed.countDown(); });
+    removed.wait();
+  }
+
+  loop->runInLoop([&] { resolver.reset(); stub.reset(); });
+  while (stub) usleep(1000);
+  printf("OK\n");
+}
@@ -0,0 +1,115 @@
+// TcpClientPool against an echo server:
+// least-outstanding selection and reconnect after a failed health check.
+
+#include "muduo/net/TcpClientPool.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpServer.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kConnections = 4;
+
+class Test : noncopyable
+{
+ public:
+  Test(EventLoop* loop, const InetAddress& listenAddr)
+    : loop_(loop),
+      server_(loop, listenAddr, "EchoServer"),
+      pool_(loop, listenAddr, "Pool", kConnections),
+      silent_(false),
+      selectionOk_(false),
+      reconnects_(0)
+  {
+    server_.setMessageCallback(std::bind(&Test::onServerMessage, this, _1, _2));
+    pool_.setConnectionCallback(std::bind(&Test::onConnection, this, _1));
+    pool_.setMessageCallback(std::bind(&Test::onMessage, this, _1, _2));
+    pool_.setHealthCheck(0.2, 0.5, [](const TcpConnectionPtr& conn) { conn->send("ping\n"); });
+  }
+
+  void start()
+  {
+    server_.start();
+    pool_.start();
+  }
+
+  bool passed() const { return selectionOk_ && reconnects_ == kConnections; }
+
+ private:
+  void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf)
+  {
+    if (!silent_)
+      conn->send(buf);
+    else
+      buf->retrieveAll();
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (!conn->connected())
+      return;
+    if (silent_)
+    {
+      printf("reconnected after failed health check\n");
+      if (++reconnects_ == kConnections)
+        loop_->quit();
+    }
+    else if (pool_.numConnected() == kConnections)
+    {
+      checkSelection();
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+  {
+    buf->retrieveAll();
+  }
+
+  void checkSelection()
+  {
+    // acquire without release spreads evenly over all connections
+    std::vector<TcpConnectionPtr> conns;
+    for (int i = 0; i < kConnections * 3; ++i)
+    {
+      conns.push_back(pool_.acquire());
+    }
+    for (const auto& conn : conns)
+    {
+      assert(pool_.outstanding(conn) == 3);
+      (void) conn;
+    }
+    // the least loaded one is picked next
+    pool_.release(conns[1]);
+    pool_.release(conns[1]);
+    TcpConnectionPtr next = pool_.acquire();
+    selectionOk_ = next == conns[1];
+    printf("least outstanding: %s\n", selectionOk_ ? "ok" : "WRONG");
+
+    // the server stops answering, health check closes and reconnects
+    silent_ = true;
+  }
+
+  EventLoop* loop_;
+  TcpServer server_;
+  TcpClientPool pool_;
+  bool silent_;
+  bool selectionOk_;
+  int reconnects_;
+};
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 20271);
+  Test test(&loop, listenAddr);
+  test.start();
+  loop.runAfter(10.0, std::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  printf("%s\n", test.passed() ? "PASSED" : "FAILED");
+  return test.passed() ? 0 : 1;
+}
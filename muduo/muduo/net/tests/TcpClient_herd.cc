@@ -0,0 +1,138 @@
+// Thundering herd of reconnecting TcpClients.
+//
+// Connects many clients with retry enabled, kills the server, restarts it
+// two seconds later, and prints how the reconnects are spread over time.
+// Compare "tcpclient_herd 500 0" with "tcpclient_herd 500 1" (jitter).
+// Exits with 1 if the clients are not all reconnected within 30 seconds.
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpServer.h"
+
+#include <map>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 20270;
+const double kBucket = 0.1;
+
+class Herd : noncopyable
+{
+ public:
+  Herd(EventLoop* loop, int numClients, bool jitter)
+    : loop_(loop),
+      numClients_(numClients),
+      numConnected_(0),
+      restarted_(false),
+      done_(false)
+  {
+    startServer();
+    InetAddress serverAddr("127.0.0.1", kPort);
+    for (int i = 0; i < numClients; ++i)
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "herd%d", i);
+      TcpClient* client = new TcpClient(loop, serverAddr, buf);
+      client->enableRetry();
+      if (jitter)
+        client->enableRetryJitter();
+      clients_.emplace_back(client);
+      client->connect();
+    }
+  }
+
+  bool done() const { return done_; }
+
+ private:
+  void startServer()
+  {
+    server_.reset(new TcpServer(loop_, InetAddress(kPort), "HerdServer", TcpServer::kReusePort));
+    server_->setConnectionCallback(std::bind(&Herd::onConnection, this, _1));
+    server_->start();
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (!conn->connected())
+      return;
+    ++numConnected_;
+    if (restarted_)
+    {
+      int bucket = static_cast<int>(timeDifference(Timestamp::now(), restartTime_) / kBucket);
+      ++histogram_[bucket];
+    }
+    if (numConnected_ == numClients_)
+    {
+      if (!restarted_)
+      {
+        printf("%d clients connected, killing server\n", numClients_);
+        loop_->runAfter(0.5, std::bind(&Herd::killServer, this));
+      }
+      else
+      {
+        report();
+        done_ = true;
+        loop_->quit();
+      }
+    }
+  }
+
+  void killServer()
+  {
+    numConnected_ = 0;
+    server_.reset();
+    loop_->runAfter(2.0, std::bind(&Herd::restartServer, this));
+  }
+
+  void restartServer()
+  {
+    restarted_ = true;
+    restartTime_ = Timestamp::now();
+    startServer();
+  }
+
+  void report()
+  {
+    int peak = 0;
+    int last = 0;
+    for (const auto& kv : histogram_)
+    {
+      printf("%6.1fs %5d\n", kv.first * kBucket, kv.second);
+      peak = std::max(peak, kv.second);
+      last = kv.first;
+    }
+    printf("all %d reconnected in %.1fs, peak %d per %.0fms\n",
+           numClients_, (last + 1) * kBucket, peak, kBucket * 1000);
+  }
+
+  EventLoop* loop_;
+  const int numClients_;
+  int numConnected_;
+  bool restarted_;
+  bool done_;
+  Timestamp restartTime_;
+  std::unique_ptr<TcpServer> server_;
+  std::vector<std::unique_ptr<TcpClient>> clients_;
+  std::map<int, int> histogram_;
+};
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  int numClients = argc > 1 ? atoi(argv[1]) : 200;
+  bool jitter = argc > 2 && atoi(argv[2]) != 0;
+  printf("%d clients, jitter %s\n", numClients, jitter ? "on" : "off");
+
+  EventLoop loop;
+  Herd herd(&loop, numClients, jitter);
+  loop.runAfter(30.0, std::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  if (!herd.done())
+  {
+    printf("FAILED: not all clients reconnected\n");
+  }
+  return herd.done() ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// TimingWheel with many idle entries, compared with the shared_ptr
+// buckets of examples/idleconnection/echo.cc.
+
+#include "muduo/net/TimingWheel.h"
+
+#include "muduo/base/Timestamp.h"
+
+#include <boost/circular_buffer.hpp>
+
+#include <memory>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kIdleSeconds = 8;
+
+struct Connection : public TimingWheelEntry
+{
+  int id;
+};
+
+void benchTimingWheel(int n, int touches)
+{
+  int64_t expired = 0;
+  TimingWheel wheel(NULL, kIdleSeconds, 1.0,
+                    [&expired](TimingWheelEntry*) { ++expired; });
+  std::vector<Connection> conns(n);
+
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    conns[i].id = i;
+    wheel.add(&conns[i]);
+  }
+  Timestamp added(Timestamp::now());
+
+  // every "second", touch a random subset, then tick
+  std::minstd_rand random(42);
+  std::uniform_int_distribution<int> dist(0, n-1);
+  int perTick = touches / kIdleSeconds;
+  for (int tick = 0; tick < kIdleSeconds; ++tick)
+  {
+    for (int i = 0; i < perTick; ++i)
+    {
+      wheel.touch(&conns[dist(random)]);
+    }
+    wheel.onTick();
+  }
+  Timestamp touched(Timestamp::now());
+
+  for (int tick = 0; tick <= kIdleSeconds; ++tick)
+  {
+    wheel.onTick();
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("TimingWheel     add %6.1f ns  touch+tick %6.1f ns  expire all %6.1f ms"
+         "  %zd bytes/conn  expired %ld\n",
+         timeDifference(added, start) * 1e9 / n,
+         timeDifference(touched, added) * 1e9 / touches,
+         timeDifference(end, touched) * 1e3,
+         sizeof(TimingWheelEntry), static_cast<long>(expired));
+}
+
+// examples/idleconnection/echo.cc
+struct Entry
+{
+  explicit Entry(int64_t* expired) : expired_(expired) { }
+  ~Entry() { ++*expired_; }
+  int64_t* expired_;
+};
+typedef std::shared_ptr<Entry> EntryPtr;
+typedef std::weak_ptr<Entry> WeakEntryPtr;
+typedef std::unordered_set<EntryPtr> Bucket;
+typedef boost::circular_buffer<Bucket> WeakConnectionList;
+
+void benchBuckets(int n, int touches)
+{
+  int64_t expired = 0;
+  WeakConnectionList wheel(kIdleSeconds);
+  wheel.resize(kIdleSeconds);
+  std::vector<WeakEntryPtr> conns(n);
+
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    EntryPtr entry(new Entry(&expired));
+    wheel.back().insert(entry);
+    conns[i] = entry;
+  }
+  Timestamp added(Timestamp::now());
+
+  std::minstd_rand random(42);
+  std::uniform_int_distribution<int> dist(0, n-1);
+  int perTick = touches / kIdleSeconds;
+  for (int tick = 0; tick < kIdleSeconds; ++tick)
+  {
+    for (int i = 0; i < perTick; ++i)
+    {
+      EntryPtr entry(conns[dist(random)].lock());
+      if (entry)
+        wheel.back().insert(entry);
+    }
+    wheel.push_back(Bucket());
+  }
+  Timestamp touched(Timestamp::now());
+
+  for (int tick = 0; tick <= kIdleSeconds; ++tick)
+  {
+    wheel.push_back(Bucket());
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("shared_ptr sets add %6.1f ns  touch+tick %6.1f ns  expire all %6.1f ms"
+         "  expired %ld\n",
+         timeDifference(added, start) * 1e9 / n,
+         timeDifference(touched, added) * 1e9 / touches,
+         timeDifference(end, touched) * 1e3,
+         static_cast<long>(expired));
+}
+
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 1000*1000;
+  int touches = argc > 2 ? atoi(argv[2]) : 10*1000*1000;
+  printf("%d idle connections, %d touches over %d ticks\n", n, touches, kIdleSeconds);
+  benchTimingWheel(n, touches);
+  benchBuckets(n, touches);
+}
@@ -0,0 +1,109 @@
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/UdpClient.h"
+#include "muduo/net/UdpServer.h"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// sends 'count' numbered datagrams of 'size' bytes, server echoes,
+// checks every echo arrives intact and in order on loopback.
+void testEcho(int batch, bool gro, bool gso, int count, int size)
+{
+  printf("batch %d gro %d gso %d count %d size %d\n", batch, gro, gso, count, size);
+  EventLoop loop;
+  UdpServer server(&loop, InetAddress(0, true), "UdpEcho");
+  server.setBatchSize(batch);
+  if (gro)
+    server.enableGro();
+  if (gso)
+    server.enableGso();
+  server.setMessageCallback(
+      [](UdpSocket* sock, const StringPiece& data, const InetAddress& peer, Timestamp)
+      { sock->send(data, peer); });
+  server.start();
+  InetAddress serverAddr("127.0.0.1", 0);
+  {
+    struct sockaddr_in6 addr;
+    socklen_t len = static_cast<socklen_t>(sizeof addr);
+    ::getsockname(server.sockets()[0]->fd(), reinterpret_cast<struct sockaddr*>(&addr), &len);
+    serverAddr = InetAddress(addr);
+  }
+
+  UdpClient client(&loop, serverAddr, "UdpEchoClient");
+  client.socket()->setBatchSize(batch);
+  if (gro)
+    client.socket()->enableGro();
+  if (gso)
+    client.socket()->enableGso();
+  int received = 0;
+  int sent = 0;
+  string message(size, '\0');
+  auto sendOne = [&]
+  {
+    memcpy(&message[0], &sent, sizeof sent);
+    for (int i = static_cast<int>(sizeof sent); i < size; ++i)
+      message[i] = static_cast<char>(sent + i);
+    client.send(message);
+    ++sent;
+  };
+  client.setMessageCallback(
+      [&](UdpSocket*, const StringPiece& data, const InetAddress&, Timestamp)
+      {
+        assert(data.size() == size);
+        int seq = 0;
+        memcpy(&seq, data.data(), sizeof seq);
+        assert(seq == received);
+        for (int i = static_cast<int>(sizeof seq); i < size; ++i)
+          assert(data[i] == static_cast<char>(seq + i));
+        if (++received == count)
+          loop.quit();
+        else if (sent < count)
+          sendOne();
+      });
+  client.start();
+
+  // keeps a window in flight, so socket buffers never overflow
+  for (int i = 0; i < 32 && sent < count; ++i)
+  {
+    sendOne();
+  }
+  loop.runAfter(5.0, [] { assert(!"timeout"); });
+  loop.loop();
+  assert(received == count);
+  printf("recvmmsg %ld sendmmsg %ld\n",
+         static_cast<long>(client.socket()->recvCalls()),
+         static_cast<long>(client.socket()->sendCalls()));
+}
+
+// destroys a socket with a flush queued in the loop, the functor must be a no-op.
+void testDestroyWithQueuedFlush()
+{
+  printf("destroy with queued flush\n");
+  EventLoop loop;
+  std::unique_ptr<UdpClient> client(
+      new UdpClient(&loop, InetAddress("127.0.0.1", 9), "UdpDestroyed"));
+  loop.runAfter(0.0, [&]
+  {
+    client->start();
+    client->send("hello");
+    assert(client->socket()->queuedDatagrams() == 1);
+    client.reset();
+  });
+  loop.runAfter(0.1, [&] { loop.quit(); });
+  loop.loop();
+  assert(!client);
+}
+
+int main()
+{
+  testEcho(1, false, false, 100, 100);
+  testEcho(64, false, false, 1000, 100);
+  testEcho(64, false, true, 1000, 1000);
+  testEcho(64, true, true, 1000, 1000);
+  testEcho(16, true, false, 200, 1400);
+  testDestroyWithQueuedFlush();
+}
@@ -89,3 +89,23 @@ BOOST_AUTO_TEST_CASE(testZlibOutputStream5)
   printf("total %zd\n", output.readableBytes());
   BOOST_CHECK_EQUAL(stream.zlibErrorCode(), Z_STREAM_END);
 }
+
+BOOST_AUTO_TEST_CASE(testZlibOutputStreamGzipReset)
+{
+  muduo::net::Buffer output;
+  muduo::net::ZlibOutputStream stream(&output, 9, muduo::net::ZlibOutputStream::kGzip);
+  muduo::string input(100000, 'x');
+  BOOST_CHECK(stream.write(input));
+  BOOST_CHECK(stream.finishStream());
+  BOOST_CHECK_EQUAL(output.peek()[0], '\x1f');  // gzip magic
+  BOOST_CHECK_EQUAL(output.peek()[1], '\x8b');
+  size_t first = output.readableBytes();
+
+  muduo::net::Buffer output2;
+  BOOST_CHECK(stream.reset(&output2));
+  BOOST_CHECK(stream.write(input));
+  BOOST_CHECK(stream.finishStream());
+  BOOST_CHECK_EQUAL(output2.readableBytes(), first);
+  BOOST_CHECK(stream.finish());
+  BOOST_CHECK(!stream.reset(&output2));
+}
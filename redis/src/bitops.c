@@ -34,6 +34,194 @@
  * Helpers and low level bit functions.
  * -------------------------------------------------------------------------- */
 
+#define BITOP_AND   0
+#define BITOP_OR    1
+#define BITOP_XOR   2
+#define BITOP_NOT   3
+
+/* The SIMD kernels below process the bulk of the bitmaps, leaving the bytes
+ * at the tail to the scalar code. They are selected at startup according to
+ * the CPU features by bitopsSelectKernels(), and are NULL when the CPU (or
+ * the compiler) does not support them, or when disabled by DEBUG SET-SIMD 0. */
+static long long (*popcountKernel)(unsigned char *p, long count) = NULL;
+static unsigned long (*bitposSkipKernel)(unsigned char *p, unsigned long count, int skipval) = NULL;
+static unsigned long (*bitopKernel)(unsigned long op, unsigned char *res, unsigned char **src, unsigned long numkeys, unsigned long len) = NULL;
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+
+/* Count the bits set in 'count' bytes, 'count' being a multiple of 32.
+ * Every nibble is translated to its number of bits with a lookup table, and
+ * summed in per-byte counters, that can take 31 iterations (248 bits) before
+ * being added to the 64 bit totals. */
+ATTRIBUTE_TARGET_AVX2
+static long long popcountAVX2(unsigned char *p, long count) {
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0f), zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    uint64_t lanes[4];
+    long j = 0;
+
+    while (j < count) {
+        __m256i acc = zero;
+        long end = j+32*31 < count ? j+32*31 : count;
+
+        for (; j < end; j += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(p+j));
+            __m256i lo = _mm256_shuffle_epi8(lut,_mm256_and_si256(x,low));
+            __m256i hi = _mm256_shuffle_epi8(lut,
+                _mm256_and_si256(_mm256_srli_epi16(x,4),low));
+            acc = _mm256_add_epi8(acc,_mm256_add_epi8(lo,hi));
+        }
+        total = _mm256_add_epi64(total,_mm256_sad_epu8(acc,zero));
+    }
+    _mm256_storeu_si256((__m256i*)lanes,total);
+    return lanes[0]+lanes[1]+lanes[2]+lanes[3];
+}
+
+#ifdef HAVE_X86_VPOPCNTDQ
+/* Count the bits set in 'count' bytes, 'count' being a multiple of 64. */
+ATTRIBUTE_TARGET_AVX512_VPOPCNTDQ
+static long long popcountAVX512(unsigned char *p, long count) {
+    __m512i total = _mm512_setzero_si512();
+    long j;
+
+    for (j = 0; j < count; j += 64)
+        total = _mm512_add_epi64(total,
+            _mm512_popcnt_epi64(_mm512_loadu_si512(p+j)));
+    return _mm512_reduce_add_epi64(total);
+}
+#endif
+
+/* Return the number of bytes at the start of 'p', in blocks of 128 bytes,
+ * that are all set to 'skipval'. */
+ATTRIBUTE_TARGET_AVX2
+static unsigned long bitposSkipAVX2(unsigned char *p, unsigned long count, int skipval) {
+    const __m256i skip = _mm256_set1_epi8(skipval);
+    unsigned long j;
+
+    for (j = 0; j+128 <= count; j += 128) {
+        __m256i x = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p+j)),skip),
+                _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p+j+32)),skip)),
+            _mm256_or_si256(
+                _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p+j+64)),skip),
+                _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p+j+96)),skip)));
+        if (!_mm256_testz_si256(x,x)) break;
+    }
+    return j;
+}
+
+ATTRIBUTE_TARGET_AVX512
+static unsigned long bitposSkipAVX512(unsigned char *p, unsigned long count, int skipval) {
+    const __m512i skip = _mm512_set1_epi8(skipval);
+    unsigned long j;
+
+    for (j = 0; j+128 <= count; j += 128) {
+        __m512i x = _mm512_or_si512(
+            _mm512_xor_si512(_mm512_loadu_si512(p+j),skip),
+            _mm512_xor_si512(_mm512_loadu_si512(p+j+64),skip));
+        if (_mm512_test_epi64_mask(x,x)) break;
+    }
+    return j;
+}
+
+/* Compute the bit operation 'op' of the first 'len' bytes of the 'numkeys'
+ * strings in 'src' into 'res', 64 bytes at a time. Return the number of
+ * bytes processed. */
+#define BITOP_AVX2_LOOP(OP) do { \
+    for (j = 0; j+64 <= len; j += 64) { \
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src[0]+j)); \
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src[0]+j+32)); \
+        for (i = 1; i < numkeys; i++) { \
+            a = OP(a,_mm256_loadu_si256((const __m256i*)(src[i]+j))); \
+            b = OP(b,_mm256_loadu_si256((const __m256i*)(src[i]+j+32))); \
+        } \
+        _mm256_storeu_si256((__m256i*)(res+j),a); \
+        _mm256_storeu_si256((__m256i*)(res+j+32),b); \
+    } \
+} while(0)
+
+ATTRIBUTE_TARGET_AVX2
+static unsigned long bitopAVX2(unsigned long op, unsigned char *res, unsigned char **src, unsigned long numkeys, unsigned long len) {
+    unsigned long i, j;
+
+    switch(op) {
+    case BITOP_AND: BITOP_AVX2_LOOP(_mm256_and_si256); break;
+    case BITOP_OR: BITOP_AVX2_LOOP(_mm256_or_si256); break;
+    case BITOP_XOR: BITOP_AVX2_LOOP(_mm256_xor_si256); break;
+    default: {
+        /* BITOP_NOT, with a single source. */
+        const __m256i ones = _mm256_set1_epi8(-1);
+        for (j = 0; j+32 <= len; j += 32) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(src[0]+j));
+            _mm256_storeu_si256((__m256i*)(res+j),_mm256_xor_si256(a,ones));
+        }
+    }
+    }
+    return j;
+}
+
+#define BITOP_AVX512_LOOP(OP) do { \
+    for (j = 0; j+64 <= len; j += 64) { \
+        __m512i a = _mm512_loadu_si512(src[0]+j); \
+        for (i = 1; i < numkeys; i++) \
+            a = OP(a,_mm512_loadu_si512(src[i]+j)); \
+        _mm512_storeu_si512(res+j,a); \
+    } \
+} while(0)
+
+ATTRIBUTE_TARGET_AVX512
+static unsigned long bitopAVX512(unsigned long op, unsigned char *res, unsigned char **src, unsigned long numkeys, unsigned long len) {
+    unsigned long i, j;
+
+    switch(op) {
+    case BITOP_AND: BITOP_AVX512_LOOP(_mm512_and_si512); break;
+    case BITOP_OR: BITOP_AVX512_LOOP(_mm512_or_si512); break;
+    case BITOP_XOR: BITOP_AVX512_LOOP(_mm512_xor_si512); break;
+    default: {
+        /* BITOP_NOT, with a single source. */
+        const __m512i ones = _mm512_set1_epi8(-1);
+        for (j = 0; j+64 <= len; j += 64) {
+            __m512i a = _mm512_loadu_si512(src[0]+j);
+            _mm512_storeu_si512(res+j,_mm512_xor_si512(a,ones));
+        }
+    }
+    }
+    return j;
+}
+#endif
+
+/* Select the best kernels supported by the CPU, or the scalar code only if
+ * 'simd' is zero. */
+void bitopsSelectKernels(int simd) {
+    popcountKernel = NULL;
+    bitposSkipKernel = NULL;
+    bitopKernel = NULL;
+    if (!simd) return;
+
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        popcountKernel = popcountAVX2;
+        bitposSkipKernel = bitposSkipAVX2;
+        bitopKernel = bitopAVX2;
+    }
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw"))
+    {
+        bitposSkipKernel = bitposSkipAVX512;
+        bitopKernel = bitopAVX512;
+#ifdef HAVE_X86_VPOPCNTDQ
+        if (__builtin_cpu_supports("avx512vpopcntdq"))
+            popcountKernel = popcountAVX512;
+#endif
+    }
+#endif
+}
+
 /* Count number of bits set in the binary array pointed by 's' and long
  * 'count' bytes. The implementation of this function is required to
  * work with an input string length up to 512 MB or more (server.proto_max_bulk_len) */
@@ -43,6 +231,14 @@ long long redisPopcount(void *s, long count) {
     uint32_t *p4;
     static const unsigned char bitsinbyte[256] = {0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,4,5,5,6,5,6,6,7,5,6,6,7,6,7,7,8};
 
+    /* Count the bulk of the bytes with the SIMD kernel if any, the
+     * remaining ones are counted below. */
+    if (popcountKernel && count >= 64) {
+        bits += popcountKernel(p,count & ~63L);
+        p += count & ~63L;
+        count &= 63;
+    }
+
     /* Count initial bytes not aligned to 32 bit. */
     while((unsigned long)p & 3 && count) {
         bits += bitsinbyte[*p++];
@@ -119,6 +315,14 @@ long long redisBitpos(void *s, unsigned long count, int bit) {
     skipval = bit ? 0 : UCHAR_MAX;
     c = (unsigned char*) s;
     found = 0;
+
+    /* Skip large blocks with the SIMD kernel if any. */
+    if (bitposSkipKernel) {
+        j = bitposSkipKernel(c,count,skipval);
+        c += j;
+        count -= j;
+        pos += (long long)j*8;
+    }
     while((unsigned long)c & (sizeof(*l)-1) && count) {
         if (*c != skipval) {
             found = 1;
@@ -395,11 +599,6 @@ void printBits(unsigned char *p, unsigned long count) {
  * Bits related string commands: GETBIT, SETBIT, BITCOUNT, BITOP.
  * -------------------------------------------------------------------------- */
 
-#define BITOP_AND   0
-#define BITOP_OR    1
-#define BITOP_XOR   2
-#define BITOP_NOT   3
-
 #define BITFIELDOP_GET 0
 #define BITFIELDOP_SET 1
 #define BITFIELDOP_INCRBY 2
@@ -681,8 +880,9 @@ void bitopCommand(client *c) {
          * result in GCC compiling the code using multiple-words load/store
          * operations that are not supported even in ARM >= v6. */
         j = 0;
+        if (bitopKernel) j = bitopKernel(op,res,src,numkeys,minlen);
         #ifndef USE_ALIGNED_ACCESS
-        if (minlen >= sizeof(unsigned long)*4 && numkeys <= 16) {
+        if (j == 0 && minlen >= sizeof(unsigned long)*4 && numkeys <= 16) {
             unsigned long *lp[16];
             unsigned long *lres = (unsigned long*) res;
 
@@ -654,6 +654,8 @@ void handleClientsBlockedOnKeys(void) {
 
             /* Serve clients blocked on the key. */
             robj *o = lookupKeyReadWithFlags(rl->db, rl->key, LOOKUP_NONOTIFY | LOOKUP_NOSTATS);
+            if (o != NULL && server.snapshot_in_progress)
+                o = snapshotBeforeWrite(rl->db,rl->key,o);
             if (o != NULL) {
                 int objtype = o->type;
                 if (objtype == OBJ_LIST)
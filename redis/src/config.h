@@ -154,6 +154,23 @@
 #define REDIS_NO_SANITIZE(sanitizer)
 #endif
 
+/* Test for x86 SIMD support: the AVX2 / AVX-512 code paths are compiled
+ * with the target attribute regardless of the -march flags, and the caller
+ * selects them at runtime with __builtin_cpu_supports(). */
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ >= 6 || defined(__clang__))
+#if defined(__has_attribute)
+#if __has_attribute(target)
+#define HAVE_X86_SIMD 1
+#define ATTRIBUTE_TARGET_AVX2 __attribute__((target("avx2")))
+#define ATTRIBUTE_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#if __GNUC__ >= 8 || defined(__clang__)
+#define HAVE_X86_VPOPCNTDQ 1
+#define ATTRIBUTE_TARGET_AVX512_VPOPCNTDQ __attribute__((target("avx512f,avx512vpopcntdq")))
+#endif
+#endif
+#endif
+#endif
+
 /* Define rdb_fsync_range to sync_file_range() on Linux, otherwise we use
  * the plain fsync() call. */
 #if (defined(__linux__) && defined(SYNC_FILE_RANGE_WAIT_BEFORE))
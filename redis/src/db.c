@@ -99,10 +99,20 @@ robj *lookupKey(redisDb *db, robj *key, int flags) {
         }
     }
 
+    /* The snapshot thread may still have to save the value the caller is
+     * going to modify. */
+    if (val && (flags & LOOKUP_WRITE) && server.snapshot_in_progress)
+        val = snapshotBeforeWrite(db,key,val);
+
+    /* Commands executed by the I/O threads count their hits and misses per
+     * thread, and never notify (see postponeClientCommand()). */
+    int threaded = io_threads_op == IO_THREADS_OP_COMMAND;
+
     if (val) {
         /* Update the access time for the ageing algorithm.
          * Don't do it if we have a saving child, as this will trigger
-         * a copy on write madness. */
+         * a copy on write madness. When threads read the same key, the
+         * last store wins, which is as good as any for the eviction. */
         if (!hasActiveChildProcess() && !(flags & LOOKUP_NOTOUCH)){
             if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
                 updateLFU(val);
@@ -111,14 +121,22 @@ robj *lookupKey(redisDb *db, robj *key, int flags) {
             }
         }
 
-        if (!(flags & (LOOKUP_NOSTATS | LOOKUP_WRITE)))
-            server.stat_keyspace_hits++;
+        if (!(flags & (LOOKUP_NOSTATS | LOOKUP_WRITE))) {
+            if (threaded)
+                updateIOThreadKeyspaceStats(1);
+            else
+                server.stat_keyspace_hits++;
+        }
         /* TODO: Use separate hits stats for WRITE */
     } else {
-        if (!(flags & (LOOKUP_NONOTIFY | LOOKUP_WRITE)))
+        if (!(flags & (LOOKUP_NONOTIFY | LOOKUP_WRITE)) && !threaded)
             notifyKeyspaceEvent(NOTIFY_KEY_MISS, "keymiss", key, db->id);
-        if (!(flags & (LOOKUP_NOSTATS | LOOKUP_WRITE)))
-            server.stat_keyspace_misses++;
+        if (!(flags & (LOOKUP_NOSTATS | LOOKUP_WRITE))) {
+            if (threaded)
+                updateIOThreadKeyspaceStats(0);
+            else
+                server.stat_keyspace_misses++;
+        }
         /* TODO: Use separate misses stats and notify event for WRITE */
     }
 
@@ -171,15 +189,32 @@ robj *lookupKeyWriteOrReply(client *c, robj *key, robj *reply) {
     return o;
 }
 
+/* Prefetches the data of the values that don't embed it, for
+ * dbPrefetchKeys(). The robj itself was prefetched by dictPrefetch(). */
+static void dbPrefetchValue(const void *val) {
+    const robj *o = val;
+    if (o->encoding != OBJ_ENCODING_INT && o->encoding != OBJ_ENCODING_EMBSTR)
+        __builtin_prefetch(o->ptr);
+}
+
+/* Prefetches what the lookups of a batch of keys of 'db' are going to touch,
+ * given the hashes of the keys as computed by dictSdsHash(). */
+void dbPrefetchKeys(redisDb *db, const uint64_t *hashes, int count) {
+    dictPrefetch(db->dict, hashes, count, dbPrefetchValue);
+    if (dictSize(db->expires)) dictPrefetch(db->expires, hashes, count, NULL);
+}
+
 /* Add the key to the DB. It's up to the caller to increment the reference
  * counter of the value if needed.
  *
  * The program is aborted if the key already exists. */
 void dbAdd(redisDb *db, robj *key, robj *val) {
-    sds copy = sdsdup(key->ptr);
+    /* Embedded keys are copied into the entry, otherwise it needs its own. */
+    sds copy = dictHasEmbeddedKeys(db->dict) ? key->ptr : sdsdup(key->ptr);
     dictEntry *de = dictAddRaw(db->dict, copy, NULL);
     serverAssertWithInfo(NULL, key, de != NULL);
     dictSetVal(db->dict, de, val);
+    if (server.snapshot_in_progress) snapshotKeyAdded(db,key);
     signalKeyAsReady(db, key, val->type);
     if (server.cluster_enabled) slotToKeyAddEntry(de, db);
     notifyKeyspaceEvent(NOTIFY_NEW,"new",key,db->id);
@@ -195,11 +230,17 @@ void dbAdd(redisDb *db, robj *key, robj *val) {
  *
  * The function returns 1 if the key was added to the database, taking
  * ownership of the SDS string, otherwise 0 is returned, and is up to the
- * caller to free the SDS string. */
+ * caller to free the SDS string. If the keys are embedded in the entries
+ * the SDS string is copied, and the caller always has to free it. */
 int dbAddRDBLoad(redisDb *db, sds key, robj *val) {
     dictEntry *de = dictAddRaw(db->dict, key, NULL);
     if (de == NULL) return 0;
     dictSetVal(db->dict, de, val);
+    if (server.snapshot_in_progress) {
+        robj keyobj;
+        initStaticStringObject(keyobj,key);
+        snapshotKeyAdded(db,&keyobj);
+    }
     if (server.cluster_enabled) slotToKeyAddEntry(de, db);
     return 1;
 }
@@ -210,10 +251,11 @@ int dbAddRDBLoad(redisDb *db, sds key, robj *val) {
  *
  * The program is aborted if the key was not already present. */
 void dbOverwrite(redisDb *db, robj *key, robj *val) {
+    if (server.snapshot_in_progress) snapshotBeforeWrite(db,key,NULL);
     dictEntry *de = dictFind(db->dict,key->ptr);
 
     serverAssertWithInfo(NULL,key,de != NULL);
-    dictEntry auxentry = *de;
+    dictEntry auxentry = { .key = de->key, .v = de->v };
     robj *old = dictGetVal(de);
     if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
         val->lru = old->lru;
@@ -307,9 +349,15 @@ robj *dbRandomKey(redisDb *db) {
 
 /* Helper for sync and async delete. */
 static int dbGenericDelete(redisDb *db, robj *key, int async) {
+    if (server.snapshot_in_progress) snapshotBeforeWrite(db,key,NULL);
     /* Deleting an entry from the expires dict will not free the sds of
      * the key, because it is shared with the main dictionary. */
-    if (dictSize(db->expires) > 0) dictDelete(db->expires,key->ptr);
+    if (dictSize(db->expires) > 0) {
+        dictEntry *ede = dictUnlink(db->expires,key->ptr);
+        if (ede && db->expires_index)
+            expireIndexDel(db,key->ptr,dictGetSignedIntegerVal(ede));
+        dictFreeUnlinkedEntry(db->expires,ede);
+    }
     dictEntry *de = dictUnlink(db->dict,key->ptr);
     if (de) {
         robj *val = dictGetVal(de);
@@ -406,11 +454,21 @@ long long emptyDbStructure(redisDb *dbarray, int dbnum, int async,
 
     for (int j = startdb; j <= enddb; j++) {
         removed += dictSize(dbarray[j].dict);
+        /* The values referenced by the snapshot thread can't be released
+         * by another thread. */
+        if (server.snapshot_in_progress) {
+            if (dbarray == server.db) snapshotBeforeEmpty(&dbarray[j]);
+            async = 0;
+        }
         if (async) {
             emptyDbAsync(&dbarray[j]);
         } else {
             dictEmpty(dbarray[j].dict,callback);
             dictEmpty(dbarray[j].expires,callback);
+            if (dbarray[j].expires_index) {
+                raxFree(dbarray[j].expires_index);
+                dbarray[j].expires_index = raxNew();
+            }
         }
         /* Because all keys of database are removed, reset average ttl. */
         dbarray[j].avg_ttl = 0;
@@ -486,6 +544,7 @@ redisDb *initTempDb(void) {
     for (int i=0; i<server.dbnum; i++) {
         tempDb[i].dict = dictCreate(&dbDictType);
         tempDb[i].expires = dictCreate(&dbExpiresDictType);
+        tempDb[i].expires_index = server.active_expire_index ? raxNew() : NULL;
         tempDb[i].slots_to_keys = NULL;
     }
 
@@ -506,6 +565,7 @@ void discardTempDb(redisDb *tempDb, void(callback)(dict*)) {
     for (int i=0; i<server.dbnum; i++) {
         dictRelease(tempDb[i].dict);
         dictRelease(tempDb[i].expires);
+        if (tempDb[i].expires_index) raxFree(tempDb[i].expires_index);
     }
 
     if (server.cluster_enabled) {
@@ -599,8 +659,10 @@ int getFlushCommandFlags(client *c, int *flags) {
 
 /* Flushes the whole server data set. */
 void flushAllDataAndResetRDB(int flags) {
-    server.dirty += emptyData(-1,flags,NULL);
+    /* Kill the saving first, so that a snapshot thread doesn't capture all
+     * the keys just before they are deleted. */
     if (server.child_type == CHILD_TYPE_RDB) killRDBChild();
+    server.dirty += emptyData(-1,flags,NULL);
     if (server.saveparamslen > 0) {
         rdbSaveInfo rsi, *rsiptr;
         rsiptr = rdbPopulateSaveInfo(&rsi);
@@ -774,7 +836,7 @@ void scanCallback(void *privdata, const dictEntry *de) {
     } else if (o->type == OBJ_ZSET) {
         sds sdskey = dictGetKey(de);
         key = createStringObject(sdskey,sdslen(sdskey));
-        val = createStringObjectFromLongDouble(*(double*)dictGetVal(de),0);
+        val = createStringObjectFromLongDouble(zsetDictGetScore((zset*)o->ptr,de),0);
     } else {
         serverPanic("Type not handled in SCAN callback.");
     }
@@ -883,7 +945,9 @@ void scanGenericCommand(client *c, robj *o, unsigned long cursor) {
     } else if (o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT) {
         ht = o->ptr;
         count *= 2; /* We return key / value for this type. */
-    } else if (o->type == OBJ_ZSET && o->encoding == OBJ_ENCODING_SKIPLIST) {
+    } else if (o->type == OBJ_ZSET && (o->encoding == OBJ_ENCODING_SKIPLIST ||
+                                       o->encoding == OBJ_ENCODING_BTREE))
+    {
         zset *zs = o->ptr;
         ht = zs->dict;
         count *= 2; /* We return key / value for this type. */
@@ -1394,16 +1458,24 @@ int dbSwapDatabases(int id1, int id2) {
     scanDatabaseForDeletedStreams(db1, db2);
     scanDatabaseForDeletedStreams(db2, db1);
 
+    /* The snapshot thread walks the dictionaries of the databases. */
+    if (server.snapshot_in_progress) {
+        snapshotBeforeEmpty(db1);
+        snapshotBeforeEmpty(db2);
+    }
+
     /* Swap hash tables. Note that we don't swap blocking_keys,
      * ready_keys and watched_keys, since we want clients to
      * remain in the same DB they were. */
     db1->dict = db2->dict;
     db1->expires = db2->expires;
+    db1->expires_index = db2->expires_index;
     db1->avg_ttl = db2->avg_ttl;
     db1->expires_cursor = db2->expires_cursor;
 
     db2->dict = aux.dict;
     db2->expires = aux.expires;
+    db2->expires_index = aux.expires_index;
     db2->avg_ttl = aux.avg_ttl;
     db2->expires_cursor = aux.expires_cursor;
 
@@ -1443,16 +1515,20 @@ void swapMainDbWithTempDb(redisDb *tempDb) {
         /* Try to unblock any XREADGROUP clients if the key no longer exists. */
         scanDatabaseForDeletedStreams(activedb, newdb);
 
+        if (server.snapshot_in_progress) snapshotBeforeEmpty(activedb);
+
         /* Swap hash tables. Note that we don't swap blocking_keys,
          * ready_keys and watched_keys, since clients 
          * remain in the same DB they were. */
         activedb->dict = newdb->dict;
         activedb->expires = newdb->expires;
+        activedb->expires_index = newdb->expires_index;
         activedb->avg_ttl = newdb->avg_ttl;
         activedb->expires_cursor = newdb->expires_cursor;
 
         newdb->dict = aux.dict;
         newdb->expires = aux.expires;
+        newdb->expires_index = aux.expires_index;
         newdb->avg_ttl = aux.avg_ttl;
         newdb->expires_cursor = aux.expires_cursor;
 
@@ -1511,7 +1587,15 @@ int removeExpire(redisDb *db, robj *key) {
     /* An expire may only be removed if there is a corresponding entry in the
      * main dict. Otherwise, the key will never be freed. */
     serverAssertWithInfo(NULL,key,dictFind(db->dict,key->ptr) != NULL);
-    return dictDelete(db->expires,key->ptr) == DICT_OK;
+    if (server.snapshot_in_progress) snapshotBeforeWrite(db,key,NULL);
+    if (db->expires_index == NULL)
+        return dictDelete(db->expires,key->ptr) == DICT_OK;
+
+    dictEntry *de = dictUnlink(db->expires,key->ptr);
+    if (de == NULL) return 0;
+    expireIndexDel(db,key->ptr,dictGetSignedIntegerVal(de));
+    dictFreeUnlinkedEntry(db->expires,de);
+    return 1;
 }
 
 /* Set an expire to the specified key. If the expire is set in the context
@@ -1519,13 +1603,21 @@ int removeExpire(redisDb *db, robj *key) {
  * to NULL. The 'when' parameter is the absolute unix time in milliseconds
  * after which the key will no longer be considered valid. */
 void setExpire(client *c, redisDb *db, robj *key, long long when) {
-    dictEntry *kde, *de;
+    dictEntry *kde, *de, *existing;
+
+    if (server.snapshot_in_progress) snapshotBeforeWrite(db,key,NULL);
 
     /* Reuse the sds from the main dict in the expire dict */
     kde = dictFind(db->dict,key->ptr);
     serverAssertWithInfo(NULL,key,kde != NULL);
-    de = dictAddOrFind(db->expires,dictGetKey(kde));
+    de = dictAddRaw(db->expires,dictGetKey(kde),&existing);
+    if (de == NULL) {
+        de = existing;
+        if (db->expires_index)
+            expireIndexDel(db,key->ptr,dictGetSignedIntegerVal(de));
+    }
     dictSetSignedIntegerVal(de,when);
+    if (db->expires_index) expireIndexAdd(db,key->ptr,when);
 
     int writable_slave = server.masterhost && server.repl_slave_ro == 0;
     if (c && writable_slave && !(c->flags & CLIENT_MASTER))
@@ -1666,6 +1758,11 @@ int keyIsExpired(redisDb *db, robj *key) {
 int expireIfNeeded(redisDb *db, robj *key, int force_delete_expired) {
     if (!keyIsExpired(db,key)) return 0;
 
+    /* Commands executed by the I/O threads can't modify the keyspace: the
+     * key is reported as expired, and deleted later on the main thread by
+     * the next write access or by the active expire cycle. */
+    if (io_threads_op == IO_THREADS_OP_COMMAND) return 1;
+
     /* If we are running in the context of a replica, instead of
      * evicting the expired key from the database, we return ASAP:
      * the replica key expiration is controlled by the master that will
@@ -257,7 +257,9 @@ double *zslDefrag(zskiplist *zsl, double score, sds oldele, sds newele) {
 }
 
 /* Defrag helper for sorted set.
- * Defrag a single dict entry key name, and corresponding skiplist struct */
+ * Defrag a single dict entry key name, and corresponding skiplist struct.
+ * With the B+tree encoding only the element moves: the leaves are large
+ * fixed size allocations, and are left where they are. */
 long activeDefragZsetEntry(zset *zs, dictEntry *de) {
     sds newsds;
     double* newscore;
@@ -265,6 +267,10 @@ long activeDefragZsetEntry(zset *zs, dictEntry *de) {
     sds sdsele = dictGetKey(de);
     if ((newsds = activeDefragSds(sdsele)))
         defragged++, de->key = newsds;
+    if (zs->zbt) {
+        if (newsds) zbtReplaceEle(zs->zbt, dictGetDoubleVal(de), sdsele, newsds);
+        return defragged;
+    }
     newscore = zslDefrag(zs->zsl, *(double*)dictGetVal(de), sdsele, newsds);
     if (newscore) {
         dictSetVal(zs->dict, de, newscore);
@@ -522,7 +528,8 @@ void scanLaterZsetCallback(void *privdata, const dictEntry *_de) {
 }
 
 long scanLaterZset(robj *ob, unsigned long *cursor) {
-    if (ob->type != OBJ_ZSET || ob->encoding != OBJ_ENCODING_SKIPLIST)
+    if (ob->type != OBJ_ZSET || (ob->encoding != OBJ_ENCODING_SKIPLIST &&
+                                 ob->encoding != OBJ_ENCODING_BTREE))
         return 0;
     zset *zs = (zset*)ob->ptr;
     dict *d = zs->dict;
@@ -593,13 +600,20 @@ long defragZsetSkiplist(redisDb *db, dictEntry *kde) {
     dict *newdict;
     dictEntry *de;
     struct zskiplistNode *newheader;
-    serverAssert(ob->type == OBJ_ZSET && ob->encoding == OBJ_ENCODING_SKIPLIST);
+    zbtree *newzbt;
+    serverAssert(ob->type == OBJ_ZSET && (ob->encoding == OBJ_ENCODING_SKIPLIST ||
+                                          ob->encoding == OBJ_ENCODING_BTREE));
     if ((newzs = activeDefragAlloc(zs)))
         defragged++, ob->ptr = zs = newzs;
-    if ((newzsl = activeDefragAlloc(zs->zsl)))
-        defragged++, zs->zsl = newzsl;
-    if ((newheader = activeDefragAlloc(zs->zsl->header)))
-        defragged++, zs->zsl->header = newheader;
+    if (zs->zbt) {
+        if ((newzbt = activeDefragAlloc(zs->zbt)))
+            defragged++, zs->zbt = newzbt;
+    } else {
+        if ((newzsl = activeDefragAlloc(zs->zsl)))
+            defragged++, zs->zsl = newzsl;
+        if ((newheader = activeDefragAlloc(zs->zsl->header)))
+            defragged++, zs->zsl->header = newheader;
+    }
     if (dictSize(zs->dict) > server.active_defrag_max_scan_fields)
         defragLater(db, kde);
     else {
@@ -842,10 +856,12 @@ long defragKey(redisDb *db, dictEntry *de) {
     robj *newob, *ob;
     unsigned char *newzl;
     long defragged = 0;
-    sds newsds;
+    sds newsds = NULL;
 
-    /* Try to defrag the key name. */
-    newsds = activeDefragSds(keysds);
+    /* Try to defrag the key name, unless it moves with its entry, see
+     * defragDictBucketCallback(). */
+    if (!dictHasEmbeddedKeys(db->dict))
+        newsds = activeDefragSds(keysds);
     if (newsds)
         defragged++, de->key = newsds;
     if (dictSize(db->expires)) {
@@ -885,7 +901,8 @@ long defragKey(redisDb *db, dictEntry *de) {
         if (ob->encoding == OBJ_ENCODING_LISTPACK) {
             if ((newzl = activeDefragAlloc(ob->ptr)))
                 defragged++, ob->ptr = newzl;
-        } else if (ob->encoding == OBJ_ENCODING_SKIPLIST) {
+        } else if (ob->encoding == OBJ_ENCODING_SKIPLIST ||
+                   ob->encoding == OBJ_ENCODING_BTREE) {
             defragged += defragZsetSkiplist(db, de);
         } else {
             serverPanic("Unknown sorted set encoding");
@@ -920,6 +937,23 @@ void defragScanCallback(void *privdata, const dictEntry *de) {
     server.stat_active_defrag_scanned++;
 }
 
+/* The key embedded in a keyspace dictEntry moved with it: fix the key of the
+ * entry, and the one of its db->expires entry, that shares it. */
+static void defragEmbeddedKey(dict *d, dictEntry *newde, dictEntry *olde) {
+    sds oldkey = newde->key;
+    long defragged = 0;
+    dictEntryMoved(d, newde, olde);
+    for (int j = 0; j < server.dbnum; j++) {
+        redisDb *db = server.db+j;
+        if (db->dict != d) continue;
+        if (dictSize(db->expires)) {
+            uint64_t hash = dictGetHash(d, newde->key);
+            replaceSatelliteDictKeyPtrAndOrDefragDictEntry(db->expires, oldkey, newde->key, hash, &defragged);
+        }
+        break;
+    }
+}
+
 /* Defrag scan callback for each hash table bucket,
  * used in order to defrag the dictEntry allocations. */
 void defragDictBucketCallback(dict *d, dictEntry **bucketref) {
@@ -927,11 +961,14 @@ void defragDictBucketCallback(dict *d, dictEntry **bucketref) {
         dictEntry *de = *bucketref, *newde;
         if ((newde = activeDefragAlloc(de))) {
             *bucketref = newde;
+            if (dictHasEmbeddedKeys(d)) defragEmbeddedKey(d, newde, de);
             if (server.cluster_enabled && d == server.db[0].dict) {
                 /* Cluster keyspace dict. Update slot-to-entries mapping. */
                 slotToKeyReplaceEntry(newde, server.db);
             }
         }
+        /* The slots of open addressing tables hold a single entry. */
+        if (dictIsOpenAddressing(d)) break;
         bucketref = &(*bucketref)->next;
     }
 }
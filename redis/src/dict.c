@@ -40,9 +40,11 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <limits.h>
 #include <sys/time.h>
 
+#include "config.h"
 #include "dict.h"
 #include "zmalloc.h"
 #include "redisassert.h"
@@ -58,10 +60,17 @@
 static int dict_can_resize = 1;
 static unsigned int dict_force_resize_ratio = 5;
 
+/* Using dictEnableRehashStep() / dictDisableRehashStep() lookups stop
+ * moving buckets of tables being rehashed, so that several threads can
+ * read the same dictionaries at the same time. dictRehash() itself and
+ * updates are not affected. */
+static int dict_can_rehash_step = 1;
+
 /* -------------------------- private prototypes ---------------------------- */
 
 static int _dictExpandIfNeeded(dict *d);
 static signed char _dictNextExp(unsigned long size);
+static signed char _dictExpForSize(dict *d, unsigned long size);
 static long _dictKeyIndex(dict *d, const void *key, uint64_t hash, dictEntry **existing);
 static int _dictInit(dict *d, dictType *type);
 
@@ -91,6 +100,239 @@ uint64_t dictGenCaseHashFunction(const unsigned char *buf, size_t len) {
     return siphash_nocase(buf,len,dict_hash_function_seed);
 }
 
+/* ------------------------- open addressing tables ------------------------- */
+
+/* Dictionaries whose type sets 'openAddressing' don't chain their entries:
+ * every bucket of the table is a group of DICT_GROUP_SLOTS entry pointers
+ * filling a cache line, with a control byte for each slot holding 7 bits of
+ * the hash of its key, and an overflow counter. An entry is stored in the
+ * first group with a free slot starting from its home group (hash & mask),
+ * incrementing the overflow counter of every group it skips, so that
+ * lookups stop at the first group that never overflowed, usually the home
+ * one, and deletions don't need tombstones.
+ *
+ * The control bytes of a group are compared all together with the hash of
+ * the key looked up, so that only the entries with matching hash bits are
+ * dereferenced: a lookup usually touches one cache line of the table and,
+ * if the key is found, its entry, while chaining dereferences every entry
+ * of the chain.
+ *
+ * The table can't hold more entries than its slots, so it grows when the
+ * groups are on average DICT_GROUP_FILL/DICT_GROUP_SLOTS full, or 15/16
+ * full when resizing is disabled. Incremental rehashing and dictScan()
+ * work as for chained tables, a bucket being the group of the same index:
+ * a group is emptied when rehashed but keeps its overflow counter, so that
+ * the entries it overflowed to are still found.
+ *
+ * The new table of a rehashing is sized so that the rehashing steps done by
+ * the inserts finish it before it fills up. If it gets nearly full anyway,
+ * because rehashing was paused, new entries go to the old table, see
+ * _dictOAInsertNew(), and the rehashing changes its target once resumed, see
+ * _dictOARetarget(). The entries never move while rehashing is paused. */
+
+typedef struct dictGroup {
+    uint8_t ctrl[DICT_GROUP_SLOTS]; /* 0 if the slot is empty, or 0x80 | the
+                                     * 7 high bits of the hash of its key. */
+    uint8_t overflow;   /* Entries stored past this group while probing from
+                         * their home group, saturated at UINT8_MAX. */
+    dictEntry *slots[DICT_GROUP_SLOTS];
+} dictGroup;
+
+#define DICT_GROUP_FILL 6
+#define DICT_GROUP_LANES 0x0080808080808080ULL /* High bit of the ctrl bytes */
+
+#define dictGroups(d, htidx) ((dictGroup*)(d)->ht_table[htidx])
+#define dictCtrlByte(hash) ((uint8_t)(0x80 | ((hash) >> 57)))
+
+/* Returns a mask with the high bit of the i-th byte set for every slot i of
+ * the group whose control byte is 'c', comparing all the bytes at once in a
+ * 64 bit word. When 'c' is zero the result is exact, otherwise a full slot
+ * next to a matching one may be reported as well: callers compare the
+ * keys anyway, and empty slots are never reported. */
+static inline uint64_t _dictGroupMatch(const dictGroup *g, uint8_t c) {
+    uint64_t w;
+
+    memcpy(&w,g,sizeof(w)); /* Control bytes and overflow counter. */
+#if (BYTE_ORDER == BIG_ENDIAN)
+    w = __builtin_bswap64(w);
+#endif
+    w ^= 0x0101010101010101ULL * c;
+    return (w - 0x0101010101010101ULL) & ~w & DICT_GROUP_LANES;
+}
+
+#define _dictGroupIsEmpty(g) (_dictGroupMatch((g),0) == DICT_GROUP_LANES)
+#define _dictMatchSlot(m) (__builtin_ctzll(m) >> 3)
+
+/* Returns the reference to the slot of table 'htidx' holding 'key', or NULL
+ * if the key is not there. */
+static dictEntry **_dictOAFindRef(dict *d, int htidx, const void *key, uint64_t hash) {
+    unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[htidx]);
+    unsigned long idx = hash & mask, probes;
+    dictGroup *groups = dictGroups(d,htidx);
+    uint8_t c = dictCtrlByte(hash);
+
+    for (probes = 0; probes <= mask; probes++) {
+        dictGroup *g = groups+idx;
+        uint64_t m = _dictGroupMatch(g,c);
+        while (m) {
+            int i = _dictMatchSlot(m);
+            dictEntry *he = g->slots[i];
+            if (key==he->key || dictCompareKeys(d, key, he->key))
+                return &g->slots[i];
+            m &= m-1;
+        }
+        if (g->overflow == 0) break;
+        idx = (idx+1) & mask;
+    }
+    return NULL;
+}
+
+/* Takes the first free slot of table 'htidx' for a key with the given hash,
+ * returning its reference. The caller makes sure the table is not full. */
+static dictEntry **_dictOAInsertRef(dict *d, int htidx, uint64_t hash) {
+    unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[htidx]);
+    unsigned long idx = hash & mask;
+    dictGroup *groups = dictGroups(d,htidx);
+
+    assert(d->ht_used[htidx] < DICTHT_SIZE(d->ht_size_exp[htidx])*DICT_GROUP_SLOTS);
+    while(1) {
+        dictGroup *g = groups+idx;
+        uint64_t m = _dictGroupMatch(g,0);
+        if (m) {
+            int i = _dictMatchSlot(m);
+            g->ctrl[i] = dictCtrlByte(hash);
+            d->ht_used[htidx]++;
+            return &g->slots[i];
+        }
+        if (g->overflow != UINT8_MAX) g->overflow++;
+        idx = (idx+1) & mask;
+    }
+}
+
+/* Empties the slot 'ref' of table 'htidx', holding an entry with the given
+ * hash, and updates the overflow counters of the groups probed to reach it. */
+static void _dictOAClearRef(dict *d, int htidx, dictEntry **ref, uint64_t hash) {
+    unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[htidx]);
+    unsigned long idx = hash & mask;
+    dictGroup *groups = dictGroups(d,htidx);
+    unsigned long target = ((char*)ref - (char*)groups) / sizeof(dictGroup);
+    dictGroup *g = groups+target;
+
+    while (idx != target) {
+        if (groups[idx].overflow != UINT8_MAX) groups[idx].overflow--;
+        idx = (idx+1) & mask;
+    }
+    g->ctrl[ref - g->slots] = 0;
+    *ref = NULL;
+    d->ht_used[htidx]--;
+}
+
+/* Entries table 'htidx' takes before it is nearly full: tables are grown
+ * anyway when 15/16 full, see _dictExpandIfNeeded(). */
+static unsigned long _dictOACapacity(dict *d, int htidx) {
+    unsigned long slots = DICTHT_SIZE(d->ht_size_exp[htidx])*DICT_GROUP_SLOTS;
+    return slots - slots/16;
+}
+
+static int _dictOANearlyFull(dict *d, int htidx) {
+    return d->ht_used[htidx] >= _dictOACapacity(d,htidx);
+}
+
+/* Takes a slot for a new entry with the given hash, returning its reference.
+ * During rehashing new entries go to the new table, unless it is nearly full,
+ * which takes adding more entries than it was sized for while rehashing is
+ * paused: then they go to the old table, and rehashidx moves back to their
+ * group so that they are moved with the rest. When both tables are nearly
+ * full the free slots left are taken, the new table's first. */
+static dictEntry **_dictOAInsertNew(dict *d, uint64_t hash) {
+    int htidx = 1;
+
+    if (!dictIsRehashing(d)) return _dictOAInsertRef(d,0,hash);
+    if (_dictOANearlyFull(d,1) &&
+        (!_dictOANearlyFull(d,0) ||
+         d->ht_used[1] == DICTHT_SIZE(d->ht_size_exp[1])*DICT_GROUP_SLOTS))
+    {
+        htidx = 0;
+    }
+
+    dictEntry **ref = _dictOAInsertRef(d,htidx,hash);
+    if (htidx == 0) {
+        long idx = ((char*)ref - (char*)dictGroups(d,0)) / sizeof(dictGroup);
+        if (idx < d->rehashidx) d->rehashidx = idx;
+    }
+    return ref;
+}
+
+/* Called by dictRehash() when the entries of both tables don't fit in the new
+ * one, see _dictOAInsertNew(). If they fit in the old table, the rehashing
+ * goes the other way: the tables are swapped, no entry moves. Otherwise the
+ * entries of the new table move to a larger one, the only rehashing step that
+ * is not incremental. */
+static void _dictOARetarget(dict *d) {
+    unsigned long used = d->ht_used[0] + d->ht_used[1];
+
+    if (used <= _dictOACapacity(d,0)) {
+        dictEntry **table = d->ht_table[0];
+        signed char exp = d->ht_size_exp[0];
+        unsigned long tused = d->ht_used[0];
+
+        d->ht_table[0] = d->ht_table[1];
+        d->ht_size_exp[0] = d->ht_size_exp[1];
+        d->ht_used[0] = d->ht_used[1];
+        d->ht_table[1] = table;
+        d->ht_size_exp[1] = exp;
+        d->ht_used[1] = tused;
+        d->rehashidx = 0;
+        return;
+    }
+
+    dictGroup *old = dictGroups(d,1);
+    unsigned long size = DICTHT_SIZE(d->ht_size_exp[1]);
+
+    d->ht_size_exp[1] = _dictExpForSize(d, used+1);
+    d->ht_table[1] = zcalloc(DICTHT_SIZE(d->ht_size_exp[1])*sizeof(dictGroup));
+    d->ht_used[1] = 0;
+    for (unsigned long j = 0; j < size; j++) {
+        for (int i = 0; i < DICT_GROUP_SLOTS; i++) {
+            dictEntry *de = old[j].slots[i];
+            if (de) *_dictOAInsertRef(d,1,dictHashKey(d, de->key)) = de;
+        }
+    }
+    zfree(old);
+}
+
+/* Entries of open addressing tables have no 'next' pointer, unless it is
+ * needed to keep the metadata where dictMetadata() expects it. */
+static size_t _dictEntrySize(dict *d) {
+    if (dictIsOpenAddressing(d) && dictMetadataSize(d) == 0)
+        return offsetof(dictEntry,next);
+    return sizeof(dictEntry);
+}
+
+/* Size of the buckets of the tables of the dictionary. */
+static size_t _dictBucketSize(dict *d) {
+    return dictIsOpenAddressing(d) ? sizeof(dictGroup) : sizeof(dictEntry*);
+}
+
+/* Number of entry slots of table 'htidx', and the reference to the i-th. */
+static unsigned long _dictTableSlots(dict *d, int htidx) {
+    return DICTHT_SIZE(d->ht_size_exp[htidx]) *
+           (dictIsOpenAddressing(d) ? DICT_GROUP_SLOTS : 1);
+}
+
+static dictEntry **_dictSlotRef(dict *d, int htidx, unsigned long i) {
+    if (dictIsOpenAddressing(d))
+        return &dictGroups(d,htidx)[i/DICT_GROUP_SLOTS].slots[i%DICT_GROUP_SLOTS];
+    return &d->ht_table[htidx][i];
+}
+
+/* The exponent of the table size needed to store 'size' entries. */
+static signed char _dictExpForSize(dict *d, unsigned long size) {
+    if (dictIsOpenAddressing(d))
+        size = size/DICT_GROUP_FILL + (size%DICT_GROUP_FILL != 0);
+    return _dictNextExp(size);
+}
+
 /* ----------------------------- API implementation ------------------------- */
 
 /* Reset hash table parameters already initialized with _dictInit()*/
@@ -116,6 +358,7 @@ int _dictInit(dict *d, dictType *type)
     _dictReset(d, 0);
     _dictReset(d, 1);
     d->type = type;
+    d->embedded_keys_size = 0;
     d->rehashidx = -1;
     d->pauserehash = 0;
     return DICT_OK;
@@ -129,6 +372,11 @@ int dictResize(dict *d)
 
     if (!dict_can_resize || dictIsRehashing(d)) return DICT_ERR;
     minimal = d->ht_used[0];
+    /* An open addressing table also needs room for the entries added until
+     * the rehashing is done: at most one per rehashing step, and a step
+     * moves a group or skips 10 empty ones. */
+    if (dictIsOpenAddressing(d))
+        minimal = minimal*2 + DICTHT_SIZE(d->ht_size_exp[0])/10;
     if (minimal < DICT_HT_INITIAL_SIZE)
         minimal = DICT_HT_INITIAL_SIZE;
     return dictExpand(d, minimal);
@@ -149,11 +397,13 @@ int _dictExpand(dict *d, unsigned long size, int* malloc_failed)
     /* the new hash table */
     dictEntry **new_ht_table;
     unsigned long new_ht_used;
-    signed char new_ht_size_exp = _dictNextExp(size);
+    signed char new_ht_size_exp = _dictExpForSize(d, size);
+    size_t bucketsize = _dictBucketSize(d);
 
     /* Detect overflows */
     size_t newsize = 1ul<<new_ht_size_exp;
-    if (newsize < size || newsize * sizeof(dictEntry*) < newsize)
+    size_t capacity = dictIsOpenAddressing(d) ? newsize*DICT_GROUP_FILL : newsize;
+    if (capacity < size || newsize * bucketsize < newsize)
         return DICT_ERR;
 
     /* Rehashing to the same table size is not useful. */
@@ -161,12 +411,12 @@ int _dictExpand(dict *d, unsigned long size, int* malloc_failed)
 
     /* Allocate the new hash table and initialize all pointers to NULL */
     if (malloc_failed) {
-        new_ht_table = ztrycalloc(newsize*sizeof(dictEntry*));
+        new_ht_table = ztrycalloc(newsize*bucketsize);
         *malloc_failed = new_ht_table == NULL;
         if (*malloc_failed)
             return DICT_ERR;
     } else
-        new_ht_table = zcalloc(newsize*sizeof(dictEntry*));
+        new_ht_table = zcalloc(newsize*bucketsize);
 
     new_ht_used = 0;
 
@@ -211,6 +461,12 @@ int dictTryExpand(dict *d, unsigned long size) {
 int dictRehash(dict *d, int n) {
     int empty_visits = n*10; /* Max number of empty buckets to visit. */
     if (!dictIsRehashing(d)) return 0;
+    if (dictIsOpenAddressing(d) && d->ht_used[0] != 0 &&
+        d->ht_used[0] + d->ht_used[1] > _dictOACapacity(d,1))
+    {
+        if (d->pauserehash > 0) return 1;
+        _dictOARetarget(d);
+    }
 
     while(n-- && d->ht_used[0] != 0) {
         dictEntry *de, *nextde;
@@ -218,6 +474,25 @@ int dictRehash(dict *d, int n) {
         /* Note that rehashidx can't overflow as we are sure there are more
          * elements because ht[0].used != 0 */
         assert(DICTHT_SIZE(d->ht_size_exp[0]) > (unsigned long)d->rehashidx);
+        if (dictIsOpenAddressing(d)) {
+            dictGroup *g = dictGroups(d,0)+d->rehashidx;
+            while(_dictGroupIsEmpty(g)) {
+                d->rehashidx++;
+                g++;
+                if (--empty_visits == 0) return 1;
+            }
+            /* Move the entries of this group, leaving its overflow counter
+             * for the lookups of the entries still to move after it. */
+            for (int i = 0; i < DICT_GROUP_SLOTS; i++) {
+                if ((de = g->slots[i]) == NULL) continue;
+                *_dictOAInsertRef(d,1,dictHashKey(d, de->key)) = de;
+                g->slots[i] = NULL;
+                g->ctrl[i] = 0;
+                d->ht_used[0]--;
+            }
+            d->rehashidx++;
+            continue;
+        }
         while(d->ht_table[0][d->rehashidx] == NULL) {
             d->rehashidx++;
             if (--empty_visits == 0) return 1;
@@ -288,7 +563,7 @@ int dictRehashMilliseconds(dict *d, int ms) {
  * dictionary so that the hash table automatically migrates from H1 to H2
  * while it is actively used. */
 static void _dictRehashStep(dict *d) {
-    if (d->pauserehash == 0) dictRehash(d,1);
+    if (d->pauserehash == 0 && dict_can_rehash_step) dictRehash(d,1);
 }
 
 /* Add an element to the target hash table */
@@ -324,12 +599,14 @@ dictEntry *dictAddRaw(dict *d, void *key, dictEntry **existing)
     long index;
     dictEntry *entry;
     int htidx;
+    uint64_t hash;
 
     if (dictIsRehashing(d)) _dictRehashStep(d);
 
     /* Get the index of the new element, or -1 if
      * the element already exists. */
-    if ((index = _dictKeyIndex(d, key, dictHashKey(d,key), existing)) == -1)
+    hash = dictHashKey(d,key);
+    if ((index = _dictKeyIndex(d, key, hash, existing)) == -1)
         return NULL;
 
     /* Allocate the memory and store the new entry.
@@ -338,16 +615,26 @@ dictEntry *dictAddRaw(dict *d, void *key, dictEntry **existing)
      * more frequently. */
     htidx = dictIsRehashing(d) ? 1 : 0;
     size_t metasize = dictMetadataSize(d);
-    entry = zmalloc(sizeof(*entry) + metasize);
+    size_t keysize = dictHasEmbeddedKeys(d) ? d->type->keyEmbedLen(d, key) : 0;
+    entry = zmalloc(_dictEntrySize(d) + metasize + keysize);
     if (metasize > 0) {
         memset(dictMetadata(entry), 0, metasize);
     }
-    entry->next = d->ht_table[htidx][index];
-    d->ht_table[htidx][index] = entry;
-    d->ht_used[htidx]++;
+    if (dictIsOpenAddressing(d)) {
+        *_dictOAInsertNew(d, hash) = entry;
+    } else {
+        entry->next = d->ht_table[htidx][index];
+        d->ht_table[htidx][index] = entry;
+        d->ht_used[htidx]++;
+    }
 
     /* Set the hash entry fields. */
-    dictSetKey(d, entry, key);
+    if (keysize) {
+        entry->key = d->type->keyEmbed(d, (char*)entry + _dictEntrySize(d) + metasize, key);
+        d->embedded_keys_size += keysize;
+    } else {
+        dictSetKey(d, entry, key);
+    }
     return entry;
 }
 
@@ -372,8 +659,9 @@ int dictReplace(dict *d, void *key, void *val)
      * to do that in this order, as the value may just be exactly the same
      * as the previous one. In this context, think to reference counting,
      * you want to increment (set), and then decrement (free), and not the
-     * reverse. */
-    auxentry = *existing;
+     * reverse. Only the value is copied, as entries of open addressing
+     * tables are shorter than a dictEntry. */
+    auxentry.v = existing->v;
     dictSetVal(d, existing, val);
     dictFreeVal(d, &auxentry);
     return 0;
@@ -407,6 +695,19 @@ static dictEntry *dictGenericDelete(dict *d, const void *key, int nofree) {
     h = dictHashKey(d, key);
 
     for (table = 0; table <= 1; table++) {
+        if (dictIsOpenAddressing(d)) {
+            dictEntry **ref = _dictOAFindRef(d, table, key, h);
+            if (ref) {
+                he = *ref;
+                _dictOAClearRef(d, table, ref, h);
+                if (!nofree) {
+                    dictFreeUnlinkedEntry(d, he);
+                }
+                return he;
+            }
+            if (!dictIsRehashing(d)) break;
+            continue;
+        }
         idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         he = d->ht_table[table][idx];
         prevHe = NULL;
@@ -466,6 +767,8 @@ dictEntry *dictUnlink(dict *d, const void *key) {
  * to dictUnlink(). It's safe to call this function with 'he' = NULL. */
 void dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
     if (he == NULL) return;
+    if (dictHasEmbeddedKeys(d))
+        d->embedded_keys_size -= d->type->keyEmbedLen(d, he->key);
     dictFreeKey(d, he);
     dictFreeVal(d, he);
     zfree(he);
@@ -481,6 +784,17 @@ int _dictClear(dict *d, int htidx, void(callback)(dict*)) {
 
         if (callback && (i & 65535) == 0) callback(d);
 
+        if (dictIsOpenAddressing(d)) {
+            dictGroup *g = dictGroups(d,htidx)+i;
+            for (int j = 0; j < DICT_GROUP_SLOTS; j++) {
+                if ((he = g->slots[j]) == NULL) continue;
+                dictFreeKey(d, he);
+                dictFreeVal(d, he);
+                zfree(he);
+                d->ht_used[htidx]--;
+            }
+            continue;
+        }
         if ((he = d->ht_table[htidx][i]) == NULL) continue;
         while(he) {
             nextHe = he->next;
@@ -515,6 +829,12 @@ dictEntry *dictFind(dict *d, const void *key)
     if (dictIsRehashing(d)) _dictRehashStep(d);
     h = dictHashKey(d, key);
     for (table = 0; table <= 1; table++) {
+        if (dictIsOpenAddressing(d)) {
+            dictEntry **ref = _dictOAFindRef(d, table, key, h);
+            if (ref) return *ref;
+            if (!dictIsRehashing(d)) return NULL;
+            continue;
+        }
         idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         he = d->ht_table[table][idx];
         while(he) {
@@ -603,7 +923,7 @@ dictEntry *dictNext(dictIterator *iter)
                     iter->fingerprint = dictFingerprint(iter->d);
             }
             iter->index++;
-            if (iter->index >= (long) DICTHT_SIZE(iter->d->ht_size_exp[iter->table])) {
+            if (iter->index >= (long) _dictTableSlots(iter->d, iter->table)) {
                 if (dictIsRehashing(iter->d) && iter->table == 0) {
                     iter->table++;
                     iter->index = 0;
@@ -611,14 +931,15 @@ dictEntry *dictNext(dictIterator *iter)
                     break;
                 }
             }
-            iter->entry = iter->d->ht_table[iter->table][iter->index];
+            iter->entry = *_dictSlotRef(iter->d, iter->table, iter->index);
         } else {
             iter->entry = iter->nextEntry;
         }
         if (iter->entry) {
             /* We need to save the 'next' here, the iterator user
-             * may delete the entry we are returning. */
-            iter->nextEntry = iter->entry->next;
+             * may delete the entry we are returning. The slots of open
+             * addressing tables hold a single entry. */
+            iter->nextEntry = dictIsOpenAddressing(iter->d) ? NULL : iter->entry->next;
             return iter->entry;
         }
     }
@@ -646,6 +967,17 @@ dictEntry *dictGetRandomKey(dict *d)
 
     if (dictSize(d) == 0) return NULL;
     if (dictIsRehashing(d)) _dictRehashStep(d);
+    if (dictIsOpenAddressing(d)) {
+        /* Every slot holds at most one entry, so any full slot will do.
+         * The groups of ht[0] already rehashed are empty. */
+        unsigned long s0 = _dictTableSlots(d,0);
+        unsigned long skip = dictIsRehashing(d) ? d->rehashidx*DICT_GROUP_SLOTS : 0;
+        do {
+            h = skip + (randomULong() % (dictSlots(d) - skip));
+            he = (h >= s0) ? *_dictSlotRef(d,1,h - s0) : *_dictSlotRef(d,0,h);
+        } while(he == NULL);
+        return he;
+    }
     if (dictIsRehashing(d)) {
         unsigned long s0 = DICTHT_SIZE(d->ht_size_exp[0]);
         do {
@@ -741,17 +1073,32 @@ unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count) {
                     continue;
             }
             if (i >= DICTHT_SIZE(d->ht_size_exp[j])) continue; /* Out of range for this table. */
-            dictEntry *he = d->ht_table[j][i];
+            int empty;
+            if (dictIsOpenAddressing(d))
+                empty = _dictGroupIsEmpty(dictGroups(d,j)+i);
+            else
+                empty = d->ht_table[j][i] == NULL;
 
             /* Count contiguous empty buckets, and jump to other
              * locations if they reach 'count' (with a minimum of 5). */
-            if (he == NULL) {
+            if (empty) {
                 emptylen++;
                 if (emptylen >= 5 && emptylen > count) {
                     i = randomULong() & maxsizemask;
                     emptylen = 0;
                 }
+            } else if (dictIsOpenAddressing(d)) {
+                dictGroup *g = dictGroups(d,j)+i;
+                emptylen = 0;
+                for (int k = 0; k < DICT_GROUP_SLOTS; k++) {
+                    if (g->slots[k] == NULL) continue;
+                    *des = g->slots[k];
+                    des++;
+                    stored++;
+                    if (stored == count) return stored;
+                }
             } else {
+                dictEntry *he = d->ht_table[j][i];
                 emptylen = 0;
                 while (he) {
                     /* Collect all the elements of the buckets found non
@@ -805,6 +1152,50 @@ static unsigned long rev(unsigned long v) {
     return v;
 }
 
+/* Emits the entries of table 'htidx' whose home bucket is 'idx'. */
+static void _dictScanBucket(dict *d, int htidx, unsigned long idx,
+                            dictScanFunction *fn,
+                            dictScanBucketFunction* bucketfn,
+                            void *privdata)
+{
+    const dictEntry *de, *next;
+
+    if (dictIsOpenAddressing(d)) {
+        unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[htidx]);
+        unsigned long gidx = idx;
+        dictGroup *groups = dictGroups(d,htidx), *g;
+        /* The entries are collected before calling 'fn', that may
+         * delete them. */
+        const dictEntry *found[DICT_GROUP_SLOTS];
+        /* The entries of the home group all belong to it, unless the
+         * previous group overflowed. */
+        int filter = groups[(idx-1) & mask].overflow != 0;
+
+        do {
+            int j, n = 0;
+            g = groups+gidx;
+            for (j = 0; j < DICT_GROUP_SLOTS; j++) {
+                if ((de = g->slots[j]) == NULL) continue;
+                if (filter && (dictHashKey(d, de->key) & mask) != idx) continue;
+                if (bucketfn) bucketfn(d, &g->slots[j]);
+                found[n++] = g->slots[j];
+            }
+            for (j = 0; j < n; j++) fn(privdata, found[j]);
+            filter = 1;
+            gidx = (gidx+1) & mask;
+        } while(g->overflow && gidx != idx);
+        return;
+    }
+
+    if (bucketfn) bucketfn(d, &d->ht_table[htidx][idx]);
+    de = d->ht_table[htidx][idx];
+    while (de) {
+        next = de->next;
+        fn(privdata, de);
+        de = next;
+    }
+}
+
 /* dictScan() is used to iterate over the elements of a dictionary.
  *
  * Iterating works the following way:
@@ -874,6 +1265,14 @@ static unsigned long rev(unsigned long v) {
  * table. This reduces the problem back to having only one table, where
  * the larger one, if it exists, is just an expansion of the smaller one.
  *
+ * AND WITH OPEN ADDRESSING?
+ *
+ * Entries are not necessarily stored in their home bucket, but in the
+ * first bucket with a free slot after it, so the cursor selects the entries
+ * by home bucket instead: the buckets they may have overflowed to are
+ * visited as well, emitting only the entries whose home is the cursor.
+ * The guarantees are then the same as with chaining.
+ *
  * LIMITATIONS
  *
  * This iterator is completely stateless, and this is a huge advantage,
@@ -896,7 +1295,6 @@ unsigned long dictScan(dict *d,
                        void *privdata)
 {
     int htidx0, htidx1;
-    const dictEntry *de, *next;
     unsigned long m0, m1;
 
     if (dictSize(d) == 0) return 0;
@@ -909,13 +1307,7 @@ unsigned long dictScan(dict *d,
         m0 = DICTHT_SIZE_MASK(d->ht_size_exp[htidx0]);
 
         /* Emit entries at cursor */
-        if (bucketfn) bucketfn(d, &d->ht_table[htidx0][v & m0]);
-        de = d->ht_table[htidx0][v & m0];
-        while (de) {
-            next = de->next;
-            fn(privdata, de);
-            de = next;
-        }
+        _dictScanBucket(d, htidx0, v & m0, fn, bucketfn, privdata);
 
         /* Set unmasked bits so incrementing the reversed cursor
          * operates on the masked bits */
@@ -940,25 +1332,13 @@ unsigned long dictScan(dict *d,
         m1 = DICTHT_SIZE_MASK(d->ht_size_exp[htidx1]);
 
         /* Emit entries at cursor */
-        if (bucketfn) bucketfn(d, &d->ht_table[htidx0][v & m0]);
-        de = d->ht_table[htidx0][v & m0];
-        while (de) {
-            next = de->next;
-            fn(privdata, de);
-            de = next;
-        }
+        _dictScanBucket(d, htidx0, v & m0, fn, bucketfn, privdata);
 
         /* Iterate over indices in larger table that are the expansion
          * of the index pointed to by the cursor in the smaller table */
         do {
             /* Emit entries at cursor */
-            if (bucketfn) bucketfn(d, &d->ht_table[htidx1][v & m1]);
-            de = d->ht_table[htidx1][v & m1];
-            while (de) {
-                next = de->next;
-                fn(privdata, de);
-                de = next;
-            }
+            _dictScanBucket(d, htidx1, v & m1, fn, bucketfn, privdata);
 
             /* Increment the reverse cursor not covered by the smaller mask.*/
             v |= ~m1;
@@ -975,6 +1355,69 @@ unsigned long dictScan(dict *d,
     return v;
 }
 
+/* Calls 'fn' for the entries of the next 'count' slots of table 'htidx',
+ * starting from 'slot', where a slot is a bucket of a chained table or one
+ * of the entries of a group of an open addressing table. Returns the slot
+ * to continue from, or 0 once the end of the table is reached.
+ *
+ * Unlike dictScan() the slots are walked in order and nothing is done about
+ * rehashing: entries don't change slot as long as the tables are not
+ * rehashed, so a caller pausing rehashing for the whole walk sees every
+ * entry present from the start to the end of it exactly once, and can
+ * tell whether an entry was already walked using dictFindSlot(). */
+unsigned long dictWalkSlots(dict *d, int htidx, unsigned long slot,
+                            unsigned long count,
+                            dictScanFunction *fn, void *privdata)
+{
+    unsigned long slots = _dictTableSlots(d,htidx);
+
+    while (count-- && slot < slots) {
+        dictEntry *he = *_dictSlotRef(d,htidx,slot);
+        while (he) {
+            dictEntry *next = dictIsOpenAddressing(d) ? NULL : he->next;
+            fn(privdata,he);
+            he = next;
+        }
+        slot++;
+    }
+    return slot < slots ? slot : 0;
+}
+
+/* Like dictFind(), without performing a rehashing step, but also stores in
+ * '*htidx' and '*slot' where the entry is, see dictWalkSlots(). */
+dictEntry *dictFindSlot(dict *d, const void *key, int *htidx, unsigned long *slot) {
+    uint64_t h;
+    int table;
+
+    if (dictSize(d) == 0) return NULL;
+    h = dictHashKey(d, key);
+    for (table = 0; table <= 1; table++) {
+        if (dictIsOpenAddressing(d)) {
+            dictEntry **ref = _dictOAFindRef(d, table, key, h);
+            if (ref) {
+                dictGroup *g = dictGroups(d,table);
+                unsigned long group = ((char*)ref - (char*)g) / sizeof(dictGroup);
+                *htidx = table;
+                *slot = group*DICT_GROUP_SLOTS + (ref - g[group].slots);
+                return *ref;
+            }
+        } else {
+            unsigned long idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
+            dictEntry *he = d->ht_table[table][idx];
+            while (he) {
+                if (key==he->key || dictCompareKeys(d, key, he->key)) {
+                    *htidx = table;
+                    *slot = idx;
+                    return he;
+                }
+                he = he->next;
+            }
+        }
+        if (!dictIsRehashing(d)) break;
+    }
+    return NULL;
+}
+
 /* ------------------------- private functions ------------------------------ */
 
 /* Because we may need to allocate huge memory chunk at once when dict
@@ -982,9 +1425,11 @@ unsigned long dictScan(dict *d,
  * type has expandAllowed member function. */
 static int dictTypeExpandAllowed(dict *d) {
     if (d->type->expandAllowed == NULL) return 1;
+    unsigned long capacity = DICTHT_SIZE(d->ht_size_exp[0]) *
+                             (dictIsOpenAddressing(d) ? DICT_GROUP_FILL : 1);
     return d->type->expandAllowed(
-                    DICTHT_SIZE(_dictNextExp(d->ht_used[0] + 1)) * sizeof(dictEntry*),
-                    (double)d->ht_used[0] / DICTHT_SIZE(d->ht_size_exp[0]));
+                    DICTHT_SIZE(_dictExpForSize(d, d->ht_used[0] + 1)) * _dictBucketSize(d),
+                    (double)d->ht_used[0] / capacity);
 }
 
 /* Expand the hash table if needed */
@@ -996,6 +1441,18 @@ static int _dictExpandIfNeeded(dict *d)
     /* If the hash table is empty expand it to the initial size. */
     if (DICTHT_SIZE(d->ht_size_exp[0]) == 0) return dictExpand(d, DICT_HT_INITIAL_SIZE);
 
+    /* Open addressing tables grow when the groups are DICT_GROUP_FILL full on
+     * average, if allowed. They can't exceed their slots, though, so they
+     * always grow when 15/16 full. */
+    if (dictIsOpenAddressing(d)) {
+        if (d->ht_used[0] >= DICTHT_SIZE(d->ht_size_exp[0])*DICT_GROUP_FILL &&
+            (_dictOANearlyFull(d,0) || (dict_can_resize && dictTypeExpandAllowed(d))))
+        {
+            return dictExpand(d, d->ht_used[0] + 1);
+        }
+        return DICT_OK;
+    }
+
     /* If we reached the 1:1 ratio, and we are allowed to resize the hash
      * table (global setting) or we should avoid it but the ratio between
      * elements/buckets is over the "safe" threshold, we resize doubling
@@ -1041,6 +1498,17 @@ static long _dictKeyIndex(dict *d, const void *key, uint64_t hash, dictEntry **e
     if (_dictExpandIfNeeded(d) == DICT_ERR)
         return -1;
     for (table = 0; table <= 1; table++) {
+        if (dictIsOpenAddressing(d)) {
+            /* The slot is only taken by dictAddRaw(), the index is unused. */
+            dictEntry **ref = _dictOAFindRef(d, table, key, hash);
+            if (ref) {
+                if (existing) *existing = *ref;
+                return -1;
+            }
+            idx = 0;
+            if (!dictIsRehashing(d)) break;
+            continue;
+        }
         idx = hash & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         /* Search if this slot does not already contain the given key */
         he = d->ht_table[table][idx];
@@ -1059,6 +1527,7 @@ static long _dictKeyIndex(dict *d, const void *key, uint64_t hash, dictEntry **e
 void dictEmpty(dict *d, void(callback)(dict*)) {
     _dictClear(d,0,callback);
     _dictClear(d,1,callback);
+    d->embedded_keys_size = 0;
     d->rehashidx = -1;
     d->pauserehash = 0;
 }
@@ -1071,6 +1540,14 @@ void dictDisableResize(void) {
     dict_can_resize = 0;
 }
 
+void dictEnableRehashStep(void) {
+    dict_can_rehash_step = 1;
+}
+
+void dictDisableRehashStep(void) {
+    dict_can_rehash_step = 0;
+}
+
 uint64_t dictGetHash(dict *d, const void *key) {
     return dictHashKey(d, key);
 }
@@ -1086,6 +1563,25 @@ dictEntry **dictFindEntryRefByPtrAndHash(dict *d, const void *oldptr, uint64_t h
 
     if (dictSize(d) == 0) return NULL; /* dict is empty */
     for (table = 0; table <= 1; table++) {
+        if (dictIsOpenAddressing(d)) {
+            unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[table]), probes;
+            uint8_t c = dictCtrlByte(hash);
+            idx = hash & mask;
+            for (probes = 0; probes <= mask; probes++) {
+                dictGroup *g = dictGroups(d,table)+idx;
+                uint64_t m = _dictGroupMatch(g,c);
+                while (m) {
+                    heref = &g->slots[_dictMatchSlot(m)];
+                    if (oldptr==(*heref)->key)
+                        return heref;
+                    m &= m-1;
+                }
+                if (g->overflow == 0) break;
+                idx = (idx+1) & mask;
+            }
+            if (!dictIsRehashing(d)) return NULL;
+            continue;
+        }
         idx = hash & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         heref = &d->ht_table[table][idx];
         he = *heref;
@@ -1100,9 +1596,157 @@ dictEntry **dictFindEntryRefByPtrAndHash(dict *d, const void *oldptr, uint64_t h
     return NULL;
 }
 
+/* Returns the memory used by a dictEntry and its embedded key, not counting
+ * its metadata. */
+size_t dictEntryMemUsage(dict *d, dictEntry *de) {
+    size_t size = _dictEntrySize(d);
+    if (dictHasEmbeddedKeys(d)) size += d->type->keyEmbedLen(d, de->key);
+    return size;
+}
+
+/* Fixes the embedded key of the entry 'olde' after it was moved to 'newde',
+ * as done by active defrag. 'olde' is only used as an address. */
+void dictEntryMoved(dict *d, dictEntry *newde, dictEntry *olde) {
+    if (dictHasEmbeddedKeys(d))
+        newde->key = (char*)newde + ((char*)newde->key - (char*)olde);
+}
+
+/* Returns the memory used by the tables and the entries of the dictionary,
+ * not counting the dict struct, the metadata of the entries, the embedded
+ * keys (see dictEmbeddedKeysSize()), and what keys and values point to. */
+size_t dictMemUsage(dict *d) {
+    return dictBuckets(d) * _dictBucketSize(d) +
+           dictSize(d) * _dictEntrySize(d);
+}
+
+/* ------------------------------- Prefetching -------------------------------*/
+
+#define DICT_PREFETCH_BATCH 64
+
+/* Prefetches the memory that the lookups of a batch of keys, given their
+ * hashes, are going to touch: the buckets of all the keys first, then the
+ * entries they reference, then the keys and values of the entries. This way
+ * the cache misses of every step are served in parallel, instead of one
+ * after the other as the lookups do. Only the first entry of a chain, or the
+ * first one with a matching control byte of a group, is prefetched.
+ *
+ * 'valPrefetch' is NULL unless the values are pointers: then they are
+ * prefetched as well, and 'valPrefetch' is finally called with each of them,
+ * at that point in the cache, to prefetch what the value references. */
+void dictPrefetch(dict *d, const uint64_t *hashes, int count,
+                  void (*valPrefetch)(const void *val))
+{
+    void *refs[DICT_PREFETCH_BATCH];
+    int j, n;
+
+    if (dictSize(d) == 0) return;
+    while (count > 0) {
+        n = count < DICT_PREFETCH_BATCH ? count : DICT_PREFETCH_BATCH;
+
+        /* Buckets: during rehashing the ones below rehashidx were moved
+         * to the new table. */
+        for (j = 0; j < n; j++) {
+            uint64_t h = hashes[j];
+            unsigned long idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
+            int table = 0;
+            if (dictIsRehashing(d) && (long)idx < d->rehashidx) {
+                table = 1;
+                idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[1]);
+            }
+            refs[j] = dictIsOpenAddressing(d) ?
+                      (void*)(dictGroups(d,table)+idx) :
+                      (void*)(d->ht_table[table]+idx);
+            __builtin_prefetch(refs[j]);
+        }
+
+        /* Entries */
+        for (j = 0; j < n; j++) {
+            dictEntry *de;
+            if (dictIsOpenAddressing(d)) {
+                dictGroup *g = refs[j];
+                uint64_t m = _dictGroupMatch(g,dictCtrlByte(hashes[j]));
+                de = m ? g->slots[_dictMatchSlot(m)] : NULL;
+            } else {
+                de = *(dictEntry**)refs[j];
+            }
+            if (de) __builtin_prefetch(de);
+            refs[j] = de;
+        }
+
+        /* Keys and values */
+        for (j = 0; j < n; j++) {
+            dictEntry *de = refs[j];
+            if (de == NULL) continue;
+            __builtin_prefetch(de->key);
+            if (valPrefetch) __builtin_prefetch(de->v.val);
+        }
+
+        if (valPrefetch) {
+            for (j = 0; j < n; j++) {
+                dictEntry *de = refs[j];
+                if (de) valPrefetch(de->v.val);
+            }
+        }
+        hashes += n;
+        count -= n;
+    }
+}
+
 /* ------------------------------- Debugging ---------------------------------*/
 
 #define DICT_STATS_VECTLEN 50
+
+/* Stats of open addressing tables: the probe length of an entry is the
+ * number of groups visited to find it, one if it's in its home group. */
+static size_t _dictGetStatsOAHt(char *buf, size_t bufsize, dict *d, int htidx) {
+    unsigned long i, probelen, maxprobelen = 0, fullgroups = 0;
+    unsigned long totprobelen = 0, overflowing = 0;
+    unsigned long plvector[DICT_STATS_VECTLEN];
+    unsigned long groups = DICTHT_SIZE(d->ht_size_exp[htidx]);
+    unsigned long mask = DICTHT_SIZE_MASK(d->ht_size_exp[htidx]);
+    size_t l = 0;
+
+    for (i = 0; i < DICT_STATS_VECTLEN; i++) plvector[i] = 0;
+    for (i = 0; i < groups; i++) {
+        dictGroup *g = dictGroups(d,htidx)+i;
+
+        if (_dictGroupMatch(g,0) == 0) fullgroups++;
+        if (g->overflow) overflowing++;
+        for (int j = 0; j < DICT_GROUP_SLOTS; j++) {
+            if (g->slots[j] == NULL) continue;
+            probelen = ((i - (dictHashKey(d, g->slots[j]->key) & mask)) & mask) + 1;
+            plvector[(probelen < DICT_STATS_VECTLEN) ? probelen : (DICT_STATS_VECTLEN-1)]++;
+            if (probelen > maxprobelen) maxprobelen = probelen;
+            totprobelen += probelen;
+        }
+    }
+
+    /* Generate human readable stats. */
+    l += snprintf(buf+l,bufsize-l,
+        "Hash table %d stats (%s):\n"
+        " table size: %lu\n"
+        " number of elements: %lu\n"
+        " groups: %lu (%lu full, %lu overflowing)\n"
+        " max probe length: %lu\n"
+        " avg probe length: %.02f\n"
+        " Probe length distribution:\n",
+        htidx, (htidx == 0) ? "main hash table" : "rehashing target",
+        groups*DICT_GROUP_SLOTS, d->ht_used[htidx], groups, fullgroups,
+        overflowing, maxprobelen, (float)totprobelen/d->ht_used[htidx]);
+
+    for (i = 1; i < DICT_STATS_VECTLEN; i++) {
+        if (plvector[i] == 0) continue;
+        if (l >= bufsize) break;
+        l += snprintf(buf+l,bufsize-l,
+            "   %ld: %ld (%.02f%%)\n",
+            i, plvector[i], ((float)plvector[i]/d->ht_used[htidx])*100);
+    }
+
+    /* Unlike snprintf(), return the number of characters actually written. */
+    if (bufsize) buf[bufsize-1] = '\0';
+    return strlen(buf);
+}
+
 size_t _dictGetStatsHt(char *buf, size_t bufsize, dict *d, int htidx) {
     unsigned long i, slots = 0, chainlen, maxchainlen = 0;
     unsigned long totchainlen = 0;
@@ -1113,6 +1757,7 @@ size_t _dictGetStatsHt(char *buf, size_t bufsize, dict *d, int htidx) {
         return snprintf(buf,bufsize,
             "No stats available for empty dictionaries\n");
     }
+    if (dictIsOpenAddressing(d)) return _dictGetStatsOAHt(buf,bufsize,d,htidx);
 
     /* Compute stats. */
     for (i = 0; i < DICT_STATS_VECTLEN; i++) clvector[i] = 0;
@@ -1227,30 +1872,36 @@ dictType BenchmarkDictType = {
     NULL
 };
 
+dictType BenchmarkOADictType = {
+    hashCallback,
+    NULL,
+    NULL,
+    compareCallback,
+    freeCallback,
+    NULL,
+    NULL,
+    NULL,
+    1
+};
+
+static void scanCountCallback(void *privdata, const dictEntry *de) {
+    UNUSED(de);
+    (*(long*)privdata)++;
+}
+
 #define start_benchmark() start = timeInMilliseconds()
 #define end_benchmark(msg) do { \
     elapsed = timeInMilliseconds()-start; \
     printf(msg ": %ld items in %lld ms\n", count, elapsed); \
 } while(0)
 
-/* ./redis-server test dict [<count> | --accurate] */
-int dictTest(int argc, char **argv, int flags) {
-    long j;
+static void dictBenchmark(dictType *type, long count) {
+    long j, scanned = 0;
     long long start, elapsed;
-    dict *dict = dictCreate(&BenchmarkDictType);
-    long count = 0;
-    int accurate = (flags & REDIS_TEST_ACCURATE);
-
-    if (argc == 4) {
-        if (accurate) {
-            count = 5000000;
-        } else {
-            count = strtol(argv[3],NULL,10);
-        }
-    } else {
-        count = 5000;
-    }
+    unsigned long cursor = 0;
+    dict *dict = dictCreate(type);
 
+    printf("%s dict:\n", type->openAddressing ? "Open addressing" : "Chained");
     start_benchmark();
     for (j = 0; j < count; j++) {
         int retval = dictAdd(dict,stringFromLongLong(j),(void*)j);
@@ -1258,6 +1909,14 @@ int dictTest(int argc, char **argv, int flags) {
     }
     end_benchmark("Inserting");
     assert((long)dictSize(dict) == count);
+    printf("Memory used by the tables and entries: %zu bytes per element\n",
+           dictMemUsage(dict)/count);
+
+    /* Every element is reported by a scan, even if rehashing. */
+    do {
+        cursor = dictScan(dict,cursor,scanCountCallback,NULL,&scanned);
+    } while(cursor);
+    assert(scanned >= count);
 
     /* Wait for rehashing. */
     while (dictIsRehashing(dict)) {
@@ -1319,6 +1978,87 @@ int dictTest(int argc, char **argv, int flags) {
     }
     end_benchmark("Removing and adding");
     dictRelease(dict);
+}
+
+static void dictTestAdd(dict *d, long j) {
+    int retval = dictAdd(d,stringFromLongLong(j),(void*)j);
+    assert(retval == DICT_OK);
+}
+
+/* Adds entries during a safe iteration of a dictionary being rehashed, until
+ * both of its tables are nearly full: the iteration still returns the entries
+ * it started with once. Then shrinks the dictionary and adds entries while
+ * rehashing is paused again. */
+static void dictTestPausedRehashing(dictType *type, long count) {
+    long j, added = 0, before;
+    dict *dict = dictCreate(type);
+    dictIterator *iter;
+    dictEntry *de;
+    unsigned char *seen;
+
+    while (added < count || !dictIsRehashing(dict)) dictTestAdd(dict,added++);
+    before = added;
+    seen = zcalloc(before);
+    iter = dictGetSafeIterator(dict);
+    for (j = 0; j < before/2 && (de = dictNext(iter)) != NULL; j++) {
+        if ((long)dictGetVal(de) < before) seen[(long)dictGetVal(de)]++;
+    }
+    while (!_dictOANearlyFull(dict,0) || !_dictOANearlyFull(dict,1))
+        dictTestAdd(dict,added++);
+    while ((de = dictNext(iter)) != NULL) {
+        if ((long)dictGetVal(de) < before) seen[(long)dictGetVal(de)]++;
+    }
+    dictReleaseIterator(iter);
+    for (j = 0; j < before; j++) assert(seen[j] == 1);
+    zfree(seen);
+
+    while (dictIsRehashing(dict)) dictRehash(dict,100);
+    assert((long)dictSize(dict) == added);
+    for (j = 0; j < added; j++) {
+        char *key = stringFromLongLong(j);
+        assert(dictFind(dict,key) != NULL);
+        zfree(key);
+    }
+
+    for (j = 0; j < added-added/100; j++) {
+        char *key = stringFromLongLong(j);
+        assert(dictDelete(dict,key) == DICT_OK);
+        zfree(key);
+    }
+    assert(dictResize(dict) == DICT_OK);
+    dictPauseRehashing(dict);
+    for (j = 0; j < added-added/100; j++) dictTestAdd(dict,j);
+    dictResumeRehashing(dict);
+
+    for (j = 0; j < added; j++) {
+        char *key = stringFromLongLong(j);
+        assert(dictFind(dict,key) != NULL);
+        zfree(key);
+    }
+    while (dictIsRehashing(dict)) dictRehash(dict,100);
+    assert((long)dictSize(dict) == added);
+    printf("Adding while rehashing is paused: %ld items ok\n", added);
+    dictRelease(dict);
+}
+
+/* ./redis-server test dict [<count> | --accurate] */
+int dictTest(int argc, char **argv, int flags) {
+    long count = 0;
+    int accurate = (flags & REDIS_TEST_ACCURATE);
+
+    if (argc == 4) {
+        if (accurate) {
+            count = 5000000;
+        } else {
+            count = strtol(argv[3],NULL,10);
+        }
+    } else {
+        count = 5000;
+    }
+
+    dictBenchmark(&BenchmarkDictType,count);
+    dictBenchmark(&BenchmarkOADictType,count);
+    dictTestPausedRehashing(&BenchmarkOADictType,count);
     return 0;
 }
 #endif
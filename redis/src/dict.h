@@ -3,7 +3,8 @@
  * This file implements in-memory hash tables with insert/del/replace/find/
  * get-random-element operations. Hash tables will auto-resize if needed
  * tables of power of two in size are used, collisions are handled by
- * chaining. See the source code for more information... :)
+ * chaining, or by open addressing for dictionary types that ask for it.
+ * See the source code for more information... :)
  *
  * Copyright (c) 2006-2012, Salvatore Sanfilippo <antirez at gmail dot com>
  * All rights reserved.
@@ -72,6 +73,17 @@ typedef struct dictType {
     /* Allow a dictEntry to carry extra caller-defined metadata.  The
      * extra memory is initialized to 0 when a dictEntry is allocated. */
     size_t (*dictEntryMetadataBytes)(dict *d);
+    /* Store the entries in groups of DICT_GROUP_SLOTS slots sharing a cache
+     * line instead of chaining them, see the open addressing section of
+     * dict.c. Entries have no 'next' pointer unless they carry metadata. */
+    unsigned int openAddressing:1;
+    /* Copy the keys into the allocation of their dictEntry, after the
+     * metadata: keyEmbedLen() returns the bytes needed by a key, keyEmbed()
+     * copies it to 'buf' and returns the pointer to use as the key. Like
+     * keyDup, the key passed to dictAdd() and alike is left to the caller,
+     * and keyDestructor is not called for embedded keys. */
+    size_t (*keyEmbedLen)(dict *d, const void *key);
+    void *(*keyEmbed)(dict *d, void *buf, const void *key);
 } dictType;
 
 #define DICTHT_SIZE(exp) ((exp) == -1 ? 0 : (unsigned long)1<<(exp))
@@ -83,6 +95,7 @@ struct dict {
     // 字典的两个桶（可以理解为一个数组，数组里面放的是两个指向dictentry的指针）
     dictEntry **ht_table[2];
     unsigned long ht_used[2];
+    size_t embedded_keys_size; /* Bytes of the keys embedded in the entries. */
 
     // 记录当前rehash的状态
     long rehashidx; /* rehashing not in progress if rehashidx == -1 */
@@ -112,6 +125,9 @@ typedef void (dictScanBucketFunction)(dict *d, dictEntry **bucketref);
 #define DICT_HT_INITIAL_EXP      2
 #define DICT_HT_INITIAL_SIZE     (1<<(DICT_HT_INITIAL_EXP))
 
+/* Entries per bucket of open addressing tables */
+#define DICT_GROUP_SLOTS 7
+
 /* ------------------------------- Macros ------------------------------------*/
 #define dictFreeVal(d, entry) \
     if ((d)->type->valDestructor) \
@@ -134,7 +150,7 @@ typedef void (dictScanBucketFunction)(dict *d, dictEntry **bucketref);
     do { (entry)->v.d = _val_; } while(0)
 
 #define dictFreeKey(d, entry) \
-    if ((d)->type->keyDestructor) \
+    if ((d)->type->keyDestructor && !dictHasEmbeddedKeys(d)) \
         (d)->type->keyDestructor((d), (entry)->key)
 
 #define dictSetKey(d, entry, _key_) do { \
@@ -159,7 +175,11 @@ typedef void (dictScanBucketFunction)(dict *d, dictEntry **bucketref);
 #define dictGetSignedIntegerVal(he) ((he)->v.s64)
 #define dictGetUnsignedIntegerVal(he) ((he)->v.u64)
 #define dictGetDoubleVal(he) ((he)->v.d)
-#define dictSlots(d) (DICTHT_SIZE((d)->ht_size_exp[0])+DICTHT_SIZE((d)->ht_size_exp[1]))
+#define dictIsOpenAddressing(d) ((d)->type->openAddressing)
+#define dictHasEmbeddedKeys(d) ((d)->type->keyEmbed != NULL)
+#define dictEmbeddedKeysSize(d) ((d)->embedded_keys_size)
+#define dictBuckets(d) (DICTHT_SIZE((d)->ht_size_exp[0])+DICTHT_SIZE((d)->ht_size_exp[1]))
+#define dictSlots(d) (dictBuckets(d)*(dictIsOpenAddressing(d) ? DICT_GROUP_SLOTS : 1))
 #define dictSize(d) ((d)->ht_used[0]+(d)->ht_used[1])
 #define dictIsRehashing(d) ((d)->rehashidx != -1)
 #define dictPauseRehashing(d) (d)->pauserehash++
@@ -195,16 +215,25 @@ dictEntry *dictGetRandomKey(dict *d);
 dictEntry *dictGetFairRandomKey(dict *d);
 unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count);
 void dictGetStats(char *buf, size_t bufsize, dict *d);
+size_t dictEntryMemUsage(dict *d, dictEntry *de);
+void dictEntryMoved(dict *d, dictEntry *newde, dictEntry *olde);
+size_t dictMemUsage(dict *d);
+void dictPrefetch(dict *d, const uint64_t *hashes, int count,
+                  void (*valPrefetch)(const void *val));
 uint64_t dictGenHashFunction(const void *key, size_t len);
 uint64_t dictGenCaseHashFunction(const unsigned char *buf, size_t len);
 void dictEmpty(dict *d, void(callback)(dict*));
 void dictEnableResize(void);
 void dictDisableResize(void);
+void dictEnableRehashStep(void);
+void dictDisableRehashStep(void);
 int dictRehash(dict *d, int n);
 int dictRehashMilliseconds(dict *d, int ms);
 void dictSetHashFunctionSeed(uint8_t *seed);
 uint8_t *dictGetHashFunctionSeed(void);
 unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, dictScanBucketFunction *bucketfn, void *privdata);
+unsigned long dictWalkSlots(dict *d, int htidx, unsigned long slot, unsigned long count, dictScanFunction *fn, void *privdata);
+dictEntry *dictFindSlot(dict *d, const void *key, int *htidx, unsigned long *slot);
 uint64_t dictGetHash(dict *d, const void *key);
 dictEntry **dictFindEntryRefByPtrAndHash(dict *d, const void *oldptr, uint64_t hash);
 
@@ -58,12 +58,118 @@ int activeExpireCycleTryExpire(redisDb *db, dictEntry *de, long long now) {
         robj *keyobj = createStringObject(key,sdslen(key));
         deleteExpiredKeyAndPropagate(db,keyobj);
         decrRefCount(keyobj);
+
+        /* How long the key stayed in memory after it expired. */
+        long long lag = now-t;
+        server.stat_expired_active_keys++;
+        server.stat_expired_lag_sum += lag;
+        if (lag > server.stat_expired_lag_max) server.stat_expired_lag_max = lag;
         return 1;
     } else {
         return 0;
     }
 }
 
+/*-----------------------------------------------------------------------------
+ * Expires index.
+ *
+ * When active-expire-index is enabled, every database also has a radix tree
+ * with a key per volatile key composed as such:
+ *
+ *  [8 byte big endian expire time]+[key name]
+ *
+ * So the active expire cycle, instead of sampling the expires dict, walks
+ * the tree from the start and reclaims exactly the keys that are due, no
+ * matter how many keys expire at the same time, nor how many others are
+ * not yet expired.
+ *
+ * The tree is updated together with the expires dict, see setExpire(),
+ * removeExpire() and dbGenericDelete().
+ *----------------------------------------------------------------------------*/
+
+#define EXPIRE_INDEX_TIME_LEN 8
+#define EXPIRE_INDEX_STATIC_LEN 128
+
+static void expireIndexUpdate(redisDb *db, sds key, long long when, int add) {
+    unsigned char buf[EXPIRE_INDEX_STATIC_LEN], *ikey = buf;
+    size_t keylen = sdslen(key), len = EXPIRE_INDEX_TIME_LEN+keylen;
+    /* Times before the epoch are all due: they are indexed as zero. */
+    uint64_t t = htonu64(when < 0 ? 0 : (uint64_t)when);
+
+    if (len > sizeof(buf)) ikey = zmalloc(len);
+    memcpy(ikey,&t,sizeof(t));
+    memcpy(ikey+EXPIRE_INDEX_TIME_LEN,key,keylen);
+    if (add)
+        raxInsert(db->expires_index,ikey,len,NULL,NULL);
+    else
+        raxRemove(db->expires_index,ikey,len,NULL);
+    if (ikey != buf) zfree(ikey);
+}
+
+/* Index 'key' as expiring at 'when'. */
+void expireIndexAdd(redisDb *db, sds key, long long when) {
+    expireIndexUpdate(db,key,when,1);
+}
+
+/* Remove 'key' from the index, 'when' is the expire it was indexed with. */
+void expireIndexDel(redisDb *db, sds key, long long when) {
+    expireIndexUpdate(db,key,when,0);
+}
+
+/* Reclaim the keys of 'db' that are due, in expire time order, until the
+ * first key which is not yet expired. Returns the number of expired keys,
+ * and sets *timedout if it stopped because the cycle ran out of time.
+ *
+ * Deleting the keys modifies the tree, so they are collected in batches,
+ * each found by a single walk of the tree. */
+#define EXPIRE_INDEX_BATCH 32
+static unsigned long activeExpireIndexedKeys(redisDb *db, long long now,
+                                             long long start, long long timelimit,
+                                             int *timedout)
+{
+    unsigned long expired = 0;
+    int done = 0;
+
+    *timedout = 0;
+    while(!done) {
+        robj *batch[EXPIRE_INDEX_BATCH];
+        int count = 0;
+        raxIterator ri;
+
+        raxStart(&ri,db->expires_index);
+        raxSeek(&ri,"^",NULL,0);
+        while(count < EXPIRE_INDEX_BATCH) {
+            uint64_t t;
+            if (!raxNext(&ri)) {
+                done = 1;
+                break;
+            }
+            memcpy(&t,ri.key,sizeof(t));
+            if ((long long)ntohu64(t) >= now) { /* Nothing else is due. */
+                done = 1;
+                break;
+            }
+            batch[count++] = createStringObject((char*)ri.key+EXPIRE_INDEX_TIME_LEN,
+                                                ri.key_len-EXPIRE_INDEX_TIME_LEN);
+        }
+        raxStop(&ri);
+
+        for (int j = 0; j < count; j++) {
+            dictEntry *de = dictFind(db->expires,batch[j]->ptr);
+            serverAssertWithInfo(NULL,batch[j],de != NULL);
+            /* Removes the key from the index as well. */
+            if (activeExpireCycleTryExpire(db,de,now)) expired++;
+            decrRefCount(batch[j]);
+        }
+
+        if (!done && ustime()-start > timelimit) {
+            *timedout = 1;
+            break;
+        }
+    }
+    return expired;
+}
+
 /* Try to expire a few timed out keys. The algorithm used is adaptive and
  * will use few CPU cycles if there are few expiring keys, otherwise
  * it will get more aggressive to avoid that too much memory is used by
@@ -102,6 +208,10 @@ int activeExpireCycleTryExpire(redisDb *db, dictEntry *de, long long now) {
  *
  * The configured expire "effort" will modify the baseline parameters in
  * order to do more work in both the fast and slow expire cycles.
+ *
+ * With the expires index nothing is sampled: every cycle reclaims all the
+ * keys that are due, within the same time limits, and the fast cycle only
+ * runs if the previous cycle ran out of time before it was done.
  */
 
 #define ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP 20 /* Keys for each DB loop. */
@@ -110,6 +220,30 @@ int activeExpireCycleTryExpire(redisDb *db, dictEntry *de, long long now) {
 #define ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE 10 /* % of stale keys after which
                                                    we do extra efforts. */
 
+/* State of the sampling of a database by activeExpireCycle(). */
+typedef struct {
+    redisDb *db;
+    long long now;
+    unsigned long sampled; /* Keys checked. */
+    unsigned long expired; /* Keys expired. */
+    long long ttl_sum;     /* Sum of the TTL of the keys not yet expired. */
+    int ttl_samples;       /* Keys not yet expired. */
+} expireScanData;
+
+void expireScanCallback(void *privdata, const dictEntry *const_de) {
+    dictEntry *de = (dictEntry *)const_de;
+    expireScanData *data = privdata;
+    long long ttl = dictGetSignedIntegerVal(de)-data->now;
+
+    if (activeExpireCycleTryExpire(data->db,de,data->now)) data->expired++;
+    if (ttl > 0) {
+        /* We want the average TTL of keys yet not expired. */
+        data->ttl_sum += ttl;
+        data->ttl_samples++;
+    }
+    data->sampled++;
+}
+
 void activeExpireCycle(int type) {
     /* Adjust the running parameters according to the configured expire
      * effort. The default effort is 1, and the maximum configurable effort
@@ -146,7 +280,8 @@ void activeExpireCycle(int type) {
          * too high. Also never repeat a fast cycle for the same period
          * as the fast cycle total duration itself. */
         if (!timelimit_exit &&
-            server.stat_expired_stale_perc < config_cycle_acceptable_stale)
+            (server.active_expire_index ||
+             server.stat_expired_stale_perc < config_cycle_acceptable_stale))
             return;
 
         if (start < last_fast_cycle + (long long)config_cycle_fast_duration*2)
@@ -199,14 +334,37 @@ void activeExpireCycle(int type) {
          * distribute the time evenly across DBs. */
         current_db++;
 
+        if (db->expires_index) {
+            int timedout;
+            if (dictSize(db->expires) == 0) {
+                db->avg_ttl = 0;
+                continue;
+            }
+            long long now = mstime();
+            activeExpireIndexedKeys(db,now,start,timelimit,&timedout);
+            if (timedout) {
+                timelimit_exit = 1;
+                server.stat_expired_time_cap_reached_count++;
+            }
+
+            /* The average TTL is still estimated by sampling, with a key
+             * per cycle, since it is just for stats. */
+            dictEntry *de = dictGetRandomKey(db->expires);
+            if (de && dictGetSignedIntegerVal(de) > now) {
+                long long ttl = dictGetSignedIntegerVal(de)-now;
+                if (db->avg_ttl == 0) db->avg_ttl = ttl;
+                db->avg_ttl = (db->avg_ttl/50)*49 + (ttl/50);
+            }
+            continue;
+        }
+
         /* Continue to expire if at the end of the cycle there are still
          * a big percentage of keys to expire, compared to the number of keys
          * we scanned. The percentage, stored in config_cycle_acceptable_stale
          * is not fixed, but depends on the Redis configured "expire effort". */
         do {
             unsigned long num, slots;
-            long long now, ttl_sum;
-            int ttl_samples;
+            expireScanData data;
             iteration++;
 
             /* If there is nothing to expire try next DB ASAP. */
@@ -215,7 +373,6 @@ void activeExpireCycle(int type) {
                 break;
             }
             slots = dictSlots(db->expires);
-            now = mstime();
 
             /* When there are less than 1% filled slots, sampling the key
              * space is expensive, so stop here waiting for better times...
@@ -225,17 +382,19 @@ void activeExpireCycle(int type) {
 
             /* The main collection cycle. Sample random keys among keys
              * with an expire set, checking for expired ones. */
-            expired = 0;
-            sampled = 0;
-            ttl_sum = 0;
-            ttl_samples = 0;
+            data.db = db;
+            data.now = mstime();
+            data.sampled = 0;
+            data.expired = 0;
+            data.ttl_sum = 0;
+            data.ttl_samples = 0;
 
             if (num > config_keys_per_loop)
                 num = config_keys_per_loop;
 
-            /* Here we access the low level representation of the hash table
-             * for speed concerns: this makes this code coupled with dict.c,
-             * but it hardly changed in ten years.
+            /* The keys are sampled a bucket at a time with dictScan(), that
+             * works with both the layouts of the hash tables and lets the
+             * callback delete the keys.
              *
              * Note that certain places of the hash table may be empty,
              * so we want also a stop condition about the number of
@@ -246,42 +405,19 @@ void activeExpireCycle(int type) {
             long max_buckets = num*20;
             long checked_buckets = 0;
 
-            while (sampled < num && checked_buckets < max_buckets) {
-                for (int table = 0; table < 2; table++) {
-                    if (table == 1 && !dictIsRehashing(db->expires)) break;
-
-                    unsigned long idx = db->expires_cursor;
-                    idx &= DICTHT_SIZE_MASK(db->expires->ht_size_exp[table]);
-                    dictEntry *de = db->expires->ht_table[table][idx];
-                    long long ttl;
-
-                    /* Scan the current bucket of the current table. */
-                    checked_buckets++;
-                    while(de) {
-                        /* Get the next entry now since this entry may get
-                         * deleted. */
-                        dictEntry *e = de;
-                        de = de->next;
-
-                        ttl = dictGetSignedIntegerVal(e)-now;
-                        if (activeExpireCycleTryExpire(db,e,now)) expired++;
-                        if (ttl > 0) {
-                            /* We want the average TTL of keys yet
-                             * not expired. */
-                            ttl_sum += ttl;
-                            ttl_samples++;
-                        }
-                        sampled++;
-                    }
-                }
-                db->expires_cursor++;
+            while (data.sampled < num && checked_buckets < max_buckets) {
+                db->expires_cursor = dictScan(db->expires, db->expires_cursor,
+                                              expireScanCallback, NULL, &data);
+                checked_buckets++;
             }
+            expired = data.expired;
+            sampled = data.sampled;
             total_expired += expired;
             total_sampled += sampled;
 
             /* Update the average TTL stats for this database. */
-            if (ttl_samples) {
-                long long avg_ttl = ttl_sum/ttl_samples;
+            if (data.ttl_samples) {
+                long long avg_ttl = data.ttl_sum/data.ttl_samples;
 
                 /* Do a simple running average with a few samples.
                  * We just use the current estimate with a weight of 2%
@@ -310,6 +310,23 @@ int geoGetPointsInRange(robj *zobj, double min, double max, GeoShape *shape, geo
             if (ga->used && limit && ga->used >= limit) break;
             ln = ln->level[0].forward;
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        int valid = zbtFirstInRange(zs->zbt, &range, &it, NULL);
+
+        while (valid) {
+            double score = zbtIterScore(&it);
+            /* Abort when the element is no longer in range. */
+            if (!zslValueLteMax(score, &range))
+                break;
+
+            sds ele = sdsdup(zbtIterEle(&it));
+            if (geoAppendIfWithinShape(ga,shape,score,ele)
+                == C_ERR) sdsfree(ele);
+            if (ga->used && limit && ga->used >= limit) break;
+            valid = zbtNext(&it);
+        }
     }
     return ga->used - origincount;
 }
@@ -820,6 +837,7 @@ void georadiusGeneric(client *c, int srcKeyIndex, int flags) {
 
         if (returned_items) {
             zsetConvertToListpackIfNeeded(zobj,maxelelen,totelelen);
+            zsetConvertToBtreeIfNeeded(zobj);
             setKey(c,c->db,storekey,zobj,0);
             decrRefCount(zobj);
             notifyKeyspaceEvent(NOTIFY_ZSET,flags & GEOSEARCH ? "geosearchstore" : "georadiusstore",storekey,
@@ -200,6 +200,7 @@ struct RedisModuleKey {
             uint32_t start;        /* Start pos for positional ranges. */
             uint32_t end;          /* End pos for positional ranges. */
             void *current;         /* Zset iterator current node. */
+            zbtIter btit;          /* B+tree position, current is its leaf. */
             int er;                /* Zset iterator end reached flag
                                        (true if end was reached). */
         } zset;
@@ -4491,6 +4492,12 @@ int zsetInitScoreRange(RedisModuleKey *key, double min, double max, int minex, i
         zskiplist *zsl = zs->zsl;
         key->u.zset.current = first ? zslFirstInRange(zsl,zrs) :
                                       zslLastInRange(zsl,zrs);
+    } else if (key->value->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = key->value->ptr;
+        zbtIter *it = &key->u.zset.btit;
+        int found = first ? zbtFirstInRange(zs->zbt,zrs,it,NULL) :
+                            zbtLastInRange(zs->zbt,zrs,it,NULL);
+        key->u.zset.current = found ? it->leaf : NULL;
     } else {
         serverPanic("Unsupported zset encoding");
     }
@@ -4555,6 +4562,12 @@ int zsetInitLexRange(RedisModuleKey *key, RedisModuleString *min, RedisModuleStr
         zskiplist *zsl = zs->zsl;
         key->u.zset.current = first ? zslFirstInLexRange(zsl,zlrs) :
                                       zslLastInLexRange(zsl,zlrs);
+    } else if (key->value->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = key->value->ptr;
+        zbtIter *it = &key->u.zset.btit;
+        int found = first ? zbtFirstInLexRange(zs->zbt,zlrs,it,NULL) :
+                            zbtLastInLexRange(zs->zbt,zlrs,it,NULL);
+        key->u.zset.current = found ? it->leaf : NULL;
     } else {
         serverPanic("Unsupported zset encoding");
     }
@@ -4606,6 +4619,11 @@ RedisModuleString *RM_ZsetRangeCurrentElement(RedisModuleKey *key, double *score
         zskiplistNode *ln = key->u.zset.current;
         if (score) *score = ln->score;
         str = createStringObject(ln->ele,sdslen(ln->ele));
+    } else if (key->value->encoding == OBJ_ENCODING_BTREE) {
+        zbtIter *it = &key->u.zset.btit;
+        sds ele = zbtIterEle(it);
+        if (score) *score = zbtIterScore(it);
+        str = createStringObject(ele,sdslen(ele));
     } else {
         serverPanic("Unsupported zset encoding");
     }
@@ -4672,6 +4690,28 @@ int RM_ZsetRangeNext(RedisModuleKey *key) {
             key->u.zset.current = next;
             return 1;
         }
+    } else if (key->value->encoding == OBJ_ENCODING_BTREE) {
+        zbtIter next = key->u.zset.btit;
+        if (!zbtNext(&next)) {
+            key->u.zset.er = 1;
+            return 0;
+        } else {
+            /* Are we still within the range? */
+            if (key->u.zset.type == REDISMODULE_ZSET_RANGE_SCORE &&
+                !zslValueLteMax(zbtIterScore(&next),&key->u.zset.rs))
+            {
+                key->u.zset.er = 1;
+                return 0;
+            } else if (key->u.zset.type == REDISMODULE_ZSET_RANGE_LEX) {
+                if (!zslLexValueLteMax(zbtIterEle(&next),&key->u.zset.lrs)) {
+                    key->u.zset.er = 1;
+                    return 0;
+                }
+            }
+            key->u.zset.btit = next;
+            key->u.zset.current = next.leaf;
+            return 1;
+        }
     } else {
         serverPanic("Unsupported zset encoding");
     }
@@ -4736,6 +4776,28 @@ int RM_ZsetRangePrev(RedisModuleKey *key) {
             key->u.zset.current = prev;
             return 1;
         }
+    } else if (key->value->encoding == OBJ_ENCODING_BTREE) {
+        zbtIter prev = key->u.zset.btit;
+        if (!zbtPrev(&prev)) {
+            key->u.zset.er = 1;
+            return 0;
+        } else {
+            /* Are we still within the range? */
+            if (key->u.zset.type == REDISMODULE_ZSET_RANGE_SCORE &&
+                !zslValueGteMin(zbtIterScore(&prev),&key->u.zset.rs))
+            {
+                key->u.zset.er = 1;
+                return 0;
+            } else if (key->u.zset.type == REDISMODULE_ZSET_RANGE_LEX) {
+                if (!zslLexValueGteMin(zbtIterEle(&prev),&key->u.zset.lrs)) {
+                    key->u.zset.er = 1;
+                    return 0;
+                }
+            }
+            key->u.zset.btit = prev;
+            key->u.zset.current = prev.leaf;
+            return 1;
+        }
     } else {
         serverPanic("Unsupported zset encoding");
     }
@@ -6197,19 +6259,48 @@ robj *moduleTypeDupOrReply(client *c, robj *fromkey, robj *tokey, int todb, robj
         addReplyError(c, "not supported for this module key");
         return NULL;
     }
+    robj *newobj = moduleTypeDup(fromkey, tokey, c->db->id, todb, value);
+    if (!newobj) addReplyError(c, "module key failed to copy");
+    return newobj;
+}
+
+/* Like moduleTypeDupOrReply(), without a client: returns NULL if the module
+ * type doesn't support copying its values or failed to. */
+robj *moduleTypeDup(robj *fromkey, robj *tokey, int fromdb, int todb, robj *value) {
+    moduleValue *mv = value->ptr;
+    moduleType *mt = mv->type;
     void *newval = NULL;
     if (mt->copy2 != NULL) {
-        RedisModuleKeyOptCtx ctx = {fromkey, tokey, c->db->id, todb};
+        RedisModuleKeyOptCtx ctx = {fromkey, tokey, fromdb, todb};
         newval = mt->copy2(&ctx, mv->value);
-    } else {
+    } else if (mt->copy != NULL) {
         newval = mt->copy(fromkey, tokey, mv->value);
     }
-     
-    if (!newval) {
-        addReplyError(c, "module key failed to copy");
-        return NULL;
+    return newval ? createModuleObject(mt, newval) : NULL;
+}
+
+/* Returns true if the values of all the module types can be copied. */
+int moduleTypesSupportCopy(void) {
+    dictIterator *di = dictGetIterator(modules);
+    dictEntry *de;
+    int ok = 1;
+
+    while (ok && (de = dictNext(di)) != NULL) {
+        struct RedisModule *module = dictGetVal(de);
+        listIter li;
+        listNode *ln;
+
+        listRewind(module->types,&li);
+        while((ln = listNext(&li))) {
+            moduleType *mt = ln->value;
+            if (!mt->copy && !mt->copy2) {
+                ok = 0;
+                break;
+            }
+        }
     }
-    return createModuleObject(mt, newval);
+    dictReleaseIterator(di);
+    return ok;
 }
 
 /* Register a new data type exported by the module. The parameters are the
@@ -7757,6 +7848,29 @@ int moduleTryAcquireGIL(void) {
     return pthread_mutex_trylock(&moduleGIL);
 }
 
+/* Like moduleAcquireGIL(), but gives up after 'ms' milliseconds, returning
+ * non zero if the GIL was not acquired. */
+int moduleTimedAcquireGIL(long long ms) {
+#if defined(__APPLE__)
+    /* No pthread_mutex_timedlock() on macOS. */
+    long long deadline = ustime() + ms*1000;
+    int res;
+    while ((res = pthread_mutex_trylock(&moduleGIL)) != 0 && ustime() < deadline)
+        usleep(100);
+    return res;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    ts.tv_sec += ms/1000;
+    ts.tv_nsec += (ms%1000)*1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return pthread_mutex_timedlock(&moduleGIL,&ts);
+#endif
+}
+
 void moduleReleaseGIL(void) {
     pthread_mutex_unlock(&moduleGIL);
 }
@@ -10040,8 +10154,8 @@ static void moduleScanKeyCallback(void *privdata, const dictEntry *de) {
         sds val = dictGetVal(de);
         value = createStringObject(val, sdslen(val));
     } else if (o->type == OBJ_ZSET) {
-        double *val = (double*)dictGetVal(de);
-        value = createStringObjectFromLongDouble(*val, 0);
+        double val = zsetDictGetScore((zset*)o->ptr,de);
+        value = createStringObjectFromLongDouble(val, 0);
     }
 
     data->fn(data->key, field, value, data->user_data);
@@ -10111,7 +10225,8 @@ int RM_ScanKey(RedisModuleKey *key, RedisModuleScanCursor *cursor, RedisModuleSc
         if (o->encoding == OBJ_ENCODING_HT)
             ht = o->ptr;
     } else if (o->type == OBJ_ZSET) {
-        if (o->encoding == OBJ_ENCODING_SKIPLIST)
+        if (o->encoding == OBJ_ENCODING_SKIPLIST ||
+            o->encoding == OBJ_ENCODING_BTREE)
             ht = ((zset *)o->ptr)->dict;
     } else {
         errno = EINVAL;
@@ -467,8 +467,9 @@ void addReplyErrorLength(client *c, const char *s, size_t len) {
 void afterErrorReply(client *c, const char *s, size_t len, int flags) {
     /* Module clients fall into two categories:
      * Calls to RM_Call, in which case the error isn't being returned to a client, so should not be counted.
-     * Module thread safe context calls to RM_ReplyWithError, which will be added to a real client by the main thread later. */
-    if (c->flags & CLIENT_MODULE) {
+     * Module thread safe context calls to RM_ReplyWithError, which will be added to a real client by the main thread later.
+     * Commands executed by the I/O threads also defer their errors, call() accounts for them on the main thread. */
+    if (c->flags & CLIENT_MODULE || io_threads_op == IO_THREADS_OP_COMMAND) {
         if (!c->deferred_reply_errors) {
             c->deferred_reply_errors = listCreate();
             listSetFreeMethod(c->deferred_reply_errors, (void (*)(void*))sdsfree);
@@ -1553,8 +1554,9 @@ void freeClient(client *c) {
     listNode *ln;
 
     /* If a client is protected, yet we need to free it right now, make sure
-     * to at least use asynchronous freeing. */
-    if (c->flags & CLIENT_PROTECTED) {
+     * to at least use asynchronous freeing. The same for a client with a
+     * command queued for the I/O threads. */
+    if (c->flags & (CLIENT_PROTECTED|CLIENT_PENDING_IO_COMMAND)) {
         freeClientAsync(c);
         return;
     }
@@ -1769,7 +1771,7 @@ int freeClientsInAsyncFreeQueue(void) {
     while ((ln = listNext(&li)) != NULL) {
         client *c = listNodeValue(ln);
 
-        if (c->flags & CLIENT_PROTECTED) continue;
+        if (c->flags & (CLIENT_PROTECTED|CLIENT_PENDING_IO_COMMAND)) continue;
 
         c->flags &= ~CLIENT_CLOSE_ASAP;
         freeClient(c);
@@ -2441,7 +2443,9 @@ int processCommandAndResetClient(client *c) {
     int deadclient = 0;
     client *old_client = server.current_client;
     server.current_client = c;
-    if (processCommand(c) == C_OK) {
+    /* A command queued for the I/O threads is completed later, see
+     * handleClientsWithPendingCommandsUsingThreads(). */
+    if (processCommand(c) == C_OK && !(c->flags & CLIENT_PENDING_IO_COMMAND)) {
         commandProcessed(c);
         /* Update the client's memory to include output buffer growth following the
          * processed command. */
@@ -2486,12 +2490,86 @@ int processPendingCommandAndInputBuffer(client *c) {
     return C_OK;
 }
 
+/* Parses a line of the multibulk protocol starting with 'prefix' at 'p',
+ * storing its number in 'll'. Returns the position after the line, or NULL
+ * if the line is incomplete or invalid. */
+static const char *prefetchParseLine(const char *p, const char *end, char prefix, long long *ll) {
+    const char *newline;
+
+    if (p >= end || *p != prefix) return NULL;
+    if ((newline = memchr(p, '\r', end-p)) == NULL || newline+1 >= end) return NULL;
+    if (!string2ll(p+1, newline-(p+1), ll)) return NULL;
+    return newline+2;
+}
+
+/* Prefetches the keys of the commands pipelined in the query buffer of the
+ * client, up to prefetch-batch-max-size complete multibulk commands, so that
+ * their lookups don't take the cache misses of one key after the other, see
+ * dictPrefetch(). The commands are not parsed into objects: this only reads
+ * the arguments at the key positions of the legacy range key spec of each
+ * command, and hashes them. Returns the number of commands considered, that
+ * the caller executes before calling it again. */
+#define PREFETCH_KEYS_MAX 128
+static int prefetchCommandsKeys(client *c) {
+    static sds name = NULL;
+    uint64_t hashes[PREFETCH_KEYS_MAX];
+    const char *p = c->querybuf+c->qb_pos;
+    const char *end = c->querybuf+sdslen(c->querybuf);
+    int commands = 0, keys = 0;
+
+    if (name == NULL) name = sdsempty();
+    while (commands < server.prefetch_batch_max_size) {
+        struct redisCommand *cmd = NULL;
+        long long argc, len;
+        int first = 0, last = -1, step = 1, cmdkeys = 0;
+
+        if ((p = prefetchParseLine(p, end, '*', &argc)) == NULL || argc <= 0) break;
+        for (long long j = 0; j < argc && p; j++) {
+            if ((p = prefetchParseLine(p, end, '$', &len)) == NULL) break;
+            if (len < 0 || len > server.proto_max_bulk_len || len > end-p-2) {
+                p = NULL;
+                break;
+            }
+            if (j == 0) {
+                name = sdscpylen(name, p, len);
+                cmd = dictFetchValue(server.commands, name);
+                if (cmd && !cmd->subcommands_dict &&
+                    cmd->legacy_range_key_spec.begin_search_type == KSPEC_BS_INDEX)
+                {
+                    first = cmd->legacy_range_key_spec.bs.index.pos;
+                    last = cmd->legacy_range_key_spec.fk.range.lastkey;
+                    last = last >= 0 ? last+first : argc+last;
+                    step = cmd->legacy_range_key_spec.fk.range.keystep;
+                }
+            } else if (j >= first && j <= last && (j-first) % step == 0 &&
+                       keys+cmdkeys < PREFETCH_KEYS_MAX)
+            {
+                hashes[keys+cmdkeys++] = dictGenHashFunction(p, len);
+            }
+            p += len+2;
+        }
+        if (p == NULL) break; /* Incomplete command. */
+        keys += cmdkeys;
+        commands++;
+    }
+
+    /* A single command has nothing to overlap its lookups with. */
+    if (commands > 1 && keys > 1) {
+        dbPrefetchKeys(c->db, hashes, keys);
+        server.stat_prefetch_batches++;
+        server.stat_prefetch_keys += keys;
+    }
+    return commands;
+}
+
 /* This function is called every time, in the client structure 'c', there is
  * more query buffer to process, because we read more data from the socket
  * or because a client was blocked and later reactivated, so there could be
  * pending query buffer, already representing a full command, to process.
  * return C_ERR in case the client was freed during the processing */
 int processInputBuffer(client *c) {
+    int prefetched = 0; /* Commands left of the last prefetched batch. */
+
     /* Keep processing while there is something in the input buffer */
     while(c->qb_pos < sdslen(c->querybuf)) {
         /* Immediately abort if the client is in the middle of something. */
@@ -2499,7 +2577,7 @@ int processInputBuffer(client *c) {
 
         /* Don't process more buffers from clients that have already pending
          * commands to execute in c->argv. */
-        if (c->flags & CLIENT_PENDING_COMMAND) break;
+        if (c->flags & (CLIENT_PENDING_COMMAND|CLIENT_PENDING_IO_COMMAND)) break;
 
         /* Don't process input from the master while there is a busy script
          * condition on the slave. We want just to accumulate the replication
@@ -2523,6 +2601,17 @@ int processInputBuffer(client *c) {
             }
         }
 
+        /* Prefetch the keys of the next pipelined commands before executing
+         * them, unless they are only going to be parsed by an I/O thread, or
+         * the client still has to authenticate. */
+        if (c->reqtype == PROTO_REQ_MULTIBULK && c->multibulklen == 0 &&
+            prefetched == 0 && server.prefetch_batch_max_size > 1 &&
+            io_threads_op == IO_THREADS_OP_IDLE && !authRequired(c))
+        {
+            prefetched = prefetchCommandsKeys(c);
+        }
+        if (prefetched) prefetched--;
+
         if (c->reqtype == PROTO_REQ_INLINE) {
             if (processInlineBuffer(c) != C_OK) break;
         } else if (c->reqtype == PROTO_REQ_MULTIBULK) {
@@ -4013,7 +4102,22 @@ typedef struct __attribute__((aligned(CACHE_LINE_SIZE))) threads_pending {
 pthread_t io_threads[IO_THREADS_MAX_NUM];
 pthread_mutex_t io_threads_mutex[IO_THREADS_MAX_NUM];
 threads_pending io_threads_pending[IO_THREADS_MAX_NUM];
-int io_threads_op;      /* IO_THREADS_OP_IDLE, IO_THREADS_OP_READ or IO_THREADS_OP_WRITE. */ // TODO: should access to this be atomic??!
+int io_threads_op;      /* IO_THREADS_OP_IDLE, IO_THREADS_OP_READ, IO_THREADS_OP_WRITE
+                         * or IO_THREADS_OP_COMMAND. */ // TODO: should access to this be atomic??!
+
+/* Set while the clients read by the I/O threads are processed, that is when
+ * postponeClientCommand() may queue their commands. */
+static int io_threads_queue_commands = 0;
+
+/* Keyspace hits and misses of the commands executed by each thread, added to
+ * the server stats once the threads are idle. */
+typedef struct __attribute__((aligned(CACHE_LINE_SIZE))) threads_keyspace_stats {
+    long long hits;
+    long long misses;
+} threads_keyspace_stats;
+
+threads_keyspace_stats io_threads_keyspace_stats[IO_THREADS_MAX_NUM];
+static __thread long io_thread_id = 0; /* 0 for the main thread. */
 
 /* This is the list of clients each thread will serve when threaded I/O is
  * used. We spawn io_threads_num-1 threads, since one is the main thread
@@ -4030,12 +4134,29 @@ static inline void setIOPendingCount(int i, unsigned long count) {
     atomicSetWithSync(io_threads_pending[i].value, count);
 }
 
+/* Called by lookupKey() for the commands executed by the I/O threads. */
+void updateIOThreadKeyspaceStats(int hit) {
+    if (hit)
+        io_threads_keyspace_stats[io_thread_id].hits++;
+    else
+        io_threads_keyspace_stats[io_thread_id].misses++;
+}
+
+/* Execute the command of a client queued by postponeClientCommand(), from
+ * an I/O thread or from the main thread. */
+static void executeClientCommand(client *c) {
+    monotime start = getMonotonicUs();
+    c->cmd->proc(c);
+    c->duration = getMonotonicUs() - start;
+}
+
 void *IOThreadMain(void *myid) {
     /* The ID is the thread number (from 0 to server.iothreads_num-1), and is
      * used by the thread to just manipulate a single sub-array of clients. */
     long id = (unsigned long)myid;
     char thdname[16];
 
+    io_thread_id = id;
     snprintf(thdname, sizeof(thdname), "io_thd_%ld", id);
     redis_set_thread_title(thdname);
     redisSetCpuAffinity(server.server_cpulist);
@@ -4067,6 +4188,8 @@ void *IOThreadMain(void *myid) {
                 writeToClient(c,0);
             } else if (io_threads_op == IO_THREADS_OP_READ) {
                 readQueryFromClient(c->conn);
+            } else if (io_threads_op == IO_THREADS_OP_COMMAND) {
+                executeClientCommand(c);
             } else {
                 serverPanic("io_threads_op value is unknown");
             }
@@ -4286,6 +4409,147 @@ int postponeClientRead(client *c) {
     }
 }
 
+/* Return 1 if we want to execute the command of the client later using the
+ * I/O threads. This is called by processCommand() once the command passed
+ * all the checks, and just before call(). As a side effect of calling this
+ * function the client is put in the pending command clients and flagged as
+ * such.
+ *
+ * Only fast read only commands with keys are queued, and only while the
+ * clients read by the I/O threads are processed. Such commands just look up
+ * keys and build the reply in the client buffers, so that they can run in
+ * parallel as long as nothing modifies the keyspace meanwhile. Commands
+ * firing key miss events are not queued, since notifications need the main
+ * thread. */
+int postponeClientCommand(client *c) {
+    uint64_t cmd_flags = c->cmd->flags;
+    if (io_threads_queue_commands &&
+        server.io_threads_do_commands &&
+        !ProcessingEventsWhileBlocked &&
+        (cmd_flags & (CMD_READONLY|CMD_FAST)) == (CMD_READONLY|CMD_FAST) &&
+        !(cmd_flags & (CMD_MAY_REPLICATE|CMD_MODULE|CMD_BLOCKING)) &&
+        c->cmd->key_specs_num > 0 &&
+        !(c->flags & (CLIENT_MULTI|CLIENT_CLOSE_AFTER_REPLY|CLIENT_CLOSE_ASAP)) &&
+        !(server.notify_keyspace_events & NOTIFY_KEY_MISS))
+    {
+        c->flags |= CLIENT_PENDING_IO_COMMAND;
+        listAddNodeTail(server.clients_pending_command,c);
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* Execute the commands queued by postponeClientCommand() using the I/O
+ * threads, with the same fan-out -> fan-in paradigm used for reading.
+ * While the threads run, the keyspace is only read: lookups don't rehash,
+ * expired keys are not deleted, and keyspace stats are kept per thread.
+ * The rest of call() then runs on the main thread, in the order the
+ * commands were queued, so that stats, slowlog, MONITOR and tracking are
+ * the same as for a command executed directly. Once the whole batch is
+ * complete, clients with more commands in their query buffer are processed
+ * again, which may queue another batch. */
+static void handleClientsWithPendingCommandsUsingThreads(void) {
+    listIter li;
+    listNode *ln;
+
+    while (listLength(server.clients_pending_command)) {
+        int processed = listLength(server.clients_pending_command);
+
+        /* Distribute the clients across N different lists. */
+        listRewind(server.clients_pending_command,&li);
+        int item_id = 0;
+        while((ln = listNext(&li))) {
+            client *c = listNodeValue(ln);
+            int target_id = item_id % server.io_threads_num;
+            listAddNodeTail(io_threads_list[target_id],c);
+            item_id++;
+        }
+
+        /* Expires are checked against the cached time, like in call(), and
+         * the tables of the dictionaries stay as they are. */
+        if (server.fixed_time_expire++ == 0) updateCachedTime(0);
+        dictDisableRehashStep();
+
+        io_threads_op = IO_THREADS_OP_COMMAND;
+        for (int j = 1; j < server.io_threads_num; j++) {
+            int count = listLength(io_threads_list[j]);
+            setIOPendingCount(j, count);
+        }
+
+        /* Also use the main thread to process a slice of clients. */
+        listRewind(io_threads_list[0],&li);
+        while((ln = listNext(&li))) {
+            client *c = listNodeValue(ln);
+            executeClientCommand(c);
+        }
+        listEmpty(io_threads_list[0]);
+
+        /* Wait for all the other threads to end their work. */
+        while(1) {
+            unsigned long pending = 0;
+            for (int j = 1; j < server.io_threads_num; j++)
+                pending += getIOPendingCount(j);
+            if (pending == 0) break;
+        }
+
+        io_threads_op = IO_THREADS_OP_IDLE;
+        dictEnableRehashStep();
+        server.fixed_time_expire--;
+
+        for (int j = 0; j < server.io_threads_num; j++) {
+            server.stat_keyspace_hits += io_threads_keyspace_stats[j].hits;
+            server.stat_keyspace_misses += io_threads_keyspace_stats[j].misses;
+            io_threads_keyspace_stats[j].hits = 0;
+            io_threads_keyspace_stats[j].misses = 0;
+        }
+
+        /* Complete this whole batch before any client runs the next command
+         * in its query buffer, which may modify keys read by the batch, e.g.
+         * the tracking invalidation of a key must come after the clients
+         * which read it remembered it. The clients are protected meanwhile,
+         * then processInputBuffer() may append clients to the list, for the
+         * next batch. */
+        list *leftover = listCreate();
+        while (processed--) {
+            ln = listFirst(server.clients_pending_command);
+            client *c = listNodeValue(ln);
+            listDelNode(server.clients_pending_command,ln);
+
+            server.current_client = c;
+            call(c,CMD_CALL_FULL);
+            c->woff = server.master_repl_offset;
+            commandProcessed(c);
+            updateClientMemUsage(c);
+            int deadclient = server.current_client == NULL;
+            server.current_client = NULL;
+            server.stat_io_commands_processed++;
+
+            if (deadclient || beforeNextClient(c) == C_ERR) continue;
+
+            /* The reply was built by a thread, which couldn't put the
+             * client in the pending write queue. */
+            if (!(c->flags & CLIENT_PENDING_WRITE) && clientHasPendingReplies(c))
+                putClientInPendingWriteQueue(c);
+
+            if (c->querybuf && sdslen(c->querybuf) > 0) {
+                protectClient(c);
+                listAddNodeTail(leftover,c);
+            }
+        }
+
+        while (listLength(leftover)) {
+            ln = listFirst(leftover);
+            client *c = listNodeValue(ln);
+            listDelNode(leftover,ln);
+            unprotectClient(c);
+            if (c->flags & CLIENT_CLOSE_ASAP) continue;
+            processInputBuffer(c);
+        }
+        listRelease(leftover);
+    }
+}
+
 /* When threaded I/O is also enabled for the reading + parsing side, the
  * readable handler will just put normal clients into a queue of clients to
  * process (instead of serving them synchronously). This function runs
@@ -4342,6 +4606,7 @@ int handleClientsWithPendingReadsUsingThreads(void) {
     io_threads_op = IO_THREADS_OP_IDLE;
 
     /* Run the list of clients again to process the new buffers. */
+    io_threads_queue_commands = 1;
     while(listLength(server.clients_pending_read)) {
         ln = listFirst(server.clients_pending_read);
         client *c = listNodeValue(ln);
@@ -4374,6 +4639,10 @@ int handleClientsWithPendingReadsUsingThreads(void) {
             putClientInPendingWriteQueue(c);
     }
 
+    /* Then the read only commands queued meanwhile. */
+    handleClientsWithPendingCommandsUsingThreads();
+    io_threads_queue_commands = 0;
+
     /* Update processed count on server */
     server.stat_io_reads_processed += processed;
 
@@ -261,11 +261,24 @@ robj *createZsetObject(void) {
 
     zs->dict = dictCreate(&zsetDictType);
     zs->zsl = zslCreate();
+    zs->zbt = NULL;
     o = createObject(OBJ_ZSET,zs);
     o->encoding = OBJ_ENCODING_SKIPLIST;
     return o;
 }
 
+robj *createZsetBtreeObject(void) {
+    zset *zs = zmalloc(sizeof(*zs));
+    robj *o;
+
+    zs->dict = dictCreate(&zsetDictType);
+    zs->zsl = NULL;
+    zs->zbt = zbtCreate();
+    o = createObject(OBJ_ZSET,zs);
+    o->encoding = OBJ_ENCODING_BTREE;
+    return o;
+}
+
 robj *createZsetListpackObject(void) {
     unsigned char *lp = lpNew(0);
     robj *o = createObject(OBJ_ZSET,lp);
@@ -323,6 +336,12 @@ void freeZsetObject(robj *o) {
         zslFree(zs->zsl);
         zfree(zs);
         break;
+    case OBJ_ENCODING_BTREE:
+        zs = o->ptr;
+        dictRelease(zs->dict);
+        zbtFree(zs->zbt);
+        zfree(zs);
+        break;
     case OBJ_ENCODING_LISTPACK:
         zfree(o->ptr);
         break;
@@ -464,6 +483,24 @@ void dismissZsetObject(robj *o, size_t size_hint) {
         }
 
         /* Dismiss hash table memory. */
+        dict *d = zs->dict;
+        dismissMemory(d->ht_table[0], DICTHT_SIZE(d->ht_size_exp[0])*sizeof(dictEntry*));
+        dismissMemory(d->ht_table[1], DICTHT_SIZE(d->ht_size_exp[1])*sizeof(dictEntry*));
+    } else if (o->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = o->ptr;
+        zbtree *zbt = zs->zbt;
+        serverAssert(zbt->length != 0);
+        /* Same as above: the B+tree nodes themselves are smaller than a
+         * page, only big members are worth dismissing. */
+        if (size_hint / zbt->length >= server.page_size) {
+            zbtIter it;
+            int valid = zbtFirst(zbt,&it);
+            while (valid) {
+                dismissSds(zbtIterEle(&it));
+                valid = zbtNext(&it);
+            }
+        }
+
         dict *d = zs->dict;
         dismissMemory(d->ht_table[0], DICTHT_SIZE(d->ht_size_exp[0])*sizeof(dictEntry*));
         dismissMemory(d->ht_table[1], DICTHT_SIZE(d->ht_size_exp[1])*sizeof(dictEntry*));
@@ -933,6 +970,7 @@ char *strEncoding(int encoding) {
     case OBJ_ENCODING_LISTPACK: return "listpack";
     case OBJ_ENCODING_INTSET: return "intset";
     case OBJ_ENCODING_SKIPLIST: return "skiplist";
+    case OBJ_ENCODING_BTREE: return "btree";
     case OBJ_ENCODING_EMBSTR: return "embstr";
     case OBJ_ENCODING_STREAM: return "stream";
     default: return "unknown";
@@ -1034,6 +1072,21 @@ size_t objectComputeSize(robj *key, robj *o, size_t sample_size, int dbid) {
                 znode = znode->level[0].forward;
             }
             if (samples) asize += (double)elesize/samples*dictSize(d);
+        } else if (o->encoding == OBJ_ENCODING_BTREE) {
+            d = ((zset*)o->ptr)->dict;
+            zbtree *zbt = ((zset*)o->ptr)->zbt;
+            zbtIter it;
+            int valid = zbtFirst(zbt,&it);
+            asize = sizeof(*o)+sizeof(zset)+sizeof(dict)+
+                    (sizeof(struct dictEntry*)*dictSlots(d))+
+                    zbtAllocSize(zbt);
+            while(valid && samples < sample_size) {
+                elesize += sdsZmallocSize(zbtIterEle(&it));
+                elesize += sizeof(struct dictEntry);
+                samples++;
+                valid = zbtNext(&it);
+            }
+            if (samples) asize += (double)elesize/samples*dictSize(d);
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -1218,22 +1271,26 @@ struct redisMemOverhead *getMemoryOverheadData(void) {
         mh->db = zrealloc(mh->db,sizeof(mh->db[0])*(mh->num_dbs+1));
         mh->db[mh->num_dbs].dbid = j;
 
-        mem = dictSize(db->dict) * sizeof(dictEntry) +
-              dictSlots(db->dict) * sizeof(dictEntry*) +
+        mem = dictMemUsage(db->dict) +
               dictSize(db->dict) * sizeof(robj);
         mh->db[mh->num_dbs].overhead_ht_main = mem;
+        mh->keyspace_overhead += mem;
         mem_total+=mem;
 
-        mem = dictSize(db->expires) * sizeof(dictEntry) +
-              dictSlots(db->expires) * sizeof(dictEntry*);
+        mem = dictMemUsage(db->expires);
         mh->db[mh->num_dbs].overhead_ht_expires = mem;
+        mh->keyspace_overhead += mem;
         mem_total+=mem;
 
         /* Account for the slot to keys map in cluster mode */
         mem = dictSize(db->dict) * dictMetadataSize(db->dict);
         mh->db[mh->num_dbs].overhead_ht_slot_to_keys = mem;
+        mh->keyspace_overhead += mem;
         mem_total+=mem;
 
+        /* The key names are part of the dataset, even if embedded. */
+        mh->keyspace_embedded_keys += dictEmbeddedKeysSize(db->dict);
+
         mh->num_dbs++;
     }
 
@@ -1522,8 +1579,9 @@ NULL
             return;
         }
         size_t usage = objectComputeSize(c->argv[2],dictGetVal(de),samples,c->db->id);
-        usage += sdsZmallocSize(dictGetKey(de));
-        usage += sizeof(dictEntry);
+        if (!dictHasEmbeddedKeys(c->db->dict))
+            usage += sdsZmallocSize(dictGetKey(de));
+        usage += dictEntryMemUsage(c->db->dict,de);
         usage += dictMetadataSize(c->db->dict);
         addReplyLongLong(c,usage);
     } else if (!strcasecmp(c->argv[1]->ptr,"stats") && c->argc == 2) {
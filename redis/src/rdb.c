@@ -49,9 +49,12 @@
 /* This macro is called when RDB read failed (possibly a short read) */
 #define rdbReportReadError(...) rdbReportError(0, __LINE__,__VA_ARGS__)
 
+/* Set in the threads building the values of a loaded RDB, see rdbLoaderThreadMain(). */
+static __thread int rdbLoaderThread = 0;
+
 /* This macro tells if we are in the context of a RESTORE command, and not loading an RDB or AOF. */
 #define isRestoreContext() \
-    (server.current_client == NULL || server.current_client->id == CLIENT_ID_AOF) ? 0 : 1
+    (rdbLoaderThread || server.current_client == NULL || server.current_client->id == CLIENT_ID_AOF) ? 0 : 1
 
 char* rdbFileBeingLoaded = NULL; /* used for rdb checking on read error */
 extern int rdbCheckMode;
@@ -66,14 +69,24 @@ void rdbReportError(int corruption_error, int linenum, char *reason, ...) {
     char msg[1024];
     int len;
 
-    len = snprintf(msg,sizeof(msg),
-        "Internal error in RDB reading offset %llu, function at rdb.c:%d -> ",
-        (unsigned long long)server.loading_loaded_bytes, linenum);
+    if (rdbLoaderThread)
+        len = snprintf(msg,sizeof(msg),
+            "Internal error in RDB loader thread, function at rdb.c:%d -> ",
+            linenum);
+    else
+        len = snprintf(msg,sizeof(msg),
+            "Internal error in RDB reading offset %llu, function at rdb.c:%d -> ",
+            (unsigned long long)server.loading_loaded_bytes, linenum);
     va_start(ap,reason);
     vsnprintf(msg+len,sizeof(msg)-len,reason,ap);
     va_end(ap);
 
-    if (isRestoreContext()) {
+    if (rdbLoaderThread) {
+        /* The main thread reports the failure once it adds the key, see
+         * rdbLoadAddKey(), so just log the details and return. */
+        serverLog(LL_WARNING, "%s", msg);
+        return;
+    } else if (isRestoreContext()) {
         /* If we're in the context of a RESTORE command, just propagate the error. */
         /* log in VERBOSE, and return (don't exit). */
         serverLog(LL_VERBOSE, "%s", msg);
@@ -669,7 +682,8 @@ int rdbSaveObjectType(rio *rdb, robj *o) {
     case OBJ_ZSET:
         if (o->encoding == OBJ_ENCODING_LISTPACK)
             return rdbSaveType(rdb,RDB_TYPE_ZSET_LISTPACK);
-        else if (o->encoding == OBJ_ENCODING_SKIPLIST)
+        else if (o->encoding == OBJ_ENCODING_SKIPLIST ||
+                 o->encoding == OBJ_ENCODING_BTREE)
             return rdbSaveType(rdb,RDB_TYPE_ZSET_2);
         else
             serverPanic("Unknown sorted set encoding");
@@ -893,6 +907,28 @@ ssize_t rdbSaveObject(rio *rdb, robj *o, robj *key, int dbid) {
                 nwritten += n;
                 zn = zn->backward;
             }
+        } else if (o->encoding == OBJ_ENCODING_BTREE) {
+            zset *zs = o->ptr;
+            zbtIter it;
+            int valid;
+
+            if ((n = rdbSaveLen(rdb,zs->zbt->length)) == -1) return -1;
+            nwritten += n;
+
+            /* Same format and order as the skiplist above: the B+tree also
+             * inserts the smallest element at the head quickly, and keeps
+             * the leaves full when doing so. */
+            valid = zbtLast(zs->zbt,&it);
+            while (valid) {
+                sds ele = zbtIterEle(&it);
+                if ((n = rdbSaveRawString(rdb,(unsigned char*)ele,sdslen(ele))) == -1)
+                    return -1;
+                nwritten += n;
+                if ((n = rdbSaveBinaryDoubleValue(rdb,zbtIterScore(&it))) == -1)
+                    return -1;
+                nwritten += n;
+                valid = zbtPrev(&it);
+            }
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -1244,6 +1280,25 @@ werr:
     return -1;
 }
 
+/* Write the opcodes that precede the keys of a database: the SELECT DB one,
+ * and the RESIZE DB one with the sizes of its dictionaries. */
+ssize_t rdbSaveDbHeader(rio *rdb, int dbid, uint64_t db_size, uint64_t expires_size) {
+    ssize_t written = 0;
+    ssize_t res;
+
+    if ((res = rdbSaveType(rdb,RDB_OPCODE_SELECTDB)) < 0) return -1;
+    written += res;
+    if ((res = rdbSaveLen(rdb, dbid)) < 0) return -1;
+    written += res;
+    if ((res = rdbSaveType(rdb,RDB_OPCODE_RESIZEDB)) < 0) return -1;
+    written += res;
+    if ((res = rdbSaveLen(rdb,db_size)) < 0) return -1;
+    written += res;
+    if ((res = rdbSaveLen(rdb,expires_size)) < 0) return -1;
+    written += res;
+    return written;
+}
+
 ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
     dictIterator *di;
     dictEntry *de;
@@ -1257,21 +1312,8 @@ ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
     if (dictSize(d) == 0) return 0;
     di = dictGetSafeIterator(d);
 
-    /* Write the SELECT DB opcode */
-    if ((res = rdbSaveType(rdb,RDB_OPCODE_SELECTDB)) < 0) goto werr;
-    written += res;
-    if ((res = rdbSaveLen(rdb, dbid)) < 0) goto werr;
-    written += res;
-
-    /* Write the RESIZE DB opcode. */
-    uint64_t db_size, expires_size;
-    db_size = dictSize(db->dict);
-    expires_size = dictSize(db->expires);
-    if ((res = rdbSaveType(rdb,RDB_OPCODE_RESIZEDB)) < 0) goto werr;
-    written += res;
-    if ((res = rdbSaveLen(rdb,db_size)) < 0) goto werr;
-    written += res;
-    if ((res = rdbSaveLen(rdb,expires_size)) < 0) goto werr;
+    /* Write the SELECT DB and RESIZE DB opcodes. */
+    if ((res = rdbSaveDbHeader(rdb,dbid,dictSize(db->dict),dictSize(db->expires))) < 0) goto werr;
     written += res;
 
     /* Iterate this DB writing every entry */
@@ -1312,6 +1354,38 @@ werr:
     return -1;
 }
 
+/* Writes what precedes the databases in an RDB file: the magic string, the
+ * AUX fields, the modules AUX data that goes before the keys and the
+ * functions. Returns C_ERR on I/O errors, with errno set. */
+int rdbSaveRioHead(int req, rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
+    char magic[10];
+
+    if (server.rdb_checksum)
+        rdb->update_cksum = rioGenericUpdateChecksum;
+    snprintf(magic,sizeof(magic),"REDIS%04d",RDB_VERSION);
+    if (rdbWriteRaw(rdb,magic,9) == -1) return C_ERR;
+    if (rdbSaveInfoAuxFields(rdb,rdbflags,rsi) == -1) return C_ERR;
+    if (!(req & SLAVE_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, REDISMODULE_AUX_BEFORE_RDB) == -1) return C_ERR;
+
+    /* save functions */
+    if (!(req & SLAVE_REQ_RDB_EXCLUDE_FUNCTIONS) && rdbSaveFunctions(rdb) == -1) return C_ERR;
+    return C_OK;
+}
+
+/* Writes the EOF opcode and the checksum that end an RDB file. */
+int rdbSaveRioTail(rio *rdb) {
+    uint64_t cksum;
+
+    if (rdbSaveType(rdb,RDB_OPCODE_EOF) == -1) return C_ERR;
+
+    /* CRC64 checksum. It will be zero if checksum computation is disabled, the
+     * loading code skips the check in this case. */
+    cksum = rdb->cksum;
+    memrev64ifbe(&cksum);
+    if (rioWrite(rdb,&cksum,8) == 0) return C_ERR;
+    return C_OK;
+}
+
 /* Produces a dump of the database in RDB format sending it to the specified
  * Redis I/O channel. On success C_OK is returned, otherwise C_ERR
  * is returned and part of the output, or all the output, can be
@@ -1321,20 +1395,10 @@ werr:
  * integer pointed by 'error' is set to the value of errno just after the I/O
  * error. */
 int rdbSaveRio(int req, rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
-    char magic[10];
-    uint64_t cksum;
     long key_counter = 0;
     int j;
 
-    if (server.rdb_checksum)
-        rdb->update_cksum = rioGenericUpdateChecksum;
-    snprintf(magic,sizeof(magic),"REDIS%04d",RDB_VERSION);
-    if (rdbWriteRaw(rdb,magic,9) == -1) goto werr;
-    if (rdbSaveInfoAuxFields(rdb,rdbflags,rsi) == -1) goto werr;
-    if (!(req & SLAVE_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, REDISMODULE_AUX_BEFORE_RDB) == -1) goto werr;
-
-    /* save functions */
-    if (!(req & SLAVE_REQ_RDB_EXCLUDE_FUNCTIONS) && rdbSaveFunctions(rdb) == -1) goto werr;
+    if (rdbSaveRioHead(req,rdb,rdbflags,rsi) == C_ERR) goto werr;
 
     /* save all databases, skip this if we're in functions-only mode */
     if (!(req & SLAVE_REQ_RDB_EXCLUDE_DATA)) {
@@ -1344,15 +1408,7 @@ int rdbSaveRio(int req, rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
     }
 
     if (!(req & SLAVE_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, REDISMODULE_AUX_AFTER_RDB) == -1) goto werr;
-
-    /* EOF opcode */
-    if (rdbSaveType(rdb,RDB_OPCODE_EOF) == -1) goto werr;
-
-    /* CRC64 checksum. It will be zero if checksum computation is disabled, the
-     * loading code skips the check in this case. */
-    cksum = rdb->cksum;
-    memrev64ifbe(&cksum);
-    if (rioWrite(rdb,&cksum,8) == 0) goto werr;
+    if (rdbSaveRioTail(rdb) == C_ERR) goto werr;
     return C_OK;
 
 werr:
@@ -1472,6 +1528,23 @@ int rdbSaveBackground(int req, char *filename, rdbSaveInfo *rsi) {
     server.dirty_before_bgsave = server.dirty;
     server.lastbgsave_try = time(NULL);
 
+    if (server.rdb_bgsave_method == RDB_BGSAVE_THREAD) {
+        if (snapshotAllowed()) {
+            server.rdb_last_bgsave_method = RDB_BGSAVE_THREAD;
+            if (snapshotStart(req,filename,rsi) != C_OK) {
+                server.lastbgsave_status = C_ERR;
+                return C_ERR;
+            }
+            serverLog(LL_NOTICE,"Background saving started by the snapshot thread");
+            server.rdb_save_time_start = time(NULL);
+            server.rdb_child_type = RDB_CHILD_TYPE_DISK;
+            return C_OK;
+        }
+        serverLog(LL_NOTICE,"Can't save in a thread with keyspace-open-addressing "
+                            "or module types that can't copy their values: forking");
+    }
+    server.rdb_last_bgsave_method = RDB_BGSAVE_FORK;
+
     if ((childpid = redisFork(CHILD_TYPE_RDB)) == 0) {
         int retval;
 
@@ -1843,7 +1916,11 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
         if ((zsetlen = rdbLoadLen(rdb,NULL)) == RDB_LENERR) return NULL;
         if (zsetlen == 0) goto emptykey;
 
-        o = createZsetObject();
+        if (server.zset_max_skiplist_entries &&
+            zsetlen > server.zset_max_skiplist_entries)
+            o = createZsetBtreeObject();
+        else
+            o = createZsetObject();
         zs = o->ptr;
 
         if (zsetlen > DICT_HT_INITIAL_SIZE && dictTryExpand(zs->dict,zsetlen) != DICT_OK) {
@@ -1888,6 +1965,19 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
             if (sdslen(sdsele) > maxelelen) maxelelen = sdslen(sdsele);
             totelelen += sdslen(sdsele);
 
+            if (zs->zbt) {
+                dictEntry *de = dictAddRaw(zs->dict,sdsele,NULL);
+                if (de == NULL) {
+                    rdbReportCorruptRDB("Duplicate zset fields detected");
+                    decrRefCount(o);
+                    sdsfree(sdsele);
+                    return NULL;
+                }
+                dictSetDoubleVal(de,score);
+                zbtInsert(zs->zbt,score,sdsele);
+                continue;
+            }
+
             znode = zslInsert(zs->zsl,score,sdsele);
             if (dictAdd(zs->dict,sdsele,&znode->score) != DICT_OK) {
                 rdbReportCorruptRDB("Duplicate zset fields detected");
@@ -2065,7 +2155,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
 
             if (rdbtype == RDB_TYPE_LIST_QUICKLIST_2) {
                 lp = data;
-                if (deep_integrity_validation) server.stat_dump_payload_sanitizations++;
+                if (deep_integrity_validation) atomicIncr(server.stat_dump_payload_sanitizations,1);
                 if (!lpValidateIntegrity(lp, encoded_len, deep_integrity_validation, NULL, NULL)) {
                     rdbReportCorruptRDB("Listpack integrity check failed.");
                     decrRefCount(o);
@@ -2207,7 +2297,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                     break;
                 }
             case RDB_TYPE_SET_INTSET:
-                if (deep_integrity_validation) server.stat_dump_payload_sanitizations++;
+                if (deep_integrity_validation) atomicIncr(server.stat_dump_payload_sanitizations,1);
                 if (!intsetValidateIntegrity(encoded, encoded_len, deep_integrity_validation)) {
                     rdbReportCorruptRDB("Intset integrity check failed.");
                     zfree(encoded);
@@ -2241,14 +2331,16 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                         goto emptykey;
                     }
 
-                    if (zsetLength(o) > server.zset_max_listpack_entries)
+                    if (zsetLength(o) > server.zset_max_listpack_entries) {
                         zsetConvert(o,OBJ_ENCODING_SKIPLIST);
-                    else
+                        zsetConvertToBtreeIfNeeded(o);
+                    } else {
                         o->ptr = lpShrinkToFit(o->ptr);
+                    }
                     break;
                 }
             case RDB_TYPE_ZSET_LISTPACK:
-                if (deep_integrity_validation) server.stat_dump_payload_sanitizations++;
+                if (deep_integrity_validation) atomicIncr(server.stat_dump_payload_sanitizations,1);
                 if (!lpPairsValidateIntegrityAndDups(encoded, encoded_len, deep_integrity_validation)) {
                     rdbReportCorruptRDB("Zset listpack integrity check failed.");
                     zfree(encoded);
@@ -2263,8 +2355,10 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                     goto emptykey;
                 }
 
-                if (zsetLength(o) > server.zset_max_listpack_entries)
+                if (zsetLength(o) > server.zset_max_listpack_entries) {
                     zsetConvert(o,OBJ_ENCODING_SKIPLIST);
+                    zsetConvertToBtreeIfNeeded(o);
+                }
                 break;
             case RDB_TYPE_HASH_ZIPLIST:
                 {
@@ -2294,7 +2388,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                     break;
                 }
             case RDB_TYPE_HASH_LISTPACK:
-                if (deep_integrity_validation) server.stat_dump_payload_sanitizations++;
+                if (deep_integrity_validation) atomicIncr(server.stat_dump_payload_sanitizations,1);
                 if (!lpPairsValidateIntegrityAndDups(encoded, encoded_len, deep_integrity_validation)) {
                     rdbReportCorruptRDB("Hash listpack integrity check failed.");
                     zfree(encoded);
@@ -2355,7 +2449,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                 decrRefCount(o);
                 return NULL;
             }
-            if (deep_integrity_validation) server.stat_dump_payload_sanitizations++;
+            if (deep_integrity_validation) atomicIncr(server.stat_dump_payload_sanitizations,1);
             if (!streamValidateListpackIntegrity(lp, lp_size, deep_integrity_validation)) {
                 rdbReportCorruptRDB("Stream listpack integrity check failed.");
                 sdsfree(nodekey);
@@ -2880,6 +2974,441 @@ done:
     return res;
 }
 
+/* ---------------------------- Parallel loading -----------------------------
+ * With rdb-load-threads > 0 the values are not built by the main thread. It
+ * keeps reading the RDB, but it only frames the keys: their key and value
+ * are copied in jobs as they are encoded in the file, without decompressing
+ * or converting anything. The loader threads build the values of the jobs
+ * with rdbLoadObject() (LZF decompression, listpacks, skiplists, dicts...),
+ * then the main thread adds them to the keyspace in the order of the file.
+ * Streams and module values are still loaded by the main thread, after the
+ * keys of the jobs before them. */
+
+#define RDB_LOAD_JOB_KEYS 512               /* Max keys of a job. */
+#define RDB_LOAD_JOB_BYTES (1024*1024)      /* Max framed bytes of a job. */
+#define RDB_LOAD_JOBS_PER_THREAD 4          /* Jobs in flight per thread. */
+
+/* State of rdbLoadRioWithLoadingCtx() used to add the keys. */
+typedef struct rdbLoadState {
+    int rdbflags;
+    long long now;
+    long long lru_clock;
+    long long empty_keys_skipped;
+} rdbLoadState;
+
+/* A key read from the RDB, with the attributes set by the opcodes before
+ * it. 'key' and 'val' are set to NULL once added to the keyspace. */
+typedef struct rdbLoadedKey {
+    int type;
+    redisDb *db;
+    long long expiretime, lfu_freq, lru_idle;
+    sds key;
+    robj *val;
+    int error;          /* Error of rdbLoadObject() if 'val' is NULL. */
+    long long offset;   /* Where a key built by a loader thread was framed,
+                         * or -1 if the main thread loaded it. */
+} rdbLoadedKey;
+
+typedef struct rdbLoadJob {
+    rio payload;        /* The keys framed by the main thread. */
+    rdbLoadedKey *keys;
+    int numkeys;
+    int done;           /* Set once a loader thread built the values. */
+} rdbLoadJob;
+
+static struct rdbLoader {
+    pthread_t *threads;
+    int numthreads;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;    /* Signaled when a job is queued. */
+    pthread_cond_t done_cond;   /* Signaled when a job is done. */
+    list *queued;               /* Jobs not taken by a thread yet. */
+    list *jobs;                 /* Jobs in flight, in the order of the file. */
+    rdbLoadJob *cur;            /* Job the main thread frames keys into. */
+    int stop;
+} rdbLoader;
+
+/* Adds the key loaded from the RDB to its database, unless it is empty or
+ * already expired. Returns C_ERR if the key failed loading. */
+static int rdbLoadAddKey(rdbLoadState *ls, rdbLoadedKey *k) {
+    redisDb *db = k->db;
+    sds key = k->key;
+    robj *val = k->val;
+
+    k->key = NULL;
+    k->val = NULL;
+    if (k->offset != -1 && (key == NULL ||
+        (val == NULL && k->error != RDB_LOAD_ERR_EMPTY_KEY)))
+    {
+        /* The loader thread that failed building the key left it to us. */
+        rdbReportCorruptRDB("Failed loading the key framed at offset %lld",
+            k->offset);
+    }
+    if (key == NULL) return C_ERR;
+
+    /* Check if the key already expired. This function is used when loading
+     * an RDB file from disk, either at startup, or when an RDB was
+     * received from the master. In the latter case, the master is
+     * responsible for key expiry. If we would expire keys here, the
+     * snapshot taken by the master may not be reflected on the slave.
+     * Similarly, if the base AOF is RDB format, we want to load all 
+     * the keys they are, since the log of operations in the incr AOF 
+     * is assumed to work in the exact keyspace state. */
+    if (val == NULL) {
+        /* Since we used to have bug that could lead to empty keys
+         * (See #8453), we rather not fail when empty key is encountered
+         * in an RDB file, instead we will silently discard it and
+         * continue loading. */
+        if (k->error == RDB_LOAD_ERR_EMPTY_KEY) {
+            if(ls->empty_keys_skipped++ < 10)
+                serverLog(LL_WARNING, "rdbLoadObject skipping empty key: %s", key);
+            sdsfree(key);
+        } else {
+            sdsfree(key);
+            return C_ERR;
+        }
+    } else if (iAmMaster() &&
+        !(ls->rdbflags&RDBFLAGS_AOF_PREAMBLE) &&
+        k->expiretime != -1 && k->expiretime < ls->now)
+    {
+        if (ls->rdbflags & RDBFLAGS_FEED_REPL) {
+            /* Caller should have created replication backlog,
+             * and now this path only works when rebooting,
+             * so we don't have replicas yet. */
+            serverAssert(server.repl_backlog != NULL && listLength(server.slaves) == 0);
+            robj keyobj;
+            initStaticStringObject(keyobj,key);
+            robj *argv[2];
+            argv[0] = server.lazyfree_lazy_expire ? shared.unlink : shared.del;
+            argv[1] = &keyobj;
+            replicationFeedSlaves(server.slaves,db->id,argv,2);
+        }
+        sdsfree(key);
+        decrRefCount(val);
+        server.rdb_last_load_keys_expired++;
+    } else {
+        robj keyobj;
+        initStaticStringObject(keyobj,key);
+
+        /* Add the new object in the hash table */
+        int added = dbAddRDBLoad(db,key,val);
+        server.rdb_last_load_keys_loaded++;
+        if (!added) {
+            if (ls->rdbflags & RDBFLAGS_ALLOW_DUP) {
+                /* This flag is useful for DEBUG RELOAD special modes.
+                 * When it's set we allow new keys to replace the current
+                 * keys with the same name. */
+                dbSyncDelete(db,&keyobj);
+                dbAddRDBLoad(db,key,val);
+            } else {
+                serverLog(LL_WARNING,
+                    "RDB has duplicated key '%s' in DB %d",key,db->id);
+                serverPanic("Duplicated key found in RDB file");
+            }
+        }
+
+        /* Set the expire time if needed */
+        if (k->expiretime != -1) {
+            setExpire(NULL,db,&keyobj,k->expiretime);
+        }
+
+        /* Set usage information (for eviction). */
+        objectSetLRUOrLFU(val,k->lfu_freq,k->lru_idle,ls->lru_clock,1000);
+
+        /* call key space notification on key loaded for modules only */
+        moduleNotifyKeyspaceEvent(NOTIFY_LOADED, "loaded", &keyobj, db->id);
+
+        /* The key was copied to its entry if keys are embedded. */
+        if (dictHasEmbeddedKeys(db->dict)) sdsfree(key);
+    }
+
+    /* Loading the database more slowly is useful in order to test
+     * certain edge cases. */
+    if (server.key_load_delay)
+        debugDelay(server.key_load_delay);
+    return C_OK;
+}
+
+/* Copies 'len' bytes of 'rdb' at the end of the buffer 'payload'. */
+static int rdbFrameRaw(rio *rdb, rio *payload, size_t len) {
+    while (len) {
+        /* A corrupted length fails with a short read rather than with a
+         * huge allocation. */
+        size_t chunk = len < RDB_LOAD_JOB_BYTES ? len : RDB_LOAD_JOB_BYTES;
+        sds buf = sdsMakeRoomFor(payload->io.buffer.ptr,chunk);
+
+        payload->io.buffer.ptr = buf;
+        if (rioRead(rdb,buf+sdslen(buf),chunk) == 0) return -1;
+        sdsIncrLen(buf,chunk);
+        payload->io.buffer.pos += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/* Copies a length, like rdbLoadLenByRef(). */
+static int rdbFrameLen(rio *rdb, rio *payload, int *isencoded, uint64_t *lenptr) {
+    if (rdbLoadLenByRef(rdb,isencoded,lenptr) == -1) return -1;
+    if (isencoded && *isencoded) {
+        unsigned char byte = (RDB_ENCVAL<<6)|*lenptr;
+        return rioWrite(payload,&byte,1) ? 0 : -1;
+    }
+    return rdbSaveLen(payload,*lenptr) == -1 ? -1 : 0;
+}
+
+/* Copies a string, without decompressing it. */
+static int rdbFrameString(rio *rdb, rio *payload) {
+    uint64_t len, clen;
+    int isencoded;
+
+    if (rdbFrameLen(rdb,payload,&isencoded,&len) == -1) return -1;
+    if (!isencoded) return rdbFrameRaw(rdb,payload,len);
+
+    switch(len) {
+    case RDB_ENC_INT8: return rdbFrameRaw(rdb,payload,1);
+    case RDB_ENC_INT16: return rdbFrameRaw(rdb,payload,2);
+    case RDB_ENC_INT32: return rdbFrameRaw(rdb,payload,4);
+    case RDB_ENC_LZF:
+        if (rdbFrameLen(rdb,payload,NULL,&clen) == -1 ||
+            rdbFrameLen(rdb,payload,NULL,&len) == -1) return -1;
+        return rdbFrameRaw(rdb,payload,clen);
+    default:
+        rdbReportCorruptRDB("Unknown RDB string encoding type %llu",
+            (unsigned long long)len);
+        return -1;
+    }
+}
+
+/* Returns true if the values of type 'rdbtype' can be framed. */
+static int rdbFrameableType(int rdbtype) {
+    return rdbIsObjectType(rdbtype) &&
+           rdbtype != RDB_TYPE_MODULE &&
+           rdbtype != RDB_TYPE_MODULE_2 &&
+           rdbtype != RDB_TYPE_STREAM_LISTPACKS &&
+           rdbtype != RDB_TYPE_STREAM_LISTPACKS_2;
+}
+
+/* Copies a value of a type rdbFrameableType() accepts, as encoded by
+ * rdbSaveObject(). */
+static int rdbFrameObject(int rdbtype, rio *rdb, rio *payload) {
+    uint64_t len, container;
+    unsigned char dlen;
+
+    switch(rdbtype) {
+    case RDB_TYPE_LIST:
+    case RDB_TYPE_SET:
+    case RDB_TYPE_LIST_QUICKLIST:
+    case RDB_TYPE_LIST_QUICKLIST_2:
+    case RDB_TYPE_ZSET:
+    case RDB_TYPE_ZSET_2:
+    case RDB_TYPE_HASH:
+        break;
+    default:
+        /* Strings, and the types serialized as a single blob. */
+        return rdbFrameString(rdb,payload);
+    }
+
+    if (rdbFrameLen(rdb,payload,NULL,&len) == -1) return -1;
+    while (len--) {
+        if (rdbtype == RDB_TYPE_LIST_QUICKLIST_2 &&
+            rdbFrameLen(rdb,payload,NULL,&container) == -1) return -1;
+        if (rdbFrameString(rdb,payload) == -1) return -1;
+
+        if (rdbtype == RDB_TYPE_HASH) {
+            if (rdbFrameString(rdb,payload) == -1) return -1;
+        } else if (rdbtype == RDB_TYPE_ZSET_2) {
+            if (rdbFrameRaw(rdb,payload,sizeof(double)) == -1) return -1;
+        } else if (rdbtype == RDB_TYPE_ZSET) {
+            /* See rdbLoadDoubleValue(). */
+            if (rioRead(rdb,&dlen,1) == 0 || rioWrite(payload,&dlen,1) == 0)
+                return -1;
+            if (dlen < 253 && rdbFrameRaw(rdb,payload,dlen) == -1) return -1;
+        }
+    }
+    return 0;
+}
+
+static rdbLoadJob *rdbLoadJobCreate(void) {
+    rdbLoadJob *job = zmalloc(sizeof(*job));
+
+    rioInitWithBuffer(&job->payload,sdsempty());
+    job->keys = zmalloc(sizeof(rdbLoadedKey)*RDB_LOAD_JOB_KEYS);
+    job->numkeys = 0;
+    job->done = 0;
+    return job;
+}
+
+static void rdbLoadJobFree(rdbLoadJob *job) {
+    for (int j = 0; j < job->numkeys; j++) {
+        if (job->keys[j].key) sdsfree(job->keys[j].key);
+        if (job->keys[j].val) decrRefCount(job->keys[j].val);
+    }
+    sdsfree(job->payload.io.buffer.ptr);
+    zfree(job->keys);
+    zfree(job);
+}
+
+/* Builds the keys and values of the job, in a loader thread. A key that
+ * fails loading has a NULL value and no key follows it. */
+static void rdbLoadJobProcess(rdbLoadJob *job) {
+    rio *payload = &job->payload;
+
+    payload->io.buffer.pos = 0;
+    for (int j = 0; j < job->numkeys; j++) {
+        rdbLoadedKey *k = job->keys+j;
+
+        k->key = rdbGenericLoadStringObject(payload,RDB_LOAD_SDS,NULL);
+        if (k->key == NULL) break;
+        k->val = rdbLoadObject(k->type,payload,k->key,k->db->id,&k->error);
+        if (k->val == NULL && k->error != RDB_LOAD_ERR_EMPTY_KEY) break;
+    }
+}
+
+static void *rdbLoaderThreadMain(void *arg) {
+    UNUSED(arg);
+    sigset_t sigset;
+
+    redis_set_thread_title("rdb_load");
+    rdbLoaderThread = 1;
+    /* Block SIGALRM so we are sure that only the main thread will
+     * receive the watchdog signal. */
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
+        serverLog(LL_WARNING,
+            "Warning: can't mask SIGALRM in RDB loader thread: %s", strerror(errno));
+
+    pthread_mutex_lock(&rdbLoader.mutex);
+    while(1) {
+        while (!rdbLoader.stop && listLength(rdbLoader.queued) == 0)
+            pthread_cond_wait(&rdbLoader.job_cond,&rdbLoader.mutex);
+        if (rdbLoader.stop) break;
+
+        listNode *ln = listFirst(rdbLoader.queued);
+        rdbLoadJob *job = listNodeValue(ln);
+        listDelNode(rdbLoader.queued,ln);
+        pthread_mutex_unlock(&rdbLoader.mutex);
+
+        rdbLoadJobProcess(job);
+
+        pthread_mutex_lock(&rdbLoader.mutex);
+        job->done = 1;
+        pthread_cond_signal(&rdbLoader.done_cond);
+    }
+    pthread_mutex_unlock(&rdbLoader.mutex);
+    return NULL;
+}
+
+/* Stops the loader threads, dropping the jobs in flight. */
+static void rdbLoaderStop(void) {
+    listIter li;
+    listNode *ln;
+
+    pthread_mutex_lock(&rdbLoader.mutex);
+    rdbLoader.stop = 1;
+    pthread_cond_broadcast(&rdbLoader.job_cond);
+    pthread_mutex_unlock(&rdbLoader.mutex);
+    for (int j = 0; j < rdbLoader.numthreads; j++)
+        pthread_join(rdbLoader.threads[j],NULL);
+
+    listRewind(rdbLoader.jobs,&li);
+    while ((ln = listNext(&li)) != NULL) rdbLoadJobFree(listNodeValue(ln));
+    if (rdbLoader.cur) rdbLoadJobFree(rdbLoader.cur);
+    listRelease(rdbLoader.jobs);
+    listRelease(rdbLoader.queued);
+    zfree(rdbLoader.threads);
+    pthread_mutex_destroy(&rdbLoader.mutex);
+    pthread_cond_destroy(&rdbLoader.job_cond);
+    pthread_cond_destroy(&rdbLoader.done_cond);
+    memset(&rdbLoader,0,sizeof(rdbLoader));
+}
+
+/* Starts the loader threads. On error the RDB is loaded by the main thread. */
+static int rdbLoaderStart(void) {
+    int j;
+
+    rdbLoader.threads = zmalloc(sizeof(pthread_t)*server.rdb_load_threads);
+    rdbLoader.numthreads = 0;
+    pthread_mutex_init(&rdbLoader.mutex,NULL);
+    pthread_cond_init(&rdbLoader.job_cond,NULL);
+    pthread_cond_init(&rdbLoader.done_cond,NULL);
+    rdbLoader.queued = listCreate();
+    rdbLoader.jobs = listCreate();
+    rdbLoader.cur = NULL;
+    rdbLoader.stop = 0;
+    for (j = 0; j < server.rdb_load_threads; j++) {
+        if (pthread_create(rdbLoader.threads+j,NULL,rdbLoaderThreadMain,NULL) != 0) {
+            serverLog(LL_WARNING,"Can't create the RDB loader threads: %s",
+                strerror(errno));
+            rdbLoaderStop();
+            return C_ERR;
+        }
+        rdbLoader.numthreads++;
+    }
+    return C_OK;
+}
+
+/* Adds the keys of the jobs done to the keyspace, in order, waiting for
+ * the oldest jobs while there are more than 'maxjobs' in flight. */
+static int rdbLoaderAddKeys(rdbLoadState *ls, unsigned long maxjobs) {
+    while (listLength(rdbLoader.jobs)) {
+        listNode *ln = listFirst(rdbLoader.jobs);
+        rdbLoadJob *job = listNodeValue(ln);
+        int done;
+
+        pthread_mutex_lock(&rdbLoader.mutex);
+        while (!job->done && listLength(rdbLoader.jobs) > maxjobs)
+            pthread_cond_wait(&rdbLoader.done_cond,&rdbLoader.mutex);
+        done = job->done;
+        pthread_mutex_unlock(&rdbLoader.mutex);
+        if (!done) break;
+
+        for (int j = 0; j < job->numkeys; j++)
+            if (rdbLoadAddKey(ls,job->keys+j) == C_ERR) return C_ERR;
+        listDelNode(rdbLoader.jobs,ln);
+        rdbLoadJobFree(job);
+    }
+    return C_OK;
+}
+
+/* Queues the job being framed to the loader threads. */
+static void rdbLoaderQueueJob(void) {
+    rdbLoadJob *job = rdbLoader.cur;
+
+    rdbLoader.cur = NULL;
+    listAddNodeTail(rdbLoader.jobs,job);
+    pthread_mutex_lock(&rdbLoader.mutex);
+    listAddNodeTail(rdbLoader.queued,job);
+    pthread_cond_signal(&rdbLoader.job_cond);
+    pthread_mutex_unlock(&rdbLoader.mutex);
+}
+
+/* Frames the key 'k', of a type rdbFrameableType() accepts, read from
+ * 'rdb', into the current job. */
+static int rdbLoaderFrameKey(rdbLoadState *ls, rio *rdb, rdbLoadedKey *k) {
+    if (rdbLoader.cur == NULL) rdbLoader.cur = rdbLoadJobCreate();
+    rdbLoadJob *job = rdbLoader.cur;
+
+    k->offset = server.loading_loaded_bytes;
+    job->keys[job->numkeys++] = *k;
+    if (rdbFrameString(rdb,&job->payload) == -1 ||
+        rdbFrameObject(k->type,rdb,&job->payload) == -1) return C_ERR;
+
+    if (job->numkeys == RDB_LOAD_JOB_KEYS ||
+        sdslen(job->payload.io.buffer.ptr) >= RDB_LOAD_JOB_BYTES)
+    {
+        rdbLoaderQueueJob();
+        return rdbLoaderAddKeys(ls,rdbLoader.numthreads*RDB_LOAD_JOBS_PER_THREAD);
+    }
+    return C_OK;
+}
+
+/* Adds all the keys framed so far to the keyspace. */
+static int rdbLoaderDrain(rdbLoadState *ls) {
+    if (rdbLoader.cur) rdbLoaderQueueJob();
+    return rdbLoaderAddKeys(ls,0);
+}
+
 /* Load an RDB file from the rio stream 'rdb'. On success C_OK is returned,
  * otherwise C_ERR is returned and 'errno' is set accordingly. */
 int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
@@ -2900,8 +3429,7 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
     int type, rdbver;
     redisDb *db = rdb_loading_ctx->dbarray+0;
     char buf[1024];
-    int error;
-    long long empty_keys_skipped = 0;
+    int parallel = 0;
 
     rdb->update_cksum = rdbLoadProgressCallback;
     rdb->max_processing_chunk = server.loading_process_events_interval_bytes;
@@ -2920,13 +3448,20 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
     }
 
     /* Key-specific attributes, set by opcodes before the key type. */
-    long long lru_idle = -1, lfu_freq = -1, expiretime = -1, now = mstime();
-    long long lru_clock = LRU_CLOCK();
+    long long lru_idle = -1, lfu_freq = -1, expiretime = -1;
+    rdbLoadState ls = {
+        .rdbflags = rdbflags,
+        .now = mstime(),
+        .lru_clock = LRU_CLOCK(),
+        .empty_keys_skipped = 0
+    };
+
+    /* The values are built by the loader threads if possible, see
+     * rdbLoaderFrameKey(). */
+    if (server.rdb_load_threads && !rdbCheckMode)
+        parallel = rdbLoaderStart() == C_OK;
 
     while(1) {
-        sds key;
-        robj *val;
-
         /* Read type. */
         if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
 
@@ -2959,6 +3494,7 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
             continue; /* Read next opcode. */
         } else if (type == RDB_OPCODE_EOF) {
             /* EOF: End of file, exit the main loop. */
+            if (parallel && rdbLoaderDrain(&ls) == C_ERR) goto eoferr;
             break;
         } else if (type == RDB_OPCODE_SELECTDB) {
             /* SELECTDB: Select the specified database. */
@@ -3049,6 +3585,7 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
             /* Load module data that is not related to the Redis key space.
              * Such data can be potentially be stored both before and after the
              * RDB keys-values section. */
+            if (parallel && rdbLoaderDrain(&ls) == C_ERR) goto eoferr;
             uint64_t moduleid = rdbLoadLen(rdb,NULL);
             int when_opcode = rdbLoadLen(rdb,NULL);
             int when = rdbLoadLen(rdb,NULL);
@@ -3109,96 +3646,41 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
             continue;
         }
 
-        /* Read key */
-        if ((key = rdbGenericLoadStringObject(rdb,RDB_LOAD_SDS,NULL)) == NULL)
-            goto eoferr;
-        /* Read value */
-        val = rdbLoadObject(type,rdb,key,db->id,&error);
-
-        /* Check if the key already expired. This function is used when loading
-         * an RDB file from disk, either at startup, or when an RDB was
-         * received from the master. In the latter case, the master is
-         * responsible for key expiry. If we would expire keys here, the
-         * snapshot taken by the master may not be reflected on the slave.
-         * Similarly, if the base AOF is RDB format, we want to load all 
-         * the keys they are, since the log of operations in the incr AOF 
-         * is assumed to work in the exact keyspace state. */
-        if (val == NULL) {
-            /* Since we used to have bug that could lead to empty keys
-             * (See #8453), we rather not fail when empty key is encountered
-             * in an RDB file, instead we will silently discard it and
-             * continue loading. */
-            if (error == RDB_LOAD_ERR_EMPTY_KEY) {
-                if(empty_keys_skipped++ < 10)
-                    serverLog(LL_WARNING, "rdbLoadObject skipping empty key: %s", key);
-                sdsfree(key);
-            } else {
-                sdsfree(key);
-                goto eoferr;
-            }
-        } else if (iAmMaster() &&
-            !(rdbflags&RDBFLAGS_AOF_PREAMBLE) &&
-            expiretime != -1 && expiretime < now)
-        {
-            if (rdbflags & RDBFLAGS_FEED_REPL) {
-                /* Caller should have created replication backlog,
-                 * and now this path only works when rebooting,
-                 * so we don't have replicas yet. */
-                serverAssert(server.repl_backlog != NULL && listLength(server.slaves) == 0);
-                robj keyobj;
-                initStaticStringObject(keyobj,key);
-                robj *argv[2];
-                argv[0] = server.lazyfree_lazy_expire ? shared.unlink : shared.del;
-                argv[1] = &keyobj;
-                replicationFeedSlaves(server.slaves,dbid,argv,2);
-            }
-            sdsfree(key);
-            decrRefCount(val);
-            server.rdb_last_load_keys_expired++;
+        rdbLoadedKey k = {
+            .type = type,
+            .db = db,
+            .expiretime = expiretime,
+            .lfu_freq = lfu_freq,
+            .lru_idle = lru_idle,
+            .key = NULL,
+            .val = NULL,
+            .error = RDB_LOAD_ERR_OTHER,
+            .offset = -1
+        };
+        if (parallel && rdbFrameableType(type)) {
+            if (rdbLoaderFrameKey(&ls,rdb,&k) == C_ERR) goto eoferr;
         } else {
-            robj keyobj;
-            initStaticStringObject(keyobj,key);
-
-            /* Add the new object in the hash table */
-            int added = dbAddRDBLoad(db,key,val);
-            server.rdb_last_load_keys_loaded++;
-            if (!added) {
-                if (rdbflags & RDBFLAGS_ALLOW_DUP) {
-                    /* This flag is useful for DEBUG RELOAD special modes.
-                     * When it's set we allow new keys to replace the current
-                     * keys with the same name. */
-                    dbSyncDelete(db,&keyobj);
-                    dbAddRDBLoad(db,key,val);
-                } else {
-                    serverLog(LL_WARNING,
-                        "RDB has duplicated key '%s' in DB %d",key,db->id);
-                    serverPanic("Duplicated key found in RDB file");
-                }
-            }
-
-            /* Set the expire time if needed */
-            if (expiretime != -1) {
-                setExpire(NULL,db,&keyobj,expiretime);
-            }
-
-            /* Set usage information (for eviction). */
-            objectSetLRUOrLFU(val,lfu_freq,lru_idle,lru_clock,1000);
-
-            /* call key space notification on key loaded for modules only */
-            moduleNotifyKeyspaceEvent(NOTIFY_LOADED, "loaded", &keyobj, db->id);
+            /* The keys are added in the order of the file. */
+            if (parallel && rdbLoaderDrain(&ls) == C_ERR) goto eoferr;
+            /* Read key */
+            if ((k.key = rdbGenericLoadStringObject(rdb,RDB_LOAD_SDS,NULL)) == NULL)
+                goto eoferr;
+            /* Read value */
+            k.val = rdbLoadObject(type,rdb,k.key,db->id,&k.error);
+            if (rdbLoadAddKey(&ls,&k) == C_ERR) goto eoferr;
         }
 
-        /* Loading the database more slowly is useful in order to test
-         * certain edge cases. */
-        if (server.key_load_delay)
-            debugDelay(server.key_load_delay);
-
         /* Reset the state that is key-specified and is populated by
          * opcodes before the key, so that we start from scratch again. */
         expiretime = -1;
         lfu_freq = -1;
         lru_idle = -1;
     }
+    if (parallel) {
+        rdbLoaderStop();
+        parallel = 0;
+    }
+
     /* Verify the checksum if RDB version is >= 5 */
     if (rdbver >= 5) {
         uint64_t cksum, expected = rdb->cksum;
@@ -3219,10 +3701,10 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
         }
     }
 
-    if (empty_keys_skipped) {
+    if (ls.empty_keys_skipped) {
         serverLog(LL_WARNING,
             "Done loading RDB, keys loaded: %lld, keys expired: %lld, empty keys skipped: %lld.",
-                server.rdb_last_load_keys_loaded, server.rdb_last_load_keys_expired, empty_keys_skipped);
+                server.rdb_last_load_keys_loaded, server.rdb_last_load_keys_expired, ls.empty_keys_skipped);
     } else {
         serverLog(LL_NOTICE,
             "Done loading RDB, keys loaded: %lld, keys expired: %lld.",
@@ -3235,6 +3717,7 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
      * the RDB file from a socket during initial SYNC (diskless replica mode),
      * we'll report the error to the caller, so that we can retry. */
 eoferr:
+    if (parallel) rdbLoaderStop();
     serverLog(LL_WARNING,
         "Short read or OOM loading DB. Unrecoverable error, aborting now.");
     rdbReportReadError("Unexpected EOF reading RDB file");
@@ -3287,7 +3770,8 @@ static void backgroundSaveDoneHandlerDisk(int exitcode, int bysignal) {
         serverLog(LL_WARNING,
             "Background saving terminated by signal %d", bysignal);
         latencyStartMonitor(latency);
-        rdbRemoveTempFile(server.child_pid, 0);
+        /* The snapshot thread removes its temp file itself. */
+        if (server.child_pid != -1) rdbRemoveTempFile(server.child_pid, 0);
         latencyEndMonitor(latency);
         latencyAddSampleIfNeeded("rdb-unlink-temp-file",latency);
         /* SIGUSR1 is whitelisted, so we have a way to kill a child without
@@ -3352,6 +3836,10 @@ void backgroundSaveDoneHandler(int exitcode, int bysignal) {
  * the child did not exit for an error, but because we wanted), and performs
  * the cleanup needed. */
 void killRDBChild(void) {
+    if (server.child_pid == -1) {
+        snapshotKill();
+        return;
+    }
     kill(server.child_pid, SIGUSR1);
     /* Because we are not using here waitpid (like we have in killAppendOnlyChild
      * and TerminateModuleForkChild), all the cleanup operations is done by
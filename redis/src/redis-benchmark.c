@@ -1648,6 +1648,12 @@ usage:
 "   $ redis-benchmark -t set -n 1000000 -r 100000000\n\n"
 " Benchmark 127.0.0.1:6379 for a few commands producing CSV output:\n"
 "   $ redis-benchmark -t ping,set,get -n 100000 --csv\n\n"
+" Benchmark read only commands, to compare the server with different\n"
+" io-threads when io-threads-do-commands is enabled:\n"
+"   $ redis-benchmark -t hset,hget,zadd,zscore -r 100000 -n 1000000 -c 100 --threads 8\n\n"
+" Benchmark pipelined lookups with the keys prefetched, on a dataset larger\n"
+" than the CPU caches, to compare with prefetch-batch-max-size set to 0:\n"
+"   $ redis-benchmark -t set,get -r 10000000 -n 20000000 -d 16 -P 16\n\n"
 " Benchmark a specific command line:\n"
 "   $ redis-benchmark -r 10000 -n 10000 eval 'return redis.call(\"ping\")' 0\n\n"
 " Fill a list with 10000 random elements:\n"
@@ -1959,6 +1965,13 @@ int main(int argc, char **argv) {
             free(cmd);
         }
 
+        if (test_is_selected("hget")) {
+            len = redisFormatCommand(&cmd,
+                "HGET myhash%s element:__rand_int__",tag);
+            benchmark("HGET",cmd,len);
+            free(cmd);
+        }
+
         if (test_is_selected("spop")) {
             len = redisFormatCommand(&cmd,"SPOP myset%s",tag);
             benchmark("SPOP",cmd,len);
@@ -1974,6 +1987,13 @@ int main(int argc, char **argv) {
             free(cmd);
         }
 
+        if (test_is_selected("zscore")) {
+            len = redisFormatCommand(&cmd,
+                "ZSCORE myzset%s element:__rand_int__",tag);
+            benchmark("ZSCORE",cmd,len);
+            free(cmd);
+        }
+
         if (test_is_selected("zpopmin")) {
             len = redisFormatCommand(&cmd,"ZPOPMIN myzset%s",tag);
             benchmark("ZPOPMIN",cmd,len);
@@ -270,6 +270,16 @@ void *dictSdsDup(dict *d, const void *key) {
     return sdsdup((const sds) key);
 }
 
+size_t dictSdsEmbedLen(dict *d, const void *key) {
+    UNUSED(d);
+    return sdsembedlen(sdslen((const sds) key));
+}
+
+void *dictSdsEmbed(dict *d, void *buf, const void *key) {
+    UNUSED(d);
+    return sdsnewembedded(buf, key, sdslen((const sds) key));
+}
+
 int dictObjKeyCompare(dict *d, const void *key1,
         const void *key2)
 {
@@ -423,7 +433,8 @@ dictType zsetDictType = {
     NULL                       /* allow to expand */
 };
 
-/* Db->dict, keys are sds strings, vals are Redis objects. */
+/* Db->dict, keys are sds strings, vals are Redis objects. Keys are embedded
+ * in the entries if keyspace-embed-keys is set, see initServer(). */
 dictType dbDictType = {
     dictSdsHash,                /* hash function */
     NULL,                       /* key dup */
@@ -614,12 +625,16 @@ const char *strChildType(int type) {
 }
 
 /* Return true if there are active children processes doing RDB saving,
- * AOF rewriting, or some side process spawned by a loaded module. */
+ * AOF rewriting, or some side process spawned by a loaded module. The RDB
+ * may also be saved by a thread taking the place of the child, with no
+ * pid, see snapshot.c. */
 int hasActiveChildProcess() {
-    return server.child_pid != -1;
+    return server.child_pid != -1 || server.child_type != CHILD_TYPE_NONE;
 }
 
 void resetChildState() {
+    int forked = server.child_pid != -1;
+
     server.child_type = CHILD_TYPE_NONE;
     server.child_pid = -1;
     server.stat_current_cow_peak = 0;
@@ -630,9 +645,11 @@ void resetChildState() {
     server.stat_current_save_keys_total = 0;
     updateDictResizePolicy();
     closeChildInfoPipe();
-    moduleFireServerEvent(REDISMODULE_EVENT_FORK_CHILD,
-                          REDISMODULE_SUBEVENT_FORK_CHILD_DIED,
-                          NULL);
+    if (forked) {
+        moduleFireServerEvent(REDISMODULE_EVENT_FORK_CHILD,
+                              REDISMODULE_SUBEVENT_FORK_CHILD_DIED,
+                              NULL);
+    }
 }
 
 /* Return if child type is mutually exclusive with other fork children */
@@ -1060,6 +1077,18 @@ void checkChildrenDone(void) {
     int statloc = 0;
     pid_t pid;
 
+    /* The RDB is saved by a thread rather than a child, see snapshot.c */
+    if (server.child_type == CHILD_TYPE_RDB && server.child_pid == -1) {
+        int exitcode, bysignal;
+
+        if (snapshotCheckDone(&exitcode,&bysignal)) {
+            backgroundSaveDoneHandler(exitcode,bysignal);
+            resetChildState();
+            replicationStartPendingFork();
+        }
+        if (!ldbPendingChildren()) return;
+    }
+
     if ((pid = waitpid(-1, &statloc, WNOHANG)) != 0) {
         int exitcode = WIFEXITED(statloc) ? WEXITSTATUS(statloc) : -1;
         int bysignal = 0;
@@ -1645,7 +1674,7 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
     /* Before we are going to sleep, let the threads access the dataset by
      * releasing the GIL. Redis main thread will not touch anything at this
      * time. */
-    if (moduleCount()) moduleReleaseGIL();
+    if (moduleCount() || server.snapshot_in_progress) moduleReleaseGIL();
 
     /* Do NOT add anything below moduleReleaseGIL !!! */
 }
@@ -1660,11 +1689,14 @@ void afterSleep(struct aeEventLoop *eventLoop) {
 
     /* Acquire the modules GIL so that their threads won't touch anything. */
     if (!ProcessingEventsWhileBlocked) {
-        if (moduleCount()) {
+        if (moduleCount() || server.snapshot_in_progress) {
             mstime_t latency;
             latencyStartMonitor(latency);
 
-            moduleAcquireGIL();
+            if (server.snapshot_in_progress)
+                snapshotAcquireGIL();
+            else
+                moduleAcquireGIL();
             moduleFireServerEvent(REDISMODULE_EVENT_EVENTLOOP,
                                   REDISMODULE_SUBEVENT_EVENTLOOP_AFTER_SLEEP,
                                   NULL);
@@ -2333,6 +2365,9 @@ void resetServerStats(void) {
     server.stat_expired_stale_perc = 0;
     server.stat_expired_time_cap_reached_count = 0;
     server.stat_expire_cycle_time_used = 0;
+    server.stat_expired_active_keys = 0;
+    server.stat_expired_lag_sum = 0;
+    server.stat_expired_lag_max = 0;
     server.stat_evictedkeys = 0;
     server.stat_evictedclients = 0;
     server.stat_total_eviction_exceeded_time = 0;
@@ -2356,6 +2391,9 @@ void resetServerStats(void) {
     server.stat_io_reads_processed = 0;
     atomicSet(server.stat_total_reads_processed, 0);
     server.stat_io_writes_processed = 0;
+    server.stat_io_commands_processed = 0;
+    server.stat_prefetch_batches = 0;
+    server.stat_prefetch_keys = 0;
     atomicSet(server.stat_total_writes_processed, 0);
     for (j = 0; j < STATS_METRIC_COUNT; j++) {
         server.inst_metric[j].idx = 0;
@@ -2373,7 +2411,7 @@ void resetServerStats(void) {
     atomicSet(server.stat_net_repl_output_bytes, 0);
     server.stat_unexpected_error_replies = 0;
     server.stat_total_error_replies = 0;
-    server.stat_dump_payload_sanitizations = 0;
+    atomicSet(server.stat_dump_payload_sanitizations, 0);
     server.aof_delayed_fsync = 0;
     server.stat_reply_buffer_shrinks = 0;
     server.stat_reply_buffer_expands = 0;
@@ -2418,6 +2456,7 @@ void initServer(void) {
     server.monitors = listCreate();
     server.clients_pending_write = listCreate();
     server.clients_pending_read = listCreate();
+    server.clients_pending_command = listCreate();
     server.clients_timeout_table = raxNew();
     server.replication_allowed = 1;
     server.slaveseldb = -1; /* Force to emit the first SELECT command. */
@@ -2499,9 +2538,16 @@ void initServer(void) {
     }
 
     /* Create the Redis databases, and initialize other internal state. */
+    dbDictType.openAddressing = server.keyspace_open_addressing;
+    dbExpiresDictType.openAddressing = server.keyspace_open_addressing;
+    if (server.keyspace_embed_keys) {
+        dbDictType.keyEmbedLen = dictSdsEmbedLen;
+        dbDictType.keyEmbed = dictSdsEmbed;
+    }
     for (j = 0; j < server.dbnum; j++) {
         server.db[j].dict = dictCreate(&dbDictType);
         server.db[j].expires = dictCreate(&dbExpiresDictType);
+        server.db[j].expires_index = server.active_expire_index ? raxNew() : NULL;
         server.db[j].expires_cursor = 0;
         server.db[j].blocking_keys = dictCreate(&keylistDictType);
         server.db[j].ready_keys = dictCreate(&objectKeyPointerValueDictType);
@@ -2527,6 +2573,8 @@ void initServer(void) {
     server.child_pid = -1;
     server.child_type = CHILD_TYPE_NONE;
     server.rdb_child_type = RDB_CHILD_TYPE_NONE;
+    server.rdb_last_bgsave_method = RDB_BGSAVE_FORK;
+    server.snapshot_in_progress = 0;
     server.rdb_pipe_conns = NULL;
     server.rdb_pipe_numconns = 0;
     server.rdb_pipe_numconns_writing = 0;
@@ -2554,6 +2602,10 @@ void initServer(void) {
     server.stat_current_save_keys_processed = 0;
     server.stat_current_save_keys_total = 0;
     server.stat_rdb_cow_bytes = 0;
+    server.stat_snapshot_stall_max = 0;
+    server.stat_snapshot_stall_total = 0;
+    server.stat_snapshot_captured_keys = 0;
+    server.stat_snapshot_copied_values = 0;
     server.stat_aof_cow_bytes = 0;
     server.stat_module_cow_bytes = 0;
     server.stat_module_progress = 0;
@@ -2619,6 +2671,8 @@ void initServer(void) {
     functionsInit();
     slowlogInit();
     latencyMonitorInit();
+    bitopsSelectKernels(1);
+    hllSelectKernels(1);
 
     /* Initialize ACL default password if it exists */
     ACLUpdateDefaultUserPassword(server.requirepass);
@@ -3315,14 +3369,29 @@ void call(client *c, int flags) {
     if (monotonicGetType() == MONOTONIC_CLOCK_HW)
         monotonic_start = getMonotonicUs();
 
+    /* A command executed by an I/O thread already has its reply and its
+     * c->duration, we just account for it: the errors it replied were
+     * deferred, since the stats can only be updated by the main thread. */
+    int executed = (c->flags & CLIENT_PENDING_IO_COMMAND) != 0;
     server.in_nested_call++;
-    c->cmd->proc(c);
+    if (executed) {
+        c->flags &= ~CLIENT_PENDING_IO_COMMAND;
+        if (c->deferred_reply_errors) {
+            deferredAfterErrorReply(c, c->deferred_reply_errors);
+            listRelease(c->deferred_reply_errors);
+            c->deferred_reply_errors = NULL;
+        }
+    } else {
+        c->cmd->proc(c);
+    }
     server.in_nested_call--;
 
     /* In order to avoid performance implication due to querying the clock using a system call 3 times,
      * we use a monotonic clock, when we are sure its cost is very low, and fall back to non-monotonic call otherwise. */
     ustime_t duration;
-    if (monotonicGetType() == MONOTONIC_CLOCK_HW)
+    if (executed)
+        duration = c->duration;
+    else if (monotonicGetType() == MONOTONIC_CLOCK_HW)
         duration = getMonotonicUs() - monotonic_start;
     else
         duration = ustime() - call_timer;
@@ -3945,6 +4014,10 @@ int processCommand(client *c) {
         queueMultiCommand(c, cmd_flags);
         addReply(c,shared.queued);
     } else {
+        /* Read only commands may run on the I/O threads, the remaining of
+         * this branch is done by handleClientsWithPendingCommandsUsingThreads(). */
+        if (postponeClientCommand(c)) return C_OK;
+
         call(c,CMD_CALL_FULL);
         c->woff = server.master_repl_offset;
         if (listLength(server.ready_keys))
@@ -4137,8 +4210,9 @@ int finishShutdown(void) {
          * so we need to call rdbRemoveTempFile which will close fd(in order
          * to unlink file actually) in background thread.
          * The temp rdb file fd may won't be closed when redis exits quickly,
-         * but OS will close this fd when process exits. */
-        rdbRemoveTempFile(server.child_pid, 0);
+         * but OS will close this fd when process exits. The snapshot
+         * thread removes its temp file itself. */
+        if (server.child_pid != -1) rdbRemoveTempFile(server.child_pid, 0);
     }
 
     /* Kill module child if there is one. */
@@ -5418,6 +5492,8 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             "mem_clients_normal:%zu\r\n"
             "mem_cluster_links:%zu\r\n"
             "mem_aof_buffer:%zu\r\n"
+            "mem_keyspace_overhead:%zu\r\n"
+            "mem_keyspace_embedded_keys:%zu\r\n"
             "mem_allocator:%s\r\n"
             "active_defrag_running:%d\r\n"
             "lazyfree_pending_objects:%zu\r\n"
@@ -5472,6 +5548,8 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             mh->clients_normal,
             mh->cluster_links,
             mh->aof_buffer,
+            mh->keyspace_overhead,
+            mh->keyspace_embedded_keys,
             ZMALLOC_LIB,
             server.active_defrag_running,
             lazyfreeGetPendingObjectsCount(),
@@ -5510,6 +5588,11 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             "rdb_current_bgsave_time_sec:%jd\r\n"
             "rdb_saves:%lld\r\n"
             "rdb_last_cow_size:%zu\r\n"
+            "rdb_last_bgsave_method:%s\r\n"
+            "rdb_snapshot_stall_max_usec:%lld\r\n"
+            "rdb_snapshot_stall_total_usec:%lld\r\n"
+            "rdb_snapshot_captured_keys:%lld\r\n"
+            "rdb_snapshot_copied_values:%lld\r\n"
             "rdb_last_load_keys_expired:%lld\r\n"
             "rdb_last_load_keys_loaded:%lld\r\n"
             "aof_enabled:%d\r\n"
@@ -5541,6 +5624,11 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
                 -1 : time(NULL)-server.rdb_save_time_start),
             server.stat_rdb_saves,
             server.stat_rdb_cow_bytes,
+            server.rdb_last_bgsave_method == RDB_BGSAVE_THREAD ? "thread" : "fork",
+            server.stat_snapshot_stall_max,
+            server.stat_snapshot_stall_total,
+            server.stat_snapshot_captured_keys,
+            server.stat_snapshot_copied_values,
             server.rdb_last_load_keys_expired,
             server.rdb_last_load_keys_loaded,
             server.aof_state != AOF_OFF,
@@ -5620,6 +5708,7 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
         long long stat_total_reads_processed, stat_total_writes_processed;
         long long stat_net_input_bytes, stat_net_output_bytes;
         long long stat_net_repl_input_bytes, stat_net_repl_output_bytes;
+        long long stat_dump_payload_sanitizations;
         long long current_eviction_exceeded_time = server.stat_last_eviction_exceeded_time ?
             (long long) elapsedUs(server.stat_last_eviction_exceeded_time): 0;
         long long current_active_defrag_time = server.stat_last_active_defrag_time ?
@@ -5630,6 +5719,7 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
         atomicGet(server.stat_net_output_bytes, stat_net_output_bytes);
         atomicGet(server.stat_net_repl_input_bytes, stat_net_repl_input_bytes);
         atomicGet(server.stat_net_repl_output_bytes, stat_net_repl_output_bytes);
+        atomicGet(server.stat_dump_payload_sanitizations, stat_dump_payload_sanitizations);
 
         if (sections++) info = sdscat(info,"\r\n");
         info = sdscatprintf(info,
@@ -5653,6 +5743,9 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             "expired_stale_perc:%.2f\r\n"
             "expired_time_cap_reached_count:%lld\r\n"
             "expire_cycle_cpu_milliseconds:%lld\r\n"
+            "expired_active_keys:%lld\r\n"
+            "expired_reclaim_lag_avg_ms:%.2f\r\n"
+            "expired_reclaim_lag_max_ms:%lld\r\n"
             "evicted_keys:%lld\r\n"
             "evicted_clients:%lld\r\n"
             "total_eviction_exceeded_time:%lld\r\n"
@@ -5682,6 +5775,9 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             "total_writes_processed:%lld\r\n"
             "io_threaded_reads_processed:%lld\r\n"
             "io_threaded_writes_processed:%lld\r\n"
+            "io_threaded_commands_processed:%lld\r\n"
+            "prefetch_batches:%lld\r\n"
+            "prefetch_keys:%lld\r\n"
             "reply_buffer_shrinks:%lld\r\n"
             "reply_buffer_expands:%lld\r\n",
             server.stat_numconnections,
@@ -5703,6 +5799,10 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             server.stat_expired_stale_perc*100,
             server.stat_expired_time_cap_reached_count,
             server.stat_expire_cycle_time_used/1000,
+            server.stat_expired_active_keys,
+            server.stat_expired_active_keys ?
+                (double)server.stat_expired_lag_sum/server.stat_expired_active_keys : 0,
+            server.stat_expired_lag_max,
             server.stat_evictedkeys,
             server.stat_evictedclients,
             (server.stat_total_eviction_exceeded_time + current_eviction_exceeded_time) / 1000,
@@ -5727,11 +5827,14 @@ sds genRedisInfoString(dict *section_dict, int all_sections, int everything) {
             (unsigned long long) trackingGetTotalPrefixes(),
             server.stat_unexpected_error_replies,
             server.stat_total_error_replies,
-            server.stat_dump_payload_sanitizations,
+            stat_dump_payload_sanitizations,
             stat_total_reads_processed,
             stat_total_writes_processed,
             server.stat_io_reads_processed,
             server.stat_io_writes_processed,
+            server.stat_io_commands_processed,
+            server.stat_prefetch_batches,
+            server.stat_prefetch_keys,
             server.stat_reply_buffer_shrinks,
             server.stat_reply_buffer_expands);
     }
@@ -6751,7 +6854,8 @@ struct redisTest {
     {"zmalloc", zmalloc_test},
     {"sds", sdsTest},
     {"dict", dictTest},
-    {"listpack", listpackTest}
+    {"listpack", listpackTest},
+    {"zbtree", zbtreeTest}
 };
 redisTestProc *getTestProcByName(const char *name) {
     int numtests = sizeof(redisTests)/sizeof(struct redisTest);
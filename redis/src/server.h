@@ -78,6 +78,7 @@ typedef long long ustime_t; /* microsecond time type. */
 #include "quicklist.h"  /* Lists are encoded as linked lists of
                            N-elements flat arrays */
 #include "rax.h"     /* Radix tree */
+#include "zbtree.h"  /* B+tree for large sorted sets */
 #include "connection.h" /* Connection abstraction */
 
 #define REDISMODULE_CORE 1
@@ -363,6 +364,8 @@ extern int configOOMScoreAdjValuesDefaults[CONFIG_OOM_COUNT];
                                           RDB without replication buffer. */
 #define CLIENT_NO_EVICT (1ULL<<43) /* This client is protected against client
                                       memory eviction. */
+#define CLIENT_PENDING_IO_COMMAND (1ULL<<44) /* The command in argv is queued to
+                                                run on the I/O threads. */
 
 /* Client block type (btype field in client structure)
  * if CLIENT_BLOCKED flag is set. */
@@ -591,6 +594,10 @@ typedef enum {
 #define RDB_CHILD_TYPE_DISK 1     /* RDB is written to disk. */
 #define RDB_CHILD_TYPE_SOCKET 2   /* RDB is written to slave socket. */
 
+/* How rdbSaveBackground() writes the RDB file to disk. */
+#define RDB_BGSAVE_FORK 0         /* In a fork child. */
+#define RDB_BGSAVE_THREAD 1       /* In a thread, see snapshot.c. */
+
 /* Keyspace changes notification classes. Every class is associated with a
  * character for configuration purposes. */
 #define NOTIFY_KEYSPACE (1<<0)    /* K */
@@ -839,6 +846,7 @@ typedef struct RedisModuleDigest {
 #define OBJ_ENCODING_QUICKLIST 9 /* Encoded as linked list of listpacks */
 #define OBJ_ENCODING_STREAM 10 /* Encoded as a radix tree of listpacks */
 #define OBJ_ENCODING_LISTPACK 11 /* Encoded as a listpack */
+#define OBJ_ENCODING_BTREE 12 /* Encoded as a B+tree (sorted sets) */
 
 #define LRU_BITS 24
 #define LRU_CLOCK_MAX ((1<<LRU_BITS)-1) /* Max value of obj->lru */
@@ -918,6 +926,7 @@ typedef struct clusterSlotToKeyMapping clusterSlotToKeyMapping;
 typedef struct redisDb {
     dict *dict;                 /* The keyspace for this DB */
     dict *expires;              /* Timeout of keys with a timeout set */
+    rax *expires_index;         /* Keys by expire time, NULL if disabled. */
     dict *blocking_keys;        /* Keys with clients waiting for data (BLPOP)*/
     dict *ready_keys;           /* Blocked keys that received a PUSH */
     dict *watched_keys;         /* WATCHED keys for MULTI/EXEC CAS */
@@ -1258,11 +1267,19 @@ typedef struct zskiplist {
     int level;
 } zskiplist;
 
+/* Sorted sets encoded as OBJ_ENCODING_SKIPLIST use 'zsl', and the dict
+ * values point to the scores in the skiplist nodes. With OBJ_ENCODING_BTREE
+ * 'zbt' is used instead, and the dict stores the scores by value, since the
+ * elements move between the B+tree nodes. */
 typedef struct zset {
     dict *dict;
     zskiplist *zsl;
+    zbtree *zbt;
 } zset;
 
+#define zsetDictGetScore(zs,de) \
+    ((zs)->zbt ? dictGetDoubleVal(de) : *(double*)dictGetVal(de))
+
 typedef struct clientBufferLimitsConfig {
     unsigned long long hard_limit_bytes;
     unsigned long long soft_limit_bytes;
@@ -1312,6 +1329,8 @@ struct redisMemOverhead {
     size_t dataset;
     size_t total_keys;
     size_t bytes_per_key;
+    size_t keyspace_overhead;
+    size_t keyspace_embedded_keys;
     float dataset_perc;
     float peak_perc;
     float total_frag;
@@ -1471,6 +1490,8 @@ struct redisServer {
     int last_sig_received;      /* Indicates the last SIGNAL received, if any (e.g., SIGINT or SIGTERM). */
     int shutdown_flags;         /* Flags passed to prepareForShutdown(). */
     int activerehashing;        /* Incremental rehash in serverCron() */
+    int keyspace_open_addressing; /* Open addressing dicts for the keyspace */
+    int keyspace_embed_keys;      /* Keys stored in their keyspace dictEntry */
     int active_defrag_running;  /* Active defragmentation running (holds current scan aggressiveness) */
     char *pidfile;              /* PID file path */
     int arch_bits;              /* 32 or 64 depending on sizeof(long) */
@@ -1516,6 +1537,7 @@ struct redisServer {
     list *clients_to_close;     /* Clients to close asynchronously */
     list *clients_pending_write; /* There is to write or install handler. */
     list *clients_pending_read;  /* Client has pending read socket buffers. */
+    list *clients_pending_command; /* Read only commands queued for IO threads. */
     list *slaves, *monitors;    /* List of slaves and MONITORs */
     client *current_client;     /* Current client executing the command. */
 
@@ -1536,6 +1558,8 @@ struct redisServer {
     int protected_mode;         /* Don't accept external connections. */
     int io_threads_num;         /* Number of IO threads to use. */
     int io_threads_do_reads;    /* Read and parse from IO threads? */
+    int io_threads_do_commands; /* Run read only commands from IO threads? */
+    int prefetch_batch_max_size; /* Pipelined commands to prefetch the keys of */
     int io_threads_active;      /* Is IO threads currently active? */
     long long events_processed_while_blocked; /* processEventsWhileBlocked() */
     int enable_protected_configs;    /* Enable the modification of protected configs, see PROTECTED_ACTION_ALLOWED_* */
@@ -1558,6 +1582,9 @@ struct redisServer {
     double stat_expired_stale_perc; /* Percentage of keys probably expired */
     long long stat_expired_time_cap_reached_count; /* Early expire cycle stops.*/
     long long stat_expire_cycle_time_used; /* Cumulative microseconds used. */
+    long long stat_expired_active_keys; /* Keys expired by the active cycle. */
+    long long stat_expired_lag_sum; /* Total ms those keys lived past expire. */
+    long long stat_expired_lag_max; /* Max ms a key lived past its expire. */
     long long stat_evictedkeys;     /* Number of evicted keys (maxmemory) */
     long long stat_evictedclients;  /* Number of evicted clients */
     long long stat_total_eviction_exceeded_time;  /* Total time over the memory limit, unit us */
@@ -1597,6 +1624,12 @@ struct redisServer {
     size_t stat_current_save_keys_processed;  /* Processed keys while child is active. */
     size_t stat_current_save_keys_total;  /* Number of keys when child started. */
     size_t stat_rdb_cow_bytes;      /* Copy on write bytes during RDB saving. */
+    long long stat_snapshot_stall_max;   /* Longest main thread wait for the
+                                          * snapshot thread, in microseconds. */
+    long long stat_snapshot_stall_total; /* Total wait, in microseconds. */
+    long long stat_snapshot_captured_keys; /* Keys saved before being modified. */
+    long long stat_snapshot_copied_values; /* Values copied before being
+                                            * modified in place. */
     size_t stat_aof_cow_bytes;      /* Copy on write bytes during AOF rewrite. */
     size_t stat_module_cow_bytes;   /* Copy on write bytes during module fork. */
     double stat_module_progress;   /* Module save progress. */
@@ -1604,9 +1637,12 @@ struct redisServer {
     size_t stat_cluster_links_memory; /* Mem usage by cluster links */
     long long stat_unexpected_error_replies; /* Number of unexpected (aof-loading, replica to master, etc.) error replies */
     long long stat_total_error_replies; /* Total number of issued error replies ( command + rejected errors ) */
-    long long stat_dump_payload_sanitizations; /* Number deep dump payloads integrity validations. */
+    redisAtomic long long stat_dump_payload_sanitizations; /* Number deep dump payloads integrity validations. */
     long long stat_io_reads_processed; /* Number of read events processed by IO / Main threads */
     long long stat_io_writes_processed; /* Number of write events processed by IO / Main threads */
+    long long stat_io_commands_processed; /* Number of commands executed by IO / Main threads */
+    long long stat_prefetch_batches; /* Batches of pipelined commands prefetched */
+    long long stat_prefetch_keys;   /* Keys prefetched for pipelined commands */
     redisAtomic long long stat_total_reads_processed; /* Total number of read events processed */
     redisAtomic long long stat_total_writes_processed; /* Total number of write events processed */
     /* The following two are used to track instantaneous metrics, like
@@ -1626,6 +1662,7 @@ struct redisServer {
     int tcpkeepalive;               /* Set SO_KEEPALIVE if non-zero. */
     int active_expire_enabled;      /* Can be disabled for testing purposes. */
     int active_expire_effort;       /* From 1 (default) to 10, active effort. */
+    int active_expire_index;        /* Index the expires by time? */
     int active_defrag_enabled;
     int sanitize_dump_payload;      /* Enables deep sanitization for ziplist and listpack in RDB and RESTORE. */
     int skip_checksum_validation;   /* Disable checksum validation for RDB and RESTORE payload. */
@@ -1704,6 +1741,9 @@ struct redisServer {
     time_t rdb_save_time_start;     /* Current RDB save start time. */
     int rdb_bgsave_scheduled;       /* BGSAVE when possible if true. */
     int rdb_child_type;             /* Type of save by active child. */
+    int rdb_bgsave_method;          /* RDB_BGSAVE_FORK or RDB_BGSAVE_THREAD. */
+    int rdb_last_bgsave_method;     /* Method of the last background save. */
+    int snapshot_in_progress;       /* The snapshot thread is saving the RDB. */
     int lastbgsave_status;          /* C_OK or C_ERR */
     int stop_writes_on_bgsave_err;  /* Don't allow writes if can't BGSAVE */
     int rdb_pipe_read;              /* RDB pipe used to transfer the rdb data */
@@ -1720,6 +1760,8 @@ struct redisServer {
     int key_load_delay;             /* Delay in microseconds between keys while
                                      * loading aof or rdb. (for testings). negative
                                      * value means fractions of microseconds (on average). */
+    int rdb_load_threads;           /* Threads building the values while loading
+                                     * an RDB, 0 to build them in the main thread. */
     /* Pipe and data structures for child -> parent info sharing. */
     int child_info_pipe[2];         /* Pipe used to write the child_info_data. */
     int child_info_nread;           /* Num of bytes of the last read from pipe */
@@ -1839,6 +1881,7 @@ struct redisServer {
     size_t set_max_intset_entries;
     size_t zset_max_listpack_entries;
     size_t zset_max_listpack_value;
+    size_t zset_max_skiplist_entries;
     size_t hll_sparse_max_bytes;
     size_t stream_node_max_bytes;
     long long stream_node_max_entries;
@@ -2334,6 +2377,7 @@ typedef struct {
 #define IO_THREADS_OP_IDLE 0
 #define IO_THREADS_OP_READ 1
 #define IO_THREADS_OP_WRITE 2
+#define IO_THREADS_OP_COMMAND 3
 extern int io_threads_op;
 
 /*-----------------------------------------------------------------------------
@@ -2387,6 +2431,7 @@ void modulePipeReadable(aeEventLoop *el, int fd, void *privdata, int mask);
 size_t moduleCount(void);
 void moduleAcquireGIL(void);
 int moduleTryAcquireGIL(void);
+int moduleTimedAcquireGIL(long long ms);
 void moduleReleaseGIL(void);
 void moduleNotifyKeyspaceEvent(int type, const char *event, robj *key, int dbid);
 void moduleCallCommandFilters(client *c);
@@ -2407,6 +2452,8 @@ void moduleNotifyKeyUnlink(robj *key, robj *val, int dbid);
 size_t moduleGetFreeEffort(robj *key, robj *val, int dbid);
 size_t moduleGetMemUsage(robj *key, robj *val, size_t sample_size, int dbid);
 robj *moduleTypeDupOrReply(client *c, robj *fromkey, robj *tokey, int todb, robj *value);
+robj *moduleTypeDup(robj *fromkey, robj *tokey, int fromdb, int todb, robj *value);
+int moduleTypesSupportCopy(void);
 int moduleDefragValue(robj *key, robj *obj, long *defragged, int dbid);
 int moduleLateDefrag(robj *key, robj *value, unsigned long *cursor, long long endtime, long long *defragged, int dbid);
 long moduleDefragGlobals(void);
@@ -2421,6 +2468,8 @@ void getRandomBytes(unsigned char *p, size_t len);
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
 void exitFromChild(int retcode);
 long long redisPopcount(void *s, long count);
+void bitopsSelectKernels(int simd);
+void hllSelectKernels(int simd);
 int redisSetProcTitle(char *title);
 int validateProcTitleTemplate(const char *template);
 int redisCommunicateSystemd(const char *sd_notify_msg);
@@ -2527,6 +2576,8 @@ void blockingOperationEnds();
 int handleClientsWithPendingWrites(void);
 int handleClientsWithPendingWritesUsingThreads(void);
 int handleClientsWithPendingReadsUsingThreads(void);
+int postponeClientCommand(client *c);
+void updateIOThreadKeyspaceStats(int hit);
 int stopThreadedIOIfNeeded(void);
 int clientHasPendingReplies(client *c);
 int islocalClient(client *c);
@@ -2636,6 +2687,7 @@ robj *createIntsetObject(void);
 robj *createHashObject(void);
 robj *createZsetObject(void);
 robj *createZsetListpackObject(void);
+robj *createZsetBtreeObject(void);
 robj *createStreamObject(void);
 robj *createModuleObject(moduleType *mt, void *value);
 int getLongFromObjectOrReply(client *c, robj *o, long *target, const char *msg);
@@ -2726,6 +2778,16 @@ sds writeCommandsGetDiskErrorMessage(int);
 void killRDBChild(void);
 int bg_unlink(const char *filename);
 
+/* Fork-less RDB snapshots */
+int snapshotAllowed(void);
+int snapshotStart(int req, char *filename, rdbSaveInfo *rsi);
+int snapshotCheckDone(int *exitcode, int *bysignal);
+void snapshotKill(void);
+void snapshotAcquireGIL(void);
+robj *snapshotBeforeWrite(redisDb *db, robj *key, robj *val);
+void snapshotKeyAdded(redisDb *db, robj *key);
+void snapshotBeforeEmpty(redisDb *db);
+
 /* AOF persistence */
 void flushAppendOnlyFile(int force);
 void feedAppendOnlyFile(int dictid, robj **argv, int argc);
@@ -2848,9 +2910,12 @@ void zzlNext(unsigned char *zl, unsigned char **eptr, unsigned char **sptr);
 void zzlPrev(unsigned char *zl, unsigned char **eptr, unsigned char **sptr);
 unsigned char *zzlFirstInRange(unsigned char *zl, zrangespec *range);
 unsigned char *zzlLastInRange(unsigned char *zl, zrangespec *range);
+int zbtFirstInRange(zbtree *zbt, zrangespec *range, zbtIter *it, unsigned long *rank);
+int zbtLastInRange(zbtree *zbt, zrangespec *range, zbtIter *it, unsigned long *rank);
 unsigned long zsetLength(const robj *zobj);
 void zsetConvert(robj *zobj, int encoding);
 void zsetConvertToListpackIfNeeded(robj *zobj, size_t maxelelen, size_t totelelen);
+void zsetConvertToBtreeIfNeeded(robj *zobj);
 int zsetScore(robj *zobj, sds member, double *score);
 unsigned long zslGetRank(zskiplist *zsl, double score, sds o);
 int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, double *newscore);
@@ -2867,6 +2932,8 @@ unsigned char *zzlFirstInLexRange(unsigned char *zl, zlexrangespec *range);
 unsigned char *zzlLastInLexRange(unsigned char *zl, zlexrangespec *range);
 zskiplistNode *zslFirstInLexRange(zskiplist *zsl, zlexrangespec *range);
 zskiplistNode *zslLastInLexRange(zskiplist *zsl, zlexrangespec *range);
+int zbtFirstInLexRange(zbtree *zbt, zlexrangespec *range, zbtIter *it, unsigned long *rank);
+int zbtLastInLexRange(zbtree *zbt, zlexrangespec *range, zbtIter *it, unsigned long *rank);
 int zzlLexValueGteMin(unsigned char *p, zlexrangespec *spec);
 int zzlLexValueLteMax(unsigned char *p, zlexrangespec *spec);
 int zslLexValueGteMin(sds value, zlexrangespec *spec);
@@ -3101,6 +3168,7 @@ int objectSetLRUOrLFU(robj *val, long long lfu_freq, long long lru_idle,
 #define LOOKUP_WRITE (1<<3)    /* Delete expired keys even in replicas. */
 
 void dbAdd(redisDb *db, robj *key, robj *val);
+void dbPrefetchKeys(redisDb *db, const uint64_t *hashes, int count);
 int dbAddRDBLoad(redisDb *db, sds key, robj *val);
 void dbOverwrite(redisDb *db, robj *key, robj *val);
 
@@ -3235,6 +3303,8 @@ int clientsCronHandleTimeout(client *c, mstime_t now_ms);
 
 /* expire.c -- Handling of expired keys */
 void activeExpireCycle(int type);
+void expireIndexAdd(redisDb *db, sds key, long long when);
+void expireIndexDel(redisDb *db, sds key, long long when);
 void expireSlaveKeys(void);
 void rememberSlaveKeyWithExpire(redisDb *db, robj *key);
 void flushSlaveKeysWithExpireList(void);
@@ -3259,6 +3329,8 @@ int dictSdsKeyCompare(dict *d, const void *key1, const void *key2);
 int dictSdsKeyCaseCompare(dict *d, const void *key1, const void *key2);
 void dictSdsDestructor(dict *d, void *val);
 void *dictSdsDup(dict *d, const void *key);
+size_t dictSdsEmbedLen(dict *d, const void *key);
+void *dictSdsEmbed(dict *d, void *buf, const void *key);
 
 /* Git SHA1 */
 char *redisGitSHA1(void);
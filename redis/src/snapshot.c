@@ -0,0 +1,611 @@
+/* Fork-less RDB snapshots.
+ *
+ * Copyright (c) 2022, Redis Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* rdbSaveBackground() normally forks, and the child writes the dataset as it
+ * was when forking thanks to the copy on write of the memory pages, which
+ * may double the memory used, while fork() itself blocks the main thread
+ * for a time proportional to the memory. With rdb-bgsave-method set to
+ * "thread" the RDB file is instead written by a thread of this process,
+ * while the main thread keeps serving the clients:
+ *
+ * - The thread walks the slots of the dictionaries of the databases in
+ *   order, with rehashing paused, so that every key is seen once and the
+ *   main thread can tell whether a key was walked already (see
+ *   dictWalkSlots()). It takes batches of keys holding the modules GIL,
+ *   which the main thread only releases while waiting for events, copying
+ *   their names and taking a reference to their values, then serializes
+ *   them after releasing it.
+ *
+ * - Before a key not walked yet is modified, deleted or has its TTL
+ *   changed, the main thread captures it in the same way, and marks it as
+ *   touched so that the walk skips it, as it does for the keys created in
+ *   slots not walked yet.
+ *
+ * - A value referenced by the snapshot is copied before being modified in
+ *   place, the copy replacing it in the keyspace. Strings are never modified
+ *   in place while shared anyway, see dbUnshareStringValue().
+ *
+ * - Read commands change the internals of some values too: lookups in the
+ *   dictionaries of sets and hashes do rehashing steps, which are paused
+ *   while the values are in a batch, and lists decompress their nodes, so
+ *   lists with compressed nodes are serialized holding the GIL.
+ *
+ * So the RDB file has the content of the dataset when the snapshot started,
+ * at the cost of a copy of the values written while waiting to be saved,
+ * instead of the memory pages. Module values are serialized holding the GIL.
+ * The snapshot is not possible when some module type can't copy its values,
+ * nor when the keyspace uses open addressing, since these tables can't grow
+ * past their slots while rehashing is paused. */
+
+#include "server.h"
+#include "atomicvar.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/param.h>
+
+/* Slots walked by the snapshot thread every time it holds the GIL. */
+#define SNAPSHOT_BATCH_SLOTS 256
+
+/* A key taken for the snapshot, with a reference to its value. */
+typedef struct snapshotKey {
+    sds key;
+    robj *val;          /* NULL once saved. */
+    long long expire;
+} snapshotKey;
+
+typedef struct snapshotDb {
+    dict *dict;         /* Dictionary walked, with rehashing paused, or NULL
+                         * when done with the keys of the database. */
+    int tables;         /* Tables of the dictionary when the snapshot started. */
+    int htidx;          /* Table and slot the walk continues from. */
+    unsigned long slot;
+    uint64_t size, expires; /* Sizes of the database when it started. */
+    dict *touched;      /* Keys the walk must skip. */
+    list *captured;     /* Keys captured by the main thread, to be saved. */
+} snapshotDb;
+
+static struct snapshot {
+    pthread_t thread;
+    FILE *fp;
+    rio rdb;
+    char tmpfile[256];
+    sds filename;
+    sds tail;           /* Modules AUX data following the keys. */
+    int req;
+    snapshotDb *dbs;
+    snapshotKey *batch; /* Keys taken by the thread, released holding the
+                         * GIL when taking the next batch. */
+    size_t batchlen, batchsize;
+    int status;         /* C_OK if the thread saved the file. */
+    int killed;
+    redisAtomic int abort;      /* Set to stop the thread. */
+    redisAtomic int done;       /* Set by the thread when exiting. */
+    redisAtomic int gil_wanted; /* The thread is waiting for the GIL. */
+    redisAtomic size_t keys_saved;
+} snap;
+
+/* ------------------------------ Batches ----------------------------------- */
+
+/* Returns the dictionary of the value, if it is encoded as one that lookups
+ * may rehash. */
+static dict *snapshotValueDict(robj *val) {
+    if ((val->type == OBJ_SET || val->type == OBJ_HASH) &&
+        val->encoding == OBJ_ENCODING_HT) return val->ptr;
+    return NULL;
+}
+
+/* Returns true if the value must be serialized holding the GIL. */
+static int snapshotSaveLocked(robj *val) {
+    if (val->type == OBJ_MODULE) return 1;
+    return val->type == OBJ_LIST && val->encoding == OBJ_ENCODING_QUICKLIST &&
+           ((quicklist*)val->ptr)->compress != 0;
+}
+
+/* Adds a key to the batch, holding the GIL. */
+static void snapshotBatchAdd(sds key, robj *val, long long expire) {
+    dict *d = snapshotValueDict(val);
+    if (snap.batchlen == snap.batchsize) {
+        snap.batchsize = snap.batchsize ? snap.batchsize*2 : SNAPSHOT_BATCH_SLOTS;
+        snap.batch = zrealloc(snap.batch,sizeof(snapshotKey)*snap.batchsize);
+    }
+    snapshotKey *sk = snap.batch+snap.batchlen++;
+    sk->key = key;
+    sk->val = val;
+    sk->expire = expire;
+    if (d) dictPauseRehashing(d);
+}
+
+/* Releases the keys of the batch. Called holding the GIL, or after the
+ * thread exited. */
+static void snapshotReleaseBatch(void) {
+    for (size_t j = 0; j < snap.batchlen; j++) {
+        robj *val = snap.batch[j].val;
+        sdsfree(snap.batch[j].key);
+        if (val == NULL) continue;
+        dict *d = snapshotValueDict(val);
+        if (d) dictResumeRehashing(d);
+        decrRefCount(val);
+    }
+    snap.batchlen = 0;
+}
+
+static void snapshotFreeKey(void *ptr) {
+    snapshotKey *sk = ptr;
+    sdsfree(sk->key);
+    decrRefCount(sk->val);
+    zfree(sk);
+}
+
+/* Captures the key of 'de', in the database 'db', to be saved by the thread. */
+static void snapshotCapture(redisDb *db, snapshotDb *sdb, const dictEntry *de) {
+    snapshotKey *sk = zmalloc(sizeof(*sk));
+    robj keyobj;
+
+    sk->key = sdsdup(dictGetKey(de));
+    sk->val = dictGetVal(de);
+    incrRefCount(sk->val);
+    initStaticStringObject(keyobj,sk->key);
+    sk->expire = getExpire(db,&keyobj);
+    listAddNodeTail(sdb->captured,sk);
+    server.stat_snapshot_captured_keys++;
+}
+
+typedef struct snapshotWalkCtx {
+    redisDb *db;
+    snapshotDb *sdb;
+} snapshotWalkCtx;
+
+/* dictWalkSlots() callback of the thread: takes the key in the batch. */
+static void snapshotWalkCallback(void *privdata, const dictEntry *de) {
+    snapshotWalkCtx *ctx = privdata;
+    sds key = dictGetKey(de);
+    robj keyobj, *val = dictGetVal(de);
+
+    if (dictSize(ctx->sdb->touched) && dictFind(ctx->sdb->touched,key)) return;
+    initStaticStringObject(keyobj,key);
+    incrRefCount(val);
+    snapshotBatchAdd(sdsdup(key),val,getExpire(ctx->db,&keyobj));
+}
+
+/* dictWalkSlots() callback of snapshotBeforeEmpty(): captures the key. */
+static void snapshotCaptureCallback(void *privdata, const dictEntry *de) {
+    snapshotWalkCtx *ctx = privdata;
+
+    if (dictSize(ctx->sdb->touched) && dictFind(ctx->sdb->touched,dictGetKey(de)))
+        return;
+    snapshotCapture(ctx->db,ctx->sdb,de);
+}
+
+/* Done walking the database: from now on the main thread ignores it. */
+static void snapshotDbWalked(snapshotDb *sdb) {
+    dictResumeRehashing(sdb->dict);
+    sdb->dict = NULL;
+}
+
+/* Takes the next batch of keys of the database 'dbid', holding the GIL:
+ * first the ones captured by the main thread, then the ones of the next
+ * slots. Module values are saved right away, since modules expect the GIL
+ * to be held, and so are compressed lists, see the top comment. Returns 1
+ * if there are no keys left after this batch, 0 if there are, and -1 on
+ * errors. */
+static int snapshotTakeBatch(int dbid) {
+    redisDb *db = server.db+dbid;
+    snapshotDb *sdb = snap.dbs+dbid;
+    snapshotWalkCtx ctx = {db, sdb};
+
+    snapshotReleaseBatch();
+    while (listLength(sdb->captured) && snap.batchlen < SNAPSHOT_BATCH_SLOTS) {
+        listNode *ln = listFirst(sdb->captured);
+        snapshotKey *sk = listNodeValue(ln);
+        snapshotBatchAdd(sk->key,sk->val,sk->expire);
+        zfree(sk);
+        listDelNode(sdb->captured,ln);
+    }
+
+    if (sdb->dict) {
+        sdb->slot = dictWalkSlots(sdb->dict,sdb->htidx,sdb->slot,
+                                  SNAPSHOT_BATCH_SLOTS,snapshotWalkCallback,&ctx);
+        if (sdb->slot == 0 && ++sdb->htidx == sdb->tables)
+            snapshotDbWalked(sdb);
+    }
+
+    for (size_t j = 0; j < snap.batchlen; j++) {
+        snapshotKey *sk = snap.batch+j;
+        robj keyobj;
+
+        if (!snapshotSaveLocked(sk->val)) continue;
+        initStaticStringObject(keyobj,sk->key);
+        if (rdbSaveKeyValuePair(&snap.rdb,&keyobj,sk->val,sk->expire,dbid) == -1)
+            return -1;
+        atomicIncr(snap.keys_saved,1);
+        decrRefCount(sk->val);
+        sk->val = NULL;
+    }
+    return sdb->dict == NULL && listLength(sdb->captured) == 0;
+}
+
+/* ------------------------------- Thread ----------------------------------- */
+
+/* Acquires the GIL, unless the snapshot is aborted first. */
+static int snapshotLockGIL(void) {
+    int abort;
+
+    atomicSet(snap.gil_wanted,1);
+    while (moduleTimedAcquireGIL(10) != 0) {
+        atomicGet(snap.abort,abort);
+        if (abort) {
+            atomicSet(snap.gil_wanted,0);
+            return C_ERR;
+        }
+    }
+    atomicSet(snap.gil_wanted,0);
+    return C_OK;
+}
+
+static int snapshotSaveBatch(int dbid) {
+    int abort;
+
+    for (size_t j = 0; j < snap.batchlen; j++) {
+        snapshotKey *sk = snap.batch+j;
+        robj keyobj;
+
+        atomicGet(snap.abort,abort);
+        if (abort) return C_ERR;
+        if (sk->val == NULL) continue;
+        initStaticStringObject(keyobj,sk->key);
+        if (rdbSaveKeyValuePair(&snap.rdb,&keyobj,sk->val,sk->expire,dbid) == -1)
+            return C_ERR;
+        atomicIncr(snap.keys_saved,1);
+    }
+    return C_OK;
+}
+
+static void *snapshotThreadMain(void *arg) {
+    UNUSED(arg);
+    int j, abort, status = C_ERR;
+
+    redis_set_thread_title("rdb_snapshot");
+    for (j = 0; j < server.dbnum; j++) {
+        snapshotDb *sdb = snap.dbs+j;
+        int last = 0;
+
+        if (sdb->size == 0) continue;
+        if (rdbSaveDbHeader(&snap.rdb,j,sdb->size,sdb->expires) == -1) goto werr;
+        while (!last) {
+            if (snapshotLockGIL() == C_ERR) goto werr;
+            last = snapshotTakeBatch(j);
+            moduleReleaseGIL();
+            if (last == -1 || snapshotSaveBatch(j) == C_ERR) goto werr;
+        }
+    }
+
+    if (sdslen(snap.tail) && rioWrite(&snap.rdb,snap.tail,sdslen(snap.tail)) == 0)
+        goto werr;
+    if (rdbSaveRioTail(&snap.rdb) == C_ERR) goto werr;
+
+    /* Make sure data will not remain on the OS's output buffers */
+    if (fflush(snap.fp) || fsync(fileno(snap.fp))) goto werr;
+    if (fclose(snap.fp)) {
+        snap.fp = NULL;
+        goto werr;
+    }
+    snap.fp = NULL;
+
+    atomicGet(snap.abort,abort);
+    if (abort) goto werr;
+    if (rename(snap.tmpfile,snap.filename) == -1) goto werr;
+    if (fsyncFileDir(snap.filename) == -1) goto werr;
+    status = C_OK;
+
+werr:
+    if (status == C_ERR) {
+        atomicGet(snap.abort,abort);
+        if (!abort)
+            serverLog(LL_WARNING,"Write error saving DB on disk: %s",
+                strerror(errno));
+        if (snap.fp) fclose(snap.fp);
+        snap.fp = NULL;
+        unlink(snap.tmpfile);
+    }
+    snap.status = status;
+    atomicSet(snap.done,1);
+    return NULL;
+}
+
+/* Joins the thread and releases the state of the snapshot. */
+static void snapshotStop(void) {
+    pthread_join(snap.thread,NULL);
+    snapshotReleaseBatch();
+    zfree(snap.batch);
+    snap.batch = NULL;
+    snap.batchlen = snap.batchsize = 0;
+    for (int j = 0; j < server.dbnum; j++) {
+        snapshotDb *sdb = snap.dbs+j;
+        if (sdb->dict) snapshotDbWalked(sdb);
+        /* The keys still captured were not saved. */
+        listSetFreeMethod(sdb->captured,snapshotFreeKey);
+        listRelease(sdb->captured);
+        dictRelease(sdb->touched);
+    }
+    zfree(snap.dbs);
+    snap.dbs = NULL;
+    sdsfree(snap.tail);
+    sdsfree(snap.filename);
+    server.snapshot_in_progress = 0;
+}
+
+/* ------------------------------- API -------------------------------------- */
+
+/* Returns true if the RDB can be saved by a thread, see the top comment. */
+int snapshotAllowed(void) {
+    return !server.keyspace_open_addressing && moduleTypesSupportCopy();
+}
+
+/* Starts the thread writing the RDB file 'filename' with the current content
+ * of the dataset, as the RDB child started by rdbSaveBackground() would. */
+int snapshotStart(int req, char *filename, rdbSaveInfo *rsi) {
+    monotime start = getMonotonicUs();
+    char cwd[MAXPATHLEN];
+    int j;
+
+    snprintf(snap.tmpfile,sizeof(snap.tmpfile),"temp-snapshot-%d.rdb",(int) getpid());
+    snap.fp = fopen(snap.tmpfile,"w");
+    if (!snap.fp) {
+        char *str_err = strerror(errno);
+        char *cwdp = getcwd(cwd,MAXPATHLEN);
+        serverLog(LL_WARNING,
+            "Failed opening the temp RDB file %s (in server root dir %s) "
+            "for saving: %s",
+            snap.tmpfile,
+            cwdp ? cwdp : "unknown",
+            str_err);
+        return C_ERR;
+    }
+    rioInitWithFile(&snap.rdb,snap.fp);
+    if (server.rdb_save_incremental_fsync)
+        rioSetAutoSync(&snap.rdb,REDIS_AUTOSYNC_BYTES);
+
+    /* What precedes and follows the keys is written now, like the keys, it
+     * has to be the one of when the snapshot starts. */
+    snap.tail = sdsempty();
+    if (rdbSaveRioHead(req,&snap.rdb,RDBFLAGS_NONE,rsi) == C_ERR) goto werr;
+    if (!(req & SLAVE_REQ_RDB_EXCLUDE_DATA)) {
+        rio tail;
+        rioInitWithBuffer(&tail,snap.tail);
+        snap.tail = NULL;
+        if (rdbSaveModulesAux(&tail,REDISMODULE_AUX_AFTER_RDB) == -1) {
+            sdsfree(tail.io.buffer.ptr);
+            goto werr;
+        }
+        snap.tail = tail.io.buffer.ptr;
+    }
+
+    snap.dbs = zcalloc(sizeof(snapshotDb)*server.dbnum);
+    for (j = 0; j < server.dbnum; j++) {
+        redisDb *db = server.db+j;
+        snapshotDb *sdb = snap.dbs+j;
+
+        sdb->touched = dictCreate(&setDictType);
+        sdb->captured = listCreate();
+        if ((req & SLAVE_REQ_RDB_EXCLUDE_DATA) || dictSize(db->dict) == 0) continue;
+        sdb->dict = db->dict;
+        sdb->tables = dictIsRehashing(db->dict) ? 2 : 1;
+        sdb->size = dictSize(db->dict);
+        sdb->expires = dictSize(db->expires);
+        dictPauseRehashing(db->dict);
+    }
+
+    snap.filename = sdsnew(filename);
+    snap.req = req;
+    snap.killed = 0;
+    atomicSet(snap.abort,0);
+    atomicSet(snap.done,0);
+    atomicSet(snap.gil_wanted,0);
+    atomicSet(snap.keys_saved,0);
+    server.stat_snapshot_stall_max = 0;
+    server.stat_snapshot_stall_total = 0;
+    server.stat_snapshot_captured_keys = 0;
+    server.stat_snapshot_copied_values = 0;
+    server.snapshot_in_progress = 1;
+
+    if (pthread_create(&snap.thread,NULL,snapshotThreadMain,NULL) != 0) {
+        serverLog(LL_WARNING,"Can't create the snapshot thread: %s",
+            strerror(errno));
+        for (j = 0; j < server.dbnum; j++) {
+            snapshotDb *sdb = snap.dbs+j;
+            if (sdb->dict) dictResumeRehashing(sdb->dict);
+            listRelease(sdb->captured);
+            dictRelease(sdb->touched);
+        }
+        zfree(snap.dbs);
+        snap.dbs = NULL;
+        sdsfree(snap.filename);
+        server.snapshot_in_progress = 0;
+        goto err;
+    }
+
+    /* The snapshot takes the place of the RDB child. */
+    server.child_type = CHILD_TYPE_RDB;
+    server.stat_current_save_keys_total = dbTotalServerKeyCount();
+    updateDictResizePolicy();
+
+    long long stall = getMonotonicUs()-start;
+    server.stat_snapshot_stall_max = stall;
+    server.stat_snapshot_stall_total = stall;
+    latencyAddSampleIfNeeded("snapshot-start",stall/1000);
+    return C_OK;
+
+werr:
+    serverLog(LL_WARNING,"Write error saving DB on disk: %s", strerror(errno));
+err:
+    sdsfree(snap.tail);
+    fclose(snap.fp);
+    snap.fp = NULL;
+    unlink(snap.tmpfile);
+    return C_ERR;
+}
+
+/* Called from checkChildrenDone(): returns 1 if the snapshot is over,
+ * setting 'exitcode' and 'bysignal' like the exit of the RDB child would. */
+int snapshotCheckDone(int *exitcode, int *bysignal) {
+    size_t keys;
+    int done;
+
+    atomicGet(snap.keys_saved,keys);
+    server.stat_current_save_keys_processed = keys;
+    if (!snap.killed) {
+        atomicGet(snap.done,done);
+        if (!done) return 0;
+        snapshotStop();
+    }
+    *exitcode = snap.status == C_OK ? 0 : 1;
+    *bysignal = snap.killed ? SIGUSR1 : 0;
+    return 1;
+}
+
+/* Stops the snapshot thread, the equivalent of killing the RDB child: the
+ * snapshot is reported as terminated by SIGUSR1 by snapshotCheckDone(). */
+void snapshotKill(void) {
+    if (!server.snapshot_in_progress) return;
+    atomicSet(snap.abort,1);
+    snapshotStop();
+    snap.killed = 1;
+}
+
+/* Acquires the GIL after waiting for events, see afterSleep(). Mutexes are
+ * not fair, so when the snapshot thread waits for the GIL it gets it first,
+ * otherwise a main thread that is never idle could starve it. */
+void snapshotAcquireGIL(void) {
+    monotime start = getMonotonicUs();
+    int wanted;
+
+    atomicGet(snap.gil_wanted,wanted);
+    while (wanted) {
+        sched_yield();
+        atomicGet(snap.gil_wanted,wanted);
+    }
+    moduleAcquireGIL();
+
+    long long stall = getMonotonicUs()-start;
+    if (stall > server.stat_snapshot_stall_max)
+        server.stat_snapshot_stall_max = stall;
+    server.stat_snapshot_stall_total += stall;
+    latencyAddSampleIfNeeded("snapshot-acquire-GIL",stall/1000);
+}
+
+/* Returns the state of the database 'db' if its keys are being walked. */
+static snapshotDb *snapshotGetDb(redisDb *db) {
+    if (db->id < 0 || db->id >= server.dbnum) return NULL;
+    snapshotDb *sdb = snap.dbs+db->id;
+    return sdb->dict && sdb->dict == db->dict ? sdb : NULL;
+}
+
+/* Returns the entry of 'key' if the walk didn't reach its slot yet. */
+static dictEntry *snapshotFindNotWalked(snapshotDb *sdb, sds key) {
+    unsigned long slot;
+    int htidx;
+
+    dictEntry *de = dictFindSlot(sdb->dict,key,&htidx,&slot);
+    if (de == NULL || htidx >= sdb->tables) return NULL;
+    if (htidx < sdb->htidx || (htidx == sdb->htidx && slot < sdb->slot))
+        return NULL;
+    return de;
+}
+
+/* Called by the main thread, while a snapshot is in progress, before the key
+ * is modified, deleted or has its TTL changed. If the snapshot still has to
+ * save the key, it is captured now. If 'val' is not NULL, the value of the
+ * key is going to be modified in place: if the snapshot references it, it is
+ * replaced by a copy in the keyspace, that is returned. */
+robj *snapshotBeforeWrite(redisDb *db, robj *key, robj *val) {
+    snapshotDb *sdb = snapshotGetDb(db);
+
+    if (sdb) {
+        dictEntry *de = snapshotFindNotWalked(sdb,key->ptr);
+        if (de && dictFind(sdb->touched,key->ptr) == NULL) {
+            dictAdd(sdb->touched,sdsdup(key->ptr),NULL);
+            snapshotCapture(db,sdb,de);
+        }
+    }
+
+    if (val && val->type != OBJ_STRING && val->refcount > 1 &&
+        val->refcount != OBJ_SHARED_REFCOUNT)
+    {
+        robj *copy = NULL;
+        switch(val->type) {
+        case OBJ_LIST: copy = listTypeDup(val); break;
+        case OBJ_SET: copy = setTypeDup(val); break;
+        case OBJ_ZSET: copy = zsetDup(val); break;
+        case OBJ_HASH: copy = hashTypeDup(val); break;
+        case OBJ_STREAM: copy = streamDup(val); break;
+        case OBJ_MODULE: copy = moduleTypeDup(key,key,db->id,db->id,val); break;
+        default: serverPanic("Unknown object type"); break;
+        }
+        if (copy == NULL) {
+            serverLog(LL_WARNING,"Module value copy failed, stopping the snapshot");
+            snapshotKill();
+            return val;
+        }
+        copy->lru = val->lru;
+        dictSetVal(db->dict,dictFind(db->dict,key->ptr),copy);
+        decrRefCount(val);
+        server.stat_snapshot_copied_values++;
+        val = copy;
+    }
+    return val;
+}
+
+/* Called by the main thread, while a snapshot is in progress, after the key
+ * was added: the walk must skip it if its slot was not reached yet. */
+void snapshotKeyAdded(redisDb *db, robj *key) {
+    snapshotDb *sdb = snapshotGetDb(db);
+
+    if (sdb && snapshotFindNotWalked(sdb,key->ptr) &&
+        dictFind(sdb->touched,key->ptr) == NULL)
+    {
+        dictAdd(sdb->touched,sdsdup(key->ptr),NULL);
+    }
+}
+
+/* Called by the main thread, while a snapshot is in progress, before the
+ * dictionary of the database is emptied or swapped: the keys not walked yet
+ * are captured. */
+void snapshotBeforeEmpty(redisDb *db) {
+    snapshotDb *sdb = snapshotGetDb(db);
+    snapshotWalkCtx ctx = {db, sdb};
+
+    if (sdb == NULL) return;
+    while (sdb->htidx < sdb->tables) {
+        sdb->slot = dictWalkSlots(sdb->dict,sdb->htidx,sdb->slot,ULONG_MAX,
+                                  snapshotCaptureCallback,&ctx);
+        sdb->htidx++;
+    }
+    snapshotDbWalked(sdb);
+}
@@ -316,8 +316,9 @@ void sortCommandGeneric(client *c, int readonly) {
         sortby = NULL;
     }
 
-    /* Destructively convert encoded sorted sets for SORT. */
-    if (sortval->type == OBJ_ZSET)
+    /* Destructively convert encoded sorted sets for SORT. B+tree encoded
+     * sorted sets already have a dict. */
+    if (sortval->type == OBJ_ZSET && sortval->encoding == OBJ_ENCODING_LISTPACK)
         zsetConvert(sortval, OBJ_ENCODING_SKIPLIST);
 
     /* Obtain the length of the object to sort. */
@@ -403,6 +404,29 @@ void sortCommandGeneric(client *c, int readonly) {
             j++;
         }
         setTypeReleaseIterator(si);
+    } else if (sortval->type == OBJ_ZSET && dontsort &&
+               sortval->encoding == OBJ_ENCODING_BTREE)
+    {
+        /* Same as below, for the B+tree encoding. */
+        zset *zs = sortval->ptr;
+        zbtIter it;
+        sds sdsele;
+        int rangelen = vectorlen;
+        int valid = zbtGetElementByRank(zs->zbt,
+            desc ? zs->zbt->length-start : (unsigned long)start+1, &it);
+
+        while(rangelen--) {
+            serverAssertWithInfo(c,sortval,valid);
+            sdsele = zbtIterEle(&it);
+            vector[j].obj = createStringObject(sdsele,sdslen(sdsele));
+            vector[j].u.score = 0;
+            vector[j].u.cmpobj = NULL;
+            j++;
+            valid = desc ? zbtPrev(&it) : zbtNext(&it);
+        }
+        /* Fix start/end: output code is not aware of this optimization. */
+        end -= start;
+        start = 0;
     } else if (sortval->type == OBJ_ZSET && dontsort) {
         /* Special handling for a sorted set, if 'dontsort' is true.
          * This makes sure we return elements in the sorted set original
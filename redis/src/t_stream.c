@@ -2254,6 +2254,9 @@ void xreadCommand(client *c) {
         robj *key = c->argv[i-streams_count];
         robj *o = lookupKeyRead(c->db,key);
         if (checkType(c,o,OBJ_STREAM)) goto cleanup;
+        /* XREADGROUP modifies the consumer group. */
+        if (o && xreadgroup && server.snapshot_in_progress)
+            o = snapshotBeforeWrite(c->db,key,o);
         streamCG *group = NULL;
 
         /* If a group was specified, than we need to be sure that the
@@ -2815,6 +2818,8 @@ void xsetidCommand(client *c) {
 void xackCommand(client *c) {
     streamCG *group = NULL;
     robj *o = lookupKeyRead(c->db,c->argv[1]);
+    if (o && server.snapshot_in_progress)
+        o = snapshotBeforeWrite(c->db,c->argv[1],o);
     if (o) {
         if (checkType(c,o,OBJ_STREAM)) return; /* Type error. */
         group = streamLookupCG(o->ptr,c->argv[2]->ptr);
@@ -3114,6 +3119,8 @@ void xpendingCommand(client *c) {
 void xclaimCommand(client *c) {
     streamCG *group = NULL;
     robj *o = lookupKeyRead(c->db,c->argv[1]);
+    if (o && server.snapshot_in_progress)
+        o = snapshotBeforeWrite(c->db,c->argv[1],o);
     long long minidle; /* Minimum idle time argument. */
     long long retrycount = -1;   /* -1 means RETRYCOUNT option not given. */
     mstime_t deliverytime = -1;  /* -1 means IDLE/TIME options not given. */
@@ -3332,6 +3339,8 @@ cleanup:
 void xautoclaimCommand(client *c) {
     streamCG *group = NULL;
     robj *o = lookupKeyRead(c->db,c->argv[1]);
+    if (o && server.snapshot_in_progress)
+        o = snapshotBeforeWrite(c->db,c->argv[1],o);
     long long minidle; /* Minimum idle time argument, in milliseconds. */
     long count = 100; /* Maximum entries to claim. */
     streamID startid;
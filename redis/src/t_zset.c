@@ -1148,6 +1148,91 @@ unsigned char *zzlDeleteRangeByRank(unsigned char *zl, unsigned int start, unsig
     return zl;
 }
 
+/*-----------------------------------------------------------------------------
+ * B+tree API, for large sorted sets (see zbtree.c)
+ *----------------------------------------------------------------------------*/
+
+static int zbtScoreGteMin(double score, sds ele, void *range) {
+    UNUSED(ele);
+    return zslValueGteMin(score,range);
+}
+
+static int zbtScoreLteMax(double score, sds ele, void *range) {
+    UNUSED(ele);
+    return zslValueLteMax(score,range);
+}
+
+static int zbtLexGteMin(double score, sds ele, void *range) {
+    UNUSED(score);
+    return zslLexValueGteMin(ele,range);
+}
+
+static int zbtLexLteMax(double score, sds ele, void *range) {
+    UNUSED(score);
+    return zslLexValueLteMax(ele,range);
+}
+
+/* Set 'it' to the first element that is contained in the specified range,
+ * and 'rank' (if not NULL) to its 1-based rank.
+ * Returns 0 when no element is contained in the range. */
+int zbtFirstInRange(zbtree *zbt, zrangespec *range, zbtIter *it, unsigned long *rank) {
+    if (!zbtFirstWhere(zbt,zbtScoreGteMin,range,it,rank)) return 0;
+    return zslValueLteMax(zbtIterScore(it),range);
+}
+
+/* Like zbtFirstInRange(), for the last element in the range. */
+int zbtLastInRange(zbtree *zbt, zrangespec *range, zbtIter *it, unsigned long *rank) {
+    if (!zbtLastWhere(zbt,zbtScoreLteMax,range,it,rank)) return 0;
+    return zslValueGteMin(zbtIterScore(it),range);
+}
+
+int zbtFirstInLexRange(zbtree *zbt, zlexrangespec *range, zbtIter *it, unsigned long *rank) {
+    if (!zbtFirstWhere(zbt,zbtLexGteMin,range,it,rank)) return 0;
+    return zslLexValueLteMax(zbtIterEle(it),range);
+}
+
+int zbtLastInLexRange(zbtree *zbt, zlexrangespec *range, zbtIter *it, unsigned long *rank) {
+    if (!zbtLastWhere(zbt,zbtLexLteMax,range,it,rank)) return 0;
+    return zslLexValueGteMin(zbtIterEle(it),range);
+}
+
+/* Delete all the elements with rank between start and end from the B+tree
+ * and the dict. Start and end are inclusive and 1-based.
+ * Returns the number of deleted elements. */
+static unsigned long zbtDeleteRangeByRank(zbtree *zbt, unsigned long start,
+                                          unsigned long end, dict *dict)
+{
+    unsigned long removed = 0;
+    zbtIter it;
+
+    while (removed <= end-start && zbtGetElementByRank(zbt,start,&it)) {
+        sds ele = zbtIterEle(&it);
+        double score = zbtIterScore(&it);
+        dictDelete(dict,ele);
+        zbtDelete(zbt,score,ele,NULL);
+        removed++;
+    }
+    return removed;
+}
+
+static unsigned long zbtDeleteRangeByScore(zbtree *zbt, zrangespec *range, dict *dict) {
+    unsigned long first, last;
+    zbtIter it;
+
+    if (!zbtFirstInRange(zbt,range,&it,&first) ||
+        !zbtLastInRange(zbt,range,&it,&last)) return 0;
+    return zbtDeleteRangeByRank(zbt,first,last,dict);
+}
+
+static unsigned long zbtDeleteRangeByLex(zbtree *zbt, zlexrangespec *range, dict *dict) {
+    unsigned long first, last;
+    zbtIter it;
+
+    if (!zbtFirstInLexRange(zbt,range,&it,&first) ||
+        !zbtLastInLexRange(zbt,range,&it,&last)) return 0;
+    return zbtDeleteRangeByRank(zbt,first,last,dict);
+}
+
 /*-----------------------------------------------------------------------------
  * Common sorted set API
  *----------------------------------------------------------------------------*/
@@ -1158,6 +1243,8 @@ unsigned long zsetLength(const robj *zobj) {
         length = zzlLength(zobj->ptr);
     } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
         length = ((const zset*)zobj->ptr)->zsl->length;
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        length = ((const zset*)zobj->ptr)->zbt->length;
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -1178,12 +1265,18 @@ void zsetConvert(robj *zobj, int encoding) {
         unsigned int vlen;
         long long vlong;
 
-        if (encoding != OBJ_ENCODING_SKIPLIST)
+        if (encoding != OBJ_ENCODING_SKIPLIST && encoding != OBJ_ENCODING_BTREE)
             serverPanic("Unknown target encoding");
 
         zs = zmalloc(sizeof(*zs));
         zs->dict = dictCreate(&zsetDictType);
-        zs->zsl = zslCreate();
+        if (encoding == OBJ_ENCODING_SKIPLIST) {
+            zs->zsl = zslCreate();
+            zs->zbt = NULL;
+        } else {
+            zs->zsl = NULL;
+            zs->zbt = zbtCreate();
+        }
 
         eptr = lpSeek(zl,0);
         if (eptr != NULL) {
@@ -1199,14 +1292,46 @@ void zsetConvert(robj *zobj, int encoding) {
             else
                 ele = sdsnewlen((char*)vstr,vlen);
 
-            node = zslInsert(zs->zsl,score,ele);
-            serverAssert(dictAdd(zs->dict,ele,&node->score) == DICT_OK);
+            if (zs->zsl) {
+                node = zslInsert(zs->zsl,score,ele);
+                serverAssert(dictAdd(zs->dict,ele,&node->score) == DICT_OK);
+            } else {
+                dictEntry *de = dictAddRaw(zs->dict,ele,NULL);
+                serverAssert(de != NULL);
+                dictSetDoubleVal(de,score);
+                zbtInsert(zs->zbt,score,ele);
+            }
             zzlNext(zl,&eptr,&sptr);
         }
 
         zfree(zobj->ptr);
         zobj->ptr = zs;
-        zobj->encoding = OBJ_ENCODING_SKIPLIST;
+        zobj->encoding = encoding;
+    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST &&
+               encoding == OBJ_ENCODING_BTREE)
+    {
+        zbtree *zbt = zbtCreate();
+
+        /* Move the elements to the B+tree, and the scores into the dict
+         * entries, freeing the skiplist nodes as we go. */
+        zs = zobj->ptr;
+        node = zs->zsl->header->level[0].forward;
+        zfree(zs->zsl->header);
+        zfree(zs->zsl);
+
+        while (node) {
+            dictEntry *de = dictFind(zs->dict,node->ele);
+            serverAssert(de != NULL);
+            dictSetDoubleVal(de,node->score);
+            zbtInsert(zbt,node->score,node->ele);
+            next = node->level[0].forward;
+            zfree(node);
+            node = next;
+        }
+
+        zs->zsl = NULL;
+        zs->zbt = zbt;
+        zobj->encoding = OBJ_ENCODING_BTREE;
     } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
         unsigned char *zl = lpNew(0);
 
@@ -1228,6 +1353,26 @@ void zsetConvert(robj *zobj, int encoding) {
             node = next;
         }
 
+        zfree(zs);
+        zobj->ptr = zl;
+        zobj->encoding = OBJ_ENCODING_LISTPACK;
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        unsigned char *zl = lpNew(0);
+        zbtIter it;
+        int valid;
+
+        if (encoding != OBJ_ENCODING_LISTPACK)
+            serverPanic("Unknown target encoding");
+
+        zs = zobj->ptr;
+        valid = zbtFirst(zs->zbt,&it);
+        while (valid) {
+            zl = zzlInsertAt(zl,NULL,zbtIterEle(&it),zbtIterScore(&it));
+            valid = zbtNext(&it);
+        }
+
+        dictRelease(zs->dict);
+        zbtFree(zs->zbt);
         zfree(zs);
         zobj->ptr = zl;
         zobj->encoding = OBJ_ENCODING_LISTPACK;
@@ -1241,9 +1386,8 @@ void zsetConvert(robj *zobj, int encoding) {
  * are within the expected ranges. */
 void zsetConvertToListpackIfNeeded(robj *zobj, size_t maxelelen, size_t totelelen) {
     if (zobj->encoding == OBJ_ENCODING_LISTPACK) return;
-    zset *zset = zobj->ptr;
 
-    if (zset->zsl->length <= server.zset_max_listpack_entries &&
+    if (zsetLength(zobj) <= server.zset_max_listpack_entries &&
         maxelelen <= server.zset_max_listpack_value &&
         lpSafeToAdd(NULL, totelelen))
     {
@@ -1251,6 +1395,19 @@ void zsetConvertToListpackIfNeeded(robj *zobj, size_t maxelelen, size_t totelele
     }
 }
 
+/* Convert a skiplist encoded sorted set into a B+tree once it has more than
+ * zset-max-skiplist-entries elements (if not 0). There is no conversion
+ * back: like for listpacks, sets only go back to a listpack when a result
+ * is stored by ZUNIONSTORE and friends. */
+void zsetConvertToBtreeIfNeeded(robj *zobj) {
+    if (zobj->encoding == OBJ_ENCODING_SKIPLIST &&
+        server.zset_max_skiplist_entries &&
+        zsetLength(zobj) > server.zset_max_skiplist_entries)
+    {
+        zsetConvert(zobj,OBJ_ENCODING_BTREE);
+    }
+}
+
 /* Return (by reference) the score of the specified member of the sorted set
  * storing it into *score. If the element does not exist C_ERR is returned
  * otherwise C_OK is returned and *score is correctly populated.
@@ -1260,11 +1417,13 @@ int zsetScore(robj *zobj, sds member, double *score) {
 
     if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
         if (zzlFind(zobj->ptr, member, score) == NULL) return C_ERR;
-    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
+    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST ||
+               zobj->encoding == OBJ_ENCODING_BTREE)
+    {
         zset *zs = zobj->ptr;
         dictEntry *de = dictFind(zs->dict, member);
         if (de == NULL) return C_ERR;
-        *score = *(double*)dictGetVal(de);
+        *score = zsetDictGetScore(zs,de);
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -1310,7 +1469,8 @@ int zsetScore(robj *zobj, sds member, double *score) {
  * start.
  *
  * The command as a side effect of adding a new element may convert the sorted
- * set internal encoding from listpack to hashtable+skiplist.
+ * set internal encoding from listpack to hashtable+skiplist, and from
+ * hashtable+skiplist to hashtable+B+tree.
  *
  * Memory management of 'ele':
  *
@@ -1389,7 +1549,9 @@ int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, dou
 
     /* Note that the above block handling listpack would have either returned or
      * converted the key to skiplist. */
-    if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
+    if (zobj->encoding == OBJ_ENCODING_SKIPLIST ||
+        zobj->encoding == OBJ_ENCODING_BTREE)
+    {
         zset *zs = zobj->ptr;
         zskiplistNode *znode;
         dictEntry *de;
@@ -1402,7 +1564,7 @@ int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, dou
                 return 1;
             }
 
-            curscore = *(double*)dictGetVal(de);
+            curscore = zsetDictGetScore(zs,de);
 
             /* Prepare the score for the increment if needed. */
             if (incr) {
@@ -1423,18 +1585,31 @@ int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, dou
 
             /* Remove and re-insert when score changes. */
             if (score != curscore) {
-                znode = zslUpdateScore(zs->zsl,curscore,ele,score);
                 /* Note that we did not removed the original element from
                  * the hash table representing the sorted set, so we just
                  * update the score. */
-                dictGetVal(de) = &znode->score; /* Update score ptr. */
+                if (zs->zbt) {
+                    zbtUpdateScore(zs->zbt,curscore,ele,score);
+                    dictSetDoubleVal(de,score);
+                } else {
+                    znode = zslUpdateScore(zs->zsl,curscore,ele,score);
+                    dictGetVal(de) = &znode->score; /* Update score ptr. */
+                }
                 *out_flags |= ZADD_OUT_UPDATED;
             }
             return 1;
         } else if (!xx) {
             ele = sdsdup(ele);
-            znode = zslInsert(zs->zsl,score,ele);
-            serverAssert(dictAdd(zs->dict,ele,&znode->score) == DICT_OK);
+            if (zs->zbt) {
+                de = dictAddRaw(zs->dict,ele,NULL);
+                serverAssert(de != NULL);
+                dictSetDoubleVal(de,score);
+                zbtInsert(zs->zbt,score,ele);
+            } else {
+                znode = zslInsert(zs->zsl,score,ele);
+                serverAssert(dictAdd(zs->dict,ele,&znode->score) == DICT_OK);
+                zsetConvertToBtreeIfNeeded(zobj);
+            }
             *out_flags |= ZADD_OUT_ADDED;
             if (newscore) *newscore = score;
             return 1;
@@ -1448,8 +1623,8 @@ int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, dou
     return 0; /* Never reached. */
 }
 
-/* Deletes the element 'ele' from the sorted set encoded as a skiplist+dict,
- * returning 1 if the element existed and was deleted, 0 otherwise (the
+/* Deletes the element 'ele' from the sorted set encoded as a skiplist+dict
+ * (or B+tree+dict), returning 1 if the element existed and was deleted, 0 otherwise (the
  * element was not there). It does not resize the dict after deleting the
  * element. */
 static int zsetRemoveFromSkiplist(zset *zs, sds ele) {
@@ -1459,7 +1634,7 @@ static int zsetRemoveFromSkiplist(zset *zs, sds ele) {
     de = dictUnlink(zs->dict,ele);
     if (de != NULL) {
         /* Get the score in order to delete from the skiplist later. */
-        score = *(double*)dictGetVal(de);
+        score = zsetDictGetScore(zs,de);
 
         /* Delete from the hash table and later from the skiplist.
          * Note that the order is important: deleting from the skiplist
@@ -1469,7 +1644,8 @@ static int zsetRemoveFromSkiplist(zset *zs, sds ele) {
         dictFreeUnlinkedEntry(zs->dict,de);
 
         /* Delete from skiplist. */
-        int retval = zslDelete(zs->zsl,score,ele,NULL);
+        int retval = zs->zbt ? zbtDelete(zs->zbt,score,ele,NULL) :
+                               zslDelete(zs->zsl,score,ele,NULL);
         serverAssert(retval);
 
         return 1;
@@ -1488,7 +1664,9 @@ int zsetDel(robj *zobj, sds ele) {
             zobj->ptr = zzlDelete(zobj->ptr,eptr);
             return 1;
         }
-    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
+    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST ||
+               zobj->encoding == OBJ_ENCODING_BTREE)
+    {
         zset *zs = zobj->ptr;
         if (zsetRemoveFromSkiplist(zs, ele)) {
             if (htNeedsResize(zs->dict)) dictResize(zs->dict);
@@ -1542,16 +1720,18 @@ long zsetRank(robj *zobj, sds ele, int reverse) {
         } else {
             return -1;
         }
-    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
+    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST ||
+               zobj->encoding == OBJ_ENCODING_BTREE)
+    {
         zset *zs = zobj->ptr;
-        zskiplist *zsl = zs->zsl;
         dictEntry *de;
         double score;
 
         de = dictFind(zs->dict,ele);
         if (de != NULL) {
-            score = *(double*)dictGetVal(de);
-            rank = zslGetRank(zsl,score,ele);
+            score = zsetDictGetScore(zs,de);
+            rank = zs->zbt ? zbtGetRank(zs->zbt,score,ele) :
+                             zslGetRank(zs->zsl,score,ele);
             /* Existing elements always have a rank. */
             serverAssert(rank != 0);
             if (reverse)
@@ -1610,6 +1790,22 @@ robj *zsetDup(robj *o) {
             dictAdd(new_zs->dict,new_ele,&znode->score);
             ln = ln->backward;
         }
+    } else if (o->encoding == OBJ_ENCODING_BTREE) {
+        zbtIter it;
+        int valid;
+
+        zobj = createZsetBtreeObject();
+        zs = o->ptr;
+        new_zs = zobj->ptr;
+        dictExpand(new_zs->dict,dictSize(zs->dict));
+        valid = zbtLast(zs->zbt,&it);
+        while (valid) {
+            sds new_ele = sdsdup(zbtIterEle(&it));
+            dictEntry *de = dictAddRaw(new_zs->dict,new_ele,NULL);
+            dictSetDoubleVal(de,zbtIterScore(&it));
+            zbtInsert(new_zs->zbt,zbtIterScore(&it),new_ele);
+            valid = zbtPrev(&it);
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -1635,14 +1831,16 @@ void zsetReplyFromListpackEntry(client *c, listpackEntry *e) {
  * The memory in `key` is not to be freed or modified by the caller.
  * 'score' can be NULL in which case it's not extracted. */
 void zsetTypeRandomElement(robj *zsetobj, unsigned long zsetsize, listpackEntry *key, double *score) {
-    if (zsetobj->encoding == OBJ_ENCODING_SKIPLIST) {
+    if (zsetobj->encoding == OBJ_ENCODING_SKIPLIST ||
+        zsetobj->encoding == OBJ_ENCODING_BTREE)
+    {
         zset *zs = zsetobj->ptr;
         dictEntry *de = dictGetFairRandomKey(zs->dict);
         sds s = dictGetKey(de);
         key->sval = (unsigned char*)s;
         key->slen = sdslen(s);
         if (score)
-            *score = *(double*)dictGetVal(de);
+            *score = zsetDictGetScore(zs,de);
     } else if (zsetobj->encoding == OBJ_ENCODING_LISTPACK) {
         listpackEntry val;
         lpRandomPair(zsetobj->ptr, zsetsize, key, &val);
@@ -1923,6 +2121,25 @@ void zremrangeGenericCommand(client *c, zrange_type rangetype) {
             dbDelete(c->db,key);
             keyremoved = 1;
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        switch(rangetype) {
+        case ZRANGE_AUTO:
+        case ZRANGE_RANK:
+            deleted = zbtDeleteRangeByRank(zs->zbt,start+1,end+1,zs->dict);
+            break;
+        case ZRANGE_SCORE:
+            deleted = zbtDeleteRangeByScore(zs->zbt,&range,zs->dict);
+            break;
+        case ZRANGE_LEX:
+            deleted = zbtDeleteRangeByLex(zs->zbt,&lexrange,zs->dict);
+            break;
+        }
+        if (htNeedsResize(zs->dict)) dictResize(zs->dict);
+        if (dictSize(zs->dict) == 0) {
+            dbDelete(c->db,key);
+            keyremoved = 1;
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -1983,6 +2200,10 @@ typedef struct {
                 zset *zs;
                 zskiplistNode *node;
             } sl;
+            struct {
+                zbtIter it;
+                int valid;
+            } bt;
         } zset;
     } iter;
 } zsetopsrc;
@@ -2043,6 +2264,9 @@ void zuiInitIterator(zsetopsrc *op) {
         } else if (op->encoding == OBJ_ENCODING_SKIPLIST) {
             it->sl.zs = op->subject->ptr;
             it->sl.node = it->sl.zs->zsl->tail;
+        } else if (op->encoding == OBJ_ENCODING_BTREE) {
+            zset *zs = op->subject->ptr;
+            it->bt.valid = zbtLast(zs->zbt,&it->bt.it);
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -2068,7 +2292,9 @@ void zuiClearIterator(zsetopsrc *op) {
         iterzset *it = &op->iter.zset;
         if (op->encoding == OBJ_ENCODING_LISTPACK) {
             UNUSED(it); /* skip */
-        } else if (op->encoding == OBJ_ENCODING_SKIPLIST) {
+        } else if (op->encoding == OBJ_ENCODING_SKIPLIST ||
+                   op->encoding == OBJ_ENCODING_BTREE)
+        {
             UNUSED(it); /* skip */
         } else {
             serverPanic("Unknown sorted set encoding");
@@ -2105,6 +2331,9 @@ unsigned long zuiLength(zsetopsrc *op) {
         } else if (op->encoding == OBJ_ENCODING_SKIPLIST) {
             zset *zs = op->subject->ptr;
             return zs->zsl->length;
+        } else if (op->encoding == OBJ_ENCODING_BTREE) {
+            zset *zs = op->subject->ptr;
+            return zs->zbt->length;
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -2166,6 +2395,14 @@ int zuiNext(zsetopsrc *op, zsetopval *val) {
 
             /* Move to next element. (going backwards, see zuiInitIterator) */
             it->sl.node = it->sl.node->backward;
+        } else if (op->encoding == OBJ_ENCODING_BTREE) {
+            if (!it->bt.valid)
+                return 0;
+            val->ele = zbtIterEle(&it->bt.it);
+            val->score = zbtIterScore(&it->bt.it);
+
+            /* Move to next element. (going backwards, see zuiInitIterator) */
+            it->bt.valid = zbtPrev(&it->bt.it);
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -2274,11 +2511,13 @@ int zuiFind(zsetopsrc *op, zsetopval *val, double *score) {
             } else {
                 return 0;
             }
-        } else if (op->encoding == OBJ_ENCODING_SKIPLIST) {
+        } else if (op->encoding == OBJ_ENCODING_SKIPLIST ||
+                   op->encoding == OBJ_ENCODING_BTREE)
+        {
             zset *zs = op->subject->ptr;
             dictEntry *de;
             if ((de = dictFind(zs->dict,val->ele)) != NULL) {
-                *score = *(double*)dictGetVal(de);
+                *score = zsetDictGetScore(zs,de);
                 return 1;
             } else {
                 return 0;
@@ -2770,6 +3009,7 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
     if (dstkey) {
         if (dstzset->zsl->length) {
             zsetConvertToListpackIfNeeded(dstobj, maxelelen, totelelen);
+            zsetConvertToBtreeIfNeeded(dstobj);
             setKey(c, c->db, dstkey, dstobj, 0);
             addReplyLongLong(c, zsetLength(dstobj));
             notifyKeyspaceEvent(NOTIFY_ZSET,
@@ -3119,6 +3359,17 @@ void genericZrangebyrankCommand(zrange_result_handler *handler,
             handler->emitResultFromCBuffer(handler, ele, sdslen(ele), ln->score);
             ln = reverse ? ln->backward : ln->level[0].forward;
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        int valid = zbtGetElementByRank(zs->zbt,reverse ? llen-start : start+1,&it);
+
+        while(rangelen--) {
+            serverAssertWithInfo(c,zobj,valid);
+            sds ele = zbtIterEle(&it);
+            handler->emitResultFromCBuffer(handler, ele, sdslen(ele), zbtIterScore(&it));
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -3256,6 +3507,42 @@ void genericZrangebyscoreCommand(zrange_result_handler *handler,
                 ln = ln->level[0].forward;
             }
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        unsigned long rank;
+        int valid;
+
+        /* If reversed, get the last element in range as starting point. The
+         * offset is skipped by rank, without walking the elements (like
+         * above, a negative offset means an empty result). */
+        if (reverse) {
+            valid = zbtLastInRange(zs->zbt,range,&it,&rank);
+            if (valid && offset != 0)
+                valid = offset > 0 && (unsigned long)offset < rank &&
+                        zbtGetElementByRank(zs->zbt,rank-offset,&it);
+        } else {
+            valid = zbtFirstInRange(zs->zbt,range,&it,&rank);
+            if (valid && offset != 0)
+                valid = offset > 0 &&
+                        zbtGetElementByRank(zs->zbt,rank+offset,&it);
+        }
+
+        while (valid && limit--) {
+            double score = zbtIterScore(&it);
+            sds ele = zbtIterEle(&it);
+
+            /* Abort when the element is no longer in range. */
+            if (reverse) {
+                if (!zslValueGteMin(score,range)) break;
+            } else {
+                if (!zslValueLteMax(score,range)) break;
+            }
+
+            rangelen++;
+            handler->emitResultFromCBuffer(handler, ele, sdslen(ele), score);
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -3347,6 +3634,18 @@ void zcountCommand(client *c) {
                 count -= (zsl->length - rank);
             }
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        unsigned long first, last;
+
+        /* The ranks of the first and the last element in range are found
+         * with the elements themselves. */
+        if (zbtFirstInRange(zs->zbt, &range, &it, &first) &&
+            zbtLastInRange(zs->zbt, &range, &it, &last))
+        {
+            count = last - first + 1;
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -3425,6 +3724,16 @@ void zlexcountCommand(client *c) {
                 count -= (zsl->length - rank);
             }
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        unsigned long first, last;
+
+        if (zbtFirstInLexRange(zs->zbt, &range, &it, &first) &&
+            zbtLastInLexRange(zs->zbt, &range, &it, &last))
+        {
+            count = last - first + 1;
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -3537,6 +3846,39 @@ void genericZrangebylexCommand(zrange_result_handler *handler,
                 ln = ln->level[0].forward;
             }
         }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtIter it;
+        unsigned long rank;
+        int valid;
+
+        /* If reversed, get the last element in range as starting point. */
+        if (reverse) {
+            valid = zbtLastInLexRange(zs->zbt,range,&it,&rank);
+            if (valid && offset != 0)
+                valid = offset > 0 && (unsigned long)offset < rank &&
+                        zbtGetElementByRank(zs->zbt,rank-offset,&it);
+        } else {
+            valid = zbtFirstInLexRange(zs->zbt,range,&it,&rank);
+            if (valid && offset != 0)
+                valid = offset > 0 &&
+                        zbtGetElementByRank(zs->zbt,rank+offset,&it);
+        }
+
+        while (valid && limit--) {
+            sds ele = zbtIterEle(&it);
+
+            /* Abort when the element is no longer in range. */
+            if (reverse) {
+                if (!zslLexValueGteMin(ele,range)) break;
+            } else {
+                if (!zslLexValueLteMax(ele,range)) break;
+            }
+
+            rangelen++;
+            handler->emitResultFromCBuffer(handler, ele, sdslen(ele), zbtIterScore(&it));
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
@@ -3912,6 +4254,18 @@ void genericZpopCommand(client *c, robj **keyv, int keyc, int where, int emitkey
             serverAssertWithInfo(c,zobj,zln != NULL);
             ele = sdsdup(zln->ele);
             score = zln->score;
+        } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+            zset *zs = zobj->ptr;
+            zbtIter it;
+
+            /* Get the first or last element in the sorted set. */
+            int valid = (where == ZSET_MAX ? zbtLast(zs->zbt,&it) :
+                                             zbtFirst(zs->zbt,&it));
+
+            /* There must be an element in the sorted set. */
+            serverAssertWithInfo(c,zobj,valid);
+            ele = sdsdup(zbtIterEle(&it));
+            score = zbtIterScore(&it);
         } else {
             serverPanic("Unknown sorted set encoding");
         }
@@ -4116,7 +4470,9 @@ void zrandmemberWithCountCommand(client *c, long l, int withscores) {
             addReplyArrayLen(c, count*2);
         else
             addReplyArrayLen(c, count);
-        if (zsetobj->encoding == OBJ_ENCODING_SKIPLIST) {
+        if (zsetobj->encoding == OBJ_ENCODING_SKIPLIST ||
+            zsetobj->encoding == OBJ_ENCODING_BTREE)
+        {
             zset *zs = zsetobj->ptr;
             while (count--) {
                 dictEntry *de = dictGetFairRandomKey(zs->dict);
@@ -4125,7 +4481,7 @@ void zrandmemberWithCountCommand(client *c, long l, int withscores) {
                     addReplyArrayLen(c,2);
                 addReplyBulkCBuffer(c, key, sdslen(key));
                 if (withscores)
-                    addReplyDouble(c, *(double*)dictGetVal(de));
+                    addReplyDouble(c, zsetDictGetScore(zs,de));
             }
         } else if (zsetobj->encoding == OBJ_ENCODING_LISTPACK) {
             listpackEntry *keys, *vals = NULL;
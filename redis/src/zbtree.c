@@ -0,0 +1,813 @@
+/* zbtree -- A B+tree ordered by (score, element), used as the sorted index
+ * of large sorted sets.
+ *
+ * Compared to the skiplist, elements are stored many per node in sorted
+ * arrays, so that a lookup touches a handful of cache lines instead of one
+ * node per level, and the per element overhead is the score and the element
+ * pointer instead of a node allocation with its levels.
+ *
+ * The tree is ordered like the skiplist: by score, then by element. Every
+ * inner node stores, for each child, the number of elements in the subtree
+ * and the first element of the subtree, so ranks and ranges are O(log N).
+ * Nodes have no parent pointers: modifications recurse from the root and
+ * fix the counters and first elements on the way back. Leaves are linked
+ * in order, which is all the iterators need.
+ *
+ * Copyright (c) 2022, Redis Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "zbtree.h"
+#include "zmalloc.h"
+#include "redisassert.h"
+
+/* Nodes with fewer entries than this are merged with, or borrow from, a
+ * sibling after a deletion. */
+#define ZBT_LEAF_MIN (ZBT_LEAF_CAP/4)
+#define ZBT_INNER_MIN (ZBT_INNER_CAP/4)
+
+static inline int zbtCompare(double s1, sds e1, double s2, sds e2) {
+    if (s1 < s2) return -1;
+    if (s1 > s2) return 1;
+    return sdscmp(e1,e2);
+}
+
+static zbtLeaf *zbtLeafCreate(zbtree *zbt) {
+    zbtLeaf *l = zmalloc(sizeof(*l));
+    l->prev = l->next = NULL;
+    l->count = 0;
+    zbt->leaves++;
+    return l;
+}
+
+static zbtInner *zbtInnerCreate(zbtree *zbt) {
+    zbtInner *in = zmalloc(sizeof(*in));
+    in->count = 0;
+    zbt->inners++;
+    return in;
+}
+
+/* Move 'n' entries of 'src' starting at 'spos' to 'dst' at 'dpos'. The two
+ * nodes may be the same one, and the ranges may overlap. */
+static void zbtLeafMove(zbtLeaf *dst, int dpos, zbtLeaf *src, int spos, int n) {
+    memmove(dst->score+dpos,src->score+spos,n*sizeof(double));
+    memmove(dst->ele+dpos,src->ele+spos,n*sizeof(sds));
+}
+
+static void zbtInnerMove(zbtInner *dst, int dpos, zbtInner *src, int spos, int n) {
+    memmove(dst->size+dpos,src->size+spos,n*sizeof(unsigned long));
+    memmove(dst->child+dpos,src->child+spos,n*sizeof(void*));
+    memmove(dst->score+dpos,src->score+spos,n*sizeof(double));
+    memmove(dst->ele+dpos,src->ele+spos,n*sizeof(sds));
+}
+
+static inline int zbtNodeCount(void *node, int height) {
+    return height ? (int)((zbtInner*)node)->count : (int)((zbtLeaf*)node)->count;
+}
+
+/* Number of elements in the subtree. */
+static unsigned long zbtNodeSize(void *node, int height) {
+    if (height == 0) return ((zbtLeaf*)node)->count;
+
+    zbtInner *in = node;
+    unsigned long size = 0;
+    for (uint32_t j = 0; j < in->count; j++) size += in->size[j];
+    return size;
+}
+
+/* Copy the first element of the child 'i' (of the given height) in 'in'. */
+static void zbtInnerUpdateKey(zbtInner *in, int i, int height) {
+    if (height == 0) {
+        zbtLeaf *l = in->child[i];
+        if (l->count == 0) return;
+        in->score[i] = l->score[0];
+        in->ele[i] = l->ele[0];
+    } else {
+        zbtInner *c = in->child[i];
+        in->score[i] = c->score[0];
+        in->ele[i] = c->ele[0];
+    }
+}
+
+/* Index of the first element of the leaf not lower than (score, ele). */
+static int zbtLeafLowerBound(zbtLeaf *l, double score, sds ele) {
+    int lo = 0, hi = l->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (zbtCompare(l->score[mid],l->ele[mid],score,ele) < 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Index of the child that contains, or would contain, (score, ele): the
+ * last one starting with a lower or equal element, or the first one. */
+static int zbtInnerFind(zbtInner *in, double score, sds ele) {
+    int lo = 1, hi = in->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (zbtCompare(in->score[mid],in->ele[mid],score,ele) <= 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo-1;
+}
+
+zbtree *zbtCreate(void) {
+    zbtree *zbt = zmalloc(sizeof(*zbt));
+    zbt->leaves = zbt->inners = 0;
+    zbt->length = 0;
+    zbt->height = 0;
+    zbt->root = zbt->head = zbt->tail = zbtLeafCreate(zbt);
+    return zbt;
+}
+
+static void zbtFreeNode(void *node, int height) {
+    if (height == 0) {
+        zbtLeaf *l = node;
+        for (uint32_t j = 0; j < l->count; j++) sdsfree(l->ele[j]);
+    } else {
+        zbtInner *in = node;
+        for (uint32_t j = 0; j < in->count; j++)
+            zbtFreeNode(in->child[j],height-1);
+    }
+    zfree(node);
+}
+
+/* Free the tree and the elements it holds. */
+void zbtFree(zbtree *zbt) {
+    zbtFreeNode(zbt->root,zbt->height);
+    zfree(zbt);
+}
+
+/* Insert in the leaf, splitting it if full. Returns the new right sibling
+ * if it was split, otherwise NULL. */
+static zbtLeaf *zbtLeafInsert(zbtree *zbt, zbtLeaf *l, double score, sds ele) {
+    int pos = zbtLeafLowerBound(l,score,ele);
+    zbtLeaf *r = NULL;
+
+    if (l->count == ZBT_LEAF_CAP) {
+        int mid;
+        /* Elements added in order at either end of the set (like when
+         * loading an RDB file) leave the old leaf full instead of two half
+         * empty ones. */
+        if (pos == ZBT_LEAF_CAP && l->next == NULL) mid = ZBT_LEAF_CAP;
+        else if (pos == 0 && l->prev == NULL) mid = 0;
+        else mid = ZBT_LEAF_CAP/2;
+
+        r = zbtLeafCreate(zbt);
+        zbtLeafMove(r,0,l,mid,l->count-mid);
+        r->count = l->count-mid;
+        l->count = mid;
+        r->prev = l;
+        r->next = l->next;
+        if (l->next) l->next->prev = r; else zbt->tail = r;
+        l->next = r;
+        if (pos > mid || mid == ZBT_LEAF_CAP) {
+            l = r;
+            pos -= mid;
+        }
+    }
+    zbtLeafMove(l,pos+1,l,pos,l->count-pos);
+    l->score[pos] = score;
+    l->ele[pos] = ele;
+    l->count++;
+    return r;
+}
+
+/* Add 'child' at 'pos' in 'in', splitting it if full. Returns the new right
+ * sibling if it was split, otherwise NULL. */
+static zbtInner *zbtInnerAdd(zbtree *zbt, zbtInner *in, int pos, void *child,
+                             unsigned long size, int height)
+{
+    zbtInner *r = NULL;
+
+    if (in->count == ZBT_INNER_CAP) {
+        int mid = ZBT_INNER_CAP/2+1;
+        r = zbtInnerCreate(zbt);
+        zbtInnerMove(r,0,in,mid,in->count-mid);
+        r->count = in->count-mid;
+        in->count = mid;
+        if (pos > mid) {
+            in = r;
+            pos -= mid;
+        }
+    }
+    zbtInnerMove(in,pos+1,in,pos,in->count-pos);
+    in->child[pos] = child;
+    in->size[pos] = size;
+    in->count++;
+    zbtInnerUpdateKey(in,pos,height);
+    return r;
+}
+
+static void *zbtInsertNode(zbtree *zbt, void *node, int height, double score, sds ele) {
+    if (height == 0) return zbtLeafInsert(zbt,node,score,ele);
+
+    zbtInner *in = node;
+    int i = zbtInnerFind(in,score,ele);
+    void *right = zbtInsertNode(zbt,in->child[i],height-1,score,ele);
+    in->size[i]++;
+    zbtInnerUpdateKey(in,i,height-1);
+    if (right == NULL) return NULL;
+
+    unsigned long rsize = zbtNodeSize(right,height-1);
+    in->size[i] -= rsize;
+    return zbtInnerAdd(zbt,in,i+1,right,rsize,height-1);
+}
+
+/* Insert a new element, which must not already be in the tree. The tree
+ * takes ownership of the sds 'ele'. */
+void zbtInsert(zbtree *zbt, double score, sds ele) {
+    void *right = zbtInsertNode(zbt,zbt->root,zbt->height,score,ele);
+
+    if (right) {
+        zbtInner *root = zbtInnerCreate(zbt);
+        root->count = 2;
+        root->child[0] = zbt->root;
+        root->child[1] = right;
+        root->size[0] = zbtNodeSize(zbt->root,zbt->height);
+        root->size[1] = zbtNodeSize(right,zbt->height);
+        zbtInnerUpdateKey(root,0,zbt->height);
+        zbtInnerUpdateKey(root,1,zbt->height);
+        zbt->root = root;
+        zbt->height++;
+    }
+    zbt->length++;
+}
+
+static void zbtInnerRemove(zbtInner *in, int pos) {
+    zbtInnerMove(in,pos,in,pos+1,in->count-pos-1);
+    in->count--;
+}
+
+/* The child 'i' of 'in' went under the minimum fill: merge it with a
+ * sibling, or move entries from the sibling if they don't fit in a node. */
+static void zbtRebalance(zbtree *zbt, zbtInner *in, int i, int height) {
+    if (in->count < 2) return;
+    int a = i > 0 ? i-1 : i, b = a+1;
+
+    if (height == 0) {
+        zbtLeaf *l = in->child[a], *r = in->child[b];
+        if (l->count + r->count <= ZBT_LEAF_CAP) {
+            zbtLeafMove(l,l->count,r,0,r->count);
+            l->count += r->count;
+            l->next = r->next;
+            if (r->next) r->next->prev = l; else zbt->tail = l;
+            zfree(r);
+            zbt->leaves--;
+            zbtInnerRemove(in,b);
+        } else {
+            int want = (l->count + r->count)/2;
+            if ((int)l->count < want) {
+                int n = want-l->count;
+                zbtLeafMove(l,l->count,r,0,n);
+                zbtLeafMove(r,0,r,n,r->count-n);
+                l->count += n;
+                r->count -= n;
+            } else {
+                int n = l->count-want;
+                zbtLeafMove(r,n,r,0,r->count);
+                zbtLeafMove(r,0,l,want,n);
+                l->count -= n;
+                r->count += n;
+            }
+            in->size[b] = r->count;
+            zbtInnerUpdateKey(in,b,0);
+        }
+        in->size[a] = l->count;
+    } else {
+        zbtInner *l = in->child[a], *r = in->child[b];
+        if (l->count + r->count <= ZBT_INNER_CAP) {
+            zbtInnerMove(l,l->count,r,0,r->count);
+            l->count += r->count;
+            in->size[a] += in->size[b];
+            zfree(r);
+            zbt->inners--;
+            zbtInnerRemove(in,b);
+        } else {
+            int want = (l->count + r->count)/2;
+            if ((int)l->count < want) {
+                int n = want-l->count;
+                zbtInnerMove(l,l->count,r,0,n);
+                zbtInnerMove(r,0,r,n,r->count-n);
+                l->count += n;
+                r->count -= n;
+            } else {
+                int n = l->count-want;
+                zbtInnerMove(r,n,r,0,r->count);
+                zbtInnerMove(r,0,l,want,n);
+                l->count -= n;
+                r->count += n;
+            }
+            unsigned long total = in->size[a] + in->size[b];
+            in->size[a] = zbtNodeSize(l,height);
+            in->size[b] = total - in->size[a];
+            zbtInnerUpdateKey(in,b,height);
+        }
+    }
+    zbtInnerUpdateKey(in,a,height);
+}
+
+static int zbtDeleteNode(zbtree *zbt, void *node, int height, double score,
+                         sds ele, sds *removed)
+{
+    if (height == 0) {
+        zbtLeaf *l = node;
+        int pos = zbtLeafLowerBound(l,score,ele);
+        if (pos == (int)l->count || l->score[pos] != score ||
+            sdscmp(l->ele[pos],ele) != 0) return 0;
+        if (removed) *removed = l->ele[pos];
+        else sdsfree(l->ele[pos]);
+        zbtLeafMove(l,pos,l,pos+1,l->count-pos-1);
+        l->count--;
+        return 1;
+    }
+
+    zbtInner *in = node;
+    int i = zbtInnerFind(in,score,ele);
+    if (!zbtDeleteNode(zbt,in->child[i],height-1,score,ele,removed)) return 0;
+    in->size[i]--;
+    zbtInnerUpdateKey(in,i,height-1);
+    if (zbtNodeCount(in->child[i],height-1) <
+        (height == 1 ? ZBT_LEAF_MIN : ZBT_INNER_MIN))
+    {
+        zbtRebalance(zbt,in,i,height-1);
+    }
+    return 1;
+}
+
+/* Delete the element matching (score, ele). Returns 1 if it was found. The
+ * element sds is freed, unless 'removed' is not NULL, in which case it is
+ * returned there and it is up to the caller to free it. */
+int zbtDelete(zbtree *zbt, double score, sds ele, sds *removed) {
+    if (!zbtDeleteNode(zbt,zbt->root,zbt->height,score,ele,removed)) return 0;
+    zbt->length--;
+    while (zbt->height > 0 && ((zbtInner*)zbt->root)->count == 1) {
+        zbtInner *root = zbt->root;
+        zbt->root = root->child[0];
+        zfree(root);
+        zbt->inners--;
+        zbt->height--;
+    }
+    return 1;
+}
+
+/* Find (score, ele). On success 'it' points to the element and 'rank' (if
+ * not NULL) is set to its 1-based rank. */
+static int zbtFind(zbtree *zbt, double score, sds ele, zbtIter *it, unsigned long *rank) {
+    void *node = zbt->root;
+    unsigned long acc = 0;
+
+    for (int h = zbt->height; h > 0; h--) {
+        zbtInner *in = node;
+        int i = zbtInnerFind(in,score,ele);
+        for (int j = 0; j < i; j++) acc += in->size[j];
+        node = in->child[i];
+    }
+
+    zbtLeaf *l = node;
+    int pos = zbtLeafLowerBound(l,score,ele);
+    if (pos == (int)l->count || l->score[pos] != score ||
+        sdscmp(l->ele[pos],ele) != 0) return 0;
+    it->leaf = l;
+    it->idx = pos;
+    if (rank) *rank = acc+pos+1;
+    return 1;
+}
+
+/* Change the score of an element that must be in the tree. */
+void zbtUpdateScore(zbtree *zbt, double curscore, sds ele, double newscore) {
+    zbtIter it;
+    int found = zbtFind(zbt,curscore,ele,&it,NULL);
+    assert(found);
+
+    /* If the element doesn't move, update the score in place. The first
+     * element of a leaf is also referenced by the inner nodes, so in that
+     * case it is simpler to remove and re-insert it. */
+    zbtLeaf *l = it.leaf;
+    int i = it.idx;
+    if ((i > 0 || zbt->height == 0) &&
+        (i == 0 || zbtCompare(l->score[i-1],l->ele[i-1],newscore,l->ele[i]) < 0) &&
+        ((i+1 < (int)l->count) ?
+            zbtCompare(newscore,l->ele[i],l->score[i+1],l->ele[i+1]) < 0 :
+            (l->next == NULL ||
+             zbtCompare(newscore,l->ele[i],l->next->score[0],l->next->ele[0]) < 0)))
+    {
+        l->score[i] = newscore;
+        return;
+    }
+
+    sds removed;
+    zbtDelete(zbt,curscore,ele,&removed);
+    zbtInsert(zbt,newscore,removed);
+}
+
+/* Returns the 1-based rank of the element, or 0 if it is not in the tree. */
+unsigned long zbtGetRank(zbtree *zbt, double score, sds ele) {
+    zbtIter it;
+    unsigned long rank;
+    return zbtFind(zbt,score,ele,&it,&rank) ? rank : 0;
+}
+
+/* Point 'it' to the element with the given 1-based rank. Returns 0 if the
+ * rank is out of range. */
+int zbtGetElementByRank(zbtree *zbt, unsigned long rank, zbtIter *it) {
+    if (rank == 0 || rank > zbt->length) return 0;
+
+    void *node = zbt->root;
+    for (int h = zbt->height; h > 0; h--) {
+        zbtInner *in = node;
+        int i = 0;
+        while (rank > in->size[i]) rank -= in->size[i++];
+        node = in->child[i];
+    }
+    it->leaf = node;
+    it->idx = rank-1;
+    return 1;
+}
+
+int zbtFirst(zbtree *zbt, zbtIter *it) {
+    if (zbt->length == 0) return 0;
+    it->leaf = zbt->head;
+    it->idx = 0;
+    return 1;
+}
+
+int zbtLast(zbtree *zbt, zbtIter *it) {
+    if (zbt->length == 0) return 0;
+    it->leaf = zbt->tail;
+    it->idx = zbt->tail->count-1;
+    return 1;
+}
+
+/* Point 'it' to the first element for which 'pred' is true. The predicate
+ * must be false for all the elements up to some point and true after it,
+ * like "score >= min". Returns 0 if there is no such element, otherwise
+ * 'rank' (if not NULL) is set to the 1-based rank of the element. */
+int zbtFirstWhere(zbtree *zbt, zbtPredicate *pred, void *privdata, zbtIter *it,
+                  unsigned long *rank)
+{
+    void *node = zbt->root;
+    unsigned long acc = 0;
+
+    for (int h = zbt->height; h > 0; h--) {
+        zbtInner *in = node;
+        /* The last child starting before the first match: either the match
+         * is in it, or it is the first element of the next leaf. */
+        int lo = 1, hi = in->count;
+        while (lo < hi) {
+            int mid = (lo+hi)/2;
+            if (pred(in->score[mid],in->ele[mid],privdata)) hi = mid;
+            else lo = mid+1;
+        }
+        for (int j = 0; j < lo-1; j++) acc += in->size[j];
+        node = in->child[lo-1];
+    }
+
+    zbtLeaf *l = node;
+    int lo = 0, hi = l->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (pred(l->score[mid],l->ele[mid],privdata)) hi = mid;
+        else lo = mid+1;
+    }
+    acc += lo;
+    if (lo == (int)l->count) {
+        l = l->next;
+        lo = 0;
+        if (l == NULL) return 0;
+    }
+    it->leaf = l;
+    it->idx = lo;
+    if (rank) *rank = acc+1;
+    return 1;
+}
+
+/* Like zbtFirstWhere(), but for the last element for which 'pred' is true,
+ * where 'pred' is true up to some point and false after it, like
+ * "score <= max". */
+int zbtLastWhere(zbtree *zbt, zbtPredicate *pred, void *privdata, zbtIter *it,
+                 unsigned long *rank)
+{
+    void *node = zbt->root;
+    unsigned long acc = 0;
+
+    for (int h = zbt->height; h > 0; h--) {
+        zbtInner *in = node;
+        int lo = 0, hi = in->count;
+        while (lo < hi) {
+            int mid = (lo+hi)/2;
+            if (pred(in->score[mid],in->ele[mid],privdata)) lo = mid+1;
+            else hi = mid;
+        }
+        if (lo == 0) return 0;
+        for (int j = 0; j < lo-1; j++) acc += in->size[j];
+        node = in->child[lo-1];
+    }
+
+    zbtLeaf *l = node;
+    int lo = 0, hi = l->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (pred(l->score[mid],l->ele[mid],privdata)) lo = mid+1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+    it->leaf = l;
+    it->idx = lo-1;
+    if (rank) *rank = acc+lo;
+    return 1;
+}
+
+/* Move the iterator to the next element. Returns 0 at the end. */
+int zbtNext(zbtIter *it) {
+    if (++it->idx < (int)it->leaf->count) return 1;
+    it->leaf = it->leaf->next;
+    it->idx = 0;
+    return it->leaf != NULL;
+}
+
+/* Move the iterator to the previous element. Returns 0 at the start. */
+int zbtPrev(zbtIter *it) {
+    if (it->idx > 0) {
+        it->idx--;
+        return 1;
+    }
+    it->leaf = it->leaf->prev;
+    if (it->leaf == NULL) return 0;
+    it->idx = it->leaf->count-1;
+    return 1;
+}
+
+/* Compare with an element that may be 'oldele', which we can't access. */
+static inline int zbtCompareMoved(double s1, sds e1, double s2, sds e2, sds oldele) {
+    if (e1 == oldele && s1 == s2) return 0;
+    return zbtCompare(s1,e1,s2,e2);
+}
+
+/* Replace the sds of an element with another with the same content, for
+ * active defrag. 'oldele' may already be freed: it is only compared as a
+ * pointer. */
+void zbtReplaceEle(zbtree *zbt, double score, sds oldele, sds newele) {
+    void *node = zbt->root;
+
+    for (int h = zbt->height; h > 0; h--) {
+        zbtInner *in = node;
+        int lo = 1, hi = in->count;
+        while (lo < hi) {
+            int mid = (lo+hi)/2;
+            if (zbtCompareMoved(in->score[mid],in->ele[mid],score,newele,oldele) <= 0)
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+        if (in->ele[lo-1] == oldele) in->ele[lo-1] = newele;
+        node = in->child[lo-1];
+    }
+
+    zbtLeaf *l = node;
+    int lo = 0, hi = l->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+        if (zbtCompareMoved(l->score[mid],l->ele[mid],score,newele,oldele) < 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    assert(lo < (int)l->count && l->ele[lo] == oldele);
+    l->ele[lo] = newele;
+}
+
+/* Memory used by the tree structure, not including the elements. */
+size_t zbtAllocSize(zbtree *zbt) {
+    return sizeof(*zbt) + zbt->leaves*sizeof(zbtLeaf) +
+           zbt->inners*sizeof(zbtInner);
+}
+
+#ifdef REDIS_TEST
+#include <stdio.h>
+#include <stdlib.h>
+#include "testhelp.h"
+
+#define UNUSED(x) (void)(x)
+#define TEST(name) printf("test — %s\n", name);
+
+/* Check the structure of a subtree, returning its size. */
+static unsigned long zbtVerifyNode(zbtree *zbt, void *node, int height,
+                                   int isroot, zbtLeaf **prev)
+{
+    if (height == 0) {
+        zbtLeaf *l = node;
+        assert(isroot || l->count > 0);
+        assert(l->prev == *prev);
+        if (*prev) assert((*prev)->next == l); else assert(zbt->head == l);
+        for (uint32_t j = 1; j < l->count; j++)
+            assert(zbtCompare(l->score[j-1],l->ele[j-1],l->score[j],l->ele[j]) < 0);
+        *prev = l;
+        return l->count;
+    }
+
+    zbtInner *in = node;
+    unsigned long size = 0;
+    assert(in->count >= (isroot ? 2 : 1));
+    for (uint32_t j = 0; j < in->count; j++) {
+        unsigned long s = zbtVerifyNode(zbt,in->child[j],height-1,0,prev);
+        assert(s == in->size[j]);
+        if (height == 1) {
+            zbtLeaf *c = in->child[j];
+            assert(c->score[0] == in->score[j] && c->ele[0] == in->ele[j]);
+        } else {
+            zbtInner *c = in->child[j];
+            assert(c->score[0] == in->score[j] && c->ele[0] == in->ele[j]);
+        }
+        size += s;
+    }
+    return size;
+}
+
+static void zbtVerify(zbtree *zbt) {
+    zbtLeaf *prev = NULL;
+    assert(zbtVerifyNode(zbt,zbt->root,zbt->height,1,&prev) == zbt->length);
+    assert(zbt->tail == prev && prev->next == NULL);
+}
+
+static int zbtTestScoreGte(double score, sds ele, void *privdata) {
+    UNUSED(ele);
+    return score >= *(double*)privdata;
+}
+
+static int zbtTestScoreLte(double score, sds ele, void *privdata) {
+    UNUSED(ele);
+    return score <= *(double*)privdata;
+}
+
+int zbtreeTest(int argc, char *argv[], int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    int accurate = (flags & REDIS_TEST_ACCURATE);
+    int n = accurate ? 200000 : 20000;
+    /* The reference: element i has score scores[i], or is not in the tree
+     * if present[i] is 0. Several elements share each score. */
+    double *scores = zmalloc(sizeof(double)*n);
+    char *present = zcalloc(n);
+    unsigned long len = 0;
+    zbtree *zbt = zbtCreate();
+    char buf[32];
+
+    srand(1234);
+
+    TEST("Insert in order and in reverse order") {
+        zbtree *t = zbtCreate();
+        for (int j = 0; j < 1000; j++) {
+            snprintf(buf,sizeof(buf),"%06d",j);
+            zbtInsert(t,j,sdsnew(buf));
+        }
+        for (int j = -1; j >= -1000; j--) {
+            snprintf(buf,sizeof(buf),"%06d",j);
+            zbtInsert(t,j,sdsnew(buf));
+        }
+        zbtVerify(t);
+        /* Sequential inserts leave the leaves full. */
+        assert(t->leaves <= 2000/ZBT_LEAF_CAP+2);
+        zbtFree(t);
+    }
+
+    TEST("Random inserts, deletes and score updates") {
+        for (int round = 0; round < 4*n; round++) {
+            int j = rand() % n;
+            snprintf(buf,sizeof(buf),"ele:%d",j);
+            sds ele = sdsnew(buf);
+            int op = rand() % 3;
+            if (!present[j]) {
+                scores[j] = rand() % (n/8);
+                zbtInsert(zbt,scores[j],ele);
+                present[j] = 1;
+                len++;
+                continue;
+            } else if (op == 0) {
+                assert(zbtDelete(zbt,scores[j],ele,NULL));
+                present[j] = 0;
+                len--;
+            } else if (op == 1) {
+                double newscore = rand() % (n/8);
+                zbtUpdateScore(zbt,scores[j],ele,newscore);
+                scores[j] = newscore;
+            } else {
+                assert(zbtGetRank(zbt,scores[j],ele) != 0);
+                assert(zbtGetRank(zbt,scores[j]+0.5,ele) == 0);
+            }
+            sdsfree(ele);
+            if (round % 1000 == 0) zbtVerify(zbt);
+        }
+        zbtVerify(zbt);
+        assert(zbt->length == len);
+    }
+
+    TEST("Ranks and iteration") {
+        zbtIter it, byrank;
+        unsigned long rank = 0;
+        int valid = zbtFirst(zbt,&it);
+        while (valid) {
+            rank++;
+            assert(zbtGetRank(zbt,zbtIterScore(&it),zbtIterEle(&it)) == rank);
+            assert(zbtGetElementByRank(zbt,rank,&byrank));
+            assert(byrank.leaf == it.leaf && byrank.idx == it.idx);
+            valid = zbtNext(&it);
+        }
+        assert(rank == len);
+        assert(!zbtGetElementByRank(zbt,len+1,&it));
+
+        valid = zbtLast(zbt,&it);
+        while (valid) {
+            assert(zbtGetRank(zbt,zbtIterScore(&it),zbtIterEle(&it)) == rank);
+            rank--;
+            valid = zbtPrev(&it);
+        }
+        assert(rank == 0);
+    }
+
+    TEST("Score ranges") {
+        for (int j = 0; j < 1000; j++) {
+            double min = rand() % (n/8), max = min + rand() % 10;
+            unsigned long count = 0, first, last;
+            zbtIter it;
+            for (int k = 0; k < n; k++)
+                if (present[k] && scores[k] >= min && scores[k] <= max) count++;
+            if (zbtFirstWhere(zbt,zbtTestScoreGte,&min,&it,&first) &&
+                zbtIterScore(&it) <= max)
+            {
+                assert(zbtGetRank(zbt,zbtIterScore(&it),zbtIterEle(&it)) == first);
+                assert(zbtPrev(&it) == 0 || zbtIterScore(&it) < min);
+                assert(zbtLastWhere(zbt,zbtTestScoreLte,&max,&it,&last));
+                assert(zbtGetRank(zbt,zbtIterScore(&it),zbtIterEle(&it)) == last);
+                assert(zbtNext(&it) == 0 || zbtIterScore(&it) > max);
+                assert(last-first+1 == count);
+            } else {
+                assert(count == 0);
+            }
+        }
+    }
+
+    TEST("Replace element") {
+        zbtIter it;
+        for (int j = 0; j < 1000; j++) {
+            assert(zbtGetElementByRank(zbt,1+rand()%zbt->length,&it));
+            sds oldele = zbtIterEle(&it), newele = sdsdup(oldele);
+            double score = zbtIterScore(&it);
+            zbtReplaceEle(zbt,score,oldele,newele);
+            sdsfree(oldele);
+            assert(zbtGetRank(zbt,score,newele) != 0);
+        }
+        zbtVerify(zbt);
+    }
+
+    TEST("Delete everything") {
+        for (int j = 0; j < n; j++) {
+            if (!present[j]) continue;
+            snprintf(buf,sizeof(buf),"ele:%d",j);
+            sds ele = sdsnew(buf);
+            assert(zbtDelete(zbt,scores[j],ele,NULL));
+            assert(!zbtDelete(zbt,scores[j],ele,NULL));
+            sdsfree(ele);
+            if (j % 1000 == 0) zbtVerify(zbt);
+        }
+        zbtVerify(zbt);
+        assert(zbt->length == 0 && zbt->height == 0 && zbt->leaves == 1);
+    }
+
+    zbtFree(zbt);
+    zfree(scores);
+    zfree(present);
+    return 0;
+}
+#endif
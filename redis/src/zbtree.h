@@ -0,0 +1,102 @@
+/* zbtree -- A B+tree ordered by (score, element), used as the sorted index
+ * of large sorted sets.
+ *
+ * Copyright (c) 2022, Redis Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ZBTREE_H
+#define __ZBTREE_H
+
+#include <stdint.h>
+#include "sds.h"
+
+/* Leaves and inner nodes are sized to fill a 1024 bytes allocation. */
+#define ZBT_LEAF_CAP 62
+#define ZBT_INNER_CAP 31
+
+/* Leaves hold the elements, in order, as parallel arrays so that a binary
+ * search only touches the scores. They are linked in order to iterate. */
+typedef struct zbtLeaf {
+    struct zbtLeaf *prev, *next;
+    uint32_t count;
+    double score[ZBT_LEAF_CAP];
+    sds ele[ZBT_LEAF_CAP];
+} zbtLeaf;
+
+/* Inner nodes keep, for every child, the number of elements in its subtree
+ * (so that ranks are O(log N)) and the first (score, element) of the subtree.
+ * The element is not a copy: it is the same sds stored in the leaf. */
+typedef struct zbtInner {
+    uint32_t count;
+    unsigned long size[ZBT_INNER_CAP];
+    void *child[ZBT_INNER_CAP];
+    double score[ZBT_INNER_CAP];
+    sds ele[ZBT_INNER_CAP];
+} zbtInner;
+
+typedef struct zbtree {
+    void *root;             /* A leaf when height is 0. */
+    zbtLeaf *head, *tail;
+    unsigned long length;
+    unsigned long leaves, inners;
+    int height;
+} zbtree;
+
+/* Position of an element. Valid until the tree is modified. */
+typedef struct zbtIter {
+    zbtLeaf *leaf;
+    int idx;
+} zbtIter;
+
+#define zbtIterScore(it) ((it)->leaf->score[(it)->idx])
+#define zbtIterEle(it) ((it)->leaf->ele[(it)->idx])
+
+/* Monotonic predicate on the elements, used to seek ranges. */
+typedef int zbtPredicate(double score, sds ele, void *privdata);
+
+zbtree *zbtCreate(void);
+void zbtFree(zbtree *zbt);
+void zbtInsert(zbtree *zbt, double score, sds ele);
+int zbtDelete(zbtree *zbt, double score, sds ele, sds *removed);
+void zbtUpdateScore(zbtree *zbt, double curscore, sds ele, double newscore);
+unsigned long zbtGetRank(zbtree *zbt, double score, sds ele);
+int zbtGetElementByRank(zbtree *zbt, unsigned long rank, zbtIter *it);
+int zbtFirst(zbtree *zbt, zbtIter *it);
+int zbtLast(zbtree *zbt, zbtIter *it);
+int zbtFirstWhere(zbtree *zbt, zbtPredicate *pred, void *privdata, zbtIter *it, unsigned long *rank);
+int zbtLastWhere(zbtree *zbt, zbtPredicate *pred, void *privdata, zbtIter *it, unsigned long *rank);
+int zbtNext(zbtIter *it);
+int zbtPrev(zbtIter *it);
+void zbtReplaceEle(zbtree *zbt, double score, sds oldele, sds newele);
+size_t zbtAllocSize(zbtree *zbt);
+
+#ifdef REDIS_TEST
+int zbtreeTest(int argc, char *argv[], int flags);
+#endif
+
+#endif
@@ -411,4 +411,142 @@ start_server {} {
     } {OK}
 }
 
+start_server {} {
+    test "RDB load with rdb-load-threads" {
+        r select 1
+        r debug populate 1000 key 100
+        r select 0
+        r debug populate 1000 key 10
+        for {set j 1} {$j <= 50} {incr j} {
+            # Small and large encodings of every type.
+            r rpush list:$j {*}[lrepeat [expr {$j*10}] a b c]
+            r sadd set:$j {*}[lrepeat [expr {$j*10}] 1 2 3]
+            for {set i 0} {$i < $j*4} {incr i} {
+                r hset hash:$j f$i v$i
+                r zadd zset:$j $i m$i
+                r sadd strset:$j m$i
+            }
+            r xadd stream:$j * f v
+            r set big:$j [string repeat x [expr {$j*1000}]]
+            r set int:$j [expr {$j*100000}]
+            r set ttl:$j v ex 10000
+        }
+        set digest [debug_digest]
+
+        r config set rdb-load-threads 4
+        r debug reload
+        assert_equal [debug_digest] $digest
+        r config set rdb-load-threads 0
+    }
+}
+
+set corrupt_path [tmpdir "server.rdb-load-threads-corrupt"]
+
+start_server [list overrides [list "dir" $corrupt_path] keep_persistence true] {
+    r debug populate 1000
+    r sadd corrupt:intset 1 2 3
+    r save
+}
+
+# Corrupt the encoding of the intset, the first byte after its length.
+set fd [open [file join $corrupt_path dump.rdb] r+]
+fconfigure $fd -translation binary
+set pos [string first "corrupt:intset" [read $fd]]
+seek $fd [expr {$pos + [string length "corrupt:intset"] + 1}]
+puts -nonewline $fd "\x03"
+close $fd
+
+start_server_and_kill_it [list "dir" $corrupt_path "rdb-load-threads" 2] {
+    test {Server should not start if a value built by a loader thread is corrupted} {
+        wait_for_condition 50 100 {
+            [string match {*Terminating server after rdb file reading failure*} \
+                [exec tail -1 < [dict get $srv stdout]]]
+        } else {
+            fail "Server started even if a value was corrupted!"
+        }
+        assert_equal 1 [count_message_lines [dict get $srv stdout] "Internal error in RDB loader thread"]
+        assert_equal 1 [count_message_lines [dict get $srv stdout] "Failed loading the key framed at offset"]
+    }
+}
+
+start_server {} {
+    test "bgsave with rdb-bgsave-method thread saves the dataset of when it started" {
+        r config set rdb-bgsave-method thread
+        r debug populate 1000
+        for {set j 0} {$j < 100} {incr j} {
+            r rpush list:$j a b c
+            r hset hash:$j f v
+            r zadd zset:$j 1 a
+            r sadd set:$j x
+            r xadd stream:$j 1-1 f v
+            r set ttl:$j v ex 10000
+        }
+        set digest [debug_digest]
+
+        r config set rdb-key-save-delay 1000
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        for {set j 0} {$j < 100} {incr j} {
+            r rpush list:$j d
+            r del hash:$j
+            r sadd set:$j y
+            r zincrby zset:$j 5 a
+            r xgroup create stream:$j g 0
+            r persist ttl:$j
+            r expire key:$j 1000
+            r set key:[expr {$j+100}] new
+            r set new:$j x
+        }
+        r config set rdb-key-save-delay 0
+        waitForBgsave r
+        assert_equal [s rdb_last_bgsave_method] thread
+        assert_equal [s rdb_last_bgsave_status] ok
+        assert_morethan [s rdb_snapshot_captured_keys] 0
+        assert_morethan [s rdb_snapshot_copied_values] 0
+
+        r debug reload nosave
+        assert_equal [debug_digest] $digest
+    }
+
+    test "bgsave with rdb-bgsave-method thread while values are read" {
+        r flushall
+        # Lookups in the set do rehashing steps, reads of the list decompress
+        # its nodes, while the thread serializes them.
+        r eval {for i=1,1048577 do redis.call('sadd',KEYS[1],'m'..i) end} 1 set
+        r config set list-compress-depth 1
+        r eval {for i=1,100000 do redis.call('rpush',KEYS[1],'e'..i) end} 1 list
+        set digest [debug_digest]
+
+        r bgsave
+        set rd [redis_deferring_client]
+        while {[s rdb_bgsave_in_progress]} {
+            for {set j 0} {$j < 100} {incr j} {
+                $rd sismember set m[expr {$j*10000+1}]
+                $rd lindex list [expr {$j*1000}]
+            }
+            for {set j 0} {$j < 100} {incr j} {
+                assert_equal 1 [$rd read]
+                assert_equal e[expr {$j*1000+1}] [$rd read]
+            }
+        }
+        $rd close
+        assert_equal [s rdb_last_bgsave_status] ok
+
+        r debug reload nosave
+        assert_equal [debug_digest] $digest
+        r config set list-compress-depth 0
+    } {OK}
+
+    test "flushall kills a bgsave done by a thread" {
+        r config set rdb-key-save-delay 100000
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        r flushall
+        assert_equal [s rdb_bgsave_in_progress] 0
+        assert_equal [r dbsize] 0
+        r config set rdb-key-save-delay 0
+        r config set rdb-bgsave-method fork
+    } {OK}
+}
+
 } ;# tags
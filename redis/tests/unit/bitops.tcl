@@ -546,6 +546,42 @@ start_server {tags {"bitops"}} {
             }
         }
     }
+
+    test {BITCOUNT/BITPOS/BITOP results do not depend on the SIMD kernels} {
+        # Large bitmaps made of runs of zeros or ones with a few random
+        # bytes, and random offsets, so that the kernels tails are checked.
+        set bitmaps {}
+        for {set j 0} {$j < 20} {incr j} {
+            set len [expr {[randomInt 20000]+1}]
+            set a [string repeat [expr {$j % 2 ? "\xff" : "\x00"}] $len]
+            set pos [randomInt $len]
+            set a [string replace $a $pos $pos [randstring 1 1 binary]]
+            set b [string repeat "\xff" [randomInt 20000]]
+            lappend bitmaps $a $b [randomInt 100]
+        }
+
+        set results {}
+        foreach simd {0 1} {
+            r debug set-simd $simd
+            set res {}
+            foreach {a b start} $bitmaps {
+                r set a{t} $a
+                r set b{t} $b
+                lappend res [r bitcount a{t}] [r bitcount a{t} $start -1]
+                lappend res [r bitcount a{t} [expr {$start*8+3}] -5 bit]
+                lappend res [r bitpos a{t} 0] [r bitpos a{t} 1]
+                lappend res [r bitpos a{t} 0 $start] [r bitpos a{t} 1 $start]
+                foreach op {and or xor} {
+                    r bitop $op dst{t} a{t} b{t} a{t}
+                    lappend res [r get dst{t}]
+                }
+                r bitop not dst{t} a{t}
+                lappend res [r get dst{t}]
+            }
+            lappend results $res
+        }
+        assert_equal [lindex $results 0] [lindex $results 1]
+    } {} {needs:debug}
 }
 
 run_solo {bitops-large-memory} {
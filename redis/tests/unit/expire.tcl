@@ -746,3 +746,74 @@ start_server {tags {"expire"}} {
         assert_equal [r EXPIRE none 100 LT] 0
     } {}
 }
+
+start_server {tags {"expire external:skip"} overrides {active-expire-index yes}} {
+    test {Active expire with the expires index reclaims all the due keys} {
+        r flushall
+        r debug set-active-expire 0
+        for {set j 0} {$j < 1000} {incr j} {
+            r psetex due:$j 100 a
+            r setex later:$j 1000 a
+        }
+        after 200
+        assert_equal 2000 [r dbsize]
+        r config resetstat
+        r debug set-active-expire 1
+        wait_for_condition 20 100 {
+            [r dbsize] eq 1000
+        } fail {
+            "Due keys did not actively expire."
+        }
+        assert_equal 1000 [s expired_active_keys]
+        assert {[s expired_reclaim_lag_max_ms] >= 100}
+        assert_equal {} [r keys due:*]
+    } {} {needs:debug}
+
+    test {Expires index follows the changes of the expires} {
+        r flushall
+        r debug set-active-expire 0
+        # Updated, removed, renamed, moved and swapped expires.
+        r psetex a 100 a
+        r pexpire a 100000
+        r psetex b 100 b
+        r persist b
+        r psetex c 100 c
+        r set c c
+        r psetex d 100000 d
+        r pexpire d 100
+        r psetex e 100 e
+        r rename e f
+        r psetex g 100 g
+        r del g
+        r select 10
+        r psetex h 100 h
+        r move h 9
+        r select 9
+        r psetex k 100 k
+        r swapdb 9 11
+        r swapdb 9 11
+        r debug reload
+        after 200
+        r debug set-active-expire 1
+        wait_for_condition 20 100 {
+            [r dbsize] eq 3
+        } fail {
+            "Keys did not actively expire."
+        }
+        lsort [r keys *]
+    } {a b c} {needs:debug}
+
+    test {Expires index is emptied by FLUSHDB} {
+        foreach async {sync async} {
+            r flushall
+            r debug set-active-expire 0
+            r psetex a 100 a
+            r flushdb $async
+            r set a a
+            after 200
+            r debug set-active-expire 1
+            after 300
+            assert_equal 1 [r exists a]
+        }
+    } {} {needs:debug}
+}
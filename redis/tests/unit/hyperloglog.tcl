@@ -201,6 +201,36 @@ start_server {tags {"hll"}} {
         llength [r pfdebug getreg hll]
     } {16384} {needs:pfdebug}
 
+    test {PFCOUNT / PFMERGE results do not depend on the SIMD kernels} {
+        # The scalar code is the reference for the SIMD kernels, if any.
+        set results {}
+        foreach simd {0 1} {
+            r debug set-simd $simd
+            r del hll1{t} hll2{t} hll3{t} hll4{t} hll5{t}
+            set e1 {}
+            set e2 {}
+            for {set j 0} {$j < 10000} {incr j} {lappend e1 $j}
+            for {set j 5000} {$j < 8000} {incr j} {lappend e2 $j}
+            r pfadd hll1{t} {*}$e1
+            r pfadd hll2{t} {*}$e2
+            r pfadd hll3{t} a b c d e f g
+            r pfadd hll4{t} x y z 1 2 3
+            assert_equal dense [r pfdebug encoding hll1{t}]
+            assert_equal sparse [r pfdebug encoding hll3{t}]
+
+            set res {}
+            lappend res [r pfcount hll1{t}] [r pfcount hll2{t}]
+            lappend res [r pfcount hll1{t} hll2{t} hll3{t} hll4{t}]
+            r pfmerge hll5{t} hll1{t} hll2{t} hll3{t}
+            r pfmerge hll2{t} hll4{t}
+            lappend res [r get hll5{t}] [r get hll2{t}]
+            r pfdebug todense hll4{t}
+            lappend res [r get hll4{t}]
+            lappend results $res
+        }
+        assert_equal [lindex $results 0] [lindex $results 1]
+    } {} {needs:pfdebug needs:debug}
+
     test {PFADD / PFCOUNT cache invalidation works} {
         r del hll
         r pfadd hll a b c
@@ -231,6 +231,9 @@ start_server {tags {"introspection"}} {
             logfile
             dir
             socket-mark-id
+            keyspace-open-addressing
+            keyspace-embed-keys
+            active-expire-index
         }
 
         if {!$::tls} {
@@ -36,6 +36,59 @@ start_server {tags {"memefficiency external:skip"}} {
     }
 }
 
+proc test_keyspace_bytes_per_key {keylen vallen} {
+    r flushall
+    set base_mem [s used_memory]
+    # DEBUG POPULATE names the keys <prefix>:<j>, less than 10 bytes longer.
+    r debug populate 10000 [string repeat k $keylen] $vallen
+    set used [expr {[s used_memory]-$base_mem}]
+    return [expr {$used/10000}]
+}
+
+foreach embed {no yes} {
+    start_server [list tags {"memefficiency external:skip"} overrides [list keyspace-embed-keys $embed]] {
+        foreach {keylen vallen} {
+            1     8
+            16    16
+            32    100
+            100   1000
+        } {
+            set per_key($embed,$keylen,$vallen) [test_keyspace_bytes_per_key $keylen $vallen]
+            if {$::verbose} {
+                puts "keyspace-embed-keys $embed key $keylen+ value $vallen: $per_key($embed,$keylen,$vallen) bytes per key"
+            }
+        }
+
+        test "Keyspace memory reporting with keyspace-embed-keys $embed" {
+            r flushall
+            r debug populate 1000 key 10
+            r expire key:0 100
+            assert_morethan [s mem_keyspace_overhead] [expr {1000*16}]
+            if {$embed} {
+                # At least the name and null term of the 1000 keys
+                assert_morethan_equal [s mem_keyspace_embedded_keys] [expr {1000*6}]
+            } else {
+                assert_equal [s mem_keyspace_embedded_keys] 0
+            }
+            assert_match "key_sds_len:5,*" [r debug sdslen key:0]
+            r del key:0
+            r flushall
+            assert_equal [s mem_keyspace_embedded_keys] 0
+        }
+
+        # Allocators with no size classes may use more usable bytes for one
+        # allocation than for two, even if saving the overhead of one.
+        if {$embed && [string match {*jemalloc*} [s mem_allocator]]} {
+            test "Embedded keys use less memory per key" {
+                foreach key [array names per_key no,*] {
+                    set size [string range $key 3 end]
+                    assert_lessthan $per_key(yes,$size) $per_key(no,$size)
+                }
+            }
+        }
+    }
+}
+
 run_solo {defrag} {
 start_server {tags {"defrag external:skip"} overrides {appendonly yes auto-aof-rewrite-percentage 0 save ""}} {
     if {[string match {*jemalloc*} [s mem_allocator]] && [r debug mallctl arenas.page] <= 8192} {
@@ -163,3 +163,144 @@ start_server {config "minimal.conf" tags {"external:skip"}} {
         }
     }
 }
+
+start_server {config "minimal.conf" tags {"external:skip"} overrides {io-threads 2 io-threads-do-reads yes io-threads-do-commands yes}} {
+    test {Read only commands executed by the I/O threads} {
+        r set str value
+        r hset hash field 1
+        r zadd zset 1.5 member
+        r config resetstat
+
+        set clients {}
+        for {set j 0} {$j < 10} {incr j} {
+            lappend clients [redis_deferring_client]
+        }
+        # Enough clients with pending replies to keep the threads active.
+        wait_for_condition 50 100 {
+            [foreach rd $clients {
+                for {set i 0} {$i < 20} {incr i} {
+                    $rd get str
+                    $rd hget hash field
+                    $rd zscore zset member
+                    $rd get missing
+                    $rd hget str field
+                    $rd set str value
+                }
+                $rd flush
+            }
+            foreach rd $clients {
+                for {set i 0} {$i < 20} {incr i} {
+                    assert_equal value [$rd read]
+                    assert_equal 1 [$rd read]
+                    assert_equal 1.5 [$rd read]
+                    assert_equal {} [$rd read]
+                    assert_error {WRONGTYPE*} {$rd read}
+                    assert_equal OK [$rd read]
+                }
+            }
+            s io_threaded_commands_processed] > 0
+        } else {
+            fail "No command was executed by the I/O threads"
+        }
+
+        # Hits, misses and errors are accounted as on the main thread.
+        set misses [s keyspace_misses]
+        assert_equal [s keyspace_hits] [expr {$misses * 4}]
+        assert_equal $misses [s total_error_replies]
+        assert_match "*errorstat_WRONGTYPE:count=$misses\r*" [r info errorstats]
+        assert_match "*cmdstat_hget:calls=[expr {$misses * 2}],*failed_calls=$misses\r*" [r info commandstats]
+
+        foreach rd $clients {
+            $rd close
+        }
+    }
+}
+
+start_server {config "minimal.conf" tags {"external:skip"}} {
+    proc pipeline_commands {rd commands} {
+        set buf {}
+        foreach cmd $commands {
+            append buf "*[llength $cmd]\r\n"
+            foreach arg $cmd {
+                append buf "\$[string length $arg]\r\n$arg\r\n"
+            }
+        }
+        $rd write $buf
+        $rd flush
+    }
+
+    test {Pipelined commands with their keys prefetched} {
+        for {set j 0} {$j < 100} {incr j} {
+            r set key:$j $j
+        }
+        r expire key:0 100
+        r config resetstat
+        set rd [redis_deferring_client]
+
+        set commands {}
+        for {set j 0} {$j < 100} {incr j} {
+            lappend commands [list get key:$j]
+        }
+        lappend commands {mget key:1 missing key:2} {mset a 1 b 2} {select 8} {get key:3} {select 9}
+        lappend commands {del a b} {object encoding key:4} {hset key:5 f v} {get key:6}
+        pipeline_commands $rd $commands
+        for {set j 0} {$j < 100} {incr j} {
+            assert_equal $j [$rd read]
+        }
+        assert_equal {1 {} 2} [$rd read]
+        assert_equal OK [$rd read]
+        assert_equal OK [$rd read]
+        assert_equal {} [$rd read]
+        assert_equal OK [$rd read]
+        assert_equal 2 [$rd read]
+        assert_equal int [$rd read]
+        assert_error {WRONGTYPE*} {$rd read}
+        assert_equal 6 [$rd read]
+        assert_morethan [s prefetch_batches] 0
+        assert_morethan [s prefetch_keys] 100
+
+        # A command split across reads is prefetched once complete.
+        $rd write "*2\r\n\$3\r\nget\r\n\$5\r\nkey:7\r\n*2\r\n\$3\r\nget\r\n\$5\r\nke"
+        $rd flush
+        assert_equal 7 [$rd read]
+        $rd write "y:8\r\n"
+        $rd flush
+        assert_equal 8 [$rd read]
+        $rd close
+    }
+
+    test {Pipelined commands with an oversized bulk length} {
+        set rd [redis_deferring_client]
+        $rd write "*2\r\n\$3\r\nget\r\n\$5\r\nkey:1\r\n*2\r\n\$3\r\nget\r\n\$9223372036854775807\r\nx\r\n"
+        $rd flush
+        assert_equal 1 [$rd read]
+        assert_error {*invalid bulk length*} {$rd read}
+        $rd close
+        assert_equal PONG [r ping]
+    }
+
+    test {Pipelined commands of unauthenticated clients are not prefetched} {
+        r config set requirepass foobar
+        r auth foobar
+        r config resetstat
+        set rd [redis [srv 0 host] [srv 0 port] 1 $::tls]
+        pipeline_commands $rd {{get key:1} {get key:2} {get key:3}}
+        for {set j 0} {$j < 3} {incr j} {
+            assert_error {NOAUTH*} {$rd read}
+        }
+        assert_equal 0 [s prefetch_batches]
+        $rd close
+        r config set requirepass ""
+    }
+
+    test {Pipelined commands are not prefetched when disabled} {
+        r config set prefetch-batch-max-size 0
+        r config resetstat
+        set rd [redis_deferring_client]
+        pipeline_commands $rd {{get key:1} {get key:2} {get key:3}}
+        assert_equal {1 2 3} [list [$rd read] [$rd read] [$rd read]]
+        assert_equal 0 [s prefetch_batches]
+        $rd close
+        r config set prefetch-batch-max-size 16
+    }
+}
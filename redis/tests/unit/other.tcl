@@ -358,6 +358,62 @@ start_server {tags {"other external:skip"}} {
     } {} {needs:debug needs:local-process}
 }
 
+start_server {tags {"other external:skip"} overrides {keyspace-open-addressing yes}} {
+    test {Open addressing keyspace: SCAN returns all the keys while growing} {
+        r flushall
+        populate 1000 key: 3
+        set keys {}
+        set cursor 0
+        set j 0
+        while 1 {
+            set res [r scan $cursor count 10]
+            set cursor [lindex $res 0]
+            lappend keys {*}[lindex $res 1]
+            # Rehash the table a few times while scanning
+            for {set i 0} {$i < 50 && $j < 5000} {incr i} {
+                r set new:$j x
+                incr j
+            }
+            if {$cursor == 0} break
+        }
+        foreach k [lsort -unique $keys] {
+            if {[string match key:* $k]} {incr found}
+        }
+        assert_equal 1000 $found
+        assert_match "*groups: *avg probe length*" [r debug HTSTATS 9]
+    } {} {needs:debug}
+
+    test {Open addressing keyspace: lookups after deleting keys} {
+        r flushall
+        populate 10000 key: 3
+        for {set j 0} {$j < 10000} {incr j 2} {
+            r del key:$j
+        }
+        assert_equal 5000 [r dbsize]
+        for {set j 0} {$j < 10000} {incr j} {
+            assert_equal [expr {$j % 2}] [r exists key:$j]
+        }
+        r set key:0 B
+        assert_equal B [r get key:0]
+        assert_equal 5001 [llength [r keys *]]
+    }
+
+    test {Open addressing keyspace: keys are actively expired} {
+        r flushall
+        r debug set-active-expire 1
+        for {set j 0} {$j < 1000} {incr j} {
+            r psetex expiring:$j 10 x
+            r set persistent:$j x
+        }
+        wait_for_condition 50 100 {
+            [r dbsize] == 1000
+        } else {
+            fail "Keys not expired"
+        }
+        assert_equal 0 [llength [r keys expiring:*]]
+    } {} {needs:debug}
+}
+
 proc read_proc_title {pid} {
     set fd [open "/proc/$pid/cmdline" "r"]
     set cmdline [read $fd 1024]
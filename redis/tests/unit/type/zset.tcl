@@ -99,12 +99,18 @@ start_server {tags {"zset"}} {
     proc basics {encoding} {
         set original_max_entries [lindex [r config get zset-max-ziplist-entries] 1]
         set original_max_value [lindex [r config get zset-max-ziplist-value] 1]
+        set original_max_skiplist [lindex [r config get zset-max-skiplist-entries] 1]
         if {$encoding == "listpack"} {
             r config set zset-max-ziplist-entries 128
             r config set zset-max-ziplist-value 64
         } elseif {$encoding == "skiplist"} {
             r config set zset-max-ziplist-entries 0
             r config set zset-max-ziplist-value 0
+            r config set zset-max-skiplist-entries 0
+        } elseif {$encoding == "btree"} {
+            r config set zset-max-ziplist-entries 0
+            r config set zset-max-ziplist-value 0
+            r config set zset-max-skiplist-entries 1
         } else {
             puts "Unknown sorted set encoding"
             exit
@@ -112,7 +118,7 @@ start_server {tags {"zset"}} {
 
         test "Check encoding - $encoding" {
             r del ztmp
-            r zadd ztmp 10 x
+            r zadd ztmp 10 x 20 y
             assert_encoding $encoding ztmp
         }
 
@@ -1133,10 +1139,12 @@ start_server {tags {"zset"}} {
 
         r config set zset-max-ziplist-entries $original_max_entries
         r config set zset-max-ziplist-value $original_max_value
+        r config set zset-max-skiplist-entries $original_max_skiplist
     }
 
     basics listpack
     basics skiplist
+    basics btree
 
     test "ZPOP/ZMPOP against wrong type" {
         r set foo{t} bar
@@ -1491,6 +1499,7 @@ start_server {tags {"zset"}} {
     proc stressers {encoding} {
         set original_max_entries [lindex [r config get zset-max-ziplist-entries] 1]
         set original_max_value [lindex [r config get zset-max-ziplist-value] 1]
+        set original_max_skiplist [lindex [r config get zset-max-skiplist-entries] 1]
         if {$encoding == "listpack"} {
             # Little extra to allow proper fuzzing in the sorting stresser
             r config set zset-max-ziplist-entries 256
@@ -1499,7 +1508,17 @@ start_server {tags {"zset"}} {
         } elseif {$encoding == "skiplist"} {
             r config set zset-max-ziplist-entries 0
             r config set zset-max-ziplist-value 0
+            r config set zset-max-skiplist-entries 0
             if {$::accurate} {set elements 1000} else {set elements 100}
+        } elseif {$encoding == "btree"} {
+            # With leaves of up to 62 elements and inner nodes of up to 31
+            # children, 1000 elements make a root over some twenty leaves,
+            # and 5000 a root over a level of inner nodes. More would make
+            # the fuzzy tests, that look up every element, too slow.
+            r config set zset-max-ziplist-entries 0
+            r config set zset-max-ziplist-value 0
+            r config set zset-max-skiplist-entries 1
+            if {$::accurate} {set elements 5000} else {set elements 1000}
         } else {
             puts "Unknown sorted set encoding"
             exit
@@ -1814,7 +1833,10 @@ start_server {tags {"zset"}} {
                 } else {
                     set score [expr rand()]
                     r zadd myzset $score $i
-                    assert_encoding $encoding myzset
+                    # A new sorted set is a skiplist until its second element
+                    if {$encoding ne "btree" || [r zcard myzset] > 1} {
+                        assert_encoding $encoding myzset
+                    }
                 }
 
                 set card [r zcard myzset]
@@ -1940,11 +1962,13 @@ start_server {tags {"zset"}} {
 
         r config set zset-max-ziplist-entries $original_max_entries
         r config set zset-max-ziplist-value $original_max_value
+        r config set zset-max-skiplist-entries $original_max_skiplist
     }
 
     tags {"slow"} {
         stressers listpack
         stressers skiplist
+        stressers btree
     }
 
     test "BZPOP/BZMPOP against wrong type" {